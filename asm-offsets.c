@@ -59,6 +59,8 @@ void AsmOffsetsMain ()
     DEFINE(U_R15,  offsetof(Thread, u_reg[REGISTER_INDEX_R0 + 15]));
     DEFINE(U_CPSR, offsetof(Thread, u_reg[REGISTER_INDEX_PSR]));
 
+    DEFINE(KERNEL_STACK_CEILING, offsetof(Thread, kernel_stack.ceiling));
+
     DEFINE(SPINLOCK_LOCKVAL_LOCKED, SPINLOCK_LOCKVAL_LOCKED);
     DEFINE(SPINLOCK_LOCKVAL_UNLOCKED, SPINLOCK_LOCKVAL_UNLOCKED);
 
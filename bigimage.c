@@ -0,0 +1,11 @@
+#include <stdint.h>
+
+/*
+ * Initialized, so that it's part of the image on disk and has to be
+ * copied in whole every time this program is spawned
+ */
+static volatile uint8_t ballast[1024 * 1024] = { 1 };
+
+int main () {
+    return ballast[0] == 1 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <muos/arch.h>
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+/* Message sizes timed, echoed back whole by the server */
+static size_t const sizes[] = {
+    4 * 1024,
+    64 * 1024,
+};
+
+#define NUM_SIZES       (sizeof(sizes) / sizeof(sizes[0]))
+#define MAX_BYTES       (64 * 1024)
+
+/* Round trips of each size */
+#define ROUNDS          2000
+
+/*
+ * Nanoseconds per round trip of each of sizes[], in the same order, as
+ * timed by the child that sends them: the message copied from its
+ * address space into the server's, and the reply back. Consecutive
+ * trips reuse the same buffers, so each copy finds the pages the last
+ * one translated. Left here to be read from the debugger.
+ */
+static volatile uint32_t trip_ns[NUM_SIZES];
+
+/* What the child sends once it's done, told apart from a trip by length */
+struct Report
+{
+    uint32_t trip_ns[NUM_SIZES];
+};
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static void client (int coid, unsigned char * buf, unsigned char * reply)
+{
+    struct Report report;
+    unsigned int i;
+    unsigned int n;
+
+    for (i = 0; i < NUM_SIZES; i++) {
+        uint64_t start = now();
+
+        for (n = 0; n < ROUNDS; n++) {
+            int len = MessageSend(coid, buf, sizes[i], reply, sizes[i]);
+            assert(len == (int)sizes[i]);
+        }
+
+        report.trip_ns[i] = (now() - start) / ROUNDS;
+
+        assert(memcmp(reply, buf, sizes[i]) == 0);
+    }
+
+    assert(MessageSend(coid, &report, sizeof(report), NULL, 0) == 0);
+}
+
+static void serve (int chid, unsigned char * buf)
+{
+    for (;;) {
+        int msgid;
+        int n = MessageReceive(chid, &msgid, buf, MAX_BYTES);
+
+        assert(msgid != 0);
+
+        if (n == sizeof(struct Report)) {
+            struct Report const * report = (struct Report const *)buf;
+            unsigned int i;
+
+            for (i = 0; i < NUM_SIZES; i++) {
+                trip_ns[i] = report->trip_ns[i];
+            }
+
+            MessageReply(msgid, 0, NULL, 0);
+            break;
+        }
+
+        /* Echo back whatever arrived */
+        MessageReply(msgid, 0, buf, n);
+    }
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    unsigned char * buf = malloc(MAX_BYTES);
+    unsigned char * reply = malloc(MAX_BYTES);
+    struct Pulse pulse;
+    unsigned int i;
+    int wait_id;
+    int msgid;
+    int pid;
+
+    assert(buf != NULL && reply != NULL);
+
+    for (i = 0; i < MAX_BYTES; i++) {
+        buf[i] = (unsigned char)(i * 13);
+    }
+
+    pid = Fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        /* Child sends, over the connection it inherited */
+        client(coid, buf, reply);
+        return 0;
+    }
+
+    wait_id = ChildWaitAttach(coid, pid);
+    ChildWaitArm(wait_id, 1);
+
+    /* Parent owns the channel, so it serves */
+    serve(chid, reply);
+
+    assert(MessageReceive(chid, &msgid, &pulse, sizeof(pulse)) == sizeof(pulse));
+    assert(msgid == 0);
+    assert(pulse.type == PULSE_TYPE_CHILD_FINISH);
+
+    ChildWaitDetach(wait_id);
+
+    for (i = 0; i < NUM_SIZES; i++) {
+        assert(trip_ns[i] != 0);
+    }
+
+    free(reply);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/error.h>
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+#define MSEC    ((uint64_t)1000 * 1000)
+
+/* CPU time the child burns before it quits */
+#define BURN    (30 * MSEC)
+
+/* Sleeps the child takes afterwards; each one blocks it */
+#define NAPS    5
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static uint64_t own_run_time (void)
+{
+    struct ProcessTimes times;
+
+    assert(GetProcessTimes(SELF_PID, &times) == ERROR_OK);
+    return times.run_ns;
+}
+
+static void run_child (void)
+{
+    uint64_t last = own_run_time();
+    unsigned int i;
+
+    /* Run time never goes backwards, and keeps up with the work */
+    while (last < BURN) {
+        uint64_t t = own_run_time();
+
+        assert(t >= last);
+        last = t;
+    }
+
+    for (i = 0; i < NAPS; i++) {
+        assert(NanoSleep(MSEC) == 0);
+    }
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    struct ProcessTimes before;
+    struct ProcessTimes after;
+    struct ProcessTimes self;
+    uint64_t start;
+    uint64_t elapsed;
+    int wait_id;
+    int pid;
+
+    assert(GetProcessTimes(SELF_PID, &self) == ERROR_OK);
+    assert(GetProcessTimes(-1, &self) < 0);
+
+    /* Nobody's been reaped yet */
+    assert(GetChildTimes(&before) == ERROR_OK);
+    assert(before.run_ns == 0);
+
+    start = now();
+    pid = Fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        run_child();
+        return 0;
+    }
+
+    wait_id = ChildWaitAttach(coid, pid);
+    ChildWaitArm(wait_id, 1);
+
+    {
+        struct Pulse pulse;
+        int msgid;
+        size_t n = MessageReceive(chid, &msgid, &pulse, sizeof(pulse));
+
+        assert(n == sizeof(struct Pulse));
+        assert(msgid == 0);
+        assert(pulse.type == PULSE_TYPE_CHILD_FINISH);
+        assert((int)pulse.value == pid);
+    }
+
+    elapsed = now() - start;
+
+    /* Reaped, so only its share of the totals is left */
+    assert(GetProcessTimes(pid, &self) < 0);
+    assert(GetChildTimes(&after) == ERROR_OK);
+
+    assert(after.run_ns >= BURN);
+
+    /* It can't have run for longer than it was around */
+    assert(after.run_ns <= elapsed);
+
+    /* Each nap, and each query of its own times, blocks it */
+    assert(after.voluntary_switches >= NAPS);
+
+    ChildWaitDetach(wait_id);
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/arch.h>
+#include <muos/io.h>
+#include <muos/timer.h>
+
+/*
+ * The board's PL110 color LCD controller. It scans the screen out of
+ * system RAM, so the only memory of its own is the palette: 256 16-bit
+ * entries, two to a word, in the page of its registers.
+ */
+#if defined(BOARD_REALVIEW_EB_MPCORE)
+    #define CLCD_PHYS       0x10020000
+#else
+    #define CLCD_PHYS       0x10120000
+#endif
+
+#define PALETTE_OFFSET      0x200
+#define PALETTE_WORDS       (256 / 2)
+
+/* Whole-palette fills done with each memory type */
+#define FILLS               4096
+
+static CacheAttr_t const attrs[] = {
+    CACHE_ATTR_STRONGLY_ORDERED,
+    CACHE_ATTR_DEVICE,
+    CACHE_ATTR_WRITE_COMBINING,
+};
+
+#define NUM_ATTRS           (sizeof(attrs) / sizeof(attrs[0]))
+
+/*
+ * Nanoseconds per whole-palette fill with each of attrs[], in the same
+ * order. Left here to be read from the debugger.
+ */
+static volatile uint64_t fill_ns[NUM_ATTRS];
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static void fill (volatile uint32_t * palette, uint32_t colors)
+{
+    unsigned int i;
+
+    for (i = 0; i < PALETTE_WORDS; i++) {
+        palette[i] = colors;
+    }
+}
+
+static int check (volatile uint32_t const * palette, uint32_t colors)
+{
+    unsigned int i;
+
+    for (i = 0; i < PALETTE_WORDS; i++) {
+        if (palette[i] != colors) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int main () {
+    unsigned int i;
+    unsigned int n;
+
+    /* Not a memory type */
+    assert(MapPhysical(CLCD_PHYS, PAGE_SIZE, (CacheAttr_t)99) == NULL);
+
+    for (i = 0; i < NUM_ATTRS; i++) {
+        volatile uint32_t * palette;
+        void * clcd;
+        uint32_t colors = 0;
+        uint64_t start;
+
+        clcd = MapPhysical(CLCD_PHYS, PAGE_SIZE, attrs[i]);
+        assert(clcd != NULL);
+
+        palette = (volatile uint32_t *)((uintptr_t)clcd + PALETTE_OFFSET);
+
+        start = now();
+
+        for (n = 0; n < FILLS; n++) {
+            /* Same 5-5-5 color in both entries of the word */
+            colors = (n * 0x0421) & 0x7fff;
+            colors |= colors << 16;
+
+            fill(palette, colors);
+        }
+
+        fill_ns[i] = (now() - start) / FILLS;
+
+        /* Whatever the memory type, the last fill is what's there */
+        assert(check(palette, colors));
+
+        assert(Unmap(clcd, PAGE_SIZE) == 0);
+    }
+
+    return 0;
+}
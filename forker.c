@@ -0,0 +1,139 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+/* Big enough that copying it all up front would be noticeable */
+#define HEAP_BYTES (1024 * 1024)
+
+/* Program carrying about as much initialized data as the heap here */
+#define BIG_IMAGE   "bigimage"
+
+/*
+ * How long it takes to fork this process, with HEAP_BYTES of heap, and
+ * to spawn BIG_IMAGE, each counted until the new process has exited;
+ * and how long the forked child's first write into the shared heap
+ * takes. Left here to be read from the debugger.
+ */
+static volatile uint64_t fork_ns;
+static volatile uint64_t spawn_ns;
+static volatile uint32_t first_write_ns;
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static int check (unsigned char const * buf, unsigned char pattern)
+{
+    size_t i;
+
+    for (i = 0; i < HEAP_BYTES; i++) {
+        if (buf[i] != pattern) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static struct Pulse receive_pulse (int chid)
+{
+    struct Pulse pulse;
+    int msgid;
+    size_t n = MessageReceive(chid, &msgid, &pulse, sizeof(pulse));
+
+    assert(n == sizeof(struct Pulse));
+    assert(msgid == 0);
+
+    return pulse;
+}
+
+static void await_child (int chid, int coid, int pid)
+{
+    int wait_id = ChildWaitAttach(coid, pid);
+
+    ChildWaitArm(wait_id, 1);
+    assert(receive_pulse(chid).type == PULSE_TYPE_CHILD_FINISH);
+    ChildWaitDetach(wait_id);
+}
+
+int main () {
+    unsigned char * heap = malloc(HEAP_BYTES);
+    uint64_t start;
+    int chid;
+    int coid;
+    int pid;
+
+    assert(heap != NULL);
+    memset(heap, 0xa5, HEAP_BYTES);
+
+    chid = ChannelCreate();
+    coid = Connect(SELF_PID, chid);
+
+    start = now();
+    pid = Spawn(BIG_IMAGE);
+    assert(pid >= 0);
+    await_child(chid, coid, pid);
+    spawn_ns = now() - start;
+
+    start = now();
+    pid = Fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        return 0;
+    }
+    await_child(chid, coid, pid);
+    fork_ns = now() - start;
+
+    pid = Fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        uint32_t took_ns;
+
+        /* Child starts out seeing the parent's memory... */
+        assert(check(heap, 0xa5));
+
+        /* ...copies only the page it writes to... */
+        start = now();
+        heap[HEAP_BYTES / 2] = 0x5a;
+        took_ns = now() - start;
+
+        assert(MessageSend(coid, &took_ns, sizeof(took_ns), NULL, 0) == 0);
+
+        /* ...and its writes stay private */
+        memset(heap, 0x5a, HEAP_BYTES);
+        assert(check(heap, 0x5a));
+
+        return 0;
+    }
+
+    /* Hear how long its first write took... */
+    {
+        uint32_t took_ns;
+        int msgid;
+        size_t n = MessageReceive(chid, &msgid, &took_ns, sizeof(took_ns));
+
+        assert(n == sizeof(took_ns));
+        assert(msgid != 0);
+        MessageReply(msgid, 0, NULL, 0);
+
+        first_write_ns = took_ns;
+    }
+
+    /* ...and wait for the child to be done scribbling over its copy */
+    await_child(chid, coid, pid);
+
+    assert(check(heap, 0xa5));
+
+    free(heap);
+    return 0;
+}
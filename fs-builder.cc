@@ -12,6 +12,14 @@
     #include <getopt.h>
 #endif
 
+/*
+ * Every payload is padded out to start at a multiple of this many
+ * bytes from the beginning of the image, so that the kernel can map
+ * files straight into processes. Must agree with RAMFS_PAYLOAD_ALIGNMENT
+ * in include/kernel/ramfs.h.
+ */
+static const size_t PAYLOAD_ALIGNMENT = 4096;
+
 struct InputFile {
 
     InputFile (const std::string & name)
@@ -112,6 +120,14 @@ int main (int argc, char *argv[]) {
                                      ((payload_len & 0x000000ff) >> 0)};
         outputFile.write((char const *)payload_len_be, sizeof(payload_len_be));
 
+        /* Zero padding up to the next alignment boundary */
+        for (size_t offset = outputFile.tellp();
+             offset % PAYLOAD_ALIGNMENT != 0;
+             offset++)
+        {
+            outputFile.put('\0');
+        }
+
         /* Payload */
         for (size_t remaining = inputFiles[i]->mSize;
              remaining > 0;)
@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/arch.h>
+#include <muos/atomic.h>
+#include <muos/futex.h>
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/shm.h>
+#include <muos/timer.h>
+
+/* Lock/unlock pairs made by each process */
+#define ROUNDS          20000
+
+/* Processes fighting over the lock at once */
+#define CONTENDERS      4
+
+/* Loop iterations spent holding the lock, to give others time to pile up */
+#define HOLD_SPINS      20
+
+/* Lives in shared memory, so that every contender sees the same lock */
+struct Shared
+{
+    struct Mutex    lock;
+    uint32_t        counter;
+    int             ready;
+    int             done;
+};
+
+/*
+ * Nanoseconds per lock/unlock pair with the lock all to one process,
+ * and with CONTENDERS processes taking turns at it; and per call of
+ * FutexWake() on a word nobody waits on, the cheapest trip into the
+ * kernel the lock could make. Left here to be read from the debugger.
+ */
+static volatile uint64_t uncontended_ns;
+static volatile uint64_t contended_ns;
+static volatile uint64_t syscall_ns;
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static void hammer (struct Shared * shared)
+{
+    unsigned int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        volatile unsigned int spin;
+        uint32_t counter;
+
+        MutexLock(&shared->lock);
+
+        /* Read and written back separately, so that overlap would show */
+        counter = shared->counter;
+
+        for (spin = 0; spin < HOLD_SPINS; spin++) {
+        }
+
+        shared->counter = counter + 1;
+
+        MutexUnlock(&shared->lock);
+    }
+}
+
+static void contender (struct Shared * shared)
+{
+    AtomicAddAndFetch(&shared->ready, 1);
+
+    while (shared->ready < CONTENDERS + 1) {
+        NanoSleep(1000 * 1000);
+    }
+
+    hammer(shared);
+
+    AtomicAddAndFetch(&shared->done, 1);
+}
+
+int main () {
+    struct Shared * shared;
+    uint32_t unwaited = 0;
+    uint64_t start;
+    unsigned int i;
+
+    shared = SharedMemoryCreate("futexbench", PAGE_SIZE);
+    assert(shared != NULL);
+    MutexInit(&shared->lock);
+
+    start = now();
+    for (i = 0; i < ROUNDS; i++) {
+        assert(FutexWake(&unwaited, 1) == 0);
+    }
+    syscall_ns = (now() - start) / ROUNDS;
+
+    start = now();
+    hammer(shared);
+    uncontended_ns = (now() - start) / ROUNDS;
+
+    /* Shared memory stays shared across Fork() */
+    for (i = 0; i < CONTENDERS; i++) {
+        int pid = Fork();
+
+        assert(pid >= 0);
+
+        if (pid == 0) {
+            contender(shared);
+            return 0;
+        }
+    }
+
+    while (shared->ready < CONTENDERS) {
+        NanoSleep(1000 * 1000);
+    }
+
+    start = now();
+    AtomicAddAndFetch(&shared->ready, 1);
+
+    while (shared->done < CONTENDERS) {
+        NanoSleep(1000 * 1000);
+    }
+
+    contended_ns = (now() - start) / (CONTENDERS * ROUNDS);
+
+    /* No increment was lost to two holders at once */
+    assert(shared->counter == (CONTENDERS + 1) * ROUNDS);
+
+    /* Taking a free lock never costs a trip into the kernel */
+    assert(uncontended_ns < syscall_ns);
+
+    SharedMemoryUnlink("futexbench");
+
+    return 0;
+}
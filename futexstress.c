@@ -0,0 +1,140 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/arch.h>
+#include <muos/atomic.h>
+#include <muos/futex.h>
+#include <muos/process.h>
+#include <muos/shm.h>
+#include <muos/timer.h>
+
+/* Times the turn is handed over, each way */
+#define HANDOFFS        20000
+
+/* Processes taking the mutex alongside the handoffs, and how often */
+#define LOCKERS         3
+#define LOCK_ROUNDS     20000
+
+/* A second with nothing done means somebody slept through a wakeup */
+#define WATCHDOG_NS     ((uint64_t)1000 * 1000 * 1000)
+
+/* Lives in shared memory, so that every process sees the same words */
+struct Shared
+{
+    /* Which of the two handoff processes may go next */
+    volatile uint32_t   turn;
+
+    struct Mutex        lock;
+    uint32_t            locked_count;
+
+    /* Bumped by everyone as they go, for the watchdog */
+    int                 progress;
+    int                 done;
+};
+
+/*
+ * Two processes pass the turn back and forth, each sleeping in
+ * FutexWait() until the other hands it over. A wakeup lost between
+ * one checking the word and going to sleep would leave both asleep.
+ */
+static void handoff (struct Shared * shared, uint32_t me)
+{
+    uint32_t other = !me;
+    unsigned int i;
+
+    for (i = 0; i < HANDOFFS; i++) {
+        uint32_t turn;
+
+        while ((turn = shared->turn) != me) {
+            FutexWait(&shared->turn, turn);
+        }
+
+        AtomicAddAndFetch(&shared->progress, 1);
+
+        shared->turn = other;
+        assert(FutexWake(&shared->turn, 1) >= 0);
+    }
+}
+
+/* Meanwhile, others fight over a mutex in the same shared page */
+static void locker (struct Shared * shared)
+{
+    unsigned int i;
+
+    for (i = 0; i < LOCK_ROUNDS; i++) {
+        MutexLock(&shared->lock);
+        shared->locked_count++;
+        MutexUnlock(&shared->lock);
+
+        AtomicAddAndFetch(&shared->progress, 1);
+    }
+}
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static void start_child (struct Shared * shared, int which)
+{
+    int pid = Fork();
+
+    assert(pid >= 0);
+
+    if (pid != 0) {
+        return;
+    }
+
+    if (which < 2) {
+        handoff(shared, which);
+    }
+    else {
+        locker(shared);
+    }
+
+    AtomicAddAndFetch(&shared->done, 1);
+    Exit();
+}
+
+int main () {
+    struct Shared * shared;
+    int last_progress = -1;
+    uint64_t last_change = 0;
+    int which;
+
+    shared = SharedMemoryCreate("futexstress", PAGE_SIZE);
+    assert(shared != NULL);
+    MutexInit(&shared->lock);
+
+    /* Shared memory stays shared across Fork() */
+    for (which = 0; which < 2 + LOCKERS; which++) {
+        start_child(shared, which);
+    }
+
+    while (shared->done < 2 + LOCKERS) {
+        uint64_t t = now();
+
+        if (shared->progress != last_progress) {
+            last_progress = shared->progress;
+            last_change = t;
+        }
+
+        assert(t - last_change < WATCHDOG_NS);
+
+        NanoSleep(10 * 1000 * 1000);
+    }
+
+    assert(shared->progress == 2 * HANDOFFS + LOCKERS * LOCK_ROUNDS);
+    assert(shared->locked_count == LOCKERS * LOCK_ROUNDS);
+
+    /* Nothing's left asleep on either word */
+    assert(FutexWake(&shared->turn, 1) == 0);
+    assert(FutexWake(&shared->lock.state, 1) == 0);
+
+    SharedMemoryUnlink("futexstress");
+
+    return 0;
+}
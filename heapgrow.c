@@ -0,0 +1,112 @@
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <muos/arch.h>
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+/* Heap sizes timed, each granted by one sbrk() call */
+static size_t const sizes[] = {
+    64 * 1024,
+    1024 * 1024,
+    8 * 1024 * 1024,
+};
+
+#define NUM_SIZES   (sizeof(sizes) / sizeof(sizes[0]))
+
+#define ROUNDS      8
+
+/*
+ * Nanoseconds per page to grow the heap by each of sizes[], in the same
+ * order; and nanoseconds for a forked child holding that much heap to
+ * be torn down, from when it's done to its parent hearing it's gone.
+ * Left here to be read from the debugger.
+ */
+static volatile uint32_t grow_ns[NUM_SIZES];
+static volatile uint64_t teardown_ns[NUM_SIZES];
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static void time_grow (unsigned int which)
+{
+    size_t pages = sizes[which] / PAGE_SIZE;
+    uint64_t total = 0;
+    unsigned int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        uint64_t start = now();
+        void * heap = sbrk(sizes[which]);
+
+        total += now() - start;
+
+        assert(heap != (void *)-1);
+        assert(sbrk(-(int)sizes[which]) != (void *)-1);
+    }
+
+    grow_ns[which] = total / ROUNDS / pages;
+}
+
+static void time_teardown (int chid, int coid, unsigned int which)
+{
+    struct Pulse pulse;
+    uint64_t total = 0;
+    unsigned int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        uint64_t start;
+        int wait_id;
+        int msgid;
+        int pid;
+
+        pid = Fork();
+        assert(pid >= 0);
+
+        if (pid == 0) {
+            assert(sbrk(sizes[which]) != (void *)-1);
+
+            /* Tell the parent it's about to go */
+            assert(MessageSend(coid, NULL, 0, NULL, 0) == 0);
+            Exit();
+        }
+
+        wait_id = ChildWaitAttach(coid, pid);
+        ChildWaitArm(wait_id, 1);
+
+        assert(MessageReceive(chid, &msgid, &pulse, sizeof(pulse)) == 0);
+        assert(msgid != 0);
+        MessageReply(msgid, 0, NULL, 0);
+
+        start = now();
+
+        assert(MessageReceive(chid, &msgid, &pulse, sizeof(pulse)) == sizeof(pulse));
+        assert(msgid == 0);
+        assert(pulse.type == PULSE_TYPE_CHILD_FINISH);
+
+        total += now() - start;
+
+        ChildWaitDetach(wait_id);
+    }
+
+    teardown_ns[which] = total / ROUNDS;
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    unsigned int i;
+
+    for (i = 0; i < NUM_SIZES; i++) {
+        time_grow(i);
+        time_teardown(chid, coid, i);
+    }
+
+    return 0;
+}
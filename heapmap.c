@@ -0,0 +1,58 @@
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <muos/arch.h>
+#include <muos/timer.h>
+
+/*
+ * Heap mapped with one sbrk() call and unmapped with another. It's
+ * mapped as it's granted, so each call goes through the pagetable for
+ * all HEAP_PAGES pages at once.
+ */
+#define HEAP_BYTES  (16 * 1024 * 1024)
+#define HEAP_PAGES  (HEAP_BYTES / PAGE_SIZE)
+
+#define ROUNDS      8
+
+/*
+ * Nanoseconds per page to map the heap, and to unmap it, in each
+ * round. The first round also allocates the second-level tables that
+ * later rounds find kept for reuse. Left here to be read from the
+ * debugger.
+ */
+static volatile uint32_t map_ns[ROUNDS];
+static volatile uint32_t unmap_ns[ROUNDS];
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+int main () {
+    unsigned int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        volatile char * heap;
+        uint64_t start;
+
+        start = now();
+        heap = sbrk(HEAP_BYTES);
+        map_ns[i] = (now() - start) / HEAP_PAGES;
+
+        assert(heap != (char *)-1);
+
+        /* Really there, at both ends */
+        heap[0] = 1;
+        heap[HEAP_BYTES - 1] = 1;
+
+        start = now();
+        assert(sbrk(-HEAP_BYTES) != (void *)-1);
+        unmap_ns[i] = (now() - start) / HEAP_PAGES;
+    }
+
+    return 0;
+}
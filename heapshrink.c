@@ -0,0 +1,78 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <muos/arch.h>
+#include <muos/message.h>
+#include <muos/procmgr.h>
+#include <muos/process.h>
+
+#define HEAP_BYTES  (8 * 1024 * 1024)
+#define HEAP_PAGES  (HEAP_BYTES / PAGE_SIZE)
+
+/*
+ * Free pages in the whole system right before and right after the heap
+ * was given back. Left here to be read from the debugger.
+ */
+static volatile uint32_t grown_free_pages;
+static volatile uint32_t shrunk_free_pages;
+
+static struct MemoryStats stats (void)
+{
+    struct MemoryStats s;
+
+    assert(GetMemoryStats(&s) == 0);
+    return s;
+}
+
+/* Bypasses newlib, which would refuse this before the kernel saw it */
+static int raw_sbrk (intptr_t increment)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+
+    msg.type = PROC_MGR_MESSAGE_SBRK;
+    msg.payload.sbrk.increment = increment;
+
+    return MessageSend(PROCMGR_CONNECTION_ID, &msg, sizeof(msg),
+                       &reply, sizeof(reply));
+}
+
+int main () {
+    struct MemoryStats start;
+    struct MemoryStats grown;
+    struct MemoryStats shrunk;
+    char * heap;
+
+    /* Can't be negated as a signed number */
+    assert(raw_sbrk(INT_MIN) < 0);
+
+    start = stats();
+
+    heap = sbrk(HEAP_BYTES);
+    assert(heap != (char *)-1);
+    memset(heap, 0x5a, HEAP_BYTES);
+
+    grown = stats();
+    assert(sbrk(-HEAP_BYTES) != (void *)-1);
+    shrunk = stats();
+
+    grown_free_pages = grown.free_pages;
+    shrunk_free_pages = shrunk.free_pages;
+
+    /* Held while grown, and all given back after */
+    assert(grown.committed_pages >= start.committed_pages + HEAP_PAGES);
+    assert(shrunk.committed_pages <= grown.committed_pages - HEAP_PAGES);
+
+    /*
+    Other processes allocate and free alongside this one, so the free
+    count can't be matched exactly. But the two readings are only one
+    request apart, and nothing else running takes anywhere near half
+    of the 8MB in that time.
+    */
+    assert(shrunk.free_pages >= grown.free_pages + HEAP_PAGES / 2);
+
+    return 0;
+}
@@ -3,11 +3,14 @@
 
 #include <new>
 
+#include <muos/spinlock.h>
+
 #include <kernel/list.hpp>
 #include <kernel/mmu-defs.h>
 #include <kernel/mmu.hpp>
 #include <kernel/slaballocator.hpp>
 #include <kernel/smart-ptr.hpp>
+#include <kernel/tree-map.hpp>
 #include <kernel/vm.hpp>
 
 /**
@@ -52,6 +55,77 @@ public:
      */
     size_t GetPageCount ();
 
+    /**
+     * @brief   Hand off the pages from byte offset <tt>aOffset</tt>
+     *          onward to <tt>aTail</tt>, which must be empty
+     *
+     * Afterward this area is <tt>aOffset</tt> bytes long.
+     */
+    void Split (size_t aOffset, RefPtr<VmArea> aTail);
+
+    /**
+     * @brief   Take over all the pages of <tt>aTail</tt>, appending
+     *          them after the ones already in this area
+     *
+     * Afterward <tt>aTail</tt> is empty.
+     */
+    void Join (RefPtr<VmArea> aTail);
+
+    /**
+     * @brief   Flag this area as mapped by more than one address space
+     *
+     * Shared areas are only ever mapped and unmapped as a whole.
+     */
+    void MarkShared ();
+
+    bool IsShared ();
+
+    /**
+     * @brief   Fetch a handle to <tt>aPage</tt>, one of the pages
+     *          contained in this VM area
+     */
+    List<Page, &Page::list_link>::Iterator GetPagesFrom (Page * aPage);
+
+    /**
+     * @brief   Note one more mapping sharing the <tt>aCount</tt> pages
+     *          from <tt>aFirst</tt> onward copy-on-write
+     */
+    void AddCopyOnWriteSharer (Page * aFirst, size_t aCount);
+
+    /**
+     * @brief   Note that a mapping has stopped sharing the
+     *          <tt>aCount</tt> pages from <tt>aFirst</tt> onward
+     *
+     * Any of them that no other mapping shares are freed.
+     */
+    void RemoveCopyOnWriteSharer (Page * aFirst, size_t aCount);
+
+    /**
+     * @brief   Count how many of the <tt>aCount</tt> pages from
+     *          <tt>aFirst</tt> onward are shared by more than one mapping
+     */
+    size_t CountSharedPages (Page * aFirst, size_t aCount);
+
+    /**
+     * @brief   Give pages of its own to a mapping that shares the
+     *          <tt>aCount</tt> pages from <tt>aFirst</tt> onward
+     *          copy-on-write, appending them to <tt>aOwn</tt> in order
+     *
+     * Any page the mapping is the last to share is moved over as it
+     * is. The others are copied into pages taken from
+     * <tt>aCopies</tt>, which must hold at least as many as
+     * CountSharedPages() said. The copied pages stay shared by the
+     * mapping until it calls RemoveCopyOnWriteSharer() on them, once
+     * it no longer maps them.
+     *
+     * @return  the first page that was copied, the rest of which
+     *          follow it; or NULL if all were moved
+     */
+    Page * TakeCopyOnWritePages (Page * aFirst,
+                                 size_t aCount,
+                                 RefPtr<VmArea> aCopies,
+                                 RefPtr<VmArea> aOwn);
+
 private:
     virtual ~VmArea ();
 
@@ -62,6 +136,14 @@ private:
 
     size_t mPageCount;
 
+    bool mShared;
+
+    /**
+     * @brief   Guards the list of pages, and their Page#sharers counts,
+     *          while address spaces share them copy-on-write
+     */
+    Spinlock_t mLock;
+
     /**
      * @brief   For privileged access to destructor
      */
@@ -89,6 +171,63 @@ public:
 
     virtual size_t GetLength () = 0;
 
+    /**
+     * @brief   Fetch the access the owning process was granted, as
+     *          opposed to whatever is currently in the pagetable
+     */
+    Prot_t GetProtection ();
+
+    /**
+     * @brief   Cut this mapping in two at <tt>aAddress</tt>
+     *
+     * This mapping is truncated to end at <tt>aAddress</tt>, and
+     * a newly allocated mapping covering the remainder is returned.
+     * Nothing changes in the pagetable; both halves keep whatever
+     * mapped state this mapping had.
+     *
+     * @return      NULL if this mapping can't be divided
+     *
+     * @exception   std::bad_alloc if the new mapping can't be allocated,
+     *              in which case this mapping is left intact
+     */
+    virtual Mapping * Split (VmAddr_t aAddress) throw (std::bad_alloc) = 0;
+
+    /**
+     * @brief   Make an unmapped copy of this mapping, covering the same
+     *          addresses, for installing into another address space
+     *
+     * Private pages are shared copy-on-write between the two from
+     * then on, which write-protects them in <tt>aPageTable</tt>
+     * (the pagetable this mapping is installed into).
+     *
+     * @exception   std::bad_alloc if the copy can't be allocated,
+     *              in which case this mapping is left intact
+     */
+    virtual Mapping * Duplicate (RefPtr<TranslationTable> aPageTable)
+        throw (std::bad_alloc) = 0;
+
+    /**
+     * @brief   Whether this mapping is write-protected only because
+     *          it shares its pages with another address space
+     */
+    virtual bool IsCopyOnWrite ();
+
+    /**
+     * @brief   Give this mapping pages of its own, so that it can be
+     *          written without the other sharers seeing the change
+     *
+     * @return  false if there wasn't enough memory to copy the pages
+     */
+    virtual bool BreakCopyOnWrite (RefPtr<TranslationTable> aPageTable);
+
+    /**
+     * @brief   Fetch the number of pages of RAM this mapping holds on
+     *          behalf of its address space
+     *
+     * Zero unless the mapping is backed by allocated pages.
+     */
+    virtual size_t GetCommittedPages ();
+
     bool Intersects (VmAddr_t aBaseAddress, size_t aLength)
     {
         if (aBaseAddress + aLength <= mBaseAddress ||
@@ -106,9 +245,6 @@ public:
 protected:
     void Unmap (RefPtr<TranslationTable> aPageTable, size_t aPageCount);
 
-public:
-    ListElement mLink;
-
 protected:
     VmAddr_t mBaseAddress;
 
@@ -151,10 +287,128 @@ public:
      */
     virtual size_t GetLength ();
 
+    virtual Mapping * Split (VmAddr_t aAddress) throw (std::bad_alloc);
+
+    virtual Mapping * Duplicate (RefPtr<TranslationTable> aPageTable)
+        throw (std::bad_alloc);
+
+    virtual bool IsCopyOnWrite ();
+
+    virtual bool BreakCopyOnWrite (RefPtr<TranslationTable> aPageTable);
+
+    virtual size_t GetCommittedPages ();
+
+    /**
+     * @brief   Grow the mapping in place by mapping the pages of
+     *          <tt>aRegion</tt> directly after its current end
+     *
+     * On success the pages of <tt>aRegion</tt> are absorbed into this
+     * mapping's own region.
+     */
+    bool Extend (RefPtr<TranslationTable> aPageTable,
+                 RefPtr<VmArea> aRegion);
+
+    /**
+     * @brief   Take over the pages of <tt>aTail</tt>, which must start
+     *          right where this mapping ends
+     *
+     * Both must be mapped, private and not copy-on-write. On success
+     * <tt>aTail</tt> is left empty and unmapped, ready to be deleted.
+     *
+     * @return  false if the two can't be combined, in which case
+     *          neither changes
+     */
+    bool Join (BackedMapping * aTail);
+
+protected:
+    /**
+     * @brief   Make an empty mapping of the same kind as this one, with
+     *          the same protection, over all of <tt>aRegion</tt>
+     */
+    virtual BackedMapping * NewPiece (VmAddr_t aBaseAddress,
+                                      RefPtr<VmArea> aRegion)
+        throw (std::bad_alloc);
+
+    /**
+     * @brief   Fetch a handle to the first page of the region that
+     *          this mapping covers
+     */
+    List<Page, &Page::list_link>::Iterator GetFirstPage ();
+
+    /**
+     * @brief   Start sharing this mapping's pages copy-on-write with
+     *          <tt>aCopy</tt>, a freshly made duplicate of it
+     */
+    void ShareWith (BackedMapping * aCopy,
+                    RefPtr<TranslationTable> aPageTable);
+
+    /**
+     * @brief   Protection actually installed in the pagetable, which
+     *          is read-only while the pages are shared copy-on-write
+     */
+    Prot_t GetMappedProtection ();
+
+protected:
+    RefPtr<VmArea> mRegion;
+
 private:
     static SyncSlabAllocator<BackedMapping> sSlab;
 
-    RefPtr<VmArea> mRegion;
+    /**
+     * @brief   The pages of mRegion that this mapping covers
+     *
+     * Mappings split apart while sharing their pages copy-on-write
+     * each see part of the same region, starting from mFirstPage.
+     * Otherwise they cover all of it, and mFirstPage is NULL.
+     */
+    Page * mFirstPage;
+    size_t mPageCount;
+
+    bool mCopyOnWrite;
+};
+
+/**
+ * @brief   One populated piece of a thread's stack
+ *
+ * Each stack reserves a range of address space that is populated
+ * from the top down as the stack grows. Every piece remembers the
+ * lowest address its stack may grow to; the page right below that
+ * is never mapped, so that running off the end faults.
+ *
+ * @class StackMapping address-space.hpp kernel/address-space.hpp
+ */
+class StackMapping : public BackedMapping
+{
+public:
+    StackMapping (VmAddr_t aBaseAddress,
+                  Prot_t aProtection,
+                  RefPtr<VmArea> aRegion,
+                  VmAddr_t aFloor);
+
+    void * operator new (size_t size) throw (std::bad_alloc)
+    {
+        return sSlab.AllocateWithThrow();
+    }
+
+    void operator delete (void * mem)
+    {
+        sSlab.Free(mem);
+    }
+
+    /**
+     * @brief   Fetch the lowest address the stack may grow down to
+     */
+    VmAddr_t GetFloor ();
+
+protected:
+    virtual BackedMapping * NewPiece (VmAddr_t aBaseAddress,
+                                      RefPtr<VmArea> aRegion)
+        throw (std::bad_alloc);
+
+private:
+    static SyncSlabAllocator<StackMapping> sSlab;
+
+    VmAddr_t mFloor;
 };
 
 /**
@@ -169,7 +423,8 @@ public:
     PhysicalMapping (VmAddr_t aVirtualAddress,
                      PhysAddr_t aPhysicalAddress,
                      size_t aLength,
-                     Prot_t aProtection);
+                     Prot_t aProtection,
+                     CacheAttr_t aCacheAttr);
 
     virtual ~PhysicalMapping ();
 
@@ -189,12 +444,80 @@ public:
 
     virtual size_t GetLength ();
 
+    virtual Mapping * Split (VmAddr_t aAddress) throw (std::bad_alloc);
+
+    /**
+     * Device memory is never copied; both address spaces end up
+     * mapping the same physical range
+     */
+    virtual Mapping * Duplicate (RefPtr<TranslationTable> aPageTable)
+        throw (std::bad_alloc);
+
 private:
     static SyncSlabAllocator<PhysicalMapping> sSlab;
 
     PhysAddr_t mPhysicalAddress;
 
     size_t mLength;
+
+    CacheAttr_t mCacheAttr;
+};
+
+/**
+ * @brief   Set of non-overlapping mappings, ordered by base address
+ *
+ * Lookups by address and overlap queries take logarithmic time.
+ *
+ * @class MappingTree address-space.hpp kernel/address-space.hpp
+ */
+class MappingTree
+{
+public:
+    MappingTree () throw (std::bad_alloc);
+
+    /**
+     * @brief   Start tracking <tt>aMapping</tt>, which must not overlap
+     *          anything already in the tree
+     *
+     * @return  false if memory for the index couldn't be allocated
+     */
+    bool Insert (Mapping * aMapping);
+
+    void Remove (Mapping * aMapping);
+
+    /**
+     * @brief   Fetch the mapping that contains <tt>aAddress</tt>, if any
+     */
+    Mapping * Find (VmAddr_t aAddress);
+
+    /**
+     * @brief   Fetch some mapping that overlaps the given range, if any
+     */
+    Mapping * FindIntersecting (VmAddr_t aBaseAddress, size_t aLength);
+
+    /**
+     * @brief   Fetch the lowest mapping that starts above
+     *          <tt>aAddress</tt>, if any
+     */
+    Mapping * FindAbove (VmAddr_t aAddress);
+
+    /**
+     * @brief   Fetch the mapping with the lowest base address
+     */
+    Mapping * First ();
+
+    /**
+     * @brief   Fetch the mapping that follows <tt>aMapping</tt> in
+     *          address order
+     */
+    Mapping * Next (Mapping * aMapping);
+
+    bool Empty ();
+
+private:
+    typedef TreeMap<VmAddr_t, Mapping *> BaseToMappingMap_t;
+
+    ScopedPtr<BaseToMappingMap_t> mTree;
 };
 
 /**
@@ -229,19 +552,59 @@ public:
     bool CreateBackedMapping (VmAddr_t aVirtualAddress, size_t aLength);
 
     /**
-     * Allocate a stack
+     * Map the pages of a shared-memory object somewhere in the
+     * mappings region of the address space
+     */
+    bool CreateSharedMapping (RefPtr<VmArea> aArea,
+                              VmAddr_t & aVirtualAddress);
+
+    /**
+     * Reserve room for a stack of up to <tt>aMaxLength</tt> bytes,
+     * with an unmapped guard page below it, and populate the top
+     * <tt>aLength</tt> bytes of it
+     *
+     * On success, <tt>aBaseAddress</tt> and <tt>aAdjustedLength</tt>
+     * describe the populated part.
      */
     bool CreateStack (size_t aLength,
+                      size_t aMaxLength,
                       VmAddr_t & aBaseAddress,
                       size_t & aAdjustedLength);
 
     /**
-     * Insert some peripheral memory into the indicated address
-     * range of virtual memory
+     * Outcome of GrowStack()
+     */
+    enum StackFault
+    {
+        /** Address doesn't fall inside any stack's reserved range */
+        STACK_FAULT_NONE,
+
+        /** Stack now reaches down far enough to cover the address */
+        STACK_FAULT_GROWN,
+
+        /** Address is in a stack's guard page */
+        STACK_FAULT_OVERFLOW,
+
+        /** Stack may grow there, but no pages were left to do it */
+        STACK_FAULT_NO_MEM,
+    };
+
+    /**
+     * Populate enough of the stack reservation below an existing
+     * stack to cover <tt>aFaultAddress</tt>
+     */
+    StackFault GrowStack (VmAddr_t aFaultAddress);
+
+    /**
+     * Insert some peripheral memory (or other physical range the
+     * kernel hands out, such as a RAM filesystem file) into the
+     * mappings region of virtual memory
      */
     bool CreatePhysicalMapping (PhysAddr_t aPhysicalAddress,
                                 size_t aLength,
-                                VmAddr_t & aVirtualAddress);
+                                VmAddr_t & aVirtualAddress,
+                                Prot_t aProtection = PROT_USER_READWRITE,
+                                CacheAttr_t aCacheAttr = CACHE_ATTR_STRONGLY_ORDERED);
 
     /**
      * Request that the heap be extended by an additional number
@@ -251,8 +614,133 @@ public:
                      VmAddr_t & aOldEnd,
                      VmAddr_t & aNewEnd);
 
+    /**
+     * Request that the heap be shrunk by a number of bytes, releasing
+     * the pages at its top end
+     */
+    bool ShrinkHeap (size_t aLength,
+                     VmAddr_t & aOldEnd,
+                     VmAddr_t & aNewEnd);
+
+    /**
+     * Remove whatever pages of the mappings and heap fall inside the
+     * indicated address range, splitting mappings that straddle its
+     * edges. Unpopulated parts of the range are ignored.
+     */
+    bool Unmap (VmAddr_t aBaseAddress, size_t aLength);
+
+    /**
+     * Find the mapping, stack or heap chunk that covers
+     * <tt>aAddress</tt>, if any
+     */
+    Mapping * FindMapping (VmAddr_t aAddress);
+
+    /**
+     * Make a new address space with the same layout and contents as
+     * this one. Private memory is shared copy-on-write between the two
+     * rather than copied up front; shared-memory objects and physical
+     * mappings stay shared.
+     *
+     * @return  NULL if there wasn't enough memory
+     */
+    AddressSpace * Clone ();
+
+    /**
+     * Repair a write fault on a page that's only write-protected
+     * because it's shared copy-on-write, by copying that one page
+     *
+     * @return  false if the fault is for some other reason, or if
+     *          there wasn't enough memory to copy the page
+     */
+    bool HandleWriteFault (VmAddr_t aFaultAddress);
+
+    /**
+     * Break copy-on-write sharing on everything in the indicated
+     * address range, ahead of the kernel writing into it on this
+     * address space's behalf. (Kernel writes aren't stopped by
+     * the write-protection, so they'd land in the shared pages.)
+     *
+     * Also populates any part of the range that falls in a stack's
+     * reservation but hasn't been grown into yet, as a fault there
+     * would. Otherwise stops quietly at the first unmapped address;
+     * the write itself will fail there.
+     *
+     * @return  ERROR_OK, -ERROR_FAULT if part of the range is mapped
+     *          read-only to the process, or -ERROR_NO_MEM if there
+     *          wasn't enough memory to copy or populate the pages
+     */
+    int PrepareWrite (VmAddr_t aBaseAddress, size_t aLength);
+
     RefPtr<TranslationTable> GetPageTable ();
 
+    /**
+     * Cap the pages of RAM this address space may hold, as counted
+     * by GetCommittedPages(). Anything that would take it past the
+     * cap fails as if memory had run out. Zero means no cap.
+     *
+     * Lowering the cap below the current usage doesn't take anything
+     * away; it only stops further growth.
+     */
+    void SetPageLimit (size_t aPages);
+
+    size_t GetPageLimit ();
+
+    /**
+     * Fetch the number of pages of RAM held by this address space:
+     * its heap, stacks and other memory-backed mappings (counting
+     * pages shared copy-on-write, since they may need copying), its
+     * pagetable, and the kernel objects charged to it.
+     */
+    size_t GetCommittedPages ();
+
+    /**
+     * Count <tt>aBytes</tt> of kernel memory held on this address
+     * space's process's behalf (a thread, channel, connection, timer
+     * and so on) against the cap set by SetPageLimit()
+     *
+     * @return  false, charging nothing, if it wouldn't fit
+     */
+    bool ChargeKernelObject (size_t aBytes);
+
+    /**
+     * Give back a charge made by ChargeKernelObject()
+     */
+    void UnchargeKernelObject (size_t aBytes);
+
+private:
+    /**
+     * Whether <tt>aPages</tt> more pages, mapped somewhere in the
+     * <tt>aLength</tt> bytes from <tt>aBaseAddress</tt>, would still
+     * fit under the cap set by SetPageLimit(), along with whatever
+     * second-level tables mapping them would add
+     */
+    bool CanCommit (size_t aPages, VmAddr_t aBaseAddress, size_t aLength);
+
+    /**
+     * Which of the mappings, stacks and heap trees covers
+     * <tt>aAddress</tt>
+     */
+    MappingTree & GetTree (VmAddr_t aAddress);
+
+    /**
+     * Give the pages of <tt>aMapping</tt>, a copy-on-write mapping
+     * in <tt>aTree</tt>, that fall inside the given page-aligned range
+     * copies of their own. The rest of it is split off and stays
+     * shared.
+     */
+    bool BreakCopyOnWrite (MappingTree & aTree,
+                           Mapping * aMapping,
+                           VmAddr_t aBaseAddress,
+                           size_t aLength);
+
+    bool UnmapFromTree (MappingTree & aTree,
+                        VmAddr_t aBaseAddress,
+                        size_t aLength);
+
+    bool CloneTree (MappingTree & aTree,
+                    MappingTree & aCloneTree,
+                    RefPtr<TranslationTable> aClonePageTable);
+
 private:
     /**
      * The non-inclusive static upper bound on the address range
@@ -294,18 +782,19 @@ private:
      * All the current code, data, mmap, read-only, etc mappings
      * installed into this address space
      */
-    List<Mapping, &Mapping::mLink> mMappings;
+    MappingTree mMappings;
 
     /**
-     * All the stacks currently installed into this address space
+     * All the populated pieces of the stacks installed into this
+     * address space. Only StackMapping's are kept here.
      */
-    List<Mapping, &Mapping::mLink> mStacks;
+    MappingTree mStacks;
 
     /**
      * All the heap chunks currently installed into this
      * address space
      */
-    List<Mapping, &Mapping::mLink> mHeap;
+    MappingTree mHeap;
 
     /**
      * @brief   Pagetable implementing the MMU gymnastics for this
@@ -313,6 +802,21 @@ private:
      */
     RefPtr<TranslationTable> mPageTable;
 
+    /**
+     * @brief   Sum of GetCommittedPages() over all the mappings
+     */
+    size_t mMappedPages;
+
+    /**
+     * @brief   Sum of what ChargeKernelObject() has been asked to count
+     */
+    size_t mKernelObjectBytes;
+
+    /**
+     * @brief   Cap on GetCommittedPages(), or zero if none
+     */
+    size_t mPageLimit;
+
     static SyncSlabAllocator<AddressSpace> sSlab;
 };
 
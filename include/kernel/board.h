@@ -0,0 +1,43 @@
+#ifndef __KERNEL_BOARD_H__
+#define __KERNEL_BOARD_H__
+
+/*
+ * Physical addresses and interrupt numbers of the devices that the
+ * kernel drives itself, for the board it's being built for.
+ *
+ * The build defines BOARD_REALVIEW_EB_MPCORE for QEMU's
+ * 'realview-eb-mpcore'. Otherwise it's the 'versatilepb' board.
+ */
+
+#if defined(BOARD_REALVIEW_EB_MPCORE)
+
+    /* The ARM11 MPCore test chip has up to four CPUs */
+    #define BOARD_MAX_CPUS          4
+
+    /* Snoop control unit, GIC CPU interfaces and GIC distributor */
+    #define BOARD_MPCORE_PRIV_PHYS  0x10100000
+
+    /* System registers, among them the flags the secondary CPUs poll */
+    #define BOARD_SYSREGS_PHYS      0x10000000
+
+    #define BOARD_UART0_PHYS        0x10009000
+    #define BOARD_TIMER01_PHYS      0x10011000
+
+    /*
+     * Board interrupt lines reach the MPCore's GIC as its shared
+     * interrupts, numbered from 32. Timer 0/1 is line 4 on the board,
+     * which the test chip wires to shared interrupt 1.
+     */
+    #define BOARD_TIMER01_IRQ       33
+
+#else
+
+    #define BOARD_MAX_CPUS          1
+
+    #define BOARD_UART0_PHYS        0x101F1000
+    #define BOARD_TIMER01_PHYS      0x101e2000
+    #define BOARD_TIMER01_IRQ       4
+
+#endif
+
+#endif /* __KERNEL_BOARD_H__ */
@@ -0,0 +1,126 @@
+#ifndef __KERNEL_CPU_HPP__
+#define __KERNEL_CPU_HPP__
+
+#include <stdint.h>
+
+#include <muos/decls.h>
+
+#include <kernel/board.h>
+
+/**
+ * \brief   The processors of the board: which one is running, starting
+ *          up the others, and interrupting them
+ *
+ * CPU 0 boots the kernel. The others are started once it's ready to
+ * schedule, and begin life in idle threads of their own, from which
+ * they pick up or steal whatever work is ready.
+ *
+ * On a board with only one CPU, everything here collapses to CPU 0.
+ *
+ * \class Cpu cpu.hpp kernel/cpu.hpp
+ */
+class Cpu
+{
+public:
+    enum
+    {
+        MAX = BOARD_MAX_CPUS,
+    };
+
+    /**
+     * \brief   Work that an interprocessor interrupt asks for
+     */
+    enum Ipi
+    {
+        IPI_RESCHEDULE  = 1 << 0,   //!<    Run the scheduler again
+        IPI_FLUSH_TLB   = 1 << 1,   //!<    Flush the TLB, see FlushTlb()
+    };
+
+    /**
+     * \brief   Number of the CPU running the caller
+     *
+     * Only meaningful while the caller can't migrate, which is to say
+     * with interrupts disabled or a spinlock held.
+     */
+    static inline unsigned int GetId ()
+    {
+        #if BOARD_MAX_CPUS > 1
+            uint32_t mpidr;
+
+            asm volatile(
+                "mrc p15, 0, %[mpidr], c0, c0, 5"
+                : [mpidr] "=r" (mpidr)
+            );
+
+            return mpidr & CPU_ID_MASK;
+        #else
+            return 0;
+        #endif
+    }
+
+    /**
+     * \brief   Bit N is set if CPU N is up and scheduling
+     */
+    static uint32_t GetOnlineMask ();
+
+    /**
+     * \brief   Whether \a cpu is up and scheduling
+     */
+    static bool IsOnline (unsigned int cpu);
+
+    /**
+     * \brief   Called by each secondary CPU once it can take interrupts
+     *          and run threads
+     */
+    static void SetOnline ();
+
+    /**
+     * \brief   Start every other CPU on the board, returning once
+     *          they're all online
+     */
+    static void StartSecondaries ();
+
+    /**
+     * \brief   Interrupt \a cpu to do \a ipi, without waiting for it
+     */
+    static void SendIpi (unsigned int cpu, Ipi ipi);
+
+    /**
+     * \brief   Flush the TLB of each CPU in \a cpus, a mask like
+     *          GetOnlineMask()'s, returning once they've all done so
+     *
+     * May be called with spinlocks held; CPUs spinning on a lock
+     * still take part.
+     */
+    static void FlushTlb (uint32_t cpus);
+
+private:
+    /**
+     * \brief   Board-specific part of StartSecondaries(): send every
+     *          other CPU to _start_secondary
+     *
+     * \return  How many CPUs the board has, counting CPU 0
+     */
+    static unsigned int StartBoardCpus ();
+
+    enum
+    {
+        CPU_ID_MASK = 0xf,
+    };
+};
+
+BEGIN_DECLS
+
+/**
+ * \brief   Do any TLB flush asked of this CPU, without waiting for the
+ *          interprocessor interrupt to be taken
+ *
+ * Called while spinning with interrupts disabled, so that a CPU
+ * waiting in Cpu::FlushTlb() can't wait forever on one spinning for a
+ * lock it holds.
+ */
+extern void CpuPollIpis (void);
+
+END_DECLS
+
+#endif /* __KERNEL_CPU_HPP__ */
@@ -8,6 +8,42 @@ BEGIN_DECLS
 
 void ScheduleSelfAbort ();
 
+/**
+ * Called in the context of the faulting thread, with interrupts enabled,
+ * when a user-mode data access aborts. Only returns if the fault was
+ * repaired and the faulting instruction should be retried; otherwise
+ * the process is terminated.
+ *
+ * \param fault_address     contents of the Data Fault Address Register
+ * \param fault_status      contents of the Data Fault Status Register
+ */
+void HandleUserDataAbort (VmAddr_t fault_address, uint32_t fault_status);
+
+/**
+ * Called in the context of the trapping thread, with interrupts enabled,
+ * when user mode runs an undefined instruction. Only returns if the
+ * instruction should be retried (because it was the thread's first use
+ * of the VFP since some other thread had it); otherwise the process is
+ * terminated.
+ */
+void HandleUserUndefined ();
+
+/**
+ * Called on the undefined-instruction mode's stack, with interrupts
+ * disabled, when the kernel itself runs an undefined instruction.
+ * Never returns.
+ *
+ * \param pc    address of the trapping instruction
+ * \param psr   status register of the mode that trapped
+ */
+void HandleKernelUndefined (VmAddr_t pc, uint32_t psr);
+
+/**
+ * Drop the current thread into user mode with the register context
+ * stored in its Thread::u_reg. Never returns.
+ */
+void ReturnToUser ();
+
 END_DECLS
 
 #endif /* __EXCEPTION_HPP__ */
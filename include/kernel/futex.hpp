@@ -0,0 +1,106 @@
+#ifndef __KERNEL_FUTEX_HPP__
+#define __KERNEL_FUTEX_HPP__
+
+#include <stdint.h>
+
+#include <muos/spinlock.h>
+
+#include <kernel/list.hpp>
+#include <kernel/semaphore.hpp>
+#include <kernel/vm-defs.h>
+
+/**
+ * \brief   Wait queues keyed by a word of user memory, from which
+ *          userspace builds locks that only enter the kernel when
+ *          they're contended
+ *
+ * A word is identified by the physical address it's stored at rather
+ * than its virtual address, so that processes sharing memory mapped
+ * at different addresses still meet in the same queue. Private pages
+ * have copy-on-write sharing broken first, so that a parent and child
+ * after Fork() don't wake each other by accident.
+ *
+ * The queues are spread over a fixed number of hashed buckets, each
+ * with its own lock, so that unrelated words rarely contend.
+ *
+ * \class Futex futex.hpp kernel/futex.hpp
+ */
+class Futex
+{
+public:
+    /**
+     * \brief   Block the calling thread until woken by Wake(), provided
+     *          the word at \a aAddress still holds \a aExpected
+     *
+     * The word is compared with the queue locked, so a Wake() from a
+     * thread that changed the word first can't be missed.
+     *
+     * \return  ERROR_OK once woken, -ERROR_AGAIN if the word didn't
+     *          hold \a aExpected, -ERROR_INVALID if \a aAddress isn't
+     *          word-aligned, or -ERROR_FAULT if it isn't writable
+     */
+    static int Wait (VmAddr_t aAddress, uint32_t aExpected);
+
+    /**
+     * \brief   Wake up to \a aCount of the threads blocked in Wait() on
+     *          the word at \a aAddress, oldest first
+     *
+     * \return  How many were woken, or the negated error code as for
+     *          Wait()
+     */
+    static int Wake (VmAddr_t aAddress, unsigned int aCount);
+
+private:
+    /**
+     * \brief   A thread blocked in Wait(), which lives on its stack
+     *
+     * \class Waiter futex.hpp kernel/futex.hpp
+     */
+    class Waiter
+    {
+    public:
+        Waiter (PhysAddr_t aKey)
+            : mKey(aKey)
+            , mWakeup(0)
+        {
+        }
+
+    private:
+        //! Prevent heap allocation
+        void * operator new (size_t size);
+
+        //! Prevent heap allocation
+        void operator delete (void * mem);
+
+    public:
+        ListElement mLink;
+        PhysAddr_t  mKey;
+        Semaphore   mWakeup;
+    };
+
+    /**
+     * \brief   The waiters on every word whose key hashes alike
+     */
+    struct Bucket
+    {
+        Spinlock_t                      mLock;
+        List<Waiter, &Waiter::mLink>    mWaiters;
+    };
+
+    enum
+    {
+        NUM_BUCKETS = 64,
+    };
+
+    /**
+     * \brief   Find the physical address of the word at \a aAddress in
+     *          the calling process
+     */
+    static int GetKey (VmAddr_t aAddress, PhysAddr_t & aKey);
+
+    static Bucket & GetBucket (PhysAddr_t aKey);
+
+    static Bucket sBuckets[NUM_BUCKETS];
+};
+
+#endif /* __KERNEL_FUTEX_HPP__ */
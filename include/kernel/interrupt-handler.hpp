@@ -11,6 +11,7 @@
 #include <kernel/message.hpp>
 #include <kernel/slaballocator.hpp>
 #include <kernel/smart-ptr.hpp>
+#include <kernel/thread.hpp>
 
 BEGIN_DECLS
 
@@ -34,12 +35,18 @@ public:
         int                 mIrqNumber;
         RefPtr<Connection>  mConnection;
         uintptr_t           mPulsePayload;
+
+        /* Level of the worker that sends the pulse, PRIORITY_IO or above */
+        Thread::Priority    mPriority;
     };
 
     class StateInfo
     {
     public:
         bool mMasked;
+
+        /* Next handler waiting on the same worker */
+        UserInterruptHandler * mNextDeferred;
     };
 
 public:
@@ -85,6 +92,18 @@ private:
  */
 void InterruptsConfigure();
 
+/**
+ * Set up the stacks used for interrupt handling on a CPU other than the
+ * one that ran InterruptsConfigure()
+ */
+void InterruptsConfigureSecondary();
+
+/**
+ * Start the kernel threads that deliver user handlers' pulses, one per
+ * priority from PRIORITY_IO up. Needs a running scheduler.
+ */
+void InterruptsStartWorkers();
+
 void InterruptAttachKernelHandler (unsigned int irq_number, IrqKernelHandlerFunc f);
 
 void InterruptAttachUserHandler (
@@ -101,10 +120,22 @@ void InterruptDetachUserHandler (
 
 void InterruptHandler ();
 
+/**
+ * Number of interrupts \a cpu has taken since boot, of every kind
+ */
+uint32_t InterruptGetCount (unsigned int cpu);
+
 void InterruptUnmaskIrq (int n);
 
 void InterruptMaskIrq (int n);
 
+/**
+ * Interrupt raised on a CPU by InterruptSendIpi(), or -1 if there's none
+ */
+int InterruptGetIpiNum ();
+
+void InterruptSendIpi (unsigned int cpu);
+
 END_DECLS
 
 #endif /* __INTERRUPT_HANDLER_H__ */
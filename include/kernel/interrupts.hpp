@@ -44,6 +44,30 @@ public:
     virtual unsigned int GetNumSupportedIrqs () = 0;
     virtual int GetRaisedIrqNum () = 0;
 
+    /**
+     * \brief   Set up the calling CPU's own part of the controller
+     *
+     * Run on every CPU, after Init() has run on the first.
+     */
+    virtual void InitCpu () {};
+
+    /**
+     * \brief   Tell the controller that the interrupt last returned
+     *          by GetRaisedIrqNum() on this CPU has been handled
+     */
+    virtual void EndOfInterrupt (int n) {};
+
+    /**
+     * \brief   Interrupt that SendIpi() raises, or -1 if the
+     *          controller can't interrupt other CPUs
+     */
+    virtual int GetIpiNum () { return -1; };
+
+    /**
+     * \brief   Raise GetIpiNum() on \a cpu
+     */
+    virtual void SendIpi (unsigned int cpu) {};
+
 public:
     ListElement mLink;
 };
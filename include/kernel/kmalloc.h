@@ -3,8 +3,14 @@
 
 #include <stddef.h>
 
+#include <muos/arch.h>
 #include <muos/decls.h>
 
+/**
+ * Largest request that kmalloc() can serve. Use vmalloc() for anything bigger.
+ */
+#define KMALLOC_MAX_SIZE (PAGE_SIZE / 4)
+
 BEGIN_DECLS
 
 void * kmalloc (size_t size);
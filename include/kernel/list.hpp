@@ -178,6 +178,14 @@ template <class T, ListElement T::* Ptr>
             return Iterator(this, mHead.next);
         }
 
+        /**
+         * \brief   Fetch an iterator positioned initially at
+         *          <tt>element</tt>, which must be in this List.
+         */
+        Iterator At (T * element) {
+            return Iterator(this, &(element->*Ptr));
+        }
+
         /**
          * \brief   Test whether any elements are inserted into this List
          */
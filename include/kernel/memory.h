@@ -0,0 +1,28 @@
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include <muos/decls.h>
+
+BEGIN_DECLS
+
+/**
+ * Fill one #PAGE_SIZE page of memory with zeros
+ *
+ * Faster than the equivalent memset(), because it needs no checks
+ * for alignment or short lengths.
+ *
+ * \param page  address of the page; must be page-aligned
+ */
+void PageZero (void * page);
+
+/**
+ * Copy one #PAGE_SIZE page of memory to another
+ *
+ * \param dst   address of the destination page; must be page-aligned
+ * \param src   address of the source page; must be page-aligned
+ */
+void PageCopy (void * dst, void const * src);
+
+END_DECLS
+
+#endif /* __MEMORY_H__ */
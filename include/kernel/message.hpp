@@ -261,6 +261,17 @@ public:
 
     void Dispose ();
 
+    /**
+     * @brief   Open another, independent connection to the same
+     *          channel as this one
+     *
+     * @return  a null pointer if this connection has been disposed
+     *
+     * @exception   std::bad_alloc if the new connection can't be
+     *              allocated
+     */
+    RefPtr<Connection> Duplicate () throw (std::bad_alloc);
+
     /**
      * @brief   Synchronously send a message
      *
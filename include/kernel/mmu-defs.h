@@ -109,8 +109,13 @@ enum
     PT_SECONDLEVEL_MAPTYPE_BITS         = 2,
     PT_SECONDLEVEL_MAPTYPE_MASK         = (0b11 << PT_SECONDLEVEL_MAPTYPE_SHIFT),
 
-    PT_SECONDLEVEL_MAPTYPE_UNMAPPED     = (0b00 << PT_SECONDLEVEL_MAPTYPE_SHIFT),
-    PT_SECONDLEVEL_MAPTYPE_SMALL_PAGE   = (0b10 << PT_SECONDLEVEL_MAPTYPE_SHIFT),
+    PT_SECONDLEVEL_MAPTYPE_UNMAPPED             = (0b00 << PT_SECONDLEVEL_MAPTYPE_SHIFT),
+    PT_SECONDLEVEL_MAPTYPE_SMALL_PAGE           = (0b10 << PT_SECONDLEVEL_MAPTYPE_SHIFT),
+    PT_SECONDLEVEL_MAPTYPE_EXTENDED_SMALL_PAGE  = (0b11 << PT_SECONDLEVEL_MAPTYPE_SHIFT),
+
+    /* Bufferable and Cacheable memory-region attributes */
+    PT_SECONDLEVEL_B                        = (0b1 << 2),
+    PT_SECONDLEVEL_C                        = (0b1 << 3),
 
     /* First subpage Access permissions */
     PT_SECONDLEVEL_AP0_SHIFT                = 4,
@@ -163,6 +168,19 @@ enum
     PT_SECONDLEVEL_SMALL_PAGE_BASE_ADDR_MASK    = (0xfffff << PT_SECONDLEVEL_SMALL_PAGE_BASE_ADDR_SHIFT),
 };
 
+/*
+ * Pieces specific to a secondlevel translation-table "extended small" (4KB)
+ * page entry. Same as a small page, except that it trades the access
+ * permissions for subpages 1-3 for the TEX memory-region attribute bits.
+ * Access permissions for the whole page are in the AP0 position.
+ */
+enum
+{
+    PT_SECONDLEVEL_EXTENDED_TEX_SHIFT           = 6,
+    PT_SECONDLEVEL_EXTENDED_TEX_BITS            = 3,
+    PT_SECONDLEVEL_EXTENDED_TEX_MASK            = (0b111 << PT_SECONDLEVEL_EXTENDED_TEX_SHIFT),
+};
+
 END_DECLS
 
 #endif /* __MMU_DEFS_H__ */
@@ -7,16 +7,57 @@
 #include <new>
 
 #include <muos/decls.h>
+#include <muos/io.h>
+#include <muos/spinlock.h>
 
 #include <kernel/assert.h>
 #include <kernel/list.hpp>
 #include <kernel/mmu-defs.h>
 #include <kernel/slaballocator.hpp>
 #include <kernel/smart-ptr.hpp>
-#include <kernel/tree-map.hpp>
 #include <kernel/vm.hpp>
 
-class SecondlevelTable;
+/**
+ * \brief   Wrapper for individual page descriptors
+ *
+ * \class SecondlevelTable mmu.hpp kernel/mmu.hpp
+ */
+class SecondlevelTable
+{
+public:
+    void * operator new (size_t size) throw (std::bad_alloc)
+    {
+        assert(size == sizeof(SecondlevelTable));
+        return sSlab.AllocateWithThrow();
+    }
+
+    void operator delete (void * mem) throw ()
+    {
+        sSlab.Free(mem);
+    }
+
+    SecondlevelTable () throw (std::bad_alloc);
+    ~SecondlevelTable () throw ();
+
+public:
+    /*
+     * The array of individual pagetable entries used by the MMU.
+     *
+     * Allocated separately because of strict 1KB alignment-boundary
+     * requirements. Logically it's just part of this data structure
+     */
+    struct SecondlevelPtes * ptes;
+
+    /*
+     * Utility field for inserting into whatever list is needed
+     */
+    ListElement link;
+
+    unsigned int num_mapped_pages;
+
+private:
+    static SyncSlabAllocator<SecondlevelTable> sSlab;
+};
 
 /**
  * \brief   Data structure used to encapsulate the hardware translation-
@@ -31,9 +72,6 @@ class SecondlevelTable;
  */
 class TranslationTable : public RefCounted
 {
-public:
-    typedef TreeMap<VmAddr_t, struct SecondlevelTable *> SparseSecondlevelMap_t;
-
 public:
 
     void * operator new (size_t size) throw (std::bad_alloc)
@@ -52,7 +90,8 @@ public:
     bool MapPage (
             VmAddr_t virt,
             PhysAddr_t phys,
-            Prot_t prot
+            Prot_t prot,
+            CacheAttr_t attr = CACHE_ATTR_STRONGLY_ORDERED
             );
 
     bool UnmapPage (
@@ -69,6 +108,128 @@ public:
             VmAddr_t virt
             );
 
+    /**
+     * \brief   Map a physically contiguous range of pages in one pass
+     *
+     * Second-level tables are allocated as needed. If any page in the
+     * range is already mapped, or a second-level table can't be
+     * allocated, everything installed by this call is removed again
+     * and false is returned.
+     *
+     * \param attr    memory type that the range is accessed as
+     */
+    bool MapRange (
+            VmAddr_t virt,
+            PhysAddr_t phys,
+            size_t length,
+            Prot_t prot,
+            CacheAttr_t attr = CACHE_ATTR_STRONGLY_ORDERED
+            );
+
+    /**
+     * \brief   Map a sequence of (not necessarily contiguous) pages
+     *          onto a contiguous range of virtual addresses in one pass
+     *
+     * Consumes <tt>length / PAGE_SIZE</tt> elements from \a pages. Same
+     * failure semantics as the physically contiguous variant.
+     */
+    bool MapRange (
+            VmAddr_t virt,
+            List<Page, &Page::list_link>::Iterator pages,
+            size_t length,
+            Prot_t prot
+            );
+
+    /**
+     * \brief   Remove all the page mappings in a range of virtual
+     *          addresses, doing a single TLB flush for the whole range
+     *
+     * \return  true if every page in the range had been mapped
+     */
+    bool UnmapRange (
+            VmAddr_t virt,
+            size_t length
+            );
+
+    /**
+     * \brief   Change the access permissions on all the page mappings
+     *          in a range of virtual addresses, doing a single TLB
+     *          flush for the whole range
+     *
+     * \return  true if every page in the range had been mapped
+     */
+    bool ProtectRange (
+            VmAddr_t virt,
+            size_t length,
+            Prot_t prot
+            );
+
+    /**
+     * \brief   Point an already-mapped range of virtual addresses at a
+     *          different sequence of pages
+     *
+     * Unlike an unmap followed by a map, this never needs to allocate
+     * and so can't fail partway through.
+     *
+     * \return  true if every page in the range had been mapped
+     */
+    bool RemapRange (
+            VmAddr_t virt,
+            List<Page, &Page::list_link>::Iterator pages,
+            size_t length,
+            Prot_t prot
+            );
+
+    /**
+     * \brief   Take over second-level tables allocated ahead of time,
+     *          keeping them as spares
+     *
+     * A following MapRange() that needs no more new tables than were
+     * handed over won't have to allocate any, so may be made under a
+     * spinlock. \a tables is left empty.
+     */
+    void AddSpareSecondlevelTables (
+            List<SecondlevelTable, &SecondlevelTable::link> & tables
+            );
+
+    /**
+     * \brief   Hand back whatever spare second-level tables exceed the
+     *          number normally kept, for the caller to free once it's
+     *          out from under its lock
+     */
+    void TakeExcessSecondlevelTables (
+            List<SecondlevelTable, &SecondlevelTable::link> & tables
+            );
+
+    /**
+     * \brief   Number of second-level tables this table owns,
+     *          whether installed or kept as spares
+     */
+    unsigned int GetSecondlevelTableCount ();
+
+    /**
+     * \brief   Number of pages of memory taken up by this table,
+     *          including its second-level tables, and including
+     *          \a extra_tables more of them if asked
+     */
+    size_t GetFootprintPages (unsigned int extra_tables = 0);
+
+    /**
+     * \brief   Number of second-level tables that would have to be
+     *          allocated to map anything in the given range, after
+     *          using up the spares
+     */
+    unsigned int CountSecondlevelTablesNeeded (VmAddr_t virt, size_t length);
+
+    /**
+     * \brief   Find the physical address that a write to \a virt by the
+     *          owner of this table would land at
+     *
+     * \return  false if \a virt isn't mapped, or if the owner isn't
+     *          allowed to write it
+     */
+    bool TranslateWrite (VmAddr_t virt, PhysAddr_t & phys);
+
     static void SetKernel (TranslationTable * table);
     static TranslationTable * GetKernel ();
 
@@ -98,23 +259,92 @@ public:
     pt_firstlevel_t * firstlevel_ptes;
 
     /**
-     * Sparse map of beginning virtual address of each section
-     * to the SecondlevelTable instance that fills in the individual
-     * pages for that section.
+     * \brief   Provides the storage pointed at by #secondlevel_tables below,
+     *          in the kernel's table only. The others get theirs from
+     *          vmalloc().
+     */
+    PagePtr secondlevel_tables_pages;
+
+    /**
+     * Points to a SecondlevelTable *[4096], running parallel to
+     * #firstlevel_ptes.
      *
-     * Each struct contained in this list controls the mappings for
-     * 1MB worth of individual pages.
+     * Element N is the SecondlevelTable instance that fills in the
+     * individual pages for the Nth 1MB section, or NULL if that section
+     * doesn't have a coarse (page-granular) mapping installed. Indexed
+     * by (virtual address >> MEGABYTE_SHIFT), so finding the table that
+     * covers a page never requires a search.
      *
-     * A sample couple entries in this map might be:
+     * A sample couple entries in this array might be:
      *
      *    First section (0x00000000 - 0x000fffff):
-     *        0x00000000 -> (SecondlevelTable *)<struct address>
+     *        [0x000] -> (SecondlevelTable *)<struct address>
      *    ...
      *
      *    Fifteenth section (0x00e00000 - 0x00efffff)
-     *        0x00e00000 -> (SecondlevelTable *)<struct address>
+     *        [0x00e] -> (SecondlevelTable *)<struct address>
      */
-    ScopedPtr<SparseSecondlevelMap_t> sparse_secondlevel_map;
+    SecondlevelTable ** secondlevel_tables;
+
+private:
+    enum
+    {
+        /**
+         * \brief   Number of slots in #translation_cache
+         */
+        TRANSLATION_CACHE_ENTRIES = 8,
+
+        /**
+         * \brief   Most tables kept in #spare_secondlevel_tables
+         */
+        SPARE_SECONDLEVEL_TABLES = 4,
+    };
+
+    /**
+     * \brief   One remembered page translation
+     *
+     * A \a virt_page that isn't page-aligned marks the slot as empty.
+     */
+    struct TranslationCacheEntry
+    {
+        VmAddr_t    virt_page;
+        PhysAddr_t  phys_page;
+        Prot_t      prot;
+    };
+
+    /**
+     * \brief   Small direct-mapped cache of recent page-granular
+     *          translations, so that CopyWithAddressSpaces() doesn't
+     *          walk the table again for every chunk of a message that
+     *          lands in a page it just used
+     *
+     * Anything that removes a page mapping must call
+     * InvalidateTranslationCache().
+     */
+    TranslationCacheEntry translation_cache[TRANSLATION_CACHE_ENTRIES];
+
+    /**
+     * \brief   Protects #translation_cache
+     */
+    Spinlock_t translation_cache_lock;
+
+    /**
+     * \brief   Emptied second-level tables kept for reuse, so that
+     *          mappings which come and go across a section boundary
+     *          don't free and reallocate a table each time
+     */
+    List<SecondlevelTable, &SecondlevelTable::link> spare_secondlevel_tables;
+
+    /**
+     * \brief   Length of #spare_secondlevel_tables
+     */
+    unsigned int num_spare_secondlevel_tables;
+
+    /**
+     * \brief   Number of second-level tables owned by this table,
+     *          whether installed or spare
+     */
+    unsigned int num_secondlevel_tables;
 
 private:
     /**
@@ -122,51 +352,110 @@ private:
      */
     virtual ~TranslationTable ();
 
-    static SyncSlabAllocator<TranslationTable> sSlab;
+    /**
+     * \brief   Find the physical address backing \a virt
+     *
+     * \param valid_len     set to the number of bytes from \a virt
+     *                      onward that are physically contiguous with it
+     *                      and accessible the same way
+     *
+     * \param wanted_len    how many bytes the caller would like translated.
+     *                      Consecutive pages are only looked at until
+     *                      \a valid_len reaches this, so it's a bound on
+     *                      the work done rather than on \a valid_len.
+     *
+     * \param write         whether the access is a write
+     *
+     * \return  false if \a virt isn't mapped, or if the owner of this
+     *          table (user mode, unless this is the kernel table)
+     *          isn't allowed to access it that way
+     */
+    bool Translate (
+            VmAddr_t virt,
+            PhysAddr_t & phys,
+            size_t & valid_len,
+            size_t wanted_len,
+            bool write
+            );
 
-    friend class RefPtr<TranslationTable>;
-};
+    /**
+     * \brief   Forget any cached translations for the pages in a
+     *          range of virtual addresses
+     */
+    void InvalidateTranslationCache (
+            VmAddr_t virt,
+            size_t length
+            );
 
-/**
- * \brief   Wrapper for individual page descriptors
- *
- * \class SecondlevelTable mmu.hpp kernel/mmu.hpp
- */
-class SecondlevelTable
-{
-public:
-    void * operator new (size_t size) throw (std::bad_alloc)
-    {
-        assert(size == sizeof(SecondlevelTable));
-        return sSlab.AllocateWithThrow();
-    }
+    /**
+     * \brief   Common implementation of both MapRange() variants.
+     *
+     * Physical addresses are drawn from \a pages if it's non-NULL, and
+     * counted upward from \a phys otherwise.
+     */
+    bool FillRange (
+            VmAddr_t virt,
+            size_t length,
+            Prot_t prot,
+            CacheAttr_t attr,
+            PhysAddr_t phys,
+            List<Page, &Page::list_link>::Iterator * pages
+            );
 
-    void operator delete (void * mem) throw ()
-    {
-        sSlab.Free(mem);
-    }
+    /**
+     * \brief   Common implementation of ProtectRange() and RemapRange().
+     *
+     * Physical addresses are drawn from \a pages if it's non-NULL, and
+     * kept as they are otherwise. Memory types are always kept.
+     */
+    bool RewriteRange (
+            VmAddr_t virt,
+            size_t length,
+            Prot_t prot,
+            List<Page, &Page::list_link>::Iterator * pages
+            );
 
-    SecondlevelTable () throw (std::bad_alloc);
-    ~SecondlevelTable () throw ();
+    /**
+     * \brief   Find the second-level table covering \a virt, installing
+     *          a new one if \a create is set and none exists yet.
+     *
+     * \return  NULL if the section is mapped as a whole, or if there's
+     *          no table and one couldn't (or shouldn't) be created.
+     */
+    SecondlevelTable * GetSecondlevelTable (
+            VmAddr_t virt,
+            bool create
+            );
 
-public:
-    /*
-     * The array of individual pagetable entries used by the MMU.
+    /**
+     * \brief   Detach the (empty) second-level table that covers the
+     *          section with first-level index \a section_idx
+     */
+    SecondlevelTable * RemoveSecondlevelTable (
+            unsigned int section_idx
+            );
+
+    /**
+     * \brief   Fetch an empty second-level table, reusing a spare
+     *          one if there is any
      *
-     * Allocated separately because of strict 1KB alignment-boundary
-     * requirements. Logically it's just part of this data structure
+     * \return  NULL if memory for a new one couldn't be allocated
      */
-    struct SecondlevelPtes * ptes;
+    SecondlevelTable * AllocateSecondlevelTable ();
 
-    /*
-     * Utility field for inserting into whatever list is needed
+    /**
+     * \brief   Dispose of a detached, empty second-level table
+     *
+     * The TLB must already be clear of anything that was translated
+     * through it, since it may be reused for another section.
      */
-    ListElement link;
+    void RetireSecondlevelTable (
+            SecondlevelTable * secondlevel_table
+            );
 
-    unsigned int num_mapped_pages;
+    static SyncSlabAllocator<TranslationTable> sSlab;
 
-private:
-    static SyncSlabAllocator<SecondlevelTable> sSlab;
+    friend class RefPtr<TranslationTable>;
 };
 
 /**
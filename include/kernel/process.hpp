@@ -5,6 +5,7 @@
 
 #include <muos/decls.h>
 #include <muos/error.h>
+#include <muos/process.h>
 #include <muos/spinlock.h>
 
 #include <kernel/address-space.hpp>
@@ -14,9 +15,11 @@
 #include <kernel/message.hpp>
 #include <kernel/process-types.h>
 #include <kernel/reaper.hpp>
+#include <kernel/semaphore.hpp>
 #include <kernel/slaballocator.hpp>
 #include <kernel/smart-ptr.hpp>
 #include <kernel/tree-map.hpp>
+#include <kernel/user-timer.hpp>
 #include <kernel/vm.hpp>
 
 class Thread;
@@ -40,6 +43,18 @@ public:
     typedef TreeMap<int, Message *>             IdToMessageMap_t;
     typedef TreeMap<Pid_t, Process *>           PidMap_t;
     typedef TreeMap<int, UserInterruptHandler *>    IdToInterruptHandlerMap_t;
+    typedef TreeMap<int, UserTimer *>               IdToTimerMap_t;
+
+public:
+    /**
+     * \brief   Why a process stopped running, as reported to its parent
+     */
+    enum TerminationReason
+    {
+        TERMINATION_NORMAL,
+        TERMINATION_FAULT,
+        TERMINATION_STACK_OVERFLOW,
+    };
 
 public:
     /**
@@ -75,9 +90,29 @@ public:
 
     /**
      * \brief   Spawn a process from the named executable image
+     *
+     * \param aAttributes   settings requested by the spawner, or NULL
+     *                      for the defaults
      */
     static Process * Create (const char aExecutableName[],
-                             Process * aParent);
+                             Process * aParent,
+                             struct SpawnAttributes const * aAttributes = NULL);
+
+    /**
+     * \brief   Make a child of the process that \a aCaller belongs
+     *          to, which resumes from the same register context as
+     *          \a aCaller but with 0 in the return-value register
+     *
+     * The child gets a copy-on-write clone of the parent's address
+     * space, and a connection under the same identifier to the same
+     * channel for each connection the parent has. Channels, received
+     * messages, interrupt handlers, and child-wait handlers are not
+     * inherited.
+     *
+     * \a aCaller must be blocked (for instance, waiting on the reply
+     * to its fork request) for as long as this call runs.
+     */
+    static Process * Fork (Thread * aCaller);
 
     /**
      * \brief   Register a new process in the reverse mapping
@@ -127,12 +162,24 @@ public:
 
     RefPtr<UserInterruptHandler> LookupInterruptHandler (int handler_id);
 
+    int RegisterTimer (RefPtr<UserTimer> t);
+
+    int UnregisterTimer (int timer_id);
+
+    RefPtr<UserTimer> LookupTimer (int timer_id);
+
     int RegisterReaper (RefPtr<Reaper> r);
 
     int UnregisterReaper (int handler_id);
 
     RefPtr<Reaper> LookupReaper (int handler_id);
 
+    /**
+     * \brief   Let the reaper \a handler_id reap up to \a count more
+     *          children, reaping any that have already finished
+     */
+    int ArmReaper (int handler_id, unsigned int count);
+
 public:
     /**
      * \brief   Instances are allocated from a slab
@@ -163,26 +210,81 @@ public:
 
     Process * GetParent ();
 
-    void TryReapChildren (RefPtr<Reaper> aReaper);
+    /**
+     * \brief   Tell this process's parent that it has finished, so that
+     *          the parent can reap it
+     */
+    void ReportFinished ();
 
-    void ReportChildFinished (Process * aChild);
+    /**
+     * \brief   Record why this process is about to stop running
+     *
+     * Only the first reason recorded sticks.
+     */
+    void SetTerminationReason (TerminationReason aReason);
 
-    void ReapChild (Process * aChild, RefPtr<Connection> aConnection);
+    TerminationReason GetTerminationReason ();
+
+    /**
+     * \brief   CPU usage of this process's thread so far
+     */
+    void GetTimes (struct ProcessTimes * aTimes);
+
+    /**
+     * \brief   GetTimes() of the process numbered \a aPid, which can't
+     *          be reaped and deleted while it's being read
+     *
+     * \return  false if there's no such process
+     */
+    static bool GetTimesOf (Pid_t aPid, struct ProcessTimes * aTimes);
+
+    /**
+     * \brief   CPU usage of all the children reaped from this process,
+     *          and of their reaped children in turn
+     */
+    void GetChildTimes (struct ProcessTimes * aTimes);
 
 private:
     /**
      * \brief   Hidden to prevent the general public from making
      *          instances
+     *
+     * Unless \a aWithAddressSpace is set, the process starts out with
+     * no address space at all.
      */
-    Process (char const aComm[], Process * aParent);
+    Process (char const aComm[],
+             Process * aParent,
+             bool aWithAddressSpace = true);
 
 private:
     /**
      * \brief   Find a handler that's willing to reap the
      *          indicated child process.
+     *
+     * This and the other members dealing with children and reapers
+     * must be called with sFamilyLock held.
      */
     RefPtr<Reaper> GetReaperForChild (Pid_t id);
 
+    void TryReapChildren (RefPtr<Reaper> aReaper);
+
+    void ReapChild (Process * aChild, RefPtr<Connection> aConnection);
+
+private:
+    /**
+     * \brief   Count a kernel object held for this process against its
+     *          address space's page limit
+     *
+     * Processes without an address space (the Process Manager's) have
+     * no limit, and always succeed.
+     */
+    bool ChargeKernelObject (size_t aBytes);
+
+    /**
+     * \brief   Give back a charge made by ChargeKernelObject()
+     */
+    void UnchargeKernelObject (size_t aBytes);
+
 private:
     /**
      * \brief   Hidden to prevent allocating arrays
@@ -202,7 +304,8 @@ private:
      * allocation of memory to back it fails.
      */
     static Process * execIntoCurrent (const char aExecutableName[],
-                                      Process * aParent) throw (std::bad_alloc);
+                                      Process * aParent,
+                                      struct SpawnAttributes const * aAttributes) throw (std::bad_alloc);
 
     /**
      * \brief   Function executed as main body of the kernel thread backing
@@ -211,10 +314,25 @@ private:
     static void UserProcessThreadBody (void *);
 
     /**
-     * \brief   Function executed as main body of the Process Manager thread
+     * \brief   Function executed as main body of the kernel thread backing
+     *          a process made by Fork()
+     */
+    static void ForkedProcessThreadBody (void *);
+
+    /**
+     * \brief   Function executed as main body of the first Process
+     *          Manager thread, which sets up the manager's process and
+     *          starts the rest of its workers
      */
     static void ManagerThreadBody (void *);
 
+    /**
+     * \brief   Function executed as main body of each Process Manager
+     *          worker, taking messages off the manager's channel and
+     *          handling them
+     */
+    static void ManagerWorkerBody (void *);
+
 private:
     /**
      * \brief   Allocates instances of Process
@@ -232,6 +350,18 @@ private:
      */
     static Spinlock_t sPidMapSpinlock;
 
+    /**
+     * \brief   Protects every process's parent, lists of children,
+     *          reapers, and reaped children's times
+     *
+     * These change on behalf of more than one process at a time (a
+     * child finishing, its parent arming a reaper), so with several
+     * Process Manager workers they can't be left to the process's own
+     * thread. A semaphore rather than a spinlock because reaping a
+     * child waits for its thread to finish.
+     */
+    static Semaphore sFamilyLock;
+
     /**
      * \brief   Synchronization for this Process instance
      */
@@ -306,6 +436,18 @@ private:
      */
     int next_interrupt_handler_id;
 
+    /**
+     * \brief   Map integer handles to one of the UserTimer
+     *          data structures owned by this process
+     */
+    ScopedPtr<IdToTimerMap_t> id_to_timer_map;
+
+    /**
+     * \brief   Value of the next handle that will be assigned
+     *          to a UserTimer owned by this process
+     */
+    int next_timer_id;
+
     /**
      * \brief   Map integer handles to one of the Reaper
      *          data structures owned by this process.
@@ -342,6 +484,17 @@ private:
      * <tt>init</tt>.
      */
     Process * mParent;
+
+    /**
+     * \brief   Why this process stopped running
+     */
+    TerminationReason mTerminationReason;
+
+    /**
+     * \brief   Totals from GetTimes() and GetChildTimes() of every
+     *          child reaped so far
+     */
+    struct ProcessTimes mChildTimes;
 };
 
 BEGIN_DECLS
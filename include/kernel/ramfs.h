@@ -8,6 +8,13 @@
 
 typedef uint8_t const * RamFsBufferPtr;
 
+/*
+ * Each file's payload starts at a multiple of this many bytes from
+ * the start of the image, so that it can be mapped into a process.
+ * Must agree with the padding written out by fs-builder.
+ */
+#define RAMFS_PAYLOAD_ALIGNMENT 4096
+
 extern bool RamFsGetImage (const char name[],
                            RamFsBufferPtr * buffer,
                            size_t * len);
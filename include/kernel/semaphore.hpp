@@ -61,7 +61,8 @@ public:
      * \brief   Increase count by one.
      *
      * If any waiters are queued, wake one of them and allow it
-     * to consume the new count.
+     * to consume the new count. The caller keeps the CPU unless the
+     * waiter outranks it.
      */
     void Up ();
 
@@ -0,0 +1,96 @@
+#ifndef __SHARED_MEMORY_HPP__
+#define __SHARED_MEMORY_HPP__
+
+#include <new>
+
+#include <muos/spinlock.h>
+
+#include <kernel/address-space.hpp>
+#include <kernel/once.h>
+#include <kernel/slaballocator.hpp>
+#include <kernel/smart-ptr.hpp>
+#include <kernel/string.hpp>
+#include <kernel/tree-map.hpp>
+
+// This forward declaration breaks a cycle between SharedMemoryObject
+// and SharedMemoryRegistry
+class SharedMemoryRegistry;
+
+/**
+ * \brief   Association between a name and a region of anonymous
+ *          memory that any number of processes may map
+ *
+ * \class SharedMemoryObject shared-memory.hpp kernel/shared-memory.hpp
+ */
+class SharedMemoryObject
+{
+public:
+    void * operator new (size_t size) throw (std::bad_alloc)
+    {
+        return sSlab.AllocateWithThrow();
+    }
+
+    void operator delete (void * mem) throw ()
+    {
+        sSlab.Free(mem);
+    }
+
+private:
+    SharedMemoryObject (char const aName[], RefPtr<VmArea> aArea)
+        throw (std::bad_alloc);
+
+private:
+    static SyncSlabAllocator<SharedMemoryObject> sSlab;
+
+    String mName;
+
+    RefPtr<VmArea> mArea;
+
+    friend class SharedMemoryRegistry;
+};
+
+/**
+ * \brief   Registry of named shared-memory objects
+ *
+ * The registry only holds the name. The pages themselves live as long
+ * as anybody still has them mapped, so unlinking a name while it's
+ * in use is fine.
+ *
+ * \class SharedMemoryRegistry shared-memory.hpp kernel/shared-memory.hpp
+ */
+class SharedMemoryRegistry
+{
+public:
+    /**
+     * Allocate a fresh zero-filled region of <tt>aLength</tt> bytes and
+     * publish it under <tt>aName</tt>.
+     *
+     * \return  the new region, or a NULL RefPtr if the name is already
+     *          taken or memory couldn't be allocated
+     */
+    static RefPtr<VmArea> Create (char const aName[], size_t aLength);
+
+    /**
+     * \return  the region published under <tt>aName</tt>, or a NULL
+     *          RefPtr if there isn't one
+     */
+    static RefPtr<VmArea> Lookup (char const aName[]);
+
+    /**
+     * Withdraw <tt>aName</tt> so that it can't be opened again
+     *
+     * \return  false if no region was published under <tt>aName</tt>
+     */
+    static bool Unlink (char const aName[]);
+
+private:
+    void static OnceInit (void * ignored);
+
+private:
+
+    static TreeMap<char const *, SharedMemoryObject *> * sMap;
+    static Spinlock_t sMapLock;
+    static Once_t sOnceControl;
+};
+
+#endif /* __SHARED_MEMORY_HPP__ */
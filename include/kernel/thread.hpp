@@ -3,9 +3,11 @@
 
 #include <muos/arch.h>
 #include <muos/decls.h>
+#include <muos/process.h>
 
 #include <kernel/list.hpp>
 #include <kernel/smart-ptr.hpp>
+#include <kernel/vfp.hpp>
 #include <kernel/vm.hpp>
 
 // Forward declaration
@@ -102,6 +104,8 @@ public:
         STATE_RECEIVE,  //!<    Blocked waiting to receive a message
 
         STATE_SEM,      //!<    Blocked waiting on a semaphore
+        STATE_SLEEP,    //!<    Blocked waiting for a timer to expire
+        STATE_FUTEX,    //!<    Blocked waiting for a futex wakeup
 
         STATE_READY,    //!<    Ready to run
         STATE_RUNNING,  //!<    Currently using the CPU
@@ -113,11 +117,22 @@ public:
         STATE_COUNT,
     };
 
+    /**
+     * \brief   Scheduling levels; a higher level always runs first
+     *
+     * Threads on the same level take turns, one timer tick at a time.
+     */
     enum Priority
     {
-        PRIORITY_NORMAL  = 0,
-        PRIORITY_IO,
-
+        PRIORITY_IDLE     = 0,                      //!<    Only the idle loop
+        PRIORITY_MIN      = SCHED_PRIORITY_MIN,     //!<    Lowest for user threads
+        PRIORITY_NORMAL   = SCHED_PRIORITY_DEFAULT, //!<    Default for new threads
+        PRIORITY_USER_MAX = SCHED_PRIORITY_MAX,     //!<    Highest a user thread can ask for
+        PRIORITY_IO       = PRIORITY_USER_MAX + 1,  //!<    Interrupt drivers and workers
+        PRIORITY_SYSTEM   = 31,                     //!<    Process Manager, reaping included
+        PRIORITY_MAX      = PRIORITY_SYSTEM,
+
+        /* This isn't a priority, just a way to programatically calculate */
         PRIORITY_COUNT,
     };
 
@@ -192,6 +207,21 @@ public:
     /* Ceiling of the priorities of all threads blocked by this one. */
     Priority    effective_priority;
 
+    /* Microseconds spent on the CPU, as of its last switch away */
+    uint64_t    run_time;
+
+    /* Times it gave up the CPU by blocking */
+    uint32_t    voluntary_switches;
+
+    /* Times it was switched away from while still able to run */
+    uint32_t    involuntary_switches;
+
+    /* Floating-point registers, whenever another thread has the VFP */
+    VfpContext  vfp;
+
+    /* CPU it last ran on, whose ready list it goes back on */
+    unsigned int cpu;
+
 public:
 
     /**
@@ -248,10 +278,20 @@ public:
      * \brief   For use in implementing priority inheritance
      *
      * Installs an artifically higher priority for this thread than
-     * its natural one.
+     * its natural one. Asking for less than the natural priority gets
+     * the natural priority. If the thread is sitting on the ready list,
+     * it moves to its new level, which needs Thread::BeginTransaction().
      */
     void SetEffectivePriority (Thread::Priority priority);
 
+    /**
+     * \brief   Change the natural priority of this thread
+     *
+     * A boost gifted by SetEffectivePriority() is kept for as long as
+     * it's higher than the new priority.
+     */
+    void SetAssignedPriority (Thread::Priority priority);
+
     /**
      * \brief   Remove argument from ready-to-run list
      *
@@ -263,6 +303,10 @@ public:
     /**
      * \brief   Add argument to ready-to-run list
      *
+     * The list is that of the CPU the thread last ran on, or of an idle
+     * CPU if that one is busy with something at least as important.
+     * Another CPU that ought to be preempted is sent an IPI.
+     *
      * Must be performed under the protection of the Thread::BeginTransaction()
      * lock.
      */
@@ -279,14 +323,49 @@ public:
      */
     static void RunNextThread ();
 
+    /**
+     * \brief   Switch to \a woken, which was just made ready, only if it
+     *          outranks the current thread
+     *
+     * One of equal priority is left to take its turn at the next
+     * interrupt, by SetNeedResched(), and the current thread carries on
+     * meanwhile. A lower one couldn't run before the current thread
+     * blocks anyway.
+     *
+     * Nothing is done here if MakeReady() placed \a woken on another CPU
+     * and sent it an IPI, since that CPU will switch to it. It can also
+     * stay on a busy CPU's list without an IPI, when that CPU is running
+     * something at least as important. Then the switch here is what
+     * takes it from that list.
+     *
+     * Must be performed under the protection of the Thread::BeginTransaction()
+     * lock.
+     */
+    static void PreemptIfOutranked (Thread * woken);
+
     /**
      * \brief   Select and remove a thread from the runlist.
      *
+     * The calling CPU's own list is used, unless another CPU's has a
+     * higher-priority thread waiting, which is stolen.
+     *
+     * The thread that was on the CPU is charged for the time since it
+     * was last picked, and counted as switched away from if it isn't
+     * the one picked now.
+     *
      * Must be performed under the protection of the Thread::BeginTransaction()
      * lock.
      */
     static Thread * DequeueReady ();
 
+    /**
+     * \brief   Whether any thread is waiting on the ready-to-run list
+     *
+     * Must be performed under the protection of the Thread::BeginTransaction()
+     * lock.
+     */
+    static bool AnyReady ();
+
     /**
      * \brief   Inform the scheduler that some event has happened
      *          that may have added or removed tasks to the runlist.
@@ -1,11 +1,19 @@
 #ifndef __KERNEL_TIMER_HPP__
 #define __KERNEL_TIMER_HPP__
 
+#include <stdint.h>
+
+#include <kernel/list.hpp>
+
 /**
  * \brief   Driver model to be implemented by anything wanting
  *          to provide a backend implementation for the main
  *          system programmable timer.
  *
+ * The device supplies two things: a free-running counter to tell the
+ * time by, and a one-shot interrupt to wake the kernel when the next
+ * thing it's waiting for comes due. Both count in microseconds.
+ *
  * \class TimerDevice timer.hpp kernel/timer.hpp
  */
 class TimerDevice
@@ -15,20 +23,140 @@ public:
 
     virtual void Init () = 0;
     virtual void ClearInterrupt () = 0;
-    virtual void StartPeriodic (unsigned int period_ms) = 0;
+
+    /**
+     * \brief   Microseconds counted since Init(), wrapping at 2^32
+     */
+    virtual uint32_t ReadCounter () = 0;
+
+    /**
+     * \brief   Raise one interrupt \a delay_us microseconds from now,
+     *          replacing any that's already pending
+     */
+    virtual void StartOneShot (uint32_t delay_us) = 0;
+};
+
+/**
+ * \brief   Something to be done at a point in time, armed with
+ *          Timer::Arm()
+ *
+ * The fields belong to the timer code while the entry is armed.
+ *
+ * \class TimerEntry timer.hpp kernel/timer.hpp
+ */
+class TimerEntry
+{
+public:
+    TimerEntry ()
+        : mDue(0)
+        , mInterval(0)
+        , mLevel(0)
+        , mSlot(0)
+    {
+    }
+
+    virtual ~TimerEntry () {};
+
+    /**
+     * \brief   Called from the timer interrupt each time the entry
+     *          comes due, with the timer's own lock released
+     *
+     * The timer code has finished with the entry before calling this,
+     * so whoever it wakes may free the entry straight away.
+     */
+    virtual void Expire () = 0;
+
+    /**
+     * \brief   Whether the entry is waiting to come due
+     */
+    bool IsArmed ()
+    {
+        return !mLink.Unlinked();
+    }
+
+public:
+    /* Position in the timer wheel */
+    ListElement mLink;
+
+    /* Microsecond count, as told by Timer::GetTime(), to fire at */
+    uint64_t mDue;
+
+    /* Microseconds between repeats, or 0 if the entry fires once */
+    uint64_t mInterval;
+
+    /* Wheel level and slot that mLink is on */
+    uint8_t mLevel;
+    uint8_t mSlot;
 };
 
 /**
  * \brief   Factory for doing programmable timer operations
  *
+ * There's no periodic tick. The timer is programmed for whichever
+ * comes first of the end of a running thread's timeslice on any CPU or
+ * the next timed event, and not at all for the timeslice of a CPU
+ * that's idle.
+ *
+ * Armed TimerEntry objects are kept in a hierarchical timing wheel,
+ * so arming, disarming, and firing each cost the same no matter how
+ * many entries are armed. The wheel is only turned for ticks when
+ * something happens, and the hardware is programmed for when the
+ * first entry is actually due, however far off that is.
+ *
  * \class Timer timer.hpp kernel/timer.hpp
  */
 class Timer
 {
 public:
     static void RegisterDevice (TimerDevice * device);
-    static void StartPeriodic (unsigned int period_ms);
-    static void ReportPeriodicInterrupt ();
+
+    /**
+     * \brief   Begin keeping time, and preempting each thread after
+     *          it's run for \a timeslice_ms milliseconds
+     */
+    static void Start (unsigned int timeslice_ms);
+
+    /**
+     * \brief   Microseconds since Start()
+     */
+    static uint64_t GetTime ();
+
+    /**
+     * \brief   Whether the thread about to run on the calling CPU
+     *          needs a timeslice
+     *
+     * The scheduler calls this each time it picks a thread, passing
+     * false for the idle thread. The hardware is only touched when
+     * the answer changes.
+     */
+    static void SetTimeslicing (bool enabled);
+
+    /**
+     * \brief   Fire \a entry after \a delay_us microseconds, and then
+     *          every \a interval_us if that's nonzero
+     *
+     * An entry that's already armed is rearmed. It never fires early,
+     * and normally no more than a millisecond late.
+     */
+    static void Arm (TimerEntry * entry,
+                     uint64_t delay_us,
+                     uint64_t interval_us = 0);
+
+    /**
+     * \brief   Stop \a entry from firing
+     *
+     * If its Expire() is running on another CPU, this waits for it to
+     * return, so that the entry may be freed afterwards. So it mustn't
+     * be called from the entry's own Expire().
+     *
+     * \return  true if it was armed
+     */
+    static bool Disarm (TimerEntry * entry);
+
+    /**
+     * \brief   Called by the timer device's interrupt handler
+     */
+    static void ReportInterrupt ();
 };
 
 #endif /* __KERNEL_TIMER_HPP__ */
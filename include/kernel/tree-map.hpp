@@ -102,6 +102,22 @@ public:
             Key_t key
             );
 
+    /**
+     * \brief   Finds the value (if any) mapped to the greatest key
+     *          that is less than or equal to <tt>key</tt>
+     */
+    Value_t LookupFloor (
+            Key_t key
+            );
+
+    /**
+     * \brief   Finds the value (if any) mapped to the least key
+     *          that is greater than or equal to <tt>key</tt>
+     */
+    Value_t LookupCeiling (
+            Key_t key
+            );
+
     /**
      * \brief   Returns number of entries in the map
      */
@@ -178,6 +194,16 @@ template<typename K, typename V>
         {
             return reinterpret_cast<V>(RawTreeMap::Lookup(reinterpret_cast<Key_t>(key)));
         }
+
+        inline V LookupFloor (K key)
+        {
+            return reinterpret_cast<V>(RawTreeMap::LookupFloor(reinterpret_cast<Key_t>(key)));
+        }
+
+        inline V LookupCeiling (K key)
+        {
+            return reinterpret_cast<V>(RawTreeMap::LookupCeiling(reinterpret_cast<Key_t>(key)));
+        }
     };
 
 #endif /* __TREE_MAP__ */
@@ -0,0 +1,82 @@
+#ifndef __USER_TIMER_HPP__
+#define __USER_TIMER_HPP__
+
+#include <stdint.h>
+
+#include <kernel/assert.h>
+#include <kernel/message.hpp>
+#include <kernel/slaballocator.hpp>
+#include <kernel/smart-ptr.hpp>
+#include <kernel/timer.hpp>
+
+/**
+ * \brief   A timer created by userspace, which sends a pulse on a
+ *          connection each time it expires
+ *
+ * \class UserTimer user-timer.hpp kernel/user-timer.hpp
+ */
+class UserTimer : public RefCounted, public TimerEntry
+{
+public:
+    /**
+     * Do not stack-allocate
+     *
+     * @param aConnection   see mConnection
+     * @param aPulseValue   see mPulseValue
+     */
+    UserTimer (RefPtr<Connection> aConnection, uintptr_t aPulseValue)
+        : mConnection(aConnection)
+        , mPulseValue(aPulseValue)
+    {
+    }
+
+    void * operator new (size_t size) throw (std::bad_alloc)
+    {
+        assert(size == sizeof(UserTimer));
+        return sSlab.AllocateWithThrow();
+    }
+
+    void operator delete (void * mem) throw ()
+    {
+        sSlab.Free(mem);
+    }
+
+    virtual void Expire ();
+
+    /**
+     * Disarm, and let go of the connection
+     */
+    void Dispose ();
+
+private:
+    //! Only RefPtr will be allowed to run dtor
+    virtual ~UserTimer ();
+
+    //!< Prevent allocating arrays of UserTimers
+    void * operator new[] (size_t);
+
+    //!< Prevent allocating arrays of UserTimers
+    void operator delete[] (void *);
+
+public:
+    /**
+     * Connection on which a pulse with type PULSE_TYPE_TIMER
+     * is delivered when the timer expires.
+     */
+    RefPtr<Connection> mConnection;
+
+    /**
+     * Carried in the value field of each pulse
+     */
+    uintptr_t mPulseValue;
+
+private:
+    /**
+     * Allocates instances of UserTimer
+     */
+    static SyncSlabAllocator<UserTimer> sSlab;
+
+    friend class RefPtr<UserTimer>;
+};
+
+#endif /* __USER_TIMER_HPP__ */
@@ -0,0 +1,87 @@
+#ifndef __KERNEL_VFP_HPP__
+#define __KERNEL_VFP_HPP__
+
+#include <stdint.h>
+
+// Forward declaration
+class Thread;
+
+/**
+ * \brief   Floating-point registers of one thread, as kept while
+ *          some other thread has the VFP
+ */
+struct VfpContext
+{
+    uint64_t d[16];
+    uint32_t fpscr;
+
+    /* CPU whose VFP these were last loaded into */
+    uint32_t cpu;
+};
+
+/* VfpContext::cpu of registers never loaded anywhere */
+enum { VFP_NO_CPU = 0xffffffff };
+
+/**
+ * \brief   Sharing of the VFP coprocessor between threads
+ *
+ * The registers stay loaded with whichever thread last used them (the
+ * owner) until some other thread needs them. Switching to any thread
+ * but the owner turns the VFP off, so that the first floating-point
+ * instruction the thread runs traps as undefined. Only then are the
+ * owner's registers saved and the trapping thread's loaded. A thread
+ * that never uses floating point never pays for the save or the load.
+ *
+ * On a multicore board, each CPU has a VFP and an owner of its own,
+ * and a thread that had the VFP on saves its registers whenever it's
+ * switched away from, in case it moves to another CPU. Loading is
+ * still left until the thread traps, and skipped if it comes back to
+ * a CPU whose VFP it still owns.
+ *
+ * The kernel itself never uses the VFP.
+ *
+ * \class Vfp vfp.hpp kernel/vfp.hpp
+ */
+class Vfp
+{
+public:
+    /**
+     * \brief   Find out whether there's a VFP, and grant access to it
+     *          if so
+     *
+     * Called on each CPU as it comes up.
+     */
+    static void Init ();
+
+    /**
+     * \brief   Turn the VFP on or off to suit \a incoming, which is
+     *          about to be switched to
+     *
+     * Must be performed under the protection of the
+     * Thread::BeginTransaction() lock.
+     */
+    static void Switch (Thread * incoming);
+
+    /**
+     * \brief   Give \a current the VFP after it has trapped trying
+     *          to use it
+     *
+     * \return  true if the instruction should be retried, false if it
+     *          was really undefined
+     */
+    static bool HandleTrap (Thread * current);
+
+    /**
+     * \brief   Give \a child the same floating-point registers
+     *          that \a parent has
+     */
+    static void Copy (Thread * parent, Thread * child);
+
+    /**
+     * \brief   Make sure nothing refers to \a thread, which is being
+     *          reclaimed
+     */
+    static void Forget (Thread * thread);
+};
+
+#endif /* __KERNEL_VFP_HPP__ */
@@ -33,6 +33,13 @@ public:
      */
     VmAddr_t    base_address;
 
+    /**
+     * \brief   Number of mappings sharing this page copy-on-write, while
+     *          it belongs to a VmArea that's shared that way. Kept by
+     *          the VmArea; zero otherwise.
+     */
+    unsigned int sharers;
+
     /**
      * \brief   Find and provision 2<sup>\em order + 1</sup> consecutive pages of
      *          virtual memory from the free-pages pool.
@@ -56,6 +63,16 @@ public:
      */
     static void Free (Page * page);
 
+    /**
+     * \brief   Count the pages currently in the free-pages pool
+     */
+    static size_t GetFreeCount ();
+
+    /**
+     * \brief   Count all the pages the pool manages, free or not
+     */
+    static size_t GetTotalCount ();
+
 private:
     static Page * AllocInternal (unsigned int order,
                                  bool mark_busy_in_bitmap);
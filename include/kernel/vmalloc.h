@@ -0,0 +1,30 @@
+#ifndef __VMALLOC_H__
+#define __VMALLOC_H__
+
+#include <stddef.h>
+
+#include <muos/decls.h>
+
+BEGIN_DECLS
+
+/**
+ * \brief   Allocate a virtually contiguous range of kernel memory
+ *
+ * The backing pages are allocated one at a time and so needn't be
+ * physically contiguous, which lets large tables be allocated even
+ * when physical memory is too fragmented for Page#Alloc() to find a
+ * big enough block. Each range is followed by an unmapped guard page.
+ *
+ * \return  page-aligned start of at least \a size bytes of memory, or
+ *          NULL if there's not enough memory or address space
+ */
+void * vmalloc (size_t size);
+
+/**
+ * \brief   Release memory returned by vmalloc()
+ */
+void vfree (void * ptr);
+
+END_DECLS
+
+#endif /* __VMALLOC_H__ */
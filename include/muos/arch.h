@@ -55,8 +55,11 @@
     #define ARM_PSR_I_BIT   7   /* If set, disables normal IRQs */
     #define ARM_PSR_F_BIT   6   /* If set, disables fast IRQs   */
 
+    #define ARM_PSR_T_BIT   5   /* If set, running Thumb code   */
+
     #define ARM_PSR_I_VALUE (1 << ARM_PSR_I_BIT)
     #define ARM_PSR_F_VALUE (1 << ARM_PSR_F_VALUE)
+    #define ARM_PSR_T_VALUE (1 << ARM_PSR_T_BIT)
 
     #define ARM_PSR_MODE_MASK       0b11111
 
@@ -13,6 +13,7 @@ typedef enum
     ERROR_NO_MEM,
     ERROR_FAULT,
     ERROR_EXITING,
+    ERROR_AGAIN,
 } Error_t;
 
 END_DECLS
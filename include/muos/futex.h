@@ -0,0 +1,70 @@
+#ifndef __MUOS_FUTEX_H__
+#define __MUOS_FUTEX_H__
+
+/*! \file */
+
+#include <stdint.h>
+
+#include <muos/decls.h>
+
+BEGIN_DECLS
+
+/**
+ * Block the calling thread until another calls FutexWake() on the
+ * same word, provided <tt>*word</tt> still equals <tt>expected</tt>.
+ * The comparison and the decision to sleep happen together, so a
+ * thread that changes the word and then calls FutexWake() is never
+ * missed.
+ *
+ * Words are matched by the memory they're stored in, so processes
+ * sharing memory may wait on it wherever it's mapped.
+ *
+ * @return  0 once woken, #ERROR_AGAIN negated if <tt>*word</tt>
+ *          didn't equal <tt>expected</tt>, or the negated error code
+ *          if otherwise negative.
+ */
+int FutexWait (volatile uint32_t * word, uint32_t expected);
+
+/**
+ * Wake up to <tt>count</tt> of the threads blocked in FutexWait()
+ * on <tt>word</tt>, oldest first.
+ *
+ * @return  how many threads were woken, or the negated error code if
+ *          negative.
+ */
+int FutexWake (volatile uint32_t * word, unsigned int count);
+
+/**
+ * A lock built on FutexWait() and FutexWake() which only enters the
+ * kernel when some thread has to wait for it. It may be placed in
+ * shared memory to lock between processes.
+ *
+ * Initialize with MutexInit() or #MUTEX_INITIALIZER.
+ */
+struct Mutex
+{
+    /**
+     * 0 if unlocked, 1 if locked with no waiters, or 2 if locked and
+     * there may be waiters to wake when it's unlocked
+     */
+    volatile uint32_t state;
+};
+
+#define MUTEX_INITIALIZER { 0 }
+
+void MutexInit (struct Mutex * mutex);
+
+/**
+ * Take <tt>mutex</tt>, waiting for it if some other thread holds it.
+ */
+void MutexLock (struct Mutex * mutex);
+
+/**
+ * Release <tt>mutex</tt>, which the caller must hold. Makes no system
+ * call unless another thread is waiting for it.
+ */
+void MutexUnlock (struct Mutex * mutex);
+
+END_DECLS
+
+#endif /* __MUOS_FUTEX_H__ */
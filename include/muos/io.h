@@ -55,7 +55,61 @@ int InterruptDetach (int handler_id);
  */
 int InterruptComplete (int id);
 
-void * MapPhysical (uintptr_t physaddr, size_t len);
+/**
+ * Read how many interrupts CPU number <tt>cpu</tt> has taken since
+ * the system started: from devices, the kernel's timer, and other
+ * CPUs asking it to reschedule.
+ *
+ * @return  0, or the negated error code if negative (such as when
+ *          there's no such CPU)
+ */
+int GetInterruptCount (unsigned int cpu, uint32_t * count);
+
+/**
+ * Memory types that a MapPhysical() mapping can be given
+ */
+typedef enum
+{
+    /**
+     * Every access reaches the device, one at a time and in program
+     * order. What device registers need.
+     */
+    CACHE_ATTR_STRONGLY_ORDERED = 0,
+
+    /**
+     * Device memory: not cached, but writes may be posted to the
+     * write buffer instead of waiting for the device. They still
+     * reach it in order, and are never merged. Not the same as
+     * normal memory that isn't cached, which is
+     * #CACHE_ATTR_WRITE_COMBINING.
+     */
+    CACHE_ATTR_DEVICE,
+
+    /**
+     * Normal memory that isn't cached. Neighboring writes may be
+     * merged and reordered in the write buffer before they reach
+     * memory, which suits frame buffers and DMA buffers.
+     */
+    CACHE_ATTR_WRITE_COMBINING,
+} CacheAttr_t;
+
+/**
+ * Map <tt>len</tt> bytes of physical address space, starting at the
+ * page-aligned address <tt>physaddr</tt>, into the calling process.
+ *
+ * @return  the address of the mapping, or NULL if <tt>attr</tt> isn't
+ *          one of the #CacheAttr_t values or there wasn't enough memory
+ */
+void * MapPhysical (uintptr_t physaddr, size_t len, CacheAttr_t attr);
+
+/**
+ * Remove the page-aligned range of addresses starting at
+ * <tt>vmaddr</tt> from the calling process's address space. Works
+ * on mappings established by MapPhysical() as well as the heap.
+ *
+ * @return  0 on success, or a negative error code
+ */
+int Unmap (void * vmaddr, size_t len);
 
 END_DECLS
 
@@ -98,6 +98,26 @@ struct Pulse
  */
 #define PULSE_TYPE_CHILD_FINISH     (PULSE_TYPE_MIN_USER - 2)
 
+/**
+ * Value of the <tt>type</tt> field of a pulse message delivered
+ * to a program who's called ChildWaitAttach(), in place of
+ * #PULSE_TYPE_CHILD_FINISH, when a child was terminated for running
+ * off the end of its stack.
+ *
+ * The <tt>value</tt> field of the pulse contains the process ID of the
+ * child that exited.
+ */
+#define PULSE_TYPE_CHILD_STACK_OVERFLOW (PULSE_TYPE_MIN_USER - 3)
+
+/**
+ * Value of the <tt>type</tt> field of a pulse message delivered
+ * when a timer made with TimerCreate() expires.
+ *
+ * The <tt>value</tt> field of the pulse contains the value that was
+ * passed to TimerCreate().
+ */
+#define PULSE_TYPE_TIMER            (PULSE_TYPE_MIN_USER - 4)
+
 int ChannelCreate ();
 
 int ChannelDestroy (int chid);
@@ -3,14 +3,186 @@
 
 /*! \file */
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <muos/decls.h>
 
 BEGIN_DECLS
 
+/**
+ * Range of scheduling priorities for user threads. A runnable thread
+ * always gets the CPU ahead of any thread with a lower priority, and
+ * threads with equal priority share it in turns.
+ *
+ * The levels above #SCHED_PRIORITY_MAX are kept for threads that
+ * everyone else relies on: the Process Manager, and drivers once
+ * they've attached to an interrupt. No user thread can outrank them.
+ */
+#define SCHED_PRIORITY_MIN      1
+#define SCHED_PRIORITY_DEFAULT  8
+#define SCHED_PRIORITY_MAX      23
+
+/**
+ * Optional settings for a process started by SpawnWithAttributes().
+ * Initialize with SpawnAttributesInit() before changing any fields,
+ * so that settings added later keep their defaults.
+ */
+struct SpawnAttributes
+{
+    /**
+     * Most pages of RAM the new process may hold, counting its
+     * memory and its pagetable; allocations past this fail with
+     * #ERROR_NO_MEM. Zero (the default) inherits the spawner's limit.
+     * A limit looser than the spawner's own is tightened to match.
+     */
+    size_t page_limit;
+
+    /**
+     * Scheduling priority the new process starts with, between
+     * #SCHED_PRIORITY_MIN and #SCHED_PRIORITY_MAX. Defaults to
+     * #SCHED_PRIORITY_DEFAULT.
+     */
+    int priority;
+
+    /**
+     * Most bytes the new process's stack may grow to, rounded up to
+     * a whole page; running past it terminates the process with a
+     * #PULSE_TYPE_CHILD_STACK_OVERFLOW to its parent. Zero (the
+     * default) gives 256KB.
+     */
+    size_t stack_size;
+};
+
+/**
+ * CPU usage of a process, as told by GetProcessTimes() and
+ * GetChildTimes()
+ */
+struct ProcessTimes
+{
+    /**
+     * Time spent running, in nanoseconds. Counted in whole
+     * microseconds.
+     */
+    uint64_t run_ns;
+
+    /**
+     * Times the process gave up the CPU by blocking: to wait for a
+     * message, a reply, a timer, and so on.
+     */
+    uint32_t voluntary_switches;
+
+    /**
+     * Times the process was switched away from while it could still
+     * have run, because its timeslice ran out, a higher-priority
+     * thread became ready, or it let others run.
+     */
+    uint32_t involuntary_switches;
+};
+
+/**
+ * Memory usage of the whole system and of the calling process, as told
+ * by GetMemoryStats()
+ */
+struct MemoryStats
+{
+    /**
+     * Pages of RAM not in use by anything
+     */
+    uint32_t free_pages;
+
+    /**
+     * Pages of RAM handed out by the kernel's page allocator, free or
+     * not. Doesn't count the kernel image.
+     */
+    uint32_t total_pages;
+
+    /**
+     * Pages of RAM held by the caller, as counted against the limit
+     * in #SpawnAttributes: its heap, stacks and other memory, plus
+     * its pagetable.
+     */
+    uint32_t committed_pages;
+
+    /**
+     * Second-level pagetables held by the caller, including the few
+     * emptied ones kept around for reuse
+     */
+    uint32_t secondlevel_tables;
+};
+
 int GetPid (void);
 void Exit (void);
 int Spawn (char const path[]);
 
+/**
+ * Fill in the default for each field of <tt>attr</tt>
+ */
+void SpawnAttributesInit (struct SpawnAttributes * attr);
+
+/**
+ * Start a process running the program <tt>path</tt>, as Spawn()
+ * does, but with the settings in <tt>attr</tt>.
+ *
+ * \return  the process id, or a negative error code
+ */
+int SpawnWithAttributes (char const path[],
+                         struct SpawnAttributes const * attr);
+
+/**
+ * Change the scheduling priority of the calling thread to
+ * <tt>priority</tt>, between #SCHED_PRIORITY_MIN and
+ * #SCHED_PRIORITY_MAX. Takes effect immediately: if some other
+ * thread now outranks the caller, it runs before this returns.
+ *
+ * \return  #ERROR_OK, or a negative error code
+ */
+int SetPriority (int priority);
+
+/**
+ * \return  the scheduling priority of the calling thread
+ */
+int GetPriority (void);
+
+/**
+ * Read the CPU usage of process <tt>pid</tt>, which may be #SELF_PID
+ * for the caller. A child that has finished can still be asked about
+ * until it's reaped with ChildWaitArm().
+ *
+ * \return  #ERROR_OK, or a negative error code
+ */
+int GetProcessTimes (int pid, struct ProcessTimes * times);
+
+/**
+ * Read the CPU usage of all the children of the calling process that
+ * have been reaped with ChildWaitArm() so far, added together. Each
+ * child's total includes those of its own reaped children.
+ *
+ * \return  #ERROR_OK, or a negative error code
+ */
+int GetChildTimes (struct ProcessTimes * times);
+
+/**
+ * Read how much memory is free, and how much the caller holds
+ *
+ * \return  #ERROR_OK, or a negative error code
+ */
+int GetMemoryStats (struct MemoryStats * stats);
+
+/**
+ * Make a copy of the calling process, which carries on from the
+ * return of this call.
+ *
+ * The copy shares the caller's memory copy-on-write, and has its
+ * own connection to each channel the caller is connected to, under
+ * the same identifiers. It doesn't inherit channels, unreplied
+ * messages, interrupt handlers, child-wait handlers, or timers.
+ *
+ * \return  in the caller, the process id of the copy (or a negative
+ *          error code if it couldn't be made); in the copy, 0
+ */
+int Fork (void);
+
 /**
  * Request the kernel to send a #PULSE_TYPE_CHILD_FINISH
  * message when a child finishes.
@@ -4,7 +4,9 @@
 #include <stdint.h>
 
 #include <muos/decls.h>
+#include <muos/io.h>
 #include <muos/message.h>
+#include <muos/process.h>
 
 #define PROCMGR_CONNECTION_ID FIRST_CONNECTION_ID
 
@@ -32,6 +34,20 @@ typedef enum
     PROC_MGR_MESSAGE_CHILD_WAIT_DETACH,
     PROC_MGR_MESSAGE_CHILD_WAIT_ARM,
     PROC_MGR_MESSAGE_SBRK,
+    PROC_MGR_MESSAGE_UNMAP,
+    PROC_MGR_MESSAGE_SHM_CREATE,
+    PROC_MGR_MESSAGE_SHM_OPEN,
+    PROC_MGR_MESSAGE_SHM_UNLINK,
+    PROC_MGR_MESSAGE_FORK,
+    PROC_MGR_MESSAGE_RAMFS_MAP,
+    PROC_MGR_MESSAGE_SET_PRIORITY,
+    PROC_MGR_MESSAGE_GET_PRIORITY,
+    PROC_MGR_MESSAGE_TIMER_CREATE,
+    PROC_MGR_MESSAGE_TIMER_ARM,
+    PROC_MGR_MESSAGE_TIMER_DESTROY,
+    PROC_MGR_MESSAGE_GET_TIMES,
+    PROC_MGR_MESSAGE_GET_MEMORY_STATS,
+    PROC_MGR_MESSAGE_INTERRUPT_COUNT,
 
     /**
      * Not a message. Just a count.
@@ -59,6 +75,7 @@ struct ProcMgrMessage
         } getpid;
 
         struct {
+            struct SpawnAttributes attributes;
             size_t path_len;
             char path[0];
         } spawn;
@@ -80,6 +97,7 @@ struct ProcMgrMessage
         struct {
             uintptr_t physaddr;
             size_t len;
+            CacheAttr_t attr;
         } map_phys;
 
         struct {
@@ -110,6 +128,69 @@ struct ProcMgrMessage
             intptr_t increment;
         } sbrk;
 
+        struct {
+            uintptr_t vmaddr;
+            size_t len;
+        } unmap;
+
+        struct {
+            size_t len;
+            size_t path_len;
+            char path[0];
+        } shm_create;
+
+        struct {
+            size_t path_len;
+            char path[0];
+        } shm_open;
+
+        struct {
+            size_t path_len;
+            char path[0];
+        } shm_unlink;
+
+        struct {
+        } fork;
+
+        struct {
+            size_t path_len;
+            char path[0];
+        } ramfs_map;
+
+        struct {
+            int priority;
+        } set_priority;
+
+        struct {
+        } get_priority;
+
+        struct {
+            int connection_id;
+            uintptr_t value;
+        } timer_create;
+
+        struct {
+            int timer_id;
+            uint64_t delay_ns;
+            uint64_t interval_ns;
+        } timer_arm;
+
+        struct {
+            int timer_id;
+        } timer_destroy;
+
+        struct {
+            int pid;
+            int children;
+        } get_times;
+
+        struct {
+        } get_memory_stats;
+
+        struct {
+            unsigned int cpu;
+        } interrupt_count;
+
     } payload;
 };
 
@@ -167,6 +248,59 @@ struct ProcMgrReply
             intptr_t previous;
         } sbrk;
 
+        struct {
+        } unmap;
+
+        struct {
+            uintptr_t vmaddr;
+        } shm_create;
+
+        struct {
+            uintptr_t vmaddr;
+            size_t len;
+        } shm_open;
+
+        struct {
+        } shm_unlink;
+
+        struct {
+            int pid;
+        } fork;
+
+        struct {
+            uintptr_t vmaddr;
+            size_t len;
+        } ramfs_map;
+
+        struct {
+        } set_priority;
+
+        struct {
+            int priority;
+        } get_priority;
+
+        struct {
+            int timer_id;
+        } timer_create;
+
+        struct {
+        } timer_arm;
+
+        struct {
+        } timer_destroy;
+
+        struct {
+            struct ProcessTimes times;
+        } get_times;
+
+        struct {
+            struct MemoryStats stats;
+        } get_memory_stats;
+
+        struct {
+            uint32_t count;
+        } interrupt_count;
+
     } payload;
 };
 
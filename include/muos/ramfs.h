@@ -0,0 +1,24 @@
+#ifndef __MUOS_RAMFS_H__
+#define __MUOS_RAMFS_H__
+
+#include <stddef.h>
+
+#include <muos/decls.h>
+
+BEGIN_DECLS
+
+/**
+ * Map the contents of the RAM filesystem file <tt>name</tt>
+ * read-only into the calling process, without copying it.
+ *
+ * @len     if non-NULL, receives the length of the file in bytes
+ *
+ * @return  the page-aligned address the file was mapped at, or
+ *          NULL if there's no such file or address space ran out.
+ *          Release the mapping by unmapping the whole pages it covers.
+ */
+void const * RamFsMap (char const name[], size_t * len);
+
+END_DECLS
+
+#endif /* __MUOS_RAMFS_H__ */
@@ -0,0 +1,40 @@
+#ifndef __MUOS_SHM_H__
+#define __MUOS_SHM_H__
+
+#include <stddef.h>
+
+#include <muos/decls.h>
+
+BEGIN_DECLS
+
+/**
+ * Allocate a new zero-filled shared-memory object of at least
+ * <tt>len</tt> bytes, publish it under <tt>name</tt>, and map it
+ * into the calling process.
+ *
+ * @return  the address the object was mapped at, or NULL if the
+ *          name is already in use or memory ran out.
+ */
+void * SharedMemoryCreate (char const name[], size_t len);
+
+/**
+ * Map the shared-memory object published under <tt>name</tt> into
+ * the calling process.
+ *
+ * @len     if non-NULL, receives the length of the object in bytes
+ *
+ * @return  the address the object was mapped at, or NULL on failure
+ */
+void * SharedMemoryOpen (char const name[], size_t * len);
+
+/**
+ * Withdraw <tt>name</tt> so no further processes can open it. The
+ * memory itself is released once the last process unmaps it.
+ *
+ * @return  0 on success, or the negated error code if negative.
+ */
+int SharedMemoryUnlink (char const name[]);
+
+END_DECLS
+
+#endif /* __MUOS_SHM_H__ */
@@ -7,10 +7,25 @@
 
 #ifdef __KERNEL__
     #include <kernel/assert.h>
+    #include <kernel/board.h>
+#endif
+
+/*
+ * Whether the lock can be contended by another CPU, rather than only
+ * ever taken with nothing else running
+ */
+#if defined(__KERNEL__) && BOARD_MAX_CPUS > 1
+    #define SPINLOCK_SMP 1
+#else
+    #define SPINLOCK_SMP 0
 #endif
 
 BEGIN_DECLS
 
+#if SPINLOCK_SMP
+    extern void CpuPollIpis (void);
+#endif
+
 typedef struct
 {
     uint32_t    lockval;
@@ -42,16 +57,25 @@ static inline void SpinlockInit (Spinlock_t * lock)
 
 static inline void SpinlockLock (Spinlock_t * lock)
 {
-    #ifdef __KERNEL__
+    IrqSave_t irq_saved_state;
+
+    #if defined(__KERNEL__) && !SPINLOCK_SMP
         assert(SPINLOCK_LOCKVAL_UNLOCKED == lock->lockval);
     #endif
 
     /* On UP systems, this line alone does all the real work. */
-    lock->irq_saved_state = InterruptsDisable();
+    irq_saved_state = InterruptsDisable();
 
     while (!AtomicCompareAndExchange(&lock->lockval, SPINLOCK_LOCKVAL_UNLOCKED, SPINLOCK_LOCKVAL_LOCKED))
     {
+        #if SPINLOCK_SMP
+            /* The holder may be waiting on this CPU to flush its TLB */
+            CpuPollIpis();
+        #endif
     }
+
+    /* Only once it's ours; until then the holder's state is in there */
+    lock->irq_saved_state = irq_saved_state;
 }
 
 static inline void SpinlockLockNoIrqSave (Spinlock_t * lock)
@@ -62,6 +86,9 @@ static inline void SpinlockLockNoIrqSave (Spinlock_t * lock)
 
 static inline void SpinlockUnlock (Spinlock_t * lock)
 {
+    /* Read before the next holder can overwrite it */
+    IrqSave_t irq_saved_state = lock->irq_saved_state;
+
     #ifdef __KERNEL__
         assert(SPINLOCK_LOCKVAL_UNLOCKED != lock->lockval);
     #endif
@@ -70,7 +97,7 @@ static inline void SpinlockUnlock (Spinlock_t * lock)
     {
     }
 
-    InterruptsRestore(lock->irq_saved_state);
+    InterruptsRestore(irq_saved_state);
 }
 
 static inline void SpinlockUnlockNoIrqRestore (Spinlock_t * lock)
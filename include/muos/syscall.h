@@ -22,6 +22,10 @@ enum
     SYS_MSGGETLEN,
     SYS_MSGREAD,
     SYS_MSGREADV,
+    SYS_CLOCK_GETTIME,
+    SYS_NANOSLEEP,
+    SYS_FUTEX_WAIT,
+    SYS_FUTEX_WAKE,
 };
 
 /* Prototypes for userspace syscall stubs */
@@ -0,0 +1,60 @@
+#ifndef __MUOS_TIMER_H__
+#define __MUOS_TIMER_H__
+
+/*! \file */
+
+#include <stdint.h>
+
+#include <muos/decls.h>
+
+BEGIN_DECLS
+
+/**
+ * Read the system clock, which counts nanoseconds since boot and
+ * never goes backwards. Its resolution is one microsecond.
+ *
+ * @return  0 on success, or the negated error code if negative.
+ */
+int ClockGetTime (uint64_t * nanoseconds);
+
+/**
+ * Block the calling thread for at least <tt>nanoseconds</tt>. The
+ * wakeup is normally no more than a millisecond late, although a
+ * thread of higher priority may keep the caller from running for
+ * longer than that.
+ *
+ * @return  0 on success, or the negated error code if negative.
+ */
+int NanoSleep (uint64_t nanoseconds);
+
+/**
+ * Create a timer that delivers a pulse of type #PULSE_TYPE_TIMER on
+ * <tt>connection_id</tt> each time it expires. The pulse's value
+ * field carries <tt>value</tt>. The timer starts out disarmed.
+ *
+ * @return  the timer's identifier, or the negated error code if
+ *          negative.
+ */
+int TimerCreate (int connection_id, uintptr_t value);
+
+/**
+ * Arm the timer <tt>timer_id</tt> to expire <tt>delay_ns</tt>
+ * nanoseconds from now, and then every <tt>interval_ns</tt> if
+ * that's nonzero. Arming a timer that's already armed replaces its
+ * old settings; a <tt>delay_ns</tt> of zero disarms it.
+ *
+ * @return  0 on success, or the negated error code if negative.
+ */
+int TimerArm (int timer_id, uint64_t delay_ns, uint64_t interval_ns);
+
+/**
+ * Disarm and release the timer <tt>timer_id</tt>. Pulses it has
+ * already sent stay queued.
+ *
+ * @return  0 on success, or the negated error code if negative.
+ */
+int TimerDestroy (int timer_id);
+
+END_DECLS
+
+#endif /* __MUOS_TIMER_H__ */
@@ -3,31 +3,132 @@
 #include <muos/message.h>
 #include <muos/process.h>
 
+/*
+ * Programs that time something and check what they timed. Each one's
+ * numbers only mean anything with the machine otherwise quiet, so
+ * they're run one after another once the tests below are done, each
+ * left to finish before the next starts.
+ */
+struct Benchmark
+{
+    char const *    path;
+
+    /* Zero for #SCHED_PRIORITY_DEFAULT */
+    int             priority;
+};
+
+static struct Benchmark const benchmarks[] = {
+    { "fbfill",         0 },
+    { "xlatbench",      0 },
+    { "prio",           SCHED_PRIORITY_DEFAULT + 4 },
+    { "timers",         0 },
+    { "vfp",            0 },
+    { "ipcscale",       0 },
+    { "spawnlat",       0 },
+    { "irqlat",         0 },
+    { "futexbench",     0 },
+    { "ipcswitch",      0 },
+    { "irqidle",        0 },
+    { "heapmap",        0 },
+    { "heapgrow",       0 },
+    { "mapindex",       0 },
+    { "copybench",      0 },
+};
+
+#define NUM_BENCHMARKS  (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+static void await_children (int chid, int wait_id, unsigned int count)
+{
+    while (count-- > 0) {
+        struct Pulse pulse;
+        int msgid;
+        size_t n;
+
+        /* Child wait is created with an initial count of 0 */
+        ChildWaitArm(wait_id, 1);
+
+        n = MessageReceive(chid, &msgid, &pulse, sizeof(pulse));
+
+        assert(n == sizeof(struct Pulse));
+        assert(msgid == 0);
+        assert(pulse.type == PULSE_TYPE_CHILD_FINISH ||
+               pulse.type == PULSE_TYPE_CHILD_STACK_OVERFLOW);
+    }
+}
+
 int main (int argc, char *argv[]) {
 
+    unsigned int tests = 0;
+    unsigned int i;
     int pid;
 
     int chid = ChannelCreate();
     int coid = Connect(SELF_PID, chid);
     int wait_id = ChildWaitAttach(coid, ANY_PID);
 
+    /* Servers, which stay up */
     pid = Spawn("echo");
     pid = Spawn("pl011");
+
+    /* Tests that pass or fail the same however busy the machine is */
     pid = Spawn("crasher");
+    tests++;
 
-    pid = pid;
+    {
+        struct SpawnAttributes attr;
 
-    while (1) {
+        SpawnAttributesInit(&attr);
+        attr.stack_size = 512 * 1024;
+        pid = SpawnWithAttributes("recurse", &attr);
+        tests++;
+    }
 
-        /* Child wait is created with an initial count of 0 */
-        ChildWaitArm(wait_id, 1);
+    pid = Spawn("forker");
+    tests++;
+    pid = Spawn("ramfs-map");
+    tests++;
+    pid = Spawn("ptchurn");
+    tests++;
 
-        struct Pulse pulse;
-        int msgid;
-        size_t n = MessageReceive(chid, &msgid, &pulse, sizeof(pulse));
+    {
+        struct SpawnAttributes attr;
 
-        assert(n == sizeof(struct Pulse));
-        assert(msgid == 0);
+        SpawnAttributesInit(&attr);
+        attr.page_limit = 128;
+        pid = SpawnWithAttributes("memlimit", &attr);
+        tests++;
+    }
+
+    pid = Spawn("vmfrag");
+    tests++;
+    pid = Spawn("cputime");
+    tests++;
+    pid = Spawn("futexstress");
+    tests++;
+    pid = Spawn("heapshrink");
+    tests++;
+
+    await_children(chid, wait_id, tests);
+
+    for (i = 0; i < NUM_BENCHMARKS; i++) {
+        struct SpawnAttributes attr;
+
+        SpawnAttributesInit(&attr);
+
+        if (benchmarks[i].priority != 0) {
+            attr.priority = benchmarks[i].priority;
+        }
+
+        pid = SpawnWithAttributes(benchmarks[i].path, &attr);
+        assert(pid >= 0);
+
+        await_children(chid, wait_id, 1);
+    }
+
+    pid = pid;
+
+    while (1) {
+        await_children(chid, wait_id, 1);
     }
 
     ChildWaitDetach(wait_id);
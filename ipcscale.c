@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+/* Round trips made by each client */
+#define ROUNDS          5000
+
+/* Most client/server pairs run at once */
+#define MAX_PAIRS       4
+
+#define NSEC_PER_SEC    ((uint64_t)1000 * 1000 * 1000)
+
+/*
+ * Round trips per second, all pairs together, with N independent
+ * client/server pairs running at once. No two pairs share a channel
+ * or a process, so with more than one CPU the total should grow with
+ * the number of pairs until there are more pairs than CPUs. On one CPU
+ * it stays flat. Left here to be read from the debugger.
+ */
+static volatile uint64_t trips_per_sec[MAX_PAIRS + 1];
+
+/* When a server started and finished serving its client */
+struct Report
+{
+    uint64_t start;
+    uint64_t end;
+};
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static void client (int coid)
+{
+    unsigned int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        unsigned int echoed;
+
+        assert(MessageSend(coid, &i, sizeof(i), &echoed, sizeof(echoed)) == 0);
+        assert(echoed == i + 1);
+    }
+}
+
+static void server (int main_coid)
+{
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    struct Report report;
+    unsigned int i;
+    int pid;
+
+    pid = Fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        client(coid);
+        Exit();
+    }
+
+    /* Held here until every pair is ready, so that they all start at once */
+    assert(MessageSend(main_coid, NULL, 0, NULL, 0) == 0);
+
+    report.start = now();
+
+    for (i = 0; i < ROUNDS; i++) {
+        unsigned int n;
+        int msgid;
+
+        assert(MessageReceive(chid, &msgid, &n, sizeof(n)) == sizeof(n));
+        assert(msgid != 0 && n == i);
+
+        n++;
+        MessageReply(msgid, 0, &n, sizeof(n));
+    }
+
+    report.end = now();
+
+    assert(MessageSend(main_coid, &report, sizeof(report), NULL, 0) == 0);
+}
+
+static void run_pairs (int chid, int coid, unsigned int pairs)
+{
+    int ready[MAX_PAIRS];
+    uint64_t first = ~(uint64_t)0;
+    uint64_t last = 0;
+    unsigned int i;
+
+    for (i = 0; i < pairs; i++) {
+        int pid = Fork();
+
+        assert(pid >= 0);
+
+        if (pid == 0) {
+            server(coid);
+            Exit();
+        }
+    }
+
+    for (i = 0; i < pairs; i++) {
+        assert(MessageReceive(chid, &ready[i], NULL, 0) == 0);
+        assert(ready[i] != 0);
+    }
+
+    for (i = 0; i < pairs; i++) {
+        MessageReply(ready[i], 0, NULL, 0);
+    }
+
+    for (i = 0; i < pairs; i++) {
+        struct Report report;
+        int msgid;
+
+        assert(MessageReceive(chid, &msgid, &report, sizeof(report)) == sizeof(report));
+        assert(msgid != 0);
+        MessageReply(msgid, 0, NULL, 0);
+
+        first = report.start < first ? report.start : first;
+        last = report.end > last ? report.end : last;
+    }
+
+    assert(last > first);
+    trips_per_sec[pairs] = (uint64_t)pairs * ROUNDS * NSEC_PER_SEC / (last - first);
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    unsigned int pairs;
+
+    for (pairs = 1; pairs <= MAX_PAIRS; pairs *= 2) {
+        run_pairs(chid, coid, pairs);
+    }
+
+    /*
+    However many CPUs there are, more pairs mustn't mean much less
+    getting done in total, as it would if they all fought over one lock.
+    */
+    assert(trips_per_sec[MAX_PAIRS] >= trips_per_sec[1] / 2);
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+/* Clients sharing the one server, all at the same priority as it */
+#define CLIENTS         3
+
+/* Round trips made by each client */
+#define ROUNDS          2000
+
+#define MSEC            ((uint64_t)1000 * 1000)
+
+/*
+ * A repeating timer's pulses, received by a thread of the same priority
+ * as one that's spinning for as long as they keep coming
+ */
+#define TIMER_INTERVAL  (1 * MSEC)
+#define SPIN_TIME       (500 * MSEC)
+
+/*
+ * Times per hundred messages that a thread was switched away from while
+ * it could still have run: across the server and all its clients for
+ * the reply path, and for the thread spinning while timer pulses wake
+ * one of its own priority. Left here to be read from the debugger.
+ *
+ * A thread woken by another of its own priority, or by an interrupt
+ * while one of its own priority runs, doesn't take the CPU from it.
+ * So these switches only come from interrupts asking for a reschedule
+ * at the end of a timeslice: about one per five milliseconds, however
+ * many messages pass in that time. If each wakeup switched to the woken
+ * thread on a single CPU, the clients and the spinner would be switched
+ * away from once per message. With more CPUs the woken thread mostly
+ * runs on another one, and the count only goes down.
+ */
+static volatile uint32_t reply_preemptions_per_100;
+static volatile uint32_t pulse_preemptions_per_100;
+
+/* What each client sends once it's done its round trips */
+struct Report
+{
+    uint32_t preemptions;
+    uint32_t pad;
+};
+
+static uint32_t own_preemptions (void)
+{
+    struct ProcessTimes times;
+
+    assert(GetProcessTimes(SELF_PID, &times) == 0);
+    return times.involuntary_switches;
+}
+
+static void client (int coid)
+{
+    uint32_t start = own_preemptions();
+    struct Report report;
+    unsigned int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        unsigned int echoed;
+
+        assert(MessageSend(coid, &i, sizeof(i), &echoed, sizeof(echoed)) == 0);
+        assert(echoed == i + 1);
+    }
+
+    /* Told apart from a round trip by its length */
+    report.preemptions = own_preemptions() - start;
+    report.pad = 0;
+    assert(MessageSend(coid, &report, sizeof(report), NULL, 0) == 0);
+}
+
+static void measure_replies (int chid, int coid)
+{
+    uint32_t preemptions = 0;
+    unsigned int trips = 0;
+    unsigned int reports = 0;
+    uint32_t start;
+    unsigned int i;
+
+    for (i = 0; i < CLIENTS; i++) {
+        int pid = Fork();
+
+        assert(pid >= 0);
+
+        if (pid == 0) {
+            client(coid);
+            Exit();
+        }
+    }
+
+    start = own_preemptions();
+
+    while (trips < CLIENTS * ROUNDS || reports < CLIENTS) {
+        union
+        {
+            unsigned int n;
+            struct Report report;
+        } msg;
+        int msgid;
+        int len;
+
+        len = MessageReceive(chid, &msgid, &msg, sizeof(msg));
+        assert(msgid != 0);
+
+        if (len == sizeof(msg.report)) {
+            MessageReply(msgid, 0, NULL, 0);
+            preemptions += msg.report.preemptions;
+            reports++;
+        }
+        else {
+            assert(len == sizeof(msg.n));
+            msg.n++;
+            MessageReply(msgid, 0, &msg.n, sizeof(msg.n));
+            trips++;
+        }
+    }
+
+    preemptions += own_preemptions() - start;
+
+    reply_preemptions_per_100 = preemptions * 100 / (CLIENTS * ROUNDS);
+}
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static void spinner (int coid)
+{
+    uint32_t start = own_preemptions();
+    uint64_t end = now() + SPIN_TIME;
+    struct Report report;
+
+    while (now() < end) {
+    }
+
+    report.preemptions = own_preemptions() - start;
+    report.pad = 0;
+    assert(MessageSend(coid, &report, sizeof(report), NULL, 0) == 0);
+}
+
+static void measure_pulses (int chid, int coid)
+{
+    int timer = TimerCreate(coid, 0);
+    unsigned int received = 0;
+    int pid;
+
+    assert(timer > 0);
+
+    pid = Fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        spinner(coid);
+        Exit();
+    }
+
+    assert(TimerArm(timer, TIMER_INTERVAL, TIMER_INTERVAL) == 0);
+
+    for (;;) {
+        union
+        {
+            struct Pulse pulse;
+            struct Report report;
+        } msg;
+        int msgid;
+        int len;
+
+        len = MessageReceive(chid, &msgid, &msg, sizeof(msg));
+
+        if (msgid != 0) {
+            /* The spinner's done */
+            assert(len == sizeof(msg.report));
+            MessageReply(msgid, 0, NULL, 0);
+
+            assert(received > 0);
+            pulse_preemptions_per_100 = msg.report.preemptions * 100 / received;
+            break;
+        }
+
+        assert(len == sizeof(msg.pulse));
+        assert(msg.pulse.type == PULSE_TYPE_TIMER);
+        received++;
+    }
+
+    assert(TimerDestroy(timer) == 0);
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+
+    measure_replies(chid, coid);
+    measure_pulses(chid, coid);
+
+    assert(reply_preemptions_per_100 < 50);
+    assert(pulse_preemptions_per_100 < 50);
+
+    return 0;
+}
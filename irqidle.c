@@ -0,0 +1,71 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/io.h>
+#include <muos/timer.h>
+
+/* More than any board this runs on */
+#define MAX_CPUS    16
+
+/* One-second windows to watch */
+#define WINDOWS     20
+
+/*
+ * Fewest interrupts each CPU took in any one of the windows. Whatever
+ * ran before this one may still be winding down, so only a window
+ * where the system had gone quiet shows the idle rate: with the tick gone, that's next
+ * to none, where a periodic 5ms tick would give 200. Left here to be
+ * read from the debugger.
+ */
+static volatile uint32_t idle_irqs_per_second[MAX_CPUS];
+
+static unsigned int read_counts (uint32_t counts[MAX_CPUS])
+{
+    unsigned int cpus;
+
+    for (cpus = 0; cpus < MAX_CPUS; cpus++) {
+        if (GetInterruptCount(cpus, &counts[cpus]) != 0) {
+            break;
+        }
+    }
+
+    return cpus;
+}
+
+int main () {
+    uint32_t before[MAX_CPUS];
+    uint32_t after[MAX_CPUS];
+    unsigned int cpus;
+    unsigned int window;
+    unsigned int i;
+
+    cpus = read_counts(before);
+    assert(cpus > 0);
+
+    for (i = 0; i < cpus; i++) {
+        idle_irqs_per_second[i] = UINT32_MAX;
+    }
+
+    for (window = 0; window < WINDOWS; window++) {
+        uint32_t total = 0;
+
+        NanoSleep(1000 * 1000 * 1000);
+
+        assert(read_counts(after) == cpus);
+
+        for (i = 0; i < cpus; i++) {
+            total += after[i] - before[i];
+
+            if (after[i] - before[i] < idle_irqs_per_second[i]) {
+                idle_irqs_per_second[i] = after[i] - before[i];
+            }
+
+            before[i] = after[i];
+        }
+
+        /* The timer had to interrupt some CPU to end the sleep */
+        assert(total > 0);
+    }
+
+    return 0;
+}
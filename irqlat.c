@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/arch.h>
+#include <muos/error.h>
+#include <muos/io.h>
+#include <muos/message.h>
+
+/*
+ * Second dual timer of the board, which the kernel leaves alone. On the
+ * RealView EB's MPCore test chip its line 5 reaches the GIC as shared
+ * interrupt 2.
+ */
+#if defined(BOARD_REALVIEW_EB_MPCORE)
+    #define TIMER23_PHYS    0x10012000
+    #define TIMER23_IRQ     34
+#else
+    #define TIMER23_PHYS    0x101E3000
+    #define TIMER23_IRQ     5
+#endif
+
+/* Both halves count a 1 MHz reference, so one count is a microsecond */
+#define TIMER2          0x00
+#define TIMER3          0x20
+
+#define TIMER_LOAD      0x00
+#define TIMER_VALUE     0x04
+#define TIMER_CONTROL   0x08
+#define TIMER_INTCLR    0x0c
+
+#define CONTROL_ONESHOT     0x01
+#define CONTROL_32BIT       0x02
+#define CONTROL_INT_ENABLE  0x20
+#define CONTROL_ENABLE      0x80
+
+/* Interrupts timed */
+#define ROUNDS          200
+
+/* From arming the one-shot to its interrupt */
+#define DELAY_US        1000
+
+/*
+ * This program's handler runs at interrupt-handling priority, ahead of
+ * everything else it's sharing the CPU with, so getting to it should
+ * take well under a timeslice
+ */
+#define MAX_LATENCY_US  5000
+
+/*
+ * Time from the timer interrupt being raised to this program having
+ * its pulse in hand, worst and on average. Left here to be read from
+ * the debugger.
+ */
+static volatile uint32_t worst_latency_us;
+static volatile uint32_t mean_latency_us;
+
+static volatile uint8_t * timers;
+
+static volatile uint32_t * reg (unsigned int timer, unsigned int offset)
+{
+    return (volatile uint32_t *)(timers + timer + offset);
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    uint64_t total = 0;
+    unsigned int i;
+    int handler_id;
+
+    timers = MapPhysical(TIMER23_PHYS, PAGE_SIZE, CACHE_ATTR_STRONGLY_ORDERED);
+    assert(timers != NULL);
+
+    /* Timer 3 free-runs, counting down, to tell the time by */
+    *reg(TIMER3, TIMER_CONTROL) = 0;
+    *reg(TIMER3, TIMER_LOAD) = 0xffffffff;
+    *reg(TIMER3, TIMER_CONTROL) = CONTROL_32BIT | CONTROL_ENABLE;
+
+    *reg(TIMER2, TIMER_CONTROL) = 0;
+    *reg(TIMER2, TIMER_INTCLR) = 0;
+
+    handler_id = InterruptAttach(coid, TIMER23_IRQ, NULL);
+    assert(handler_id >= 0);
+
+    for (i = 0; i < ROUNDS; i++) {
+        struct Pulse pulse;
+        uint32_t armed;
+        uint32_t elapsed;
+        uint32_t latency;
+        int msgid;
+
+        /* Timer 2 is the one-shot whose interrupt is timed */
+        *reg(TIMER2, TIMER_LOAD) = DELAY_US;
+        armed = *reg(TIMER3, TIMER_VALUE);
+        *reg(TIMER2, TIMER_CONTROL) = CONTROL_32BIT | CONTROL_INT_ENABLE |
+                                      CONTROL_ONESHOT | CONTROL_ENABLE;
+
+        assert(MessageReceive(chid, &msgid, &pulse, sizeof(pulse)) == sizeof(pulse));
+        elapsed = armed - *reg(TIMER3, TIMER_VALUE);
+
+        assert(msgid == 0);
+        assert(pulse.type == PULSE_TYPE_INTERRUPT);
+        assert(elapsed >= DELAY_US);
+
+        latency = elapsed - DELAY_US;
+        total += latency;
+
+        if (latency > worst_latency_us) {
+            worst_latency_us = latency;
+        }
+
+        *reg(TIMER2, TIMER_CONTROL) = 0;
+        *reg(TIMER2, TIMER_INTCLR) = 0;
+        assert(InterruptComplete(handler_id) == ERROR_OK);
+    }
+
+    mean_latency_us = total / ROUNDS;
+
+    assert(InterruptDetach(handler_id) == ERROR_OK);
+    assert(worst_latency_us < MAX_LATENCY_US);
+
+    return 0;
+}
@@ -1,8 +1,11 @@
 #include <muos/arch.h>
+#include <muos/atomic.h>
+#include <muos/error.h>
 
 #include <kernel/address-space.hpp>
 #include <kernel/assert.h>
 #include <kernel/math.hpp>
+#include <kernel/memory.h>
 #include <kernel/minmax.hpp>
 #include <kernel/vm-defs.h>
 
@@ -10,9 +13,12 @@ SyncSlabAllocator<VmArea> VmArea::sSlab;
 
 VmArea::VmArea (size_t aLength) throw (std::bad_alloc)
     : mPageCount(0)
+    , mShared(false)
 {
     assert(aLength % PAGE_SIZE == 0);
 
+    SpinlockInit(&mLock);
+
     while (mPageCount * PAGE_SIZE < aLength)
     {
         Page * page = Page::Alloc();
@@ -20,6 +26,7 @@ VmArea::VmArea (size_t aLength) throw (std::bad_alloc)
         if (!page)
             throw std::bad_alloc();
 
+        page->sharers = 0;
         mPages.Append(page);
         mPageCount++;
     }
@@ -43,6 +50,166 @@ List<Page, &Page::list_link>::Iterator VmArea::GetPages ()
     return mPages.Begin();
 }
 
+void VmArea::Split (size_t aOffset, RefPtr<VmArea> aTail)
+{
+    assert(aOffset % PAGE_SIZE == 0);
+    assert(aTail->mPageCount == 0);
+    assert(!mShared);
+
+    while (mPageCount * PAGE_SIZE > aOffset)
+    {
+        aTail->mPages.Prepend(mPages.PopLast());
+        aTail->mPageCount++;
+        mPageCount--;
+    }
+}
+
+void VmArea::Join (RefPtr<VmArea> aTail)
+{
+    assert(!mShared);
+    assert(!aTail->mShared);
+
+    while (!aTail->mPages.Empty())
+    {
+        mPages.Append(aTail->mPages.PopFirst());
+        aTail->mPageCount--;
+        mPageCount++;
+    }
+}
+
+void VmArea::MarkShared ()
+{
+    mShared = true;
+}
+
+bool VmArea::IsShared ()
+{
+    return mShared;
+}
+
+List<Page, &Page::list_link>::Iterator VmArea::GetPagesFrom (Page * aPage)
+{
+    return mPages.At(aPage);
+}
+
+void VmArea::AddCopyOnWriteSharer (Page * aFirst, size_t aCount)
+{
+    Page * page = aFirst;
+
+    SpinlockLock(&mLock);
+
+    for (size_t i = 0; i < aCount; i++) {
+        page->sharers++;
+        page = mPages.Next(page);
+    }
+
+    SpinlockUnlock(&mLock);
+}
+
+void VmArea::RemoveCopyOnWriteSharer (Page * aFirst, size_t aCount)
+{
+    List<Page, &Page::list_link> unused;
+    Page * page = aFirst;
+
+    SpinlockLock(&mLock);
+
+    for (size_t i = 0; i < aCount; i++) {
+        Page * next = mPages.Next(page);
+
+        assert(page->sharers > 0);
+
+        // Nobody maps it any more, so it needn't wait for the rest of
+        // the area to go
+        if (--page->sharers == 0) {
+            mPages.Remove(page);
+            mPageCount--;
+            unused.Append(page);
+        }
+
+        page = next;
+    }
+
+    SpinlockUnlock(&mLock);
+
+    while (!unused.Empty()) {
+        Page::Free(unused.PopFirst());
+    }
+}
+
+size_t VmArea::CountSharedPages (Page * aFirst, size_t aCount)
+{
+    Page * page = aFirst;
+    size_t shared = 0;
+
+    SpinlockLock(&mLock);
+
+    for (size_t i = 0; i < aCount; i++) {
+        if (page->sharers > 1) {
+            shared++;
+        }
+
+        page = mPages.Next(page);
+    }
+
+    SpinlockUnlock(&mLock);
+
+    return shared;
+}
+
+Page * VmArea::TakeCopyOnWritePages (Page * aFirst,
+                                     size_t aCount,
+                                     RefPtr<VmArea> aCopies,
+                                     RefPtr<VmArea> aOwn)
+{
+    Page * firstCopied = NULL;
+    Page * page = aFirst;
+
+    for (size_t i = 0; i < aCount; i++) {
+        Page * next;
+        bool shared;
+
+        SpinlockLock(&mLock);
+
+        next = mPages.Next(page);
+        shared = page->sharers > 1;
+
+        if (!shared) {
+            // Nobody else can start sharing it now, either
+            mPages.Remove(page);
+            mPageCount--;
+            page->sharers = 0;
+        }
+
+        SpinlockUnlock(&mLock);
+
+        if (shared) {
+            // Others can only have let go since the pages were
+            // counted, so there's a copy to spare. The caller's share
+            // keeps the original from being freed meanwhile.
+            assert(!aCopies->mPages.Empty());
+
+            Page * copy = aCopies->mPages.PopFirst();
+            aCopies->mPageCount--;
+
+            PageCopy((void *)copy->base_address, (void *)page->base_address);
+
+            aOwn->mPages.Append(copy);
+
+            if (!firstCopied) {
+                firstCopied = page;
+            }
+        }
+        else {
+            aOwn->mPages.Append(page);
+        }
+
+        aOwn->mPageCount++;
+        page = next;
+    }
+
+    return firstCopied;
+}
+
 SyncSlabAllocator<BackedMapping> BackedMapping::sSlab;
 
 Mapping::Mapping (VmAddr_t aBaseAddress,
@@ -62,14 +229,10 @@ Mapping::~Mapping ()
 void Mapping::Unmap (RefPtr<TranslationTable> aPageTable,
                      size_t aPageCount)
 {
-    VmAddr_t virt = mBaseAddress;
-
-    while (aPageCount > 0) {
-        bool unmapped = aPageTable->UnmapPage(virt);
-        assert(unmapped);
-        virt += PAGE_SIZE;
-        aPageCount--;
-    }
+    bool unmapped = aPageCount == 1
+            ? aPageTable->UnmapPage(mBaseAddress)
+            : aPageTable->UnmapRange(mBaseAddress, aPageCount * PAGE_SIZE);
+    assert(unmapped);
 }
 
 VmAddr_t Mapping::GetBaseAddress ()
@@ -77,38 +240,75 @@ VmAddr_t Mapping::GetBaseAddress ()
     return mBaseAddress;
 }
 
+Prot_t Mapping::GetProtection ()
+{
+    return mProtection;
+}
+
+bool Mapping::IsCopyOnWrite ()
+{
+    return false;
+}
+
+bool Mapping::BreakCopyOnWrite (RefPtr<TranslationTable> aPageTable)
+{
+    assert(false);
+    return false;
+}
+
+size_t Mapping::GetCommittedPages ()
+{
+    return 0;
+}
+
 BackedMapping::BackedMapping (VmAddr_t aBaseAddress,
                               Prot_t aProtection,
                               RefPtr<VmArea> aRegion)
     : Mapping(aBaseAddress, aProtection)
     , mRegion(aRegion)
+    , mFirstPage(NULL)
+    , mPageCount(aRegion->GetPageCount())
+    , mCopyOnWrite(false)
 {
 }
 
 BackedMapping::~BackedMapping ()
 {
+    if (mCopyOnWrite) {
+        mRegion->RemoveCopyOnWriteSharer(mFirstPage, mPageCount);
+    }
 }
 
-bool BackedMapping::Map (RefPtr<TranslationTable> aPageTable)
+BackedMapping * BackedMapping::NewPiece (VmAddr_t aBaseAddress,
+                                         RefPtr<VmArea> aRegion)
+    throw (std::bad_alloc)
 {
-    assert(!mMapped);
+    return new BackedMapping(aBaseAddress, mProtection, aRegion);
+}
 
-    VmAddr_t virt = mBaseAddress;
-    size_t numPagesLeft = mRegion->GetPageCount();
-    List<Page, &Page::list_link>::Iterator pageIter = mRegion->GetPages();
+List<Page, &Page::list_link>::Iterator BackedMapping::GetFirstPage ()
+{
+    return mFirstPage ? mRegion->GetPagesFrom(mFirstPage)
+                      : mRegion->GetPages();
+}
 
-    while (numPagesLeft > 0) {
-        Page * p = *pageIter;
-        bool mapped = aPageTable->MapPage(virt, V2P(p->base_address), mProtection);
-        if (!mapped) {
-            assert(false);
-            Mapping::Unmap(aPageTable, mRegion->GetPageCount() - numPagesLeft);
-            return false;
-        }
+Prot_t BackedMapping::GetMappedProtection ()
+{
+    if (mCopyOnWrite && mProtection == PROT_USER_READWRITE) {
+        return PROT_USER_READONLY;
+    }
 
-        virt += PAGE_SIZE;
-        numPagesLeft--;
-        ++pageIter;
+    return mProtection;
+}
+
+bool BackedMapping::Map (RefPtr<TranslationTable> aPageTable)
+{
+    assert(!mMapped);
+
+    if (!aPageTable->MapRange(mBaseAddress, GetFirstPage(),
+                              GetLength(), GetMappedProtection()))
+    {
+        return false;
     }
 
     mMapped = true;
@@ -118,13 +318,220 @@ bool BackedMapping::Map (RefPtr<TranslationTable> aPageTable)
 void BackedMapping::Unmap (RefPtr<TranslationTable> aPageTable)
 {
     assert(mMapped);
-    Mapping::Unmap(aPageTable, mRegion->GetPageCount());
+    Mapping::Unmap(aPageTable, mPageCount);
     mMapped = false;
 }
 
 size_t BackedMapping::GetLength ()
 {
-    return mRegion->GetPageCount() * PAGE_SIZE;
+    return mPageCount * PAGE_SIZE;
+}
+
+Mapping * BackedMapping::Split (VmAddr_t aAddress) throw (std::bad_alloc)
+{
+    assert(aAddress % PAGE_SIZE == 0);
+    assert(aAddress > mBaseAddress);
+    assert(aAddress < mBaseAddress + GetLength());
+
+    size_t headPages = (aAddress - mBaseAddress) / PAGE_SIZE;
+    RefPtr<VmArea> tailRegion;
+    BackedMapping * tail;
+
+    // Other address spaces see the same pages
+    if (mRegion->IsShared()) {
+        return NULL;
+    }
+
+    if (mCopyOnWrite) {
+        // Pages shared copy-on-write stay where they are; the tail
+        // just takes over this mapping's share of the later ones
+        List<Page, &Page::list_link>::Iterator page = GetFirstPage();
+
+        for (size_t i = 0; i < headPages; i++) {
+            ++page;
+        }
+
+        tail = NewPiece(aAddress, mRegion);
+        tail->mFirstPage = *page;
+        tail->mPageCount = mPageCount - headPages;
+        tail->mCopyOnWrite = true;
+        tail->mMapped = mMapped;
+
+        mPageCount = headPages;
+
+        return tail;
+    }
+
+    // Allocate everything up front so that nothing needs undone
+    // if we run out of memory
+    tailRegion.Reset(new VmArea(0));
+    tail = NewPiece(aAddress, tailRegion);
+
+    mRegion->Split(aAddress - mBaseAddress, tailRegion);
+    tail->mPageCount = tailRegion->GetPageCount();
+    tail->mMapped = mMapped;
+    mPageCount = headPages;
+
+    return tail;
+}
+
+bool BackedMapping::Extend (RefPtr<TranslationTable> aPageTable,
+                            RefPtr<VmArea> aRegion)
+{
+    assert(mMapped);
+
+    if (mRegion->IsShared() || aRegion->IsShared() || mCopyOnWrite) {
+        return false;
+    }
+
+    if (!aPageTable->MapRange(mBaseAddress + GetLength(),
+                              aRegion->GetPages(),
+                              aRegion->GetPageCount() * PAGE_SIZE,
+                              mProtection))
+    {
+        return false;
+    }
+
+    mPageCount += aRegion->GetPageCount();
+    mRegion->Join(aRegion);
+    return true;
+}
+
+bool BackedMapping::Join (BackedMapping * aTail)
+{
+    assert(mMapped && aTail->mMapped);
+    assert(aTail->mBaseAddress == mBaseAddress + GetLength());
+
+    if (mRegion->IsShared() || aTail->mRegion->IsShared() ||
+        mCopyOnWrite || aTail->mCopyOnWrite ||
+        mProtection != aTail->mProtection)
+    {
+        return false;
+    }
+
+    // The pages are already mapped where they need to be
+    mPageCount += aTail->mPageCount;
+    mRegion->Join(aTail->mRegion);
+
+    aTail->mPageCount = 0;
+    aTail->mMapped = false;
+    return true;
+}
+
+Mapping * BackedMapping::Duplicate (RefPtr<TranslationTable> aPageTable)
+    throw (std::bad_alloc)
+{
+    BackedMapping * copy = NewPiece(mBaseAddress, mRegion);
+
+    copy->mPageCount = mPageCount;
+    ShareWith(copy, aPageTable);
+    return copy;
+}
+
+void BackedMapping::ShareWith (BackedMapping * aCopy,
+                               RefPtr<TranslationTable> aPageTable)
+{
+    // Shared-memory objects stay shared; both sides keep seeing
+    // each other's writes
+    if (mRegion->IsShared()) {
+        return;
+    }
+
+    if (!mCopyOnWrite) {
+        // Pages that other sharers stop using get taken out of the
+        // region, so from now on this mapping finds its own by
+        // pointer rather than by where they are in the region
+        mFirstPage = *mRegion->GetPages();
+        mRegion->AddCopyOnWriteSharer(mFirstPage, mPageCount);
+        mCopyOnWrite = true;
+
+        if (mMapped) {
+            bool protectedRange = aPageTable->ProtectRange(mBaseAddress,
+                                                           GetLength(),
+                                                           GetMappedProtection());
+            assert(protectedRange);
+        }
+    }
+
+    mRegion->AddCopyOnWriteSharer(mFirstPage, mPageCount);
+    aCopy->mFirstPage = mFirstPage;
+    aCopy->mCopyOnWrite = true;
+}
+
+bool BackedMapping::IsCopyOnWrite ()
+{
+    return mCopyOnWrite;
+}
+
+size_t BackedMapping::GetCommittedPages ()
+{
+    return mPageCount;
+}
+
+bool BackedMapping::BreakCopyOnWrite (RefPtr<TranslationTable> aPageTable)
+{
+    assert(mCopyOnWrite);
+    assert(mMapped);
+
+    RefPtr<VmArea> copies;
+    RefPtr<VmArea> own;
+    Page * copied;
+    size_t numCopies;
+
+    // Only pages that another mapping still shares need copying. Any
+    // whose other sharers have already broken away, or gone, are
+    // simply taken over.
+    try {
+        numCopies = mRegion->CountSharedPages(mFirstPage, mPageCount);
+        copies.Reset(new VmArea(numCopies * PAGE_SIZE));
+        own.Reset(new VmArea(0));
+    }
+    catch (std::bad_alloc) {
+        return false;
+    }
+
+    copied = mRegion->TakeCopyOnWritePages(mFirstPage, mPageCount,
+                                           copies, own);
+
+    bool remapped = aPageTable->RemapRange(mBaseAddress, own->GetPages(),
+                                           GetLength(), mProtection);
+    assert(remapped);
+
+    // Nothing here maps the originals any more, so they may go
+    if (copied) {
+        mRegion->RemoveCopyOnWriteSharer(copied,
+                                         numCopies - copies->GetPageCount());
+    }
+
+    mRegion = own;
+    mFirstPage = NULL;
+    mCopyOnWrite = false;
+    return true;
+}
+
+SyncSlabAllocator<StackMapping> StackMapping::sSlab;
+
+StackMapping::StackMapping (VmAddr_t aBaseAddress,
+                            Prot_t aProtection,
+                            RefPtr<VmArea> aRegion,
+                            VmAddr_t aFloor)
+    : BackedMapping(aBaseAddress, aProtection, aRegion)
+    , mFloor(aFloor)
+{
+    assert(aFloor % PAGE_SIZE == 0);
+    assert(aFloor <= aBaseAddress);
+}
+
+VmAddr_t StackMapping::GetFloor ()
+{
+    return mFloor;
+}
+
+BackedMapping * StackMapping::NewPiece (VmAddr_t aBaseAddress,
+                                        RefPtr<VmArea> aRegion)
+    throw (std::bad_alloc)
+{
+    return new StackMapping(aBaseAddress, mProtection, aRegion, mFloor);
 }
 
 SyncSlabAllocator<PhysicalMapping> PhysicalMapping::sSlab;
@@ -132,10 +539,12 @@ SyncSlabAllocator<PhysicalMapping> PhysicalMapping::sSlab;
 PhysicalMapping::PhysicalMapping (VmAddr_t aVirtualAddress,
                                   PhysAddr_t aPhysicalAddress,
                                   size_t aLength,
-                                  Prot_t aProtection)
+                                  Prot_t aProtection,
+                                  CacheAttr_t aCacheAttr)
     : Mapping(aVirtualAddress, aProtection)
     , mPhysicalAddress(aPhysicalAddress)
     , mLength(aLength)
+    , mCacheAttr(aCacheAttr)
 {
     assert(aPhysicalAddress % PAGE_SIZE == 0);
     assert(aLength % PAGE_SIZE == 0);
@@ -149,21 +558,10 @@ bool PhysicalMapping::Map (RefPtr<TranslationTable> aPageTable)
 {
     assert(!mMapped);
 
-    VmAddr_t virt = mBaseAddress;
-    PhysAddr_t phys = mPhysicalAddress;
-    size_t numPagesLeft = mLength / PAGE_SIZE;
-
-    while (numPagesLeft > 0) {
-        bool mapped = aPageTable->MapPage(virt, phys, mProtection);
-        if (!mapped) {
-            assert(false);
-            Mapping::Unmap(aPageTable, (mLength / PAGE_SIZE) - numPagesLeft);
-            return false;
-        }
-
-        virt += PAGE_SIZE;
-        phys += PAGE_SIZE;
-        numPagesLeft--;
+    if (!aPageTable->MapRange(mBaseAddress, mPhysicalAddress,
+                              mLength, mProtection, mCacheAttr))
+    {
+        return false;
     }
 
     mMapped = true;
@@ -182,10 +580,121 @@ size_t PhysicalMapping::GetLength ()
     return mLength;
 }
 
+Mapping * PhysicalMapping::Split (VmAddr_t aAddress) throw (std::bad_alloc)
+{
+    assert(aAddress % PAGE_SIZE == 0);
+    assert(aAddress > mBaseAddress);
+    assert(aAddress < mBaseAddress + mLength);
+
+    size_t offset = aAddress - mBaseAddress;
+
+    PhysicalMapping * tail = new PhysicalMapping(aAddress,
+                                                 mPhysicalAddress + offset,
+                                                 mLength - offset,
+                                                 mProtection,
+                                                 mCacheAttr);
+    tail->mMapped = mMapped;
+    mLength = offset;
+
+    return tail;
+}
+
+Mapping * PhysicalMapping::Duplicate (RefPtr<TranslationTable> aPageTable)
+    throw (std::bad_alloc)
+{
+    return new PhysicalMapping(mBaseAddress, mPhysicalAddress,
+                               mLength, mProtection, mCacheAttr);
+}
+
+MappingTree::MappingTree () throw (std::bad_alloc)
+    : mTree(new BaseToMappingMap_t(BaseToMappingMap_t::AddressCompareFunc))
+{
+}
+
+bool MappingTree::Insert (Mapping * aMapping)
+{
+    assert(!FindIntersecting(aMapping->GetBaseAddress(),
+                             aMapping->GetLength()));
+
+    mTree->Insert(aMapping->GetBaseAddress(), aMapping);
+
+    // Tree doesn't report allocation failures directly
+    return mTree->Lookup(aMapping->GetBaseAddress()) == aMapping;
+}
+
+void MappingTree::Remove (Mapping * aMapping)
+{
+    Mapping * removed = mTree->Remove(aMapping->GetBaseAddress());
+    assert(removed == aMapping);
+}
+
+Mapping * MappingTree::Find (VmAddr_t aAddress)
+{
+    Mapping * candidate = mTree->LookupFloor(aAddress);
+
+    if (candidate && candidate->Intersects(aAddress, 1)) {
+        return candidate;
+    }
+
+    return NULL;
+}
+
+Mapping * MappingTree::FindIntersecting (VmAddr_t aBaseAddress,
+                                         size_t aLength)
+{
+    if (aLength == 0) {
+        return NULL;
+    }
+
+    // Since the mappings don't overlap each other, the only one that
+    // can reach into the range is the last one starting before its end
+    Mapping * candidate = mTree->LookupFloor(aBaseAddress + aLength - 1);
+
+    if (candidate && candidate->Intersects(aBaseAddress, aLength)) {
+        return candidate;
+    }
+
+    return NULL;
+}
+
+Mapping * MappingTree::FindAbove (VmAddr_t aAddress)
+{
+    if (aAddress + 1 == 0) {
+        return NULL;
+    }
+
+    return mTree->LookupCeiling(aAddress + 1);
+}
+
+Mapping * MappingTree::First ()
+{
+    return mTree->LookupCeiling(0);
+}
+
+Mapping * MappingTree::Next (Mapping * aMapping)
+{
+    VmAddr_t end = aMapping->GetBaseAddress() + aMapping->GetLength();
+
+    // Mapping that runs right up to the top of the address space
+    if (end == 0) {
+        return NULL;
+    }
+
+    return mTree->LookupCeiling(end);
+}
+
+bool MappingTree::Empty ()
+{
+    return mTree->Size() == 0;
+}
+
 SyncSlabAllocator<AddressSpace> AddressSpace::sSlab;
 
 AddressSpace::AddressSpace ()
     : mPageTable(new TranslationTable())
+    , mMappedPages(0)
+    , mKernelObjectBytes(0)
+    , mPageLimit(0)
 {
     /*
     User-accessible addresses run from 0 through KERNEL_MODE_OFFSET
@@ -216,30 +725,315 @@ AddressSpace::~AddressSpace ()
 {
     Mapping * mapping;
 
-    while (!mHeap.Empty()) {
-        mapping = mHeap.PopFirst();
+    while ((mapping = mHeap.First()) != NULL) {
+        mHeap.Remove(mapping);
         mapping->Unmap(mPageTable);
         delete mapping;
     }
 
-    while (!mStacks.Empty()) {
-        mapping = mStacks.PopFirst();
+    while ((mapping = mStacks.First()) != NULL) {
+        mStacks.Remove(mapping);
         mapping->Unmap(mPageTable);
         delete mapping;
     }
 
-    while (!mMappings.Empty()) {
-        mapping = mMappings.PopFirst();
+    while ((mapping = mMappings.First()) != NULL) {
+        mMappings.Remove(mapping);
         mapping->Unmap(mPageTable);
         delete mapping;
     }
 }
 
+MappingTree & AddressSpace::GetTree (VmAddr_t aAddress)
+{
+    if (aAddress < mMappingsCeiling) {
+        return mMappings;
+    }
+    else if (aAddress < mStacksCeiling) {
+        return mStacks;
+    }
+    else {
+        return mHeap;
+    }
+}
+
+Mapping * AddressSpace::FindMapping (VmAddr_t aAddress)
+{
+    return GetTree(aAddress).Find(aAddress);
+}
+
 RefPtr<TranslationTable> AddressSpace::GetPageTable ()
 {
     return mPageTable;
 }
 
+void AddressSpace::SetPageLimit (size_t aPages)
+{
+    mPageLimit = aPages;
+}
+
+size_t AddressSpace::GetPageLimit ()
+{
+    return mPageLimit;
+}
+
+size_t AddressSpace::GetCommittedPages ()
+{
+    return mMappedPages +
+           mPageTable->GetFootprintPages() +
+           Math::RoundUp(mKernelObjectBytes, PAGE_SIZE) / PAGE_SIZE;
+}
+
+bool AddressSpace::CanCommit (size_t aPages,
+                              VmAddr_t aBaseAddress,
+                              size_t aLength)
+{
+    if (mPageLimit == 0) {
+        return true;
+    }
+
+    unsigned int tables = mPageTable->CountSecondlevelTablesNeeded(aBaseAddress,
+                                                                   aLength);
+
+    return mMappedPages +
+           mPageTable->GetFootprintPages(tables) +
+           Math::RoundUp(mKernelObjectBytes, PAGE_SIZE) / PAGE_SIZE +
+           aPages <= mPageLimit;
+}
+
+bool AddressSpace::ChargeKernelObject (size_t aBytes)
+{
+    if (mPageLimit != 0 &&
+        mMappedPages +
+        mPageTable->GetFootprintPages() +
+        Math::RoundUp(mKernelObjectBytes + aBytes, PAGE_SIZE) / PAGE_SIZE > mPageLimit)
+    {
+        return false;
+    }
+
+    mKernelObjectBytes += aBytes;
+    return true;
+}
+
+void AddressSpace::UnchargeKernelObject (size_t aBytes)
+{
+    assert(mKernelObjectBytes >= aBytes);
+    mKernelObjectBytes -= aBytes;
+}
+
+AddressSpace * AddressSpace::Clone ()
+{
+    AddressSpace * clone;
+
+    try {
+        clone = new AddressSpace();
+    }
+    catch (std::bad_alloc) {
+        return NULL;
+    }
+
+    clone->mMappingsCeiling = mMappingsCeiling;
+    clone->mMappingsNextBase = mMappingsNextBase;
+    clone->mStacksCeiling = mStacksCeiling;
+    clone->mStacksNextBase = mStacksNextBase;
+    clone->mHeapCeiling = mHeapCeiling;
+    clone->mHeapNextBase = mHeapNextBase;
+    clone->mPageLimit = mPageLimit;
+
+    if (!CloneTree(mMappings, clone->mMappings, clone->mPageTable) ||
+        !CloneTree(mStacks, clone->mStacks, clone->mPageTable) ||
+        !CloneTree(mHeap, clone->mHeap, clone->mPageTable))
+    {
+        // Whatever this address space still shares copy-on-write
+        // gets made writable again on its next write fault
+        delete clone;
+        return NULL;
+    }
+
+    // Pages shared copy-on-write count against both sides, since
+    // either one may end up needing its own copy. Kernel objects
+    // aren't copied; the child is charged for its own as it gets them.
+    clone->mMappedPages = mMappedPages;
+
+    return clone;
+}
+
+bool AddressSpace::CloneTree (MappingTree & aTree,
+                              MappingTree & aCloneTree,
+                              RefPtr<TranslationTable> aClonePageTable)
+{
+    for (Mapping * mapping = aTree.First();
+         mapping != NULL;
+         mapping = aTree.Next(mapping))
+    {
+        Mapping * copy;
+
+        try {
+            copy = mapping->Duplicate(mPageTable);
+        }
+        catch (std::bad_alloc) {
+            return false;
+        }
+
+        if (!copy->Map(aClonePageTable)) {
+            delete copy;
+            return false;
+        }
+
+        if (!aCloneTree.Insert(copy)) {
+            copy->Unmap(aClonePageTable);
+            delete copy;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AddressSpace::HandleWriteFault (VmAddr_t aFaultAddress)
+{
+    MappingTree & tree = GetTree(aFaultAddress);
+    Mapping * mapping = tree.Find(aFaultAddress);
+
+    if (!mapping || !mapping->IsCopyOnWrite()) {
+        return false;
+    }
+
+    return BreakCopyOnWrite(tree, mapping,
+                            Math::RoundDown(aFaultAddress, PAGE_SIZE),
+                            PAGE_SIZE);
+}
+
+bool AddressSpace::BreakCopyOnWrite (MappingTree & aTree,
+                                     Mapping * aMapping,
+                                     VmAddr_t aBaseAddress,
+                                     size_t aLength)
+{
+    VmAddr_t end = aBaseAddress + aLength;
+
+    assert(aMapping->IsCopyOnWrite());
+
+    // Carve off whatever parts of the mapping stick out past either
+    // end of the range; they go on sharing their pages
+    try {
+        Mapping * tail;
+
+        if (aMapping->GetBaseAddress() < aBaseAddress) {
+            tail = aMapping->Split(aBaseAddress);
+            if (!tail) {
+                return false;
+            }
+            aMapping = tail;
+            if (!aTree.Insert(aMapping)) {
+                // Still mapped, but can no longer be found
+                assert(false);
+                return false;
+            }
+        }
+
+        if (aMapping->GetBaseAddress() + aMapping->GetLength() > end) {
+            tail = aMapping->Split(end);
+            if (!tail) {
+                return false;
+            }
+            if (!aTree.Insert(tail)) {
+                // Still mapped, but can no longer be found
+                assert(false);
+                return false;
+            }
+        }
+    }
+    catch (std::bad_alloc) {
+        return false;
+    }
+
+    if (!aMapping->BreakCopyOnWrite(mPageTable)) {
+        return false;
+    }
+
+    // Pages copied one fault at a time would otherwise leave a mapping
+    // per page behind. Only the heap and stacks are known to hold
+    // nothing but BackedMapping's, and they're what gets written most.
+    if (&aTree != &mMappings) {
+        BackedMapping * piece = static_cast<BackedMapping *>(aMapping);
+        BackedMapping * before = static_cast<BackedMapping *>(
+                aTree.Find(piece->GetBaseAddress() - 1));
+        BackedMapping * after;
+
+        if (before && before->Join(piece)) {
+            aTree.Remove(piece);
+            delete piece;
+            piece = before;
+        }
+
+        after = static_cast<BackedMapping *>(
+                aTree.Find(piece->GetBaseAddress() + piece->GetLength()));
+
+        if (after && piece->Join(after)) {
+            aTree.Remove(after);
+            delete after;
+        }
+    }
+
+    return true;
+}
+
+int AddressSpace::PrepareWrite (VmAddr_t aBaseAddress, size_t aLength)
+{
+    VmAddr_t cursor = aBaseAddress;
+
+    while (cursor - aBaseAddress < aLength) {
+        MappingTree & tree = GetTree(cursor);
+        Mapping * mapping = tree.Find(cursor);
+        VmAddr_t end;
+
+        // Stack pages the process hasn't touched yet would be faulted
+        // in if it wrote them itself; the kernel's write gets the same
+        if (!mapping) {
+            StackFault grown = GrowStack(cursor);
+
+            if (grown == STACK_FAULT_GROWN) {
+                continue;
+            }
+            else if (grown == STACK_FAULT_NO_MEM) {
+                return -ERROR_NO_MEM;
+            }
+
+            break;
+        }
+
+        if (mapping->GetProtection() != PROT_USER_READWRITE) {
+            return -ERROR_FAULT;
+        }
+
+        end = mapping->GetBaseAddress() + mapping->GetLength();
+
+        // Only the pages actually written need copies of their own
+        if (mapping->IsCopyOnWrite()) {
+            VmAddr_t first = Math::RoundDown(cursor, PAGE_SIZE);
+            size_t remaining = aLength - (cursor - aBaseAddress);
+
+            if (remaining < end - cursor) {
+                end = first + Math::RoundUp(cursor - first + remaining,
+                                            PAGE_SIZE);
+            }
+
+            if (!BreakCopyOnWrite(tree, mapping, first, end - first)) {
+                return -ERROR_NO_MEM;
+            }
+        }
+
+        cursor = end;
+
+        // Mapping that runs right up to the top of the address space
+        if (cursor == 0) {
+            break;
+        }
+    }
+
+    return ERROR_OK;
+}
+
 bool AddressSpace::CreateBackedMapping (VmAddr_t aVirtualAddress,
                                         size_t aLength)
 {
@@ -255,12 +1049,12 @@ bool AddressSpace::CreateBackedMapping (VmAddr_t aVirtualAddress,
 
     // Make sure the new proposed mapping won't collide with any
     // allocated address range
-    for (List<Mapping, &Mapping::mLink>::Iterator i = mMappings.Begin();
-         i; ++i)
-    {
-        if (i->Intersects(aVirtualAddress, aLength)) {
-            return false;
-        }
+    if (mMappings.FindIntersecting(aVirtualAddress, aLength)) {
+        return false;
+    }
+
+    if (!CanCommit(aLength / PAGE_SIZE, aVirtualAddress, aLength)) {
+        return false;
     }
 
     try {
@@ -277,19 +1071,26 @@ bool AddressSpace::CreateBackedMapping (VmAddr_t aVirtualAddress,
         return false;
     }
 
-    mMappings.Append(mapping);
+    if (!mMappings.Insert(mapping)) {
+        mapping->Unmap(mPageTable);
+        delete mapping;
+        return false;
+    }
 
     if (mMappingsNextBase < aVirtualAddress + aLength) {
         mMappingsNextBase = Math::RoundUp(aVirtualAddress + aLength,
                                           PAGE_SIZE);
     }
 
+    mMappedPages += mapping->GetCommittedPages();
     return true;
 }
 
 bool AddressSpace::CreatePhysicalMapping (PhysAddr_t aPhysicalAddress,
                                           size_t aLength,
-                                          VmAddr_t & aVirtualAddress)
+                                          VmAddr_t & aVirtualAddress,
+                                          Prot_t aProtection,
+                                          CacheAttr_t aCacheAttr)
 {
     assert(aPhysicalAddress % PAGE_SIZE == 0);
 
@@ -300,41 +1101,106 @@ bool AddressSpace::CreatePhysicalMapping (PhysAddr_t aPhysicalAddress,
         return false;
     }
 
+    // The mapped range isn't RAM handed to this process, but the
+    // pagetable needed to map it counts against the limit
+    if (!CanCommit(0, mMappingsNextBase, aLength)) {
+        return false;
+    }
+
     try {
         map = new PhysicalMapping(mMappingsNextBase, aPhysicalAddress,
-                                  aLength, PROT_USER_READWRITE);
+                                  aLength, aProtection, aCacheAttr);
     } catch (std::bad_alloc) {
         return false;
     }
 
-    if (map->Map(mPageTable)) {
-        aVirtualAddress = mMappingsNextBase;
-        mMappingsNextBase += aLength;
-        mMappings.Append(map);
-        return true;
+    if (!map->Map(mPageTable)) {
+        delete map;
+        return false;
     }
-    else {
+
+    if (!mMappings.Insert(map)) {
+        map->Unmap(mPageTable);
         delete map;
         return false;
     }
+
+    aVirtualAddress = mMappingsNextBase;
+    mMappingsNextBase += aLength;
+    return true;
+}
+
+bool AddressSpace::CreateSharedMapping (RefPtr<VmArea> aArea,
+                                        VmAddr_t & aVirtualAddress)
+{
+    BackedMapping * map;
+    size_t length = aArea->GetPageCount() * PAGE_SIZE;
+
+    if (mMappingsNextBase + length > mMappingsCeiling) {
+        // Not enough address range left to satisfy this
+        return false;
+    }
+
+    if (!CanCommit(aArea->GetPageCount(), mMappingsNextBase, length)) {
+        return false;
+    }
+
+    try {
+        map = new BackedMapping(mMappingsNextBase, PROT_USER_READWRITE, aArea);
+    } catch (std::bad_alloc) {
+        return false;
+    }
+
+    if (!map->Map(mPageTable)) {
+        delete map;
+        return false;
+    }
+
+    if (!mMappings.Insert(map)) {
+        map->Unmap(mPageTable);
+        delete map;
+        return false;
+    }
+
+    aVirtualAddress = mMappingsNextBase;
+    mMappingsNextBase += length;
+    mMappedPages += map->GetCommittedPages();
+    return true;
 }
 
 bool AddressSpace::CreateStack (size_t aLength,
+                                size_t aMaxLength,
                                 VmAddr_t & aBaseAddress,
                                 size_t & aAdjustedLength)
 {
     RefPtr<VmArea> area;
-    BackedMapping * map;
+    StackMapping * map;
+
+    // Too big to reserve, and too big to round up safely
+    if (MAX(aLength, aMaxLength) > mStacksCeiling - mStacksNextBase) {
+        return false;
+    }
 
     size_t actual_len = Math::RoundUp(aLength, PAGE_SIZE);
+    size_t max_len = Math::RoundUp(MAX(aLength, aMaxLength), PAGE_SIZE);
+
+    // Guard page sits at the very bottom of the reservation
+    size_t reserved_len = max_len + PAGE_SIZE;
+    VmAddr_t floor = mStacksNextBase + PAGE_SIZE;
+    VmAddr_t ceiling = mStacksNextBase + reserved_len;
+
+    if (reserved_len > mStacksCeiling - mStacksNextBase) {
+        return false;
+    }
 
-    if (mStacksNextBase + actual_len > mStacksCeiling) {
+    if (!CanCommit(actual_len / PAGE_SIZE, ceiling - actual_len, actual_len)) {
         return false;
     }
 
     try {
         area.Reset(new VmArea(actual_len));
-        map = new BackedMapping(mStacksNextBase, PROT_USER_READWRITE, area);
+        map = new StackMapping(ceiling - actual_len, PROT_USER_READWRITE,
+                               area, floor);
     }
     catch (std::bad_alloc) {
         return false;
@@ -345,12 +1211,94 @@ bool AddressSpace::CreateStack (size_t aLength,
         return false;
     }
 
-    aBaseAddress = mStacksNextBase;
+    if (!mStacks.Insert(map)) {
+        map->Unmap(mPageTable);
+        delete map;
+        return false;
+    }
+
+    aBaseAddress = ceiling - actual_len;
     aAdjustedLength = actual_len;
-    mStacksNextBase += actual_len;
+    mStacksNextBase = ceiling;
+    mMappedPages += map->GetCommittedPages();
     return true;
 }
 
+AddressSpace::StackFault AddressSpace::GrowStack (VmAddr_t aFaultAddress)
+{
+    // Take at least this much at a time, so that a function with a
+    // large frame doesn't fault once per page
+    enum { STACK_GROWTH_MIN = PAGE_SIZE * 4 };
+
+    RefPtr<VmArea> area;
+    StackMapping * lowest;
+    StackMapping * map;
+    VmAddr_t floor;
+    VmAddr_t base;
+
+    if (aFaultAddress < mMappingsCeiling || aFaultAddress >= mStacksCeiling) {
+        return STACK_FAULT_NONE;
+    }
+
+    if (mStacks.Find(aFaultAddress)) {
+        // Already populated; the fault is about something else
+        return STACK_FAULT_NONE;
+    }
+
+    // Reservations are laid out back to back and always have their top
+    // piece populated, so the next piece up is the lowest one of the
+    // stack whose reservation covers the address.
+    lowest = static_cast<StackMapping *>(mStacks.FindAbove(aFaultAddress));
+
+    if (!lowest) {
+        return STACK_FAULT_NONE;
+    }
+
+    floor = lowest->GetFloor();
+
+    if (aFaultAddress < floor - PAGE_SIZE) {
+        return STACK_FAULT_NONE;
+    }
+    else if (aFaultAddress < floor) {
+        return STACK_FAULT_OVERFLOW;
+    }
+
+    base = Math::RoundDown(aFaultAddress, PAGE_SIZE);
+
+    if (lowest->GetBaseAddress() - base < STACK_GROWTH_MIN) {
+        base = MAX(floor, VmAddr_t(lowest->GetBaseAddress() - STACK_GROWTH_MIN));
+    }
+
+    if (!CanCommit((lowest->GetBaseAddress() - base) / PAGE_SIZE,
+                   base,
+                   lowest->GetBaseAddress() - base))
+    {
+        return STACK_FAULT_NO_MEM;
+    }
+
+    try {
+        area.Reset(new VmArea(lowest->GetBaseAddress() - base));
+        map = new StackMapping(base, PROT_USER_READWRITE, area, floor);
+    }
+    catch (std::bad_alloc) {
+        return STACK_FAULT_NO_MEM;
+    }
+
+    if (!map->Map(mPageTable)) {
+        delete map;
+        return STACK_FAULT_NO_MEM;
+    }
+
+    if (!mStacks.Insert(map)) {
+        map->Unmap(mPageTable);
+        delete map;
+        return STACK_FAULT_NO_MEM;
+    }
+
+    mMappedPages += map->GetCommittedPages();
+    return STACK_FAULT_GROWN;
+}
+
 bool AddressSpace::ExtendHeap (size_t aAdditionalLength,
                                VmAddr_t & aOldEnd,
                                VmAddr_t & aNewEnd)
@@ -366,25 +1314,143 @@ bool AddressSpace::ExtendHeap (size_t aAdditionalLength,
         return false;
     }
 
+    if (!CanCommit(aAdditionalLength / PAGE_SIZE,
+                   mHeapNextBase,
+                   aAdditionalLength))
+    {
+        return false;
+    }
+
     RefPtr<VmArea> area;
     BackedMapping * map;
 
     try {
         area.Reset(new VmArea(aAdditionalLength));
-        map = new BackedMapping(mHeapNextBase, PROT_USER_READWRITE, area);
     }
     catch (std::bad_alloc) {
         return false;
     }
 
-    if (!map->Map(mPageTable)) {
-        delete map;
-        return false;
+    // Grow the topmost heap chunk in place when it ends right at the
+    // current break, rather than adding one more chunk per call. The
+    // heap only ever holds BackedMapping's.
+    map = mHeapNextBase > mStacksCeiling
+            ? static_cast<BackedMapping *>(mHeap.Find(mHeapNextBase - 1))
+            : NULL;
+
+    if (!map || !map->Extend(mPageTable, area))
+    {
+        try {
+            map = new BackedMapping(mHeapNextBase, PROT_USER_READWRITE, area);
+        }
+        catch (std::bad_alloc) {
+            return false;
+        }
+
+        if (!map->Map(mPageTable)) {
+            delete map;
+            return false;
+        }
+
+        if (!mHeap.Insert(map)) {
+            map->Unmap(mPageTable);
+            delete map;
+            return false;
+        }
     }
 
     aOldEnd = mHeapNextBase;
     aNewEnd = mHeapNextBase + aAdditionalLength;
     mHeapNextBase = aNewEnd;
-    mMappings.Append(map);
+    mMappedPages += aAdditionalLength / PAGE_SIZE;
+    return true;
+}
+
+bool AddressSpace::ShrinkHeap (size_t aLength,
+                               VmAddr_t & aOldEnd,
+                               VmAddr_t & aNewEnd)
+{
+    assert(aLength % PAGE_SIZE == 0);
+
+    // The heap starts right where the stacks region ends
+    if (aLength > mHeapNextBase - mStacksCeiling) {
+        return false;
+    }
+
+    if (!UnmapFromTree(mHeap, mHeapNextBase - aLength, aLength)) {
+        return false;
+    }
+
+    aOldEnd = mHeapNextBase;
+    aNewEnd = mHeapNextBase - aLength;
+    mHeapNextBase = aNewEnd;
+    return true;
+}
+
+bool AddressSpace::Unmap (VmAddr_t aBaseAddress, size_t aLength)
+{
+    if (aBaseAddress % PAGE_SIZE != 0 || aLength % PAGE_SIZE != 0) {
+        return false;
+    }
+
+    if (aBaseAddress + aLength < aBaseAddress) {
+        // Wraps around the end of the address space
+        return false;
+    }
+
+    return UnmapFromTree(mMappings, aBaseAddress, aLength) &&
+           UnmapFromTree(mHeap, aBaseAddress, aLength);
+}
+
+bool AddressSpace::UnmapFromTree (MappingTree & aTree,
+                                  VmAddr_t aBaseAddress,
+                                  size_t aLength)
+{
+    VmAddr_t end = aBaseAddress + aLength;
+    Mapping * victim;
+
+    while ((victim = aTree.FindIntersecting(aBaseAddress, aLength)) != NULL)
+    {
+        // Carve off and keep whatever parts of the mapping stick out
+        // past either end of the range, so that only the portion
+        // to be released is left in 'victim'
+        try {
+            Mapping * tail;
+
+            if (victim->GetBaseAddress() < aBaseAddress) {
+                tail = victim->Split(aBaseAddress);
+                if (!tail) {
+                    return false;
+                }
+                victim = tail;
+                if (!aTree.Insert(victim)) {
+                    // Still mapped, but can no longer be found
+                    assert(false);
+                    return false;
+                }
+            }
+
+            if (victim->GetBaseAddress() + victim->GetLength() > end) {
+                tail = victim->Split(end);
+                if (!tail) {
+                    return false;
+                }
+                if (!aTree.Insert(tail)) {
+                    // Still mapped, but can no longer be found
+                    assert(false);
+                    return false;
+                }
+            }
+        }
+        catch (std::bad_alloc) {
+            return false;
+        }
+
+        aTree.Remove(victim);
+        victim->Unmap(mPageTable);
+        mMappedPages -= victim->GetCommittedPages();
+        delete victim;
+    }
+
     return true;
 }
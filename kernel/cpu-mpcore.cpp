@@ -0,0 +1,66 @@
+#include <stdint.h>
+
+#include <muos/decls.h>
+
+#include <kernel/assert.h>
+#include <kernel/board.h>
+#include <kernel/cpu.hpp>
+#include <kernel/interrupt-handler.hpp>
+#include <kernel/mmu.hpp>
+
+BEGIN_DECLS
+
+/* Physical entrypoint of the secondary CPUs, in early-entry.S */
+extern char _start_secondary;
+
+END_DECLS
+
+/*
+The boot code that QEMU (like the board's boot monitor) leaves the
+secondary CPUs running waits for an interrupt, then jumps to whatever
+address the system flags register holds, or waits again if it's zero.
+*/
+unsigned int Cpu::StartBoardCpus ()
+{
+    enum
+    {
+        SCU_PHYS        = BOARD_MPCORE_PRIV_PHYS,
+        SCU_VIRT        = 0xfff20000,
+        SYSREGS_VIRT    = 0xfff21000,
+
+        SCU_CONFIG      = 0x04,
+        SYS_FLAGSSET    = 0x30,
+    };
+
+    bool mapped = TranslationTable::GetKernel()->MapPage(
+            SCU_VIRT,
+            SCU_PHYS,
+            PROT_KERNEL
+            );
+    assert(mapped);
+
+    mapped = TranslationTable::GetKernel()->MapPage(
+            SYSREGS_VIRT,
+            BOARD_SYSREGS_PHYS,
+            PROT_KERNEL
+            );
+    assert(mapped);
+
+    volatile uint32_t * scu_config = (uint32_t *)(SCU_VIRT + SCU_CONFIG);
+    volatile uint32_t * flags_set = (uint32_t *)(SYSREGS_VIRT + SYS_FLAGSSET);
+
+    // The snoop control unit knows how many CPUs are really fitted
+    unsigned int count = (*scu_config & 0x3) + 1;
+
+    if (count > Cpu::MAX) {
+        count = Cpu::MAX;
+    }
+
+    *flags_set = (uint32_t)&_start_secondary;
+
+    for (unsigned int cpu = 1; cpu < count; cpu++) {
+        InterruptSendIpi(cpu);
+    }
+
+    return count;
+}
@@ -0,0 +1,147 @@
+#include <stdint.h>
+
+#include <muos/atomic.h>
+#include <muos/interrupts.h>
+
+#include <kernel/assert.h>
+#include <kernel/cpu.hpp>
+#include <kernel/interrupt-handler.hpp>
+#include <kernel/mmu-defs.h>
+#include <kernel/thread.hpp>
+
+/* Bit N is set once CPU N is scheduling. CPU 0 always is. */
+static volatile uint32_t online = 1;
+
+/* Cpu::Ipi bits asked of each CPU and not yet acted on */
+static volatile uint32_t pending[Cpu::MAX];
+
+/*
+TLB flushes asked of each CPU so far, and how many of those it had
+been asked for when it last flushed. Counting them, rather than using a
+bit in 'pending', lets the asker tell a flush started after its request
+from one already underway when the request was made.
+*/
+static volatile uint32_t flushes_asked[Cpu::MAX];
+static volatile uint32_t flushes_done[Cpu::MAX];
+
+static void atomic_or (volatile uint32_t * word, uint32_t bits)
+{
+    uint32_t old;
+
+    do {
+        old = *word;
+    } while (!AtomicCompareAndExchange((uint32_t *)word, old, old | bits));
+}
+
+static uint32_t atomic_take (volatile uint32_t * word)
+{
+    uint32_t old;
+
+    do {
+        old = *word;
+    } while (!AtomicCompareAndExchange((uint32_t *)word, old, 0));
+
+    return old;
+}
+
+uint32_t Cpu::GetOnlineMask ()
+{
+    return online;
+}
+
+bool Cpu::IsOnline (unsigned int cpu)
+{
+    return cpu < Cpu::MAX && (online & (1u << cpu)) != 0;
+}
+
+void Cpu::SetOnline ()
+{
+    atomic_or(&online, 1u << GetId());
+}
+
+void CpuPollIpis ()
+{
+    IrqSave_t irq_state = InterruptsDisable();
+    unsigned int self = Cpu::GetId();
+    uint32_t asked = flushes_asked[self];
+
+    if (asked != flushes_done[self]) {
+        MmuFlushTlb();
+        flushes_done[self] = asked;
+    }
+
+    InterruptsRestore(irq_state);
+}
+
+static void handle_ipi ()
+{
+    uint32_t work = atomic_take(&pending[Cpu::GetId()]);
+
+    if (work & Cpu::IPI_FLUSH_TLB) {
+        CpuPollIpis();
+    }
+
+    if (work & Cpu::IPI_RESCHEDULE) {
+        Thread::SetNeedResched();
+    }
+}
+
+void Cpu::StartSecondaries ()
+{
+    if (MAX == 1) {
+        return;
+    }
+
+    InterruptAttachKernelHandler(InterruptGetIpiNum(), handle_ipi);
+
+    unsigned int count = StartBoardCpus();
+    uint32_t all = (1u << count) - 1;
+
+    while ((online & all) != all) {
+    }
+}
+
+void Cpu::SendIpi (unsigned int cpu, Cpu::Ipi ipi)
+{
+    assert(cpu != GetId() && IsOnline(cpu));
+
+    atomic_or(&pending[cpu], ipi);
+    InterruptSendIpi(cpu);
+}
+
+void Cpu::FlushTlb (uint32_t cpus)
+{
+    unsigned int self = GetId();
+    uint32_t tickets[Cpu::MAX];
+
+    cpus &= GetOnlineMask();
+
+    if (cpus & (1u << self)) {
+        MmuFlushTlb();
+        cpus &= ~(1u << self);
+    }
+
+    for (unsigned int cpu = 0; cpu < Cpu::MAX; cpu++) {
+        if (cpus & (1u << cpu)) {
+            tickets[cpu] = AtomicAddAndFetch((int *)&flushes_asked[cpu], 1);
+            SendIpi(cpu, IPI_FLUSH_TLB);
+        }
+    }
+
+    for (unsigned int cpu = 0; cpu < Cpu::MAX; cpu++) {
+        if (cpus & (1u << cpu)) {
+            // Whoever is waiting on this CPU meanwhile mustn't be left
+            // waiting in turn
+            while ((int32_t)(flushes_done[cpu] - tickets[cpu]) < 0) {
+                CpuPollIpis();
+            }
+        }
+    }
+}
+
+#if BOARD_MAX_CPUS == 1
+unsigned int Cpu::StartBoardCpus ()
+{
+    return 1;
+}
+#endif
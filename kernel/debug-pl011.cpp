@@ -6,11 +6,11 @@
 #include <muos/bits.h>
 #include <muos/compiler.h>
 
+#include <kernel/board.h>
 #include <kernel/debug.hpp>
 #include <kernel/mmu.hpp>
 
-#define VERSATILE_UART0_BASE    0x101F1000
-#define VERSATILE_UART0_IRQ     12
+#define UART0_BASE              BOARD_UART0_PHYS
 #define PL011_MMAP_SIZE         4096
 #define KERNEL_UART0_ADDRESS    0xfffe0000
 
@@ -193,7 +193,7 @@ static char backlog[4096] = { '\0' };
 void Pl011DebugDriver::DoInit ()
 {
     assert (PL011_MMAP_SIZE <= PAGE_SIZE);
-    bool mapped = TranslationTable::GetKernel()->MapPage(KERNEL_UART0_ADDRESS, VERSATILE_UART0_BASE, PROT_KERNEL);
+    bool mapped = TranslationTable::GetKernel()->MapPage(KERNEL_UART0_ADDRESS, UART0_BASE, PROT_KERNEL);
     assert(mapped);
 
     mUart0 = (pl011_t volatile *)KERNEL_UART0_ADDRESS;
@@ -103,6 +103,7 @@ static void _enable_mmu()
 
 BEGIN_DECLS
 void early_setup_dual_memory_map (void);
+void early_enable_secondary_memory_map (void);
 END_DECLS
 
 void early_setup_dual_memory_map (void)
@@ -169,3 +170,14 @@ void early_setup_dual_memory_map (void)
     _install_pagetable();
     _enable_mmu();
 }
+
+/*
+ * Install the table built by early_setup_dual_memory_map() on one of
+ * the other CPUs of a multicore board, which start up after CPU 0 is
+ * already running the kernel
+ */
+void early_enable_secondary_memory_map (void)
+{
+    _install_pagetable();
+    _enable_mmu();
+}
@@ -6,6 +6,20 @@
 #include <kernel/message.hpp>
 #include <kernel/process.hpp>
 #include <kernel/thread.hpp>
+#include <kernel/vfp.hpp>
+
+/*
+ * Fault status encodings of the DFSR. The fifth status bit
+ * lives apart from the other four, at bit 10.
+ */
+enum
+{
+    FSR_STATUS_MASK             = 0x40f,
+    FSR_TRANSLATION_SECTION     = 0x005,
+    FSR_TRANSLATION_PAGE        = 0x007,
+    FSR_PERMISSION_SECTION      = 0x00d,
+    FSR_PERMISSION_PAGE         = 0x00f,
+};
 
 void ScheduleSelfAbort ()
 {
@@ -25,6 +39,7 @@ void ScheduleSelfAbort ()
 
     /* Deallocate current process */
     Process * process = THREAD_CURRENT()->process;
+    process->SetTerminationReason(Process::TERMINATION_FAULT);
     RefPtr<Connection> con = process->LookupConnection(PROCMGR_CONNECTION_ID);
     con->SendMessageAsync(PULSE_TYPE_CHILD_FINISH, process->GetId());
 
@@ -35,3 +50,70 @@ void ScheduleSelfAbort ()
 
     assert(false);
 }
+
+void HandleUserDataAbort (VmAddr_t fault_address, uint32_t fault_status)
+{
+    Process * process = THREAD_CURRENT()->process;
+    uint32_t status = fault_status & FSR_STATUS_MASK;
+
+    assert(process != NULL);
+
+    /*
+    Pages shared copy-on-write stay readable, so a permission fault
+    on one of them is a write that needs a private copy made.
+    */
+    if (status == FSR_PERMISSION_SECTION || status == FSR_PERMISSION_PAGE) {
+        if (process->GetAddressSpace()->HandleWriteFault(fault_address)) {
+            /* Retry the faulting instruction */
+            return;
+        }
+    }
+
+    /* Only a missing translation can be a stack that needs to grow */
+    if (status == FSR_TRANSLATION_SECTION || status == FSR_TRANSLATION_PAGE) {
+        switch (process->GetAddressSpace()->GrowStack(fault_address)) {
+
+            case AddressSpace::STACK_FAULT_GROWN:
+                /* Retry the faulting instruction */
+                return;
+
+            case AddressSpace::STACK_FAULT_OVERFLOW:
+                process->SetTerminationReason(Process::TERMINATION_STACK_OVERFLOW);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    ScheduleSelfAbort();
+}
+
+void HandleKernelUndefined (VmAddr_t pc, uint32_t psr)
+{
+    /* Left in the arguments for the debugger to find */
+    (void)pc;
+    (void)psr;
+
+    assert(false);
+
+    for (;;) {
+    }
+}
+
+void HandleUserUndefined ()
+{
+    Thread * thread = THREAD_CURRENT();
+
+    assert(thread->process != NULL);
+
+    /* There are no VFP instructions in Thumb state */
+    if (!(thread->u_reg[REGISTER_INDEX_PSR] & ARM_PSR_T_VALUE)) {
+        if (Vfp::HandleTrap(thread)) {
+            /* Retry the trapping instruction */
+            return;
+        }
+    }
+
+    ScheduleSelfAbort();
+}
@@ -0,0 +1,124 @@
+#include <stdint.h>
+
+#include <muos/error.h>
+#include <muos/spinlock.h>
+
+#include <kernel/address-space.hpp>
+#include <kernel/futex.hpp>
+#include <kernel/mmu.hpp>
+#include <kernel/process.hpp>
+#include <kernel/thread.hpp>
+#include <kernel/vm-defs.h>
+
+Futex::Bucket Futex::sBuckets[Futex::NUM_BUCKETS];
+
+int Futex::GetKey (VmAddr_t aAddress, PhysAddr_t & aKey)
+{
+    if (aAddress % sizeof(uint32_t) != 0) {
+        return -ERROR_INVALID;
+    }
+
+    // A page still shared copy-on-write would give the same key to
+    // words that are only going to be separate
+    int prepared = THREAD_CURRENT()->process->GetAddressSpace()->PrepareWrite(
+            aAddress,
+            sizeof(uint32_t)
+            );
+
+    if (prepared < 0) {
+        return prepared;
+    }
+
+    if (!TranslationTable::GetUser()->TranslateWrite(aAddress, aKey)) {
+        return -ERROR_FAULT;
+    }
+
+    return ERROR_OK;
+}
+
+Futex::Bucket & Futex::GetBucket (PhysAddr_t aKey)
+{
+    // Words are aligned, and neighbouring ones are as likely to be
+    // in use together as not
+    return sBuckets[(aKey / sizeof(uint32_t)) % NUM_BUCKETS];
+}
+
+int Futex::Wait (VmAddr_t aAddress, uint32_t aExpected)
+{
+    PhysAddr_t key;
+    int ret = GetKey(aAddress, key);
+
+    if (ret < 0) {
+        return ret;
+    }
+
+    Bucket & bucket = GetBucket(key);
+    Waiter waiter(key);
+
+    // The key is where the word lives, already translated and made
+    // writable, so it's read through the kernel's own mapping of RAM
+    // with one aligned load; no page tables are walked with the bucket
+    // locked. Should the page be unmapped meanwhile, the load still
+    // hits RAM, and nothing can wake a key that's gone anyway.
+    volatile uint32_t * word = (volatile uint32_t *)P2V(key);
+
+    SpinlockLock(&bucket.mLock);
+
+    if (*word != aExpected) {
+        ret = -ERROR_AGAIN;
+    }
+    else {
+        bucket.mWaiters.Append(&waiter);
+    }
+
+    SpinlockUnlock(&bucket.mLock);
+
+    if (ret < 0) {
+        return ret;
+    }
+
+    // A Wake() between the unlock and here leaves the count at one,
+    // so this returns straight away
+    waiter.mWakeup.Down(Thread::STATE_FUTEX);
+
+    return ERROR_OK;
+}
+
+int Futex::Wake (VmAddr_t aAddress, unsigned int aCount)
+{
+    PhysAddr_t key;
+    int ret = GetKey(aAddress, key);
+
+    if (ret < 0) {
+        return ret;
+    }
+
+    Bucket & bucket = GetBucket(key);
+    List<Waiter, &Waiter::mLink> woken;
+    unsigned int num_woken = 0;
+
+    SpinlockLock(&bucket.mLock);
+
+    List<Waiter, &Waiter::mLink>::Iterator cursor = bucket.mWaiters.Begin();
+
+    while (cursor && num_woken < aCount) {
+        Waiter * waiter = *cursor;
+        ++cursor;
+
+        if (waiter->mKey == key) {
+            bucket.mWaiters.Remove(waiter);
+            woken.Append(waiter);
+            ++num_woken;
+        }
+    }
+
+    SpinlockUnlock(&bucket.mLock);
+
+    // Semaphore::Up() may switch threads, which mustn't happen with
+    // the bucket locked
+    while (!woken.Empty()) {
+        woken.PopFirst()->mWakeup.Up();
+    }
+
+    return num_woken;
+}
@@ -6,12 +6,14 @@
 #include <muos/interrupts.h>
 
 #include <kernel/assert.h>
+#include <kernel/cpu.hpp>
 #include <kernel/interrupt-handler.hpp>
 #include <kernel/mmu.hpp>
 #include <kernel/object-cache.hpp>
 #include <kernel/once.h>
 #include <kernel/process.hpp>
 #include <kernel/thread.hpp>
+#include <kernel/vfp.hpp>
 #include <kernel/vm.hpp>
 
 #include "init.h"
@@ -28,6 +30,15 @@ uint8_t * init_stack_ceiling = &init_stack[
     N_ELEMENTS(init_stack) - ALIGNED_THREAD_STRUCT_SIZE
     ];
 
+/*
+Kernel stacks of the other CPUs' idle threads, which they also start
+up on. Slot 0 is unused, since CPU 0 starts on init_stack.
+*/
+static uint8_t secondary_stacks[Cpu::MAX][PAGE_SIZE]
+    __attribute__ ((aligned (PAGE_SIZE)));
+
+uint8_t * secondary_stack_ceilings[Cpu::MAX];
+
 struct ObjectCache an_object_cache;
 enum { AN_OBJECT_CACHE_ELEMENT_SIZE = PAGE_SIZE / 2 };
 
@@ -146,14 +157,55 @@ void install_kernel_memory_map ()
 /* Retroactively filled in */
 static Thread *first_thread = (Thread *)&init_stack[N_ELEMENTS(init_stack) - ALIGNED_THREAD_STRUCT_SIZE];
 
+/**
+ * Stop the core until an interrupt is raised. It wakes even if the
+ * interrupt is masked, in which case it's taken once it's unmasked.
+ */
+static inline void wait_for_interrupt ()
+{
+    asm volatile(
+        "mcr p15, 0, %[zero], c7, c0, 4"
+        :
+        : [zero] "r" (0)
+        : "memory"
+    );
+}
+
 __attribute__((noreturn))
 void run_idle_loop ()
 {
+    /* Only gets the CPU when nothing else wants it */
+    Thread::BeginTransaction();
+    THREAD_CURRENT()->SetAssignedPriority(Thread::PRIORITY_IDLE);
+    Thread::EndTransaction();
+
     while (true) {
         Thread::BeginTransaction();
-        Thread::MakeReady(THREAD_CURRENT());
-        Thread::RunNextThread();
+
+        if (Thread::AnyReady()) {
+            Thread::MakeReady(THREAD_CURRENT());
+            Thread::RunNextThread();
+            Thread::EndTransaction();
+            continue;
+        }
+
+        /*
+        The scheduler lock mustn't be held while asleep: another CPU
+        spinning on it with interrupts masked could be the very one the
+        board's interrupts go to, and nothing would ever wake us.
+
+        Anything made ready from here on is either by an interrupt on
+        this CPU, or by another CPU that then sends an IPI to this idle
+        one. With interrupts masked before sleeping, one raised after
+        this point still wakes the core, and is taken once they're
+        unmasked. Whatever it makes ready is switched to on the way out
+        of its handler.
+        */
         Thread::EndTransaction();
+
+        IrqSave_t irq_state = InterruptsDisable();
+        wait_for_interrupt();
+        InterruptsRestore(irq_state);
     }
 }
 
@@ -171,10 +223,50 @@ void run_first_thread ()
 
     /* Device-independent */
     InterruptsConfigure();
+    Vfp::Init();
     InterruptsEnable();
+    InterruptsStartWorkers();
+
+    for (unsigned int cpu = 1; cpu < Cpu::MAX; cpu++) {
+        secondary_stack_ceilings[cpu] = &secondary_stacks[cpu][
+            PAGE_SIZE - ALIGNED_THREAD_STRUCT_SIZE
+            ];
+    }
+
+    Cpu::StartSecondaries();
 
     Process::StartManager();
     Process::Create("init", NULL);
 
     run_idle_loop();
 }
+
+void InitSecondary ()
+{
+    unsigned int cpu = Cpu::GetId();
+
+    /*
+    Same translation setup as CPU 0's in install_kernel_memory_map(),
+    with the tables it built. Nothing from the crude early table may
+    linger in the TLB.
+    */
+    TranslationTable::SetKernel(TranslationTable::GetKernel());
+    MmuSetEnabled();
+    TranslationTable::SetUser(NULL);
+    MmuFlushTlb();
+
+    /* This thread goes on to be the CPU's idle thread */
+    Thread::DecorateStatic(
+            (Thread *)secondary_stack_ceilings[cpu],
+            (VmAddr_t)&secondary_stacks[cpu][0],
+            (VmAddr_t)secondary_stack_ceilings[cpu]
+            );
+
+    InterruptsConfigureSecondary();
+    Vfp::Init();
+
+    Cpu::SetOnline();
+    InterruptsEnable();
+
+    run_idle_loop();
+}
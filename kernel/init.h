@@ -10,9 +10,14 @@ BEGIN_DECLS
 extern uint8_t init_stack[];
 extern uint8_t * init_stack_ceiling;
 
+extern uint8_t * secondary_stack_ceilings[];
+
 extern void Init (void)
     __attribute__ ((noreturn));
 
+extern void InitSecondary (void)
+    __attribute__ ((noreturn));
+
 END_DECLS
 
 #endif /* __INIT_H__ */
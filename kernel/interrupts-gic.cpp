@@ -0,0 +1,198 @@
+#include <stdint.h>
+
+#include <kernel/assert.h>
+#include <kernel/board.h>
+#include <kernel/cpu.hpp>
+#include <kernel/interrupts.hpp>
+#include <kernel/mmu.hpp>
+
+/**
+ * \brief   Device-specific driver for the interrupt controller built
+ *          into the ARM11 MPCore
+ *
+ * One distributor is shared by all the CPUs, and each CPU has its own
+ * interface to it at the same address. Board interrupts are all routed
+ * to CPU 0. Software-generated interrupt 0 is used to interrupt other
+ * CPUs.
+ */
+class Gic : public InterruptController
+{
+public:
+    Gic();
+
+    virtual void Init ();
+    virtual void InitCpu ();
+    virtual void MaskIrq (int n);
+    virtual void UnmaskIrq (int n);
+    virtual unsigned int GetNumSupportedIrqs ();
+    virtual int GetRaisedIrqNum ();
+    virtual void EndOfInterrupt (int n);
+    virtual int GetIpiNum ();
+    virtual void SendIpi (unsigned int cpu);
+
+private:
+    enum
+    {
+        IPI_IRQ             = 0,
+        FIRST_SHARED_IRQ    = 32,
+        MAX_IRQS            = 96,
+
+        IAR_ID_MASK         = 0x3ff,
+
+        /* Middling, so that anything at all is let through the mask */
+        IRQ_PRIORITY        = 0xa0,
+        PRIORITY_MASK_ALL   = 0xf0,
+    };
+
+    /* CPU interface */
+    volatile uint32_t * CpuControl;
+    volatile uint32_t * CpuPriorityMask;
+    volatile uint32_t * CpuAcknowledge;
+    volatile uint32_t * CpuEndOfInterrupt;
+
+    /* Distributor */
+    volatile uint32_t * DistControl;
+    volatile uint32_t * DistType;
+    volatile uint32_t * DistSetEnable;
+    volatile uint32_t * DistClearEnable;
+    volatile uint32_t * DistPriority;
+    volatile uint32_t * DistTarget;
+    volatile uint32_t * DistSoftwareInterrupt;
+
+    unsigned int mNumIrqs;
+
+    /*
+    What each CPU last read from its acknowledge register, which has to
+    be written back whole to end the interrupt
+    */
+    uint32_t mActive[Cpu::MAX];
+};
+
+Gic::Gic ()
+{
+    // Hook into modular core
+    Interrupts::RegisterController(this);
+}
+
+void Gic::Init ()
+{
+    enum
+    {
+        GIC_CPU_PHYS    = BOARD_MPCORE_PRIV_PHYS + 0x0000,
+        GIC_DIST_PHYS   = BOARD_MPCORE_PRIV_PHYS + 0x1000,
+        GIC_CPU_VIRT    = 0xfff10000,
+        GIC_DIST_VIRT   = 0xfff11000,
+    };
+
+    bool mapped = TranslationTable::GetKernel()->MapPage(
+            GIC_CPU_VIRT,
+            GIC_CPU_PHYS,
+            PROT_KERNEL
+            );
+    assert(mapped);
+
+    mapped = TranslationTable::GetKernel()->MapPage(
+            GIC_DIST_VIRT,
+            GIC_DIST_PHYS,
+            PROT_KERNEL
+            );
+    assert(mapped);
+
+    // The CPU interface is at offset 0x100 of the first page
+    uint8_t * cpu = (uint8_t *)GIC_CPU_VIRT + 0x100;
+    uint8_t * dist = (uint8_t *)GIC_DIST_VIRT;
+
+    this->CpuControl            = (uint32_t *)(cpu + 0x000);
+    this->CpuPriorityMask       = (uint32_t *)(cpu + 0x004);
+    this->CpuAcknowledge        = (uint32_t *)(cpu + 0x00c);
+    this->CpuEndOfInterrupt     = (uint32_t *)(cpu + 0x010);
+
+    this->DistControl           = (uint32_t *)(dist + 0x000);
+    this->DistType              = (uint32_t *)(dist + 0x004);
+    this->DistSetEnable         = (uint32_t *)(dist + 0x100);
+    this->DistClearEnable       = (uint32_t *)(dist + 0x180);
+    this->DistPriority          = (uint32_t *)(dist + 0x400);
+    this->DistTarget            = (uint32_t *)(dist + 0x800);
+    this->DistSoftwareInterrupt = (uint32_t *)(dist + 0xf00);
+
+    *this->DistControl = 0;
+
+    mNumIrqs = ((*this->DistType & 0x1f) + 1) * 32;
+
+    if (mNumIrqs > MAX_IRQS) {
+        mNumIrqs = MAX_IRQS;
+    }
+
+    // Shared interrupts start out masked, and go to CPU 0 once unmasked.
+    // Priority and target registers hold a byte per interrupt.
+    for (unsigned int n = FIRST_SHARED_IRQ; n < mNumIrqs; n += 32) {
+        this->DistClearEnable[n / 32] = 0xffffffff;
+    }
+
+    for (unsigned int n = FIRST_SHARED_IRQ; n < mNumIrqs; n += 4) {
+        this->DistPriority[n / 4] = IRQ_PRIORITY * 0x01010101u;
+        this->DistTarget[n / 4] = 0x01010101u;
+    }
+
+    *this->DistControl = 1;
+}
+
+void Gic::InitCpu ()
+{
+    // The registers for the first 32 interrupts are each CPU's own
+    for (unsigned int n = 0; n < FIRST_SHARED_IRQ; n += 4) {
+        this->DistPriority[n / 4] = IRQ_PRIORITY * 0x01010101u;
+    }
+
+    this->DistSetEnable[0] = 1u << IPI_IRQ;
+
+    *this->CpuPriorityMask = PRIORITY_MASK_ALL;
+    *this->CpuControl = 1;
+}
+
+void Gic::MaskIrq (int n)
+{
+    this->DistClearEnable[n / 32] = 1u << (n % 32);
+}
+
+void Gic::UnmaskIrq (int n)
+{
+    this->DistSetEnable[n / 32] = 1u << (n % 32);
+}
+
+unsigned int Gic::GetNumSupportedIrqs ()
+{
+    return mNumIrqs;
+}
+
+int Gic::GetRaisedIrqNum ()
+{
+    // Reading acknowledges it. A spurious interrupt reads as 1023,
+    // which the core ignores as out of range.
+    uint32_t iar = *this->CpuAcknowledge;
+
+    mActive[Cpu::GetId()] = iar;
+
+    return iar & IAR_ID_MASK;
+}
+
+void Gic::EndOfInterrupt (int n)
+{
+    uint32_t iar = mActive[Cpu::GetId()];
+
+    assert((int)(iar & IAR_ID_MASK) == n);
+    *this->CpuEndOfInterrupt = iar;
+}
+
+int Gic::GetIpiNum ()
+{
+    return IPI_IRQ;
+}
+
+void Gic::SendIpi (unsigned int cpu)
+{
+    *this->DistSoftwareInterrupt = (1u << (16 + cpu)) | IPI_IRQ;
+}
+
+// Constructor execution will register this driver instance with the core
+static Gic instance;
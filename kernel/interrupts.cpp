@@ -9,6 +9,7 @@
 #include <muos/spinlock.h>
 
 #include <kernel/assert.h>
+#include <kernel/cpu.hpp>
 #include <kernel/interrupt-handler.hpp>
 #include <kernel/interrupts.hpp>
 #include <kernel/message.hpp>
@@ -16,7 +17,9 @@
 #include <kernel/once.h>
 #include <kernel/process.hpp>
 #include <kernel/ref-list.hpp>
+#include <kernel/semaphore.hpp>
 #include <kernel/slaballocator.hpp>
+#include <kernel/thread.hpp>
 
 static InterruptController * gController = 0;
 
@@ -28,19 +31,26 @@ void Interrupts::RegisterController (InterruptController * controller)
 
 enum
 {
-    NUM_IRQS = 32,
+    /* Enough for the GIC's private interrupts and 64 board lines */
+    NUM_IRQS = 96,
 };
 
 /**
- * Stack for IRQ context to execute on.
+ * Stacks for IRQ context to execute on, one per CPU.
  */
-static uint8_t irq_stack[PAGE_SIZE]
+static uint8_t irq_stack[Cpu::MAX][PAGE_SIZE]
     __attribute__((aligned(PAGE_SIZE)));
 
 /**
- * Stack for abort-handler context to execute on.
+ * Stacks for abort-handler context to execute on, one per CPU.
  */
-static uint8_t abt_stack[PAGE_SIZE]
+static uint8_t abt_stack[Cpu::MAX][PAGE_SIZE]
+    __attribute__((aligned(PAGE_SIZE)));
+
+/**
+ * Stacks for undefined-instruction context to execute on, one per CPU.
+ */
+static uint8_t und_stack[Cpu::MAX][PAGE_SIZE]
     __attribute__((aligned(PAGE_SIZE)));
 
 /**
@@ -49,6 +59,12 @@ static uint8_t abt_stack[PAGE_SIZE]
  */
 static IrqKernelHandlerFunc kernel_irq_handlers[NUM_IRQS];
 
+/**
+ * Interrupts taken by each CPU since boot. Only ever bumped by its own
+ * CPU, with interrupts off.
+ */
+static volatile uint32_t irq_counts[Cpu::MAX];
+
 /**
  * User program's IRQ handlers
  */
@@ -65,6 +81,32 @@ static unsigned int irq_mask_counts[NUM_IRQS] = { 0 };
  */
 static Spinlock_t irq_handlers_lock = SPINLOCK_INIT;
 
+enum
+{
+    /*
+    One worker for each priority a user handler can have: a driver is
+    raised to PRIORITY_IO when it attaches, and stays below the Process
+    Manager
+    */
+    FIRST_WORKER_PRIORITY = Thread::PRIORITY_IO,
+    NUM_WORKERS = Thread::PRIORITY_SYSTEM - Thread::PRIORITY_IO,
+};
+
+/**
+ * User handlers whose interrupt has been raised, waiting for the worker
+ * at their priority to send the pulse. Each is a stack, pushed onto
+ * from IRQ context and emptied all at once by its worker, both under
+ * irq_handlers_lock. The worker holds a reference on every handler in
+ * it.
+ */
+static UserInterruptHandler * deferred_handlers[NUM_WORKERS];
+
+/**
+ * Posted when a worker's stack goes from empty to not. They start out
+ * with a count, so a worker's first wait finds nothing to do.
+ */
+static Semaphore deferred_wakeups[NUM_WORKERS];
+
 static void decrement_irq_mask (unsigned int irq_number)
 {
     if (AtomicSubAndFetch((int *)&irq_mask_counts[irq_number], 1) == 0) {
@@ -79,7 +121,7 @@ static void increment_irq_mask (unsigned int irq_number)
     }
 }
 
-static void init_handlers (void * ignored)
+static void install_mode_stacks (unsigned int cpu)
 {
     #ifdef __arm__
         /**
@@ -97,18 +139,29 @@ static void init_handlers (void * ignored)
             "cps %[abt_mode_bits]       \n\t"
             "mov sp, %[abt_sp]          \n\t"
 
+            /* Switch to UND mode and install stack pointer */
+            "cps %[und_mode_bits]       \n\t"
+            "mov sp, %[und_sp]          \n\t"
+
             /* Restore previous execution mode              */
             "msr cpsr, v1               \n\t"
             :
-            : [irq_sp] "r" (&irq_stack[0] + sizeof(irq_stack))
+            : [irq_sp] "r" (&irq_stack[cpu][0] + sizeof(irq_stack[cpu]))
             , [irq_mode_bits] "i" (ARM_PSR_MODE_IRQ_BITS)
-            , [abt_sp] "r" (&abt_stack[0] + sizeof(abt_stack))
+            , [abt_sp] "r" (&abt_stack[cpu][0] + sizeof(abt_stack[cpu]))
             , [abt_mode_bits] "i" (ARM_PSR_MODE_ABT_BITS)
+            , [und_sp] "r" (&und_stack[cpu][0] + sizeof(und_stack[cpu]))
+            , [und_mode_bits] "i" (ARM_PSR_MODE_UND_BITS)
             : "memory", "v1"
         );
     #else
         #error
     #endif
+}
+
+static void init_handlers (void * ignored)
+{
+    install_mode_stacks(Cpu::GetId());
 
     /**
      * Initialize array of in-kernel IRQ handler functions
@@ -120,6 +173,7 @@ static void init_handlers (void * ignored)
      */
     assert(gController != 0);
     gController->Init();
+    gController->InitCpu();
 }
 
 void InterruptsConfigure ()
@@ -129,6 +183,117 @@ void InterruptsConfigure ()
     Once(&control, init_handlers, NULL);
 }
 
+void InterruptsConfigureSecondary ()
+{
+    install_mode_stacks(Cpu::GetId());
+    gController->InitCpu();
+}
+
+/**
+ * Hand \a handler to its worker. Called with irq_handlers_lock held.
+ *
+ * \return  A bit for the worker's level, if it needs waking up
+ */
+static uint32_t defer_handler (UserInterruptHandler * handler)
+{
+    unsigned int level = handler->mHandlerInfo.mPriority - FIRST_WORKER_PRIORITY;
+    UserInterruptHandler * head = deferred_handlers[level];
+
+    handler->Ref();
+
+    handler->mStateInfo.mNextDeferred = head;
+    deferred_handlers[level] = handler;
+
+    /* If there were others, the worker's already been woken for them */
+    return head == NULL ? 1u << level : 0;
+}
+
+/**
+ * Take everything off a worker's stack, oldest first
+ */
+static UserInterruptHandler * take_deferred_handlers (unsigned int level)
+{
+    UserInterruptHandler * head;
+    UserInterruptHandler * oldest_first = NULL;
+
+    SpinlockLock(&irq_handlers_lock);
+
+    head = deferred_handlers[level];
+    deferred_handlers[level] = NULL;
+
+    SpinlockUnlock(&irq_handlers_lock);
+
+    while (head) {
+        UserInterruptHandler * next = head->mStateInfo.mNextDeferred;
+
+        head->mStateInfo.mNextDeferred = oldest_first;
+        oldest_first = head;
+        head = next;
+    }
+
+    return oldest_first;
+}
+
+static void send_interrupt_pulse (RefPtr<UserInterruptHandler> handler)
+{
+    RefPtr<Connection> connection;
+
+    /*
+    A handler is detached from its line under the lock before its
+    connection is dropped, so one still attached has a connection
+    that's safe to take a reference on
+    */
+    SpinlockLock(&irq_handlers_lock);
+
+    if (!handler->mLink.Unlinked()) {
+        connection = handler->mHandlerInfo.mConnection;
+    }
+
+    SpinlockUnlock(&irq_handlers_lock);
+
+    if (!connection ||
+        connection->SendMessageAsync(PULSE_TYPE_INTERRUPT,
+                                     handler->mHandlerInfo.mPulsePayload) != ERROR_OK)
+    {
+        /* Nobody will hear of it, so nobody will unmask it either */
+        InterruptCompleteUserHandler(handler);
+    }
+}
+
+static void interrupt_worker (void * pLevel)
+{
+    unsigned int level = (uintptr_t)pLevel;
+
+    Thread::BeginTransaction();
+    THREAD_CURRENT()->SetAssignedPriority(Thread::Priority(FIRST_WORKER_PRIORITY + level));
+    Thread::EndTransaction();
+
+    while (true) {
+        deferred_wakeups[level].Down();
+
+        UserInterruptHandler * handler = take_deferred_handlers(level);
+
+        while (handler) {
+            UserInterruptHandler * next = handler->mStateInfo.mNextDeferred;
+
+            // Take over the reference that defer_handler() added
+            RefPtr<UserInterruptHandler> record(handler);
+            handler->Unref();
+
+            send_interrupt_pulse(record);
+            handler = next;
+        }
+    }
+}
+
+void InterruptsStartWorkers ()
+{
+    for (unsigned int level = 0; level < NUM_WORKERS; level++) {
+        Thread * worker = Thread::Create(interrupt_worker, (void *)level);
+        assert(worker != NULL);
+    }
+}
+
 void InterruptAttachKernelHandler (unsigned int irq_number, IrqKernelHandlerFunc f)
 {
     assert(irq_number < N_ELEMENTS(kernel_irq_handlers));
@@ -148,6 +313,8 @@ void InterruptAttachUserHandler (
 {
     assert(handler->mLink.Unlinked());
     assert(handler->mHandlerInfo.mIrqNumber < NUM_IRQS && handler->mHandlerInfo.mIrqNumber >= 0);
+    assert(handler->mHandlerInfo.mPriority >= FIRST_WORKER_PRIORITY &&
+           handler->mHandlerInfo.mPriority < FIRST_WORKER_PRIORITY + NUM_WORKERS);
 
     handler->mStateInfo.mMasked = false;
 
@@ -180,6 +347,7 @@ void InterruptDetachUserHandler (
 
     /* Flush out any outstanding per-drive interrupt masks */
     if (record->mStateInfo.mMasked) {
+        record->mStateInfo.mMasked = false;
         decrement_irq_mask(n);
     }
 
@@ -202,18 +370,29 @@ int InterruptCompleteUserHandler (
     RefPtr<UserInterruptHandler> handler
     )
 {
+    int ret;
+
+    /* The interrupt may be being raised again on another CPU */
+    SpinlockLock(&irq_handlers_lock);
+
     if (!handler->mStateInfo.mMasked) {
-        return ERROR_INVALID;
+        ret = ERROR_INVALID;
     }
     else {
         handler->mStateInfo.mMasked = false;
         decrement_irq_mask(handler->mHandlerInfo.mIrqNumber);
-        return ERROR_OK;
+        ret = ERROR_OK;
     }
+
+    SpinlockUnlock(&irq_handlers_lock);
+
+    return ret;
 }
 
 void InterruptHandler ()
 {
+    irq_counts[Cpu::GetId()]++;
+
     /* Figure out which IRQ was raised. */
     int which = gController->GetRaisedIrqNum();
     assert(which >= 0);
@@ -223,6 +402,8 @@ void InterruptHandler ()
         return;
     }
 
+    uint32_t wake = 0;
+
     SpinlockLock(&irq_handlers_lock);
 
     /* Execute any kernel-installed IRQ handlers */
@@ -230,7 +411,11 @@ void InterruptHandler ()
         kernel_irq_handlers[which]();
     }
 
-    /* Execute any user-installed IRQ handlers */
+    /*
+    User-installed handlers only get the line masked here. Sending the
+    pulse is left to a worker thread, so as not to hold off every other
+    interrupt while a message is allocated and queued.
+    */
     for (user_irq_handler_list_t::Iterator cursor = user_irq_handlers[which].Begin();
          cursor;
          cursor++) {
@@ -239,14 +424,27 @@ void InterruptHandler ()
 
         assert(!record->mStateInfo.mMasked);
 
-        int result = record->mHandlerInfo.mConnection->SendMessageAsyncDuringException(PULSE_TYPE_INTERRUPT, (uintptr_t)record->mHandlerInfo.mPulsePayload);
-        if (result == ERROR_OK) {
-            record->mStateInfo.mMasked = true;
-            increment_irq_mask(record->mHandlerInfo.mIrqNumber);
-        }
+        record->mStateInfo.mMasked = true;
+        increment_irq_mask(record->mHandlerInfo.mIrqNumber);
+
+        wake |= defer_handler(*record);
     }
 
     SpinlockUnlock(&irq_handlers_lock);
+
+    for (unsigned int level = 0; level < NUM_WORKERS; level++) {
+        if (wake & (1u << level)) {
+            deferred_wakeups[level].UpDuringException();
+        }
+    }
+
+    gController->EndOfInterrupt(which);
+}
+
+uint32_t InterruptGetCount (unsigned int cpu)
+{
+    assert(cpu < Cpu::MAX);
+    return irq_counts[cpu];
 }
 
 void InterruptUnmaskIrq (int n)
@@ -259,11 +457,24 @@ void InterruptMaskIrq (int n)
     gController->MaskIrq(n);
 }
 
+int InterruptGetIpiNum ()
+{
+    return gController->GetIpiNum();
+}
+
+void InterruptSendIpi (unsigned int cpu)
+{
+    gController->SendIpi(cpu);
+}
+
 SyncSlabAllocator<UserInterruptHandler> UserInterruptHandler::sSlab;
 
 UserInterruptHandler::UserInterruptHandler ()
     : mDisposed(false)
 {
+    mHandlerInfo.mPriority = Thread::PRIORITY_IO;
+    mStateInfo.mMasked = false;
+    mStateInfo.mNextDeferred = NULL;
 }
 
 UserInterruptHandler::~UserInterruptHandler ()
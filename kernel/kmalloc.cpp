@@ -1,5 +1,6 @@
 #include <muos/arch.h>
 #include <muos/array.h>
+#include <muos/compiler.h>
 #include <muos/spinlock.h>
 
 #include <kernel/kmalloc.h>
@@ -9,12 +10,14 @@
 enum
 {
     /**
-     * kmalloc() will be able to service objects up to 2**(PAGE_SHIFT -1)
+     * kmalloc() will be able to service objects up to 2**(PAGE_SHIFT - 2)
      * bytes in size. For larger things, just use page allocations directly.
      */
     NUM_BUCKETS = PAGE_SHIFT - 1,
 };
 
+COMPILER_ASSERT((1 << (NUM_BUCKETS - 1)) == KMALLOC_MAX_SIZE);
+
 /**
  * allocators[i] serves out objects 2**i bytes long
  */
@@ -0,0 +1,221 @@
+/*
+ * Block-copy and block-fill primitives.
+ *
+ * The kernel is built without optimization, so these are written to
+ * do as little work per byte as possible regardless: the bulk of any
+ * buffer is moved 32 bytes at a time with LDM/STM, whatever is left
+ * over a word at a time, and only the unaligned head and tail a byte
+ * at a time.
+ *
+ * Nothing in here depends on the rest of the kernel, so that memtest.c
+ * can build it for the host. Off ARM, the block loops fall back to
+ * plain C.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <muos/arch.h>
+
+#include <kernel/memory.h>
+
+typedef uint32_t word_t;
+
+enum
+{
+    WORD_SIZE   = sizeof(word_t),
+    WORD_MASK   = sizeof(word_t) - 1,
+
+    /* Bytes moved by each pass of the LDM/STM loops: eight registers */
+    BLOCK_SIZE  = 8 * sizeof(word_t),
+};
+
+/*
+ * Copy 'len' bytes, a multiple of BLOCK_SIZE, between word-aligned
+ * buffers.
+ */
+static inline void copy_blocks (word_t * dst, word_t const * src, size_t len)
+{
+#if defined(__arm__)
+    if (len == 0) {
+        return;
+    }
+
+    asm volatile (
+        "0:                         \n\t"
+        "ldmia  %1!, {r3-r10}       \n\t"
+        "stmia  %0!, {r3-r10}       \n\t"
+        "subs   %2, %2, #32         \n\t"
+        "bne    0b                  \n\t"
+        : "+r" (dst), "+r" (src), "+r" (len)
+        :
+        : "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "cc", "memory"
+        );
+#else
+    for (; len > 0; len -= BLOCK_SIZE, dst += 8, src += 8) {
+        dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = src[3];
+        dst[4] = src[4]; dst[5] = src[5]; dst[6] = src[6]; dst[7] = src[7];
+    }
+#endif
+}
+
+/*
+ * Store 'pattern' over 'len' bytes, a multiple of BLOCK_SIZE, starting
+ * at a word-aligned address.
+ */
+static inline void fill_blocks (word_t * dst, word_t pattern, size_t len)
+{
+#if defined(__arm__)
+    if (len == 0) {
+        return;
+    }
+
+    asm volatile (
+        "mov    r3, %2              \n\t"
+        "mov    r4, %2              \n\t"
+        "mov    r5, %2              \n\t"
+        "mov    r6, %2              \n\t"
+        "mov    r7, %2              \n\t"
+        "mov    r8, %2              \n\t"
+        "mov    r9, %2              \n\t"
+        "mov    r10, %2             \n\t"
+        "0:                         \n\t"
+        "stmia  %0!, {r3-r10}       \n\t"
+        "subs   %1, %1, #32         \n\t"
+        "bne    0b                  \n\t"
+        : "+r" (dst), "+r" (len)
+        : "r" (pattern)
+        : "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "cc", "memory"
+        );
+#else
+    for (; len > 0; len -= BLOCK_SIZE, dst += 8) {
+        dst[0] = pattern; dst[1] = pattern; dst[2] = pattern; dst[3] = pattern;
+        dst[4] = pattern; dst[5] = pattern; dst[6] = pattern; dst[7] = pattern;
+    }
+#endif
+}
+
+void *
+memcpy (void *__restrict s1, const void *__restrict s2, size_t n)
+{
+    uint8_t * dst = (uint8_t *)s1;
+    uint8_t const * src = (uint8_t const *)s2;
+
+    /* Not worth setting up the word loops for */
+    if (n < 2 * WORD_SIZE) {
+        while (n-- > 0) {
+            *dst++ = *src++;
+        }
+        return s1;
+    }
+
+    /* Byte-copy up to the first word boundary of the destination */
+    while (((uintptr_t)dst & WORD_MASK) != 0) {
+        *dst++ = *src++;
+        n--;
+    }
+
+    if (((uintptr_t)src & WORD_MASK) == 0) {
+        /* Both buffers are now aligned */
+        size_t block_bytes = n & ~(size_t)(BLOCK_SIZE - 1);
+
+        copy_blocks((word_t *)dst, (word_t const *)src, block_bytes);
+        dst += block_bytes;
+        src += block_bytes;
+        n -= block_bytes;
+
+        while (n >= WORD_SIZE) {
+            *(word_t *)dst = *(word_t const *)src;
+            dst += WORD_SIZE;
+            src += WORD_SIZE;
+            n -= WORD_SIZE;
+        }
+    }
+    else {
+        /*
+        The source is misaligned by the same amount all the way through.
+        Only do aligned loads, and stitch each destination word together
+        out of the tail of one source word and the head of the next
+        (little-endian byte order).
+
+        The load of 'next' never touches a word that doesn't hold some
+        byte of the source buffer, so this can't fault past its end.
+        */
+        unsigned int    offset = (uintptr_t)src & WORD_MASK;
+        unsigned int    lo_shift = offset * 8;
+        unsigned int    hi_shift = 32 - lo_shift;
+        word_t const *  src_word = (word_t const *)(src - offset);
+        word_t          cur = *src_word++;
+
+        while (n >= WORD_SIZE) {
+            word_t next = *src_word++;
+
+            *(word_t *)dst = (cur >> lo_shift) | (next << hi_shift);
+            cur = next;
+
+            dst += WORD_SIZE;
+            src += WORD_SIZE;
+            n -= WORD_SIZE;
+        }
+    }
+
+    /* Tail */
+    while (n-- > 0) {
+        *dst++ = *src++;
+    }
+
+    return s1;
+}
+
+void * memset (void *b, int c, size_t len)
+{
+    uint8_t * dst = (uint8_t *)b;
+    word_t pattern;
+    size_t block_bytes;
+
+    if (len < 2 * WORD_SIZE) {
+        while (len-- > 0) {
+            *dst++ = (uint8_t)c;
+        }
+        return b;
+    }
+
+    /* Head */
+    while (((uintptr_t)dst & WORD_MASK) != 0) {
+        *dst++ = (uint8_t)c;
+        len--;
+    }
+
+    pattern = (uint8_t)c;
+    pattern |= pattern << 8;
+    pattern |= pattern << 16;
+
+    block_bytes = len & ~(size_t)(BLOCK_SIZE - 1);
+    fill_blocks((word_t *)dst, pattern, block_bytes);
+    dst += block_bytes;
+    len -= block_bytes;
+
+    while (len >= WORD_SIZE) {
+        *(word_t *)dst = pattern;
+        dst += WORD_SIZE;
+        len -= WORD_SIZE;
+    }
+
+    /* Tail */
+    while (len-- > 0) {
+        *dst++ = (uint8_t)c;
+    }
+
+    return b;
+}
+
+void PageZero (void * page)
+{
+    fill_blocks((word_t *)page, 0, PAGE_SIZE);
+}
+
+void PageCopy (void * dst, void const * src)
+{
+    copy_blocks((word_t *)dst, (word_t const *)src, PAGE_SIZE);
+}
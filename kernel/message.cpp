@@ -138,6 +138,15 @@ Connection::~Connection ()
 {
 }
 
+RefPtr<Connection> Connection::Duplicate () throw (std::bad_alloc)
+{
+    if (mDisposed) {
+        return RefPtr<Connection>();
+    }
+
+    return RefPtr<Connection>(new Connection(channel));
+}
+
 void Connection::Dispose ()
 {
     if (mDisposed) {
@@ -531,6 +540,9 @@ ssize_t Message::Reply (
     assert(*mReceiver == THREAD_CURRENT());
 
     if (mDisposed) {
+        /* Abandon any temporary priority boost the sender gave us */
+        THREAD_CURRENT()->SetEffectivePriority(THREAD_CURRENT()->assigned_priority);
+
         result = -ERROR_INVALID;
     }
     else {
@@ -561,13 +573,17 @@ ssize_t Message::Reply (
 
         result = status == ERROR_OK ? mResult : ERROR_OK;
 
+        /*
+        Abandon any temporary priority boost the sender gave us before
+        unblocking it, so that waking it is weighed against our own
+        priority and not against the one it lent us
+        */
+        THREAD_CURRENT()->SetEffectivePriority(THREAD_CURRENT()->assigned_priority);
+
         /* Sender will get to run again whenever a scheduling decision happens */
         mSenderSemaphore.Up();
     }
 
-    /* Abandon any temporary priority boost we had now that the sender is unblocked */
-    THREAD_CURRENT()->SetEffectivePriority(THREAD_CURRENT()->assigned_priority);
-
     /* Sender frees the message after fetching the return value from it */
     return result;
 } /* Message::Reply() */
@@ -691,6 +707,18 @@ static ssize_t TransferPayload (
     } else {
         assert(dest_thread->process != NULL);
         dst_tt = dest_thread->process->GetTranslationTable();
+
+        // The copy goes through the kernel's view of physical memory,
+        // which would write straight into pages still shared
+        // copy-on-write with some other process
+        int prepared = dest_thread->process->GetAddressSpace()->PrepareWrite(
+                (VmAddr_t)dest_buf,
+                dest_len
+                );
+
+        if (prepared < 0) {
+            return prepared;
+        }
     }
 
     return TranslationTable::CopyWithAddressSpaces(
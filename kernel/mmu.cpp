@@ -9,11 +9,12 @@
 #include <muos/spinlock.h>
 
 #include <kernel/assert.h>
+#include <kernel/cpu.hpp>
 #include <kernel/minmax.hpp>
 #include <kernel/mmu.hpp>
 #include <kernel/slaballocator.hpp>
-#include <kernel/tree-map.hpp>
 #include <kernel/vm.hpp>
+#include <kernel/vmalloc.h>
 
 #define ARM_MMU_ENABLED_BIT             0
 #define ARM_MMU_EXCEPTION_VECTOR_BIT    13
@@ -130,11 +131,99 @@ static inline Prot_t prot_from_ap (uint8_t ap)
     return ret;
 }
 
+/*
+ * Memory types with TEX bits set need an extended small page, which has
+ * room for them. The rest use plain small pages, where TEX reads as 000.
+ */
+static inline pt_secondlevel_t small_page_pte (PhysAddr_t phys, Prot_t prot,
+                                               CacheAttr_t attr)
+{
+    pt_secondlevel_t pte = phys & PT_SECONDLEVEL_SMALL_PAGE_BASE_ADDR_MASK;
+
+    switch (attr) {
+        case CACHE_ATTR_STRONGLY_ORDERED:
+            /* TEX 000, C 0, B 0 */
+            break;
+
+        case CACHE_ATTR_DEVICE:
+            /* TEX 000, C 0, B 1: Device */
+            pte |= PT_SECONDLEVEL_B;
+            break;
+
+        case CACHE_ATTR_WRITE_COMBINING:
+            /* TEX 001, C 0, B 0: Normal, non-cacheable */
+            return pte |
+                   PT_SECONDLEVEL_MAPTYPE_EXTENDED_SMALL_PAGE |
+                   (0b001 << PT_SECONDLEVEL_EXTENDED_TEX_SHIFT) |
+                   (ap_from_prot(prot) << PT_SECONDLEVEL_AP0_SHIFT);
+
+        default:
+            assert(false);
+            break;
+    }
+
+    return pte |
+           PT_SECONDLEVEL_MAPTYPE_SMALL_PAGE |
+           (ap_from_prot(prot) << PT_SECONDLEVEL_AP0_SHIFT) |
+           (ap_from_prot(prot) << PT_SECONDLEVEL_AP1_SHIFT) |
+           (ap_from_prot(prot) << PT_SECONDLEVEL_AP2_SHIFT) |
+           (ap_from_prot(prot) << PT_SECONDLEVEL_AP3_SHIFT);
+}
+
+/*
+ * Inverse of the memory-type part of small_page_pte()
+ */
+static inline CacheAttr_t cache_attr_from_pte (pt_secondlevel_t pte)
+{
+    if ((pte & PT_SECONDLEVEL_MAPTYPE_MASK) == PT_SECONDLEVEL_MAPTYPE_EXTENDED_SMALL_PAGE) {
+        return CACHE_ATTR_WRITE_COMBINING;
+    }
+    else if (pte & PT_SECONDLEVEL_B) {
+        return CACHE_ATTR_DEVICE;
+    }
+    else {
+        return CACHE_ATTR_STRONGLY_ORDERED;
+    }
+}
+
+/*
+ * Whether a second-level entry maps a page, in either of the formats
+ * that small_page_pte() produces
+ */
+static inline bool pte_maps_page (pt_secondlevel_t pte)
+{
+    switch (pte & PT_SECONDLEVEL_MAPTYPE_MASK) {
+        case PT_SECONDLEVEL_MAPTYPE_SMALL_PAGE:
+        case PT_SECONDLEVEL_MAPTYPE_EXTENDED_SMALL_PAGE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Whether an access is allowed to a page with protection 'prot'.
+ * Privileged accesses ignore the user read-only restriction, just
+ * as the MMU does.
+ */
 static inline bool check_access (
-        uint8_t ap
+        Prot_t prot,
+        bool user,
+        bool write
         )
 {
-    return true;
+    switch (prot) {
+        case PROT_NONE:
+            return false;
+        case PROT_KERNEL:
+            return !user;
+        case PROT_USER_READONLY:
+            return !user || !write;
+        case PROT_USER_READWRITE:
+            return true;
+    }
+
+    return false;
 }
 
 int MmuGetEnabled (void)
@@ -260,24 +349,32 @@ SecondlevelTable::~SecondlevelTable () throw ()
 
 SyncSlabAllocator<TranslationTable> TranslationTable::sSlab;
 
-TranslationTable::TranslationTable () throw (std::bad_alloc)
-{
-    enum {
-        /*
-         * log_2 of the number of pages required to hold
-         * the hardware translation-table.
-         *
-         * I.e., the translation table is
-         *
-         *     PAGE_SIZE * (2^^TRANSLATION_TABLE_PAGES_ORDER)
-         *
-         * bytes long.
-         */
-        TRANSLATION_TABLE_PAGES_ORDER = 2,
+enum {
+    /*
+     * log_2 of the number of pages required to hold
+     * the hardware translation-table.
+     *
+     * I.e., the translation table is
+     *
+     *     PAGE_SIZE * (2^^TRANSLATION_TABLE_PAGES_ORDER)
+     *
+     * bytes long.
+     */
+    TRANSLATION_TABLE_PAGES_ORDER = 2,
+
+    TRANSLATION_TABLE_SIZE = PAGE_SIZE * (1 << TRANSLATION_TABLE_PAGES_ORDER),
+
+    /* One first-level descriptor for each 1MB section */
+    TRANSLATION_TABLE_ENTRIES = TRANSLATION_TABLE_SIZE / sizeof(pt_firstlevel_t),
+};
 
-        TRANSLATION_TABLE_SIZE = PAGE_SIZE * (1 << TRANSLATION_TABLE_PAGES_ORDER),
-    };
+/*
+ * Never page-aligned, so it can't match any lookup in the translation cache
+ */
+static const VmAddr_t TRANSLATION_CACHE_EMPTY = 1;
 
+TranslationTable::TranslationTable () throw (std::bad_alloc)
+{
     /* The ARM MMU hardware requires that a translation table is 16KB long */
     COMPILER_ASSERT(TRANSLATION_TABLE_SIZE == 4096 * 4);
 
@@ -290,47 +387,70 @@ TranslationTable::TranslationTable () throw (std::bad_alloc)
 
     this->firstlevel_ptes = (pt_firstlevel_t *)this->firstlevel_ptes_pages->base_address;
 
-    this->sparse_secondlevel_map = new SparseSecondlevelMap_t(SparseSecondlevelMap_t::AddressCompareFunc);
+    /*
+     * Lookaside array of SecondlevelTable pointers has exactly as many
+     * entries as the hardware table, so it's the same number of pages.
+     */
+    COMPILER_ASSERT(sizeof(SecondlevelTable *) == sizeof(pt_firstlevel_t));
+
+    if (GetKernel()) {
+        /*
+         * Unlike the hardware table, nothing requires this to be physically
+         * contiguous. Taking it from vmalloc() means that creating a process
+         * only needs to find one 16KB block.
+         */
+        this->secondlevel_tables = (SecondlevelTable **)vmalloc(TRANSLATION_TABLE_SIZE);
+
+        if (!this->secondlevel_tables) {
+            throw std::bad_alloc();
+        }
+    }
+    else {
+        /* The kernel's own table is what vmalloc() maps things into */
+        this->secondlevel_tables_pages = Page::Alloc(TRANSLATION_TABLE_PAGES_ORDER);
+
+        if (!this->secondlevel_tables_pages) {
+            throw std::bad_alloc();
+        }
+
+        this->secondlevel_tables = (SecondlevelTable **)this->secondlevel_tables_pages->base_address;
+    }
 
     /* Initially make all sections unmapped */
-    for (unsigned int i = 0; i < TRANSLATION_TABLE_SIZE / sizeof(pt_firstlevel_t); i++) {
+    for (unsigned int i = 0; i < TRANSLATION_TABLE_ENTRIES; i++) {
         this->firstlevel_ptes[i] = PT_FIRSTLEVEL_MAPTYPE_UNMAPPED;
+        this->secondlevel_tables[i] = NULL;
     }
-}
-
-/*
-Use a foreach on the tree to collect any existing nodes into a
-list, then blow away the list's elements afterward.
-*/
-static void func (RawTreeMap::Key_t key, RawTreeMap::Value_t value, void * user_data)
-{
-    typedef List<SecondlevelTable, &SecondlevelTable::link> list_t;
 
-    list_t *                    head;
-    struct SecondlevelTable *   secondlevel_table;
+    SpinlockInit(&this->translation_cache_lock);
 
-    head                = (List<SecondlevelTable, &SecondlevelTable::link> *)user_data;
-    secondlevel_table   = (struct SecondlevelTable *)value;
+    for (unsigned int i = 0; i < N_ELEMENTS(this->translation_cache); i++) {
+        this->translation_cache[i].virt_page = TRANSLATION_CACHE_EMPTY;
+    }
 
-    head->Append(secondlevel_table);
+    this->num_spare_secondlevel_tables = 0;
+    this->num_secondlevel_tables = 0;
 }
 
 TranslationTable::~TranslationTable ()
 {
-    /* Aggregates any individual secondlevel_table's that need freed */
-    List<SecondlevelTable, &SecondlevelTable::link> head;
-
     /* Clean out any individual second-level translation tables */
+    for (unsigned int i = 0; i < TRANSLATION_TABLE_ENTRIES; i++) {
+        if (this->secondlevel_tables[i] != NULL) {
+            delete this->secondlevel_tables[i];
+            this->secondlevel_tables[i] = NULL;
+        }
+    }
 
-    /* Go ahead and gather up all the nodes */
-    this->sparse_secondlevel_map->Foreach(func, &head);
+    while (!this->spare_secondlevel_tables.Empty()) {
+        delete this->spare_secondlevel_tables.PopFirst();
+    }
 
-    /* Deallocate everything we found in there */
-    while (!head.Empty())
-    {
-        delete head.PopFirst();
+    if (!this->secondlevel_tables_pages) {
+        vfree(this->secondlevel_tables);
     }
 
+    this->secondlevel_tables = NULL;
     this->firstlevel_ptes = NULL;
 }
 
@@ -367,11 +487,12 @@ void TranslationTable::SetKernel (TranslationTable * table)
     kernel_translation_table = table;
 }
 
-static TranslationTable * user_translation_table = 0;
+/* Table installed for user addresses on each CPU */
+static TranslationTable * volatile user_translation_tables[Cpu::MAX];
 
 TranslationTable * TranslationTable::GetUser ()
 {
-    return user_translation_table;
+    return user_translation_tables[Cpu::GetId()];
 }
 
 void TranslationTable::SetUser (TranslationTable * table)
@@ -386,6 +507,16 @@ void TranslationTable::SetUser (TranslationTable * table)
     /* Sanity check */
     assert((table_phys & 0xffffc000) == table_phys);
 
+    /*
+    Recorded before the table's installed, so that anyone changing the
+    table from another CPU after this either sees it's in use here and
+    asks for a flush, or finished the change before the walks below.
+    */
+    unsigned int cpu = Cpu::GetId();
+    bool changed = user_translation_tables[cpu] != table;
+
+    user_translation_tables[cpu] = table;
+
     /*
     Only bits 14 through 31 (that is, the high 18 bits) of the translation
     table base register are usable. Because the hardware requires the
@@ -402,11 +533,36 @@ void TranslationTable::SetUser (TranslationTable * table)
     /* Install modified register back */
     SetTTBR0(ttbr0);
 
-    if (user_translation_table != table) {
+    if (changed) {
         MmuFlushTlb();
     }
+}
+
+/*
+Flush every TLB that can hold entries walked from 'table': those of all
+CPUs for the kernel's table, and otherwise those of the CPUs it's
+installed on right now. Tables that aren't installed in the MMU can't
+have any live TLB entries; switching address spaces already flushed
+them.
+*/
+static void flush_tlbs_using (TranslationTable * table)
+{
+    uint32_t cpus = 0;
+
+    if (table == kernel_translation_table) {
+        cpus = Cpu::GetOnlineMask();
+    }
+    else {
+        for (unsigned int cpu = 0; cpu < Cpu::MAX; cpu++) {
+            if (user_translation_tables[cpu] == table) {
+                cpus |= 1u << cpu;
+            }
+        }
+    }
 
-    user_translation_table = table;
+    if (cpus != 0) {
+        Cpu::FlushTlb(cpus);
+    }
 }
 
 TranslationTable * TranslationTableGetUser ()
@@ -482,7 +638,8 @@ bool TranslationTable::UnmapSection (
 bool TranslationTable::MapPage (
         VmAddr_t virt,
         PhysAddr_t phys,
-        Prot_t prot
+        Prot_t prot,
+        CacheAttr_t attr
         )
 {
     /* VM address rounded down to nearest megabyte */
@@ -514,7 +671,7 @@ bool TranslationTable::MapPage (
 
         case PT_FIRSTLEVEL_MAPTYPE_COARSE:
         {
-            secondlevel_table = this->sparse_secondlevel_map->Lookup(virt_mb_rounded);
+            secondlevel_table = this->secondlevel_tables[virt_mb_rounded >> MEGABYTE_SHIFT];
 
             if (!secondlevel_table) {
                 /* No pages exist in the section. Why's it mapped then?? */
@@ -541,15 +698,14 @@ bool TranslationTable::MapPage (
     /* In case a table didn't exist yet, make it */
     if (!secondlevel_table) {
 
-        try {
-            secondlevel_table = new SecondlevelTable();
-        }
-        catch (std::bad_alloc & exc) {
+        secondlevel_table = AllocateSecondlevelTable();
+
+        if (!secondlevel_table) {
             // Couldn't allocate memory for the new secondary table
             return false;
         }
 
-        this->sparse_secondlevel_map->Insert(virt_mb_rounded, secondlevel_table);
+        this->secondlevel_tables[virt_mb_rounded >> MEGABYTE_SHIFT] = secondlevel_table;
 
         this->firstlevel_ptes[virt_mb_rounded >> MEGABYTE_SHIFT] =
                 PT_FIRSTLEVEL_MAPTYPE_COARSE |
@@ -558,13 +714,7 @@ bool TranslationTable::MapPage (
     }
 
     /* Insert the new page into the secondlevel TT */
-    secondlevel_table->ptes->ptes[virt_pg_idx] =
-            PT_SECONDLEVEL_MAPTYPE_SMALL_PAGE |
-            (ap_from_prot(prot) << PT_SECONDLEVEL_AP0_SHIFT) |
-            (ap_from_prot(prot) << PT_SECONDLEVEL_AP1_SHIFT) |
-            (ap_from_prot(prot) << PT_SECONDLEVEL_AP2_SHIFT) |
-            (ap_from_prot(prot) << PT_SECONDLEVEL_AP3_SHIFT) |
-            (phys & PT_SECONDLEVEL_SMALL_PAGE_BASE_ADDR_MASK);
+    secondlevel_table->ptes->ptes[virt_pg_idx] = small_page_pte(phys, prot, attr);
 
     secondlevel_table->num_mapped_pages++;
 
@@ -601,7 +751,7 @@ bool TranslationTable::UnmapPage (
 
         case PT_FIRSTLEVEL_MAPTYPE_COARSE:
 
-            secondlevel_table = this->sparse_secondlevel_map->Lookup(virt_mb_rounded);
+            secondlevel_table = this->secondlevel_tables[virt_mb_rounded >> MEGABYTE_SHIFT];
 
             if (!secondlevel_table) {
                 /* No pages exist in the section. Why's it mapped then?? */
@@ -618,164 +768,661 @@ bool TranslationTable::UnmapPage (
             break;
     }
 
-    if ((secondlevel_table->ptes->ptes[virt_pg_idx] & PT_SECONDLEVEL_MAPTYPE_MASK) != PT_SECONDLEVEL_MAPTYPE_SMALL_PAGE) {
+    if (!pte_maps_page(secondlevel_table->ptes->ptes[virt_pg_idx])) {
         return false;
     }
 
     secondlevel_table->ptes->ptes[virt_pg_idx] = PT_SECONDLEVEL_MAPTYPE_UNMAPPED;
     secondlevel_table->num_mapped_pages--;
 
-    /* If no pages are used in the secondlevel table, clean it up */
+    InvalidateTranslationCache(virt, PAGE_SIZE);
+
+    /* If no pages are used in the secondlevel table, unhook it */
     if (secondlevel_table->num_mapped_pages < 1) {
-        this->firstlevel_ptes[virt_mb_rounded >> MEGABYTE_SHIFT] &= ~PT_FIRSTLEVEL_MAPTYPE_MASK;
-        this->firstlevel_ptes[virt_mb_rounded >> MEGABYTE_SHIFT] |= PT_FIRSTLEVEL_MAPTYPE_UNMAPPED;
+        RemoveSecondlevelTable(virt_mb_rounded >> MEGABYTE_SHIFT);
+    }
+    else {
+        secondlevel_table = NULL;
+    }
 
-        secondlevel_table = this->sparse_secondlevel_map->Remove(virt_mb_rounded);
+    flush_tlbs_using(this);
 
-        assert(secondlevel_table != NULL);
+    /* Only once the TLB can no longer walk through it */
+    if (secondlevel_table) {
+        RetireSecondlevelTable(secondlevel_table);
     }
 
     return true;
 }
 
-ssize_t TranslationTable::CopyWithAddressSpaces (
-        TranslationTable *  source_tt,
-        const void *        source_buf,
-        size_t              source_len,
-        TranslationTable *  dest_tt,
-        void *              dest_buf,
-        size_t              dest_len
+SecondlevelTable * TranslationTable::GetSecondlevelTable (
+        VmAddr_t virt,
+        bool create
         )
 {
-    size_t len;
+    unsigned int section_idx = virt >> MEGABYTE_SHIFT;
+    SecondlevelTable * secondlevel_table;
 
-    len = MIN(source_len, dest_len);
+    switch (this->firstlevel_ptes[section_idx] & PT_FIRSTLEVEL_MAPTYPE_MASK)
+    {
+        case PT_FIRSTLEVEL_MAPTYPE_COARSE:
+            secondlevel_table = this->secondlevel_tables[section_idx];
+            assert(secondlevel_table != NULL);
+            return secondlevel_table;
 
-    if (source_tt == dest_tt && false) {
-        /* Sender and receiver both in same address space. */
-        memcpy(dest_buf, source_buf, len);
+        case PT_FIRSTLEVEL_MAPTYPE_UNMAPPED:
+            break;
+
+        case PT_FIRSTLEVEL_MAPTYPE_SECTION:
+            return NULL;
+
+        /* There are no other defined mapping types */
+        default:
+            assert(false);
+            return NULL;
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    secondlevel_table = AllocateSecondlevelTable();
+
+    if (!secondlevel_table) {
+        return NULL;
+    }
+
+    this->secondlevel_tables[section_idx] = secondlevel_table;
+
+    this->firstlevel_ptes[section_idx] =
+            PT_FIRSTLEVEL_MAPTYPE_COARSE |
+            (PT_DOMAIN_DEFAULT << PT_FIRSTLEVEL_DOMAIN_SHIFT) |
+            (V2P((VmAddr_t)&secondlevel_table->ptes->ptes[0]) & PT_FIRSTLEVEL_COARSE_BASE_ADDR_MASK);
+
+    return secondlevel_table;
+}
+
+SecondlevelTable * TranslationTable::RemoveSecondlevelTable (
+        unsigned int section_idx
+        )
+{
+    SecondlevelTable * secondlevel_table = this->secondlevel_tables[section_idx];
+
+    assert(secondlevel_table != NULL);
+    assert(secondlevel_table->num_mapped_pages == 0);
+
+    this->firstlevel_ptes[section_idx] = PT_FIRSTLEVEL_MAPTYPE_UNMAPPED;
+    this->secondlevel_tables[section_idx] = NULL;
+
+    return secondlevel_table;
+}
+
+SecondlevelTable * TranslationTable::AllocateSecondlevelTable ()
+{
+    if (!this->spare_secondlevel_tables.Empty()) {
+        this->num_spare_secondlevel_tables--;
+        return this->spare_secondlevel_tables.PopFirst();
+    }
+
+    try {
+        SecondlevelTable * secondlevel_table = new SecondlevelTable();
+        this->num_secondlevel_tables++;
+        return secondlevel_table;
+    }
+    catch (std::bad_alloc & exc) {
+        return NULL;
+    }
+}
+
+void TranslationTable::RetireSecondlevelTable (
+        SecondlevelTable * secondlevel_table
+        )
+{
+    assert(secondlevel_table->num_mapped_pages == 0);
+
+    /*
+    Every entry went back to PT_SECONDLEVEL_MAPTYPE_UNMAPPED as its page
+    was unmapped, so a spare is as good as a freshly constructed table.
+    */
+    if (this->num_spare_secondlevel_tables < SPARE_SECONDLEVEL_TABLES) {
+        this->spare_secondlevel_tables.Prepend(secondlevel_table);
+        this->num_spare_secondlevel_tables++;
     }
     else {
+        delete secondlevel_table;
+        this->num_secondlevel_tables--;
+    }
+}
 
-        size_t      remaining;
-        VmAddr_t    src_cursor  = (VmAddr_t)source_buf;
-        VmAddr_t    dst_cursor  = (VmAddr_t)dest_buf;
+void TranslationTable::AddSpareSecondlevelTables (
+        List<SecondlevelTable, &SecondlevelTable::link> & tables
+        )
+{
+    while (!tables.Empty()) {
+        this->spare_secondlevel_tables.Prepend(tables.PopFirst());
+        this->num_spare_secondlevel_tables++;
+        this->num_secondlevel_tables++;
+    }
+}
 
-        /*
-        Loop once for each contiguous chunk that can be copied from a
-        source-address-space page to a destination-address-space page.
-        */
-        for (remaining = len; remaining > 0;) {
+void TranslationTable::TakeExcessSecondlevelTables (
+        List<SecondlevelTable, &SecondlevelTable::link> & tables
+        )
+{
+    while (this->num_spare_secondlevel_tables > SPARE_SECONDLEVEL_TABLES) {
+        tables.Append(this->spare_secondlevel_tables.PopFirst());
+        this->num_spare_secondlevel_tables--;
+        this->num_secondlevel_tables--;
+    }
+}
+
+unsigned int TranslationTable::GetSecondlevelTableCount ()
+{
+    return this->num_secondlevel_tables;
+}
+
+size_t TranslationTable::GetFootprintPages (unsigned int extra_tables)
+{
+    /* First-level table plus the parallel lookaside array */
+    size_t bytes = 2 * TRANSLATION_TABLE_SIZE;
+
+    bytes += (this->num_secondlevel_tables + extra_tables) *
+             (sizeof(SecondlevelTable) + sizeof(SecondlevelPtes));
+
+    return (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+unsigned int TranslationTable::CountSecondlevelTablesNeeded (
+        VmAddr_t virt,
+        size_t length
+        )
+{
+    unsigned int missing = 0;
+
+    if (length == 0) {
+        return 0;
+    }
+
+    for (VmAddr_t section_idx = virt >> MEGABYTE_SHIFT;
+         section_idx <= (virt + length - 1) >> MEGABYTE_SHIFT;
+         section_idx++)
+    {
+        if (!this->secondlevel_tables[section_idx]) {
+            missing++;
+        }
+    }
+
+    return missing > this->num_spare_secondlevel_tables
+            ? missing - this->num_spare_secondlevel_tables
+            : 0;
+}
 
-            VmAddr_t src_mb;
-            VmAddr_t dst_mb;
+bool TranslationTable::FillRange (
+        VmAddr_t virt,
+        size_t length,
+        Prot_t prot,
+        CacheAttr_t attr,
+        PhysAddr_t phys,
+        List<Page, &Page::list_link>::Iterator * pages
+        )
+{
+    enum {
+        PAGES_PER_SECTION = SECTION_SIZE / PAGE_SIZE,
+    };
+
+    VmAddr_t    cursor = virt;
+    size_t      remaining;
+    bool        ok = true;
+
+    assert(virt % PAGE_SIZE == 0);
+    assert(phys % PAGE_SIZE == 0);
+    assert(length % PAGE_SIZE == 0);
+
+    /* Loop once for each (partial) section covered by the range */
+    for (remaining = length / PAGE_SIZE; remaining > 0;) {
+
+        unsigned int        pg_idx = (cursor & ~MEGABYTE_MASK) >> PAGE_SHIFT;
+        size_t              count = MIN(remaining, size_t(PAGES_PER_SECTION - pg_idx));
+        SecondlevelTable *  secondlevel_table;
+        pt_secondlevel_t *  pte;
+        unsigned int        i;
+
+        secondlevel_table = GetSecondlevelTable(cursor, true);
+
+        if (!secondlevel_table) {
+            ok = false;
+            break;
+        }
+
+        pte = &secondlevel_table->ptes->ptes[pg_idx];
+
+        /* Make sure no previous mapping exists for any of the pages */
+        for (i = 0; i < count; i++) {
+            if ((pte[i] & PT_SECONDLEVEL_MAPTYPE_MASK) != PT_SECONDLEVEL_MAPTYPE_UNMAPPED) {
+                break;
+            }
+        }
+
+        if (i < count) {
+            /* Don't leave behind a table that was installed just now */
+            if (secondlevel_table->num_mapped_pages == 0) {
+                RetireSecondlevelTable(RemoveSecondlevelTable(cursor >> MEGABYTE_SHIFT));
+            }
+            ok = false;
+            break;
+        }
+
+        for (i = 0; i < count; i++) {
+            if (pages) {
+                pte[i] = small_page_pte(V2P((**pages)->base_address), prot, attr);
+                ++(*pages);
+            }
+            else {
+                pte[i] = small_page_pte(phys, prot, attr);
+                phys += PAGE_SIZE;
+            }
+        }
+
+        secondlevel_table->num_mapped_pages += count;
+
+        remaining -= count;
+        cursor += count * PAGE_SIZE;
+    }
+
+    if (!ok) {
+        /* Back out whatever part of the range did get mapped */
+        UnmapRange(virt, cursor - virt);
+    }
+
+    return ok;
+}
+
+bool TranslationTable::MapRange (
+        VmAddr_t virt,
+        PhysAddr_t phys,
+        size_t length,
+        Prot_t prot,
+        CacheAttr_t attr
+        )
+{
+    return FillRange(virt, length, prot, attr, phys, NULL);
+}
+
+bool TranslationTable::MapRange (
+        VmAddr_t virt,
+        List<Page, &Page::list_link>::Iterator pages,
+        size_t length,
+        Prot_t prot
+        )
+{
+    return FillRange(virt, length, prot, CACHE_ATTR_STRONGLY_ORDERED, 0, &pages);
+}
+
+bool TranslationTable::UnmapRange (
+        VmAddr_t virt,
+        size_t length
+        )
+{
+    enum {
+        PAGES_PER_SECTION = SECTION_SIZE / PAGE_SIZE,
+    };
+
+    /* Emptied second-level tables, retired once the TLB is clean */
+    List<SecondlevelTable, &SecondlevelTable::link> emptied;
+
+    VmAddr_t    cursor = virt;
+    size_t      remaining;
+    bool        all_mapped = true;
+    bool        changed = false;
+
+    assert(virt % PAGE_SIZE == 0);
+    assert(length % PAGE_SIZE == 0);
+
+    /* Loop once for each (partial) section covered by the range */
+    for (remaining = length / PAGE_SIZE; remaining > 0;) {
+
+        unsigned int        pg_idx = (cursor & ~MEGABYTE_MASK) >> PAGE_SHIFT;
+        size_t              count = MIN(remaining, size_t(PAGES_PER_SECTION - pg_idx));
+        SecondlevelTable *  secondlevel_table;
+        pt_secondlevel_t *  pte;
+
+        secondlevel_table = GetSecondlevelTable(cursor, false);
+
+        if (!secondlevel_table) {
+            all_mapped = false;
+        }
+        else {
+            pte = &secondlevel_table->ptes->ptes[pg_idx];
+
+            for (unsigned int i = 0; i < count; i++) {
+                if (!pte_maps_page(pte[i])) {
+                    all_mapped = false;
+                    continue;
+                }
+
+                pte[i] = PT_SECONDLEVEL_MAPTYPE_UNMAPPED;
+                secondlevel_table->num_mapped_pages--;
+                changed = true;
+            }
+
+            if (secondlevel_table->num_mapped_pages < 1) {
+                emptied.Append(RemoveSecondlevelTable(cursor >> MEGABYTE_SHIFT));
+            }
+        }
+
+        remaining -= count;
+        cursor += count * PAGE_SIZE;
+    }
+
+    if (changed) {
+        InvalidateTranslationCache(virt, length);
+        flush_tlbs_using(this);
+    }
+
+    while (!emptied.Empty()) {
+        RetireSecondlevelTable(emptied.PopFirst());
+    }
+
+    return all_mapped;
+}
+
+bool TranslationTable::RewriteRange (
+        VmAddr_t virt,
+        size_t length,
+        Prot_t prot,
+        List<Page, &Page::list_link>::Iterator * pages
+        )
+{
+    enum {
+        PAGES_PER_SECTION = SECTION_SIZE / PAGE_SIZE,
+    };
+
+    VmAddr_t    cursor = virt;
+    size_t      remaining;
+    bool        all_mapped = true;
+    bool        changed = false;
+
+    assert(virt % PAGE_SIZE == 0);
+    assert(length % PAGE_SIZE == 0);
+
+    /* Loop once for each (partial) section covered by the range */
+    for (remaining = length / PAGE_SIZE; remaining > 0;) {
+
+        unsigned int        pg_idx = (cursor & ~MEGABYTE_MASK) >> PAGE_SHIFT;
+        size_t              count = MIN(remaining, size_t(PAGES_PER_SECTION - pg_idx));
+        SecondlevelTable *  secondlevel_table;
+        pt_secondlevel_t *  pte;
+
+        secondlevel_table = GetSecondlevelTable(cursor, false);
+
+        if (!secondlevel_table) {
+            all_mapped = false;
+
+            /* Keep the pages lined up with the addresses they belong to */
+            for (unsigned int i = 0; pages && i < count; i++) {
+                ++(*pages);
+            }
+        }
+        else {
+            pte = &secondlevel_table->ptes->ptes[pg_idx];
+
+            for (unsigned int i = 0; i < count; i++) {
+                PhysAddr_t phys = pte[i] & PT_SECONDLEVEL_SMALL_PAGE_BASE_ADDR_MASK;
+
+                if (pages) {
+                    phys = V2P((**pages)->base_address);
+                    ++(*pages);
+                }
 
-            PhysAddr_t src_phys;
-            PhysAddr_t dst_phys;
+                if (!pte_maps_page(pte[i])) {
+                    all_mapped = false;
+                    continue;
+                }
 
-            size_t src_valid_len;
-            size_t dst_valid_len;
+                pte[i] = small_page_pte(phys, prot, cache_attr_from_pte(pte[i]));
+                changed = true;
+            }
+        }
 
-            pt_firstlevel_t src_firstlevel_pte;
-            pt_firstlevel_t dst_firstlevel_pte;
+        remaining -= count;
+        cursor += count * PAGE_SIZE;
+    }
 
-            pt_secondlevel_t *src_secondlevel_base;
-            pt_secondlevel_t *dst_secondlevel_base;
+    if (changed) {
+        InvalidateTranslationCache(virt, length);
+        flush_tlbs_using(this);
+    }
 
-            pt_secondlevel_t src_secondlevel_pte;
-            pt_secondlevel_t dst_secondlevel_pte;
+    return all_mapped;
+}
 
-            bool src_access;
-            bool dst_access;
+bool TranslationTable::ProtectRange (
+        VmAddr_t virt,
+        size_t length,
+        Prot_t prot
+        )
+{
+    return RewriteRange(virt, length, prot, NULL);
+}
 
-            src_mb = src_cursor & MEGABYTE_MASK;
-            dst_mb = dst_cursor & MEGABYTE_MASK;
+bool TranslationTable::RemapRange (
+        VmAddr_t virt,
+        List<Page, &Page::list_link>::Iterator pages,
+        size_t length,
+        Prot_t prot
+        )
+{
+    return RewriteRange(virt, length, prot, &pages);
+}
 
-            src_firstlevel_pte = source_tt->firstlevel_ptes[src_mb >> MEGABYTE_SHIFT];
-            dst_firstlevel_pte = dest_tt->firstlevel_ptes[dst_mb >> MEGABYTE_SHIFT];
+bool TranslationTable::Translate (
+        VmAddr_t virt,
+        PhysAddr_t & phys,
+        size_t & valid_len,
+        size_t wanted_len,
+        bool write
+        )
+{
+    enum {
+        PAGES_PER_SECTION = SECTION_SIZE / PAGE_SIZE,
+    };
 
-            /* Figure out physical address of source buffer chunk */
-            switch (src_firstlevel_pte & PT_FIRSTLEVEL_MAPTYPE_MASK) {
+    VmAddr_t            virt_page = virt & PAGE_MASK;
+    size_t              page_offset = virt & ~PAGE_MASK;
+    unsigned int        cache_idx = (virt >> PAGE_SHIFT) % TRANSLATION_CACHE_ENTRIES;
+    bool                user = this != kernel_translation_table;
+    SecondlevelTable *  secondlevel_table;
+    pt_firstlevel_t     firstlevel_pte;
+    pt_secondlevel_t *  pte;
+    PhysAddr_t          phys_page;
+    Prot_t              prot;
+
+    /* User tables only ever cover the bottom half of the address space */
+    if (user && virt >= KERNEL_MODE_OFFSET) {
+        return false;
+    }
 
-                case PT_FIRSTLEVEL_MAPTYPE_SECTION:
+    /*
+    Held across the table walk as well, so that a translation can't be
+    cached after an unmap has already invalidated it.
+    */
+    SpinlockLock(&this->translation_cache_lock);
 
-                    src_phys = (src_firstlevel_pte & PT_FIRSTLEVEL_SECTION_BASE_ADDR_MASK) + (src_cursor & ~MEGABYTE_MASK);
+    /*
+    A cached page is only good enough if the caller doesn't want more than
+    it; otherwise walking the table lets the answer cover several pages.
+    */
+    if (this->translation_cache[cache_idx].virt_page == virt_page &&
+        wanted_len <= PAGE_SIZE - page_offset)
+    {
+        phys_page = this->translation_cache[cache_idx].phys_page;
+        prot = this->translation_cache[cache_idx].prot;
+        SpinlockUnlock(&this->translation_cache_lock);
 
-                    src_valid_len = (1 << MEGABYTE_SHIFT) - (src_cursor & ~MEGABYTE_MASK);
+        if (!check_access(prot, user, write)) {
+            return false;
+        }
 
-                    src_access = check_access(
-                            (src_firstlevel_pte & PT_FIRSTLEVEL_SECTION_AP_MASK) >> PT_FIRSTLEVEL_SECTION_AP_SHIFT
-                            );
-                    break;
+        phys = phys_page + page_offset;
+        valid_len = PAGE_SIZE - page_offset;
+        return true;
+    }
 
-                case PT_FIRSTLEVEL_MAPTYPE_COARSE:
+    /*
+    Fast path for a small page. The lookaside array gives the second-level
+    table directly, without decoding the first-level descriptor.
+    */
+    secondlevel_table = this->secondlevel_tables[virt >> MEGABYTE_SHIFT];
 
-                    src_secondlevel_base = (pt_secondlevel_t *)P2V(
-                            src_firstlevel_pte &
-                            PT_FIRSTLEVEL_COARSE_BASE_ADDR_MASK
-                            );
+    if (secondlevel_table) {
+        unsigned int pg_idx = (virt & ~MEGABYTE_MASK) >> PAGE_SHIFT;
+        unsigned int run;
 
-                    assert((VmAddr_t)src_secondlevel_base != P2V((PhysAddr_t)NULL));
+        pte = &secondlevel_table->ptes->ptes[pg_idx];
 
-                    src_secondlevel_pte = src_secondlevel_base[(src_cursor & ~MEGABYTE_MASK) >> PAGE_SHIFT];
+        if (!pte_maps_page(pte[0])) {
+            SpinlockUnlock(&this->translation_cache_lock);
+            return false;
+        }
 
-                    src_phys = (src_secondlevel_pte & PT_SECONDLEVEL_SMALL_PAGE_BASE_ADDR_MASK) + (src_cursor & ~PAGE_MASK);
+        phys_page = pte[0] & PT_SECONDLEVEL_SMALL_PAGE_BASE_ADDR_MASK;
+        prot = prot_from_ap((pte[0] & PT_SECONDLEVEL_AP0_MASK) >> PT_SECONDLEVEL_AP0_SHIFT);
 
-                    src_valid_len = PAGE_SIZE - (src_cursor & ~PAGE_MASK);
+        this->translation_cache[cache_idx].virt_page = virt_page;
+        this->translation_cache[cache_idx].phys_page = phys_page;
+        this->translation_cache[cache_idx].prot = prot;
 
-                    src_access = check_access(
-                            (src_secondlevel_pte & PT_SECONDLEVEL_AP0_MASK) >> PT_SECONDLEVEL_AP0_SHIFT
-                            );
-                    break;
+        /*
+        Following pages in the same table that carry on where this one
+        leaves off in physical memory, with the same permissions, can be
+        handed back as part of the same chunk.
+        */
+        valid_len = PAGE_SIZE - page_offset;
 
-                default:
-                    src_access = false;
-                    src_valid_len = dst_valid_len = 0;
-                    src_phys = 0;
-                    break;
+        for (run = 1;
+             valid_len < wanted_len && pg_idx + run < PAGES_PER_SECTION;
+             run++)
+        {
+            if (!pte_maps_page(pte[run]) ||
+                (pte[run] & PT_SECONDLEVEL_SMALL_PAGE_BASE_ADDR_MASK) != phys_page + run * PAGE_SIZE ||
+                (pte[run] & PT_SECONDLEVEL_AP0_MASK) != (pte[0] & PT_SECONDLEVEL_AP0_MASK))
+            {
+                break;
             }
 
-            /* Figure out physical address of destination buffer chunk */
-            switch (dst_firstlevel_pte & PT_FIRSTLEVEL_MAPTYPE_MASK) {
+            valid_len += PAGE_SIZE;
+        }
+
+        SpinlockUnlock(&this->translation_cache_lock);
+
+        if (!check_access(prot, user, write)) {
+            return false;
+        }
+
+        phys = phys_page + page_offset;
+        return true;
+    }
+
+    SpinlockUnlock(&this->translation_cache_lock);
+
+    /* Only the kernel's table has whole sections mapped */
+    if (user) {
+        return false;
+    }
+
+    firstlevel_pte = this->firstlevel_ptes[virt >> MEGABYTE_SHIFT];
+
+    if ((firstlevel_pte & PT_FIRSTLEVEL_MAPTYPE_MASK) != PT_FIRSTLEVEL_MAPTYPE_SECTION) {
+        return false;
+    }
+
+    /* One lookup covers the whole megabyte; not worth caching */
+    prot = prot_from_ap((firstlevel_pte & PT_FIRSTLEVEL_SECTION_AP_MASK) >> PT_FIRSTLEVEL_SECTION_AP_SHIFT);
+
+    if (!check_access(prot, user, write)) {
+        return false;
+    }
+
+    phys = (firstlevel_pte & PT_FIRSTLEVEL_SECTION_BASE_ADDR_MASK) + (virt & ~MEGABYTE_MASK);
+    valid_len = SECTION_SIZE - (virt & ~MEGABYTE_MASK);
+    return true;
+}
 
-                case PT_FIRSTLEVEL_MAPTYPE_SECTION:
+void TranslationTable::InvalidateTranslationCache (
+        VmAddr_t virt,
+        size_t length
+        )
+{
+    SpinlockLock(&this->translation_cache_lock);
 
-                    dst_phys = (dst_firstlevel_pte & PT_FIRSTLEVEL_SECTION_BASE_ADDR_MASK) + (dst_cursor & ~MEGABYTE_MASK);
+    for (unsigned int i = 0; i < N_ELEMENTS(this->translation_cache); i++) {
+        VmAddr_t cached = this->translation_cache[i].virt_page;
 
-                    dst_valid_len = (1 << MEGABYTE_SHIFT) - (dst_cursor & ~MEGABYTE_MASK);
+        if (cached != TRANSLATION_CACHE_EMPTY && cached - virt < length) {
+            this->translation_cache[i].virt_page = TRANSLATION_CACHE_EMPTY;
+        }
+    }
 
-                    dst_access = check_access(
-                            (dst_firstlevel_pte & PT_FIRSTLEVEL_SECTION_AP_MASK) >> PT_FIRSTLEVEL_SECTION_AP_SHIFT
-                            );
-                    break;
+    SpinlockUnlock(&this->translation_cache_lock);
+}
 
-                case PT_FIRSTLEVEL_MAPTYPE_COARSE:
+bool TranslationTable::TranslateWrite (VmAddr_t virt, PhysAddr_t & phys)
+{
+    size_t valid_len;
 
-                    dst_secondlevel_base = (pt_secondlevel_t *)P2V(
-                            dst_firstlevel_pte &
-                            PT_FIRSTLEVEL_COARSE_BASE_ADDR_MASK
-                            );
+    return Translate(virt, phys, valid_len, 1, true);
+}
 
-                    assert((VmAddr_t)dst_secondlevel_base != P2V((PhysAddr_t)NULL));
+ssize_t TranslationTable::CopyWithAddressSpaces (
+        TranslationTable *  source_tt,
+        const void *        source_buf,
+        size_t              source_len,
+        TranslationTable *  dest_tt,
+        void *              dest_buf,
+        size_t              dest_len
+        )
+{
+    size_t len;
 
-                    dst_secondlevel_pte = dst_secondlevel_base[(dst_cursor & ~MEGABYTE_MASK) >> PAGE_SHIFT];
+    len = MIN(source_len, dest_len);
 
-                    dst_phys = (dst_secondlevel_pte & PT_SECONDLEVEL_SMALL_PAGE_BASE_ADDR_MASK) + (dst_cursor & ~PAGE_MASK);
+    if (source_tt == dest_tt && false) {
+        /* Sender and receiver both in same address space. */
+        memcpy(dest_buf, source_buf, len);
+    }
+    else {
 
-                    dst_valid_len = PAGE_SIZE - (dst_cursor & ~PAGE_MASK);
+        size_t      remaining;
+        VmAddr_t    src_cursor  = (VmAddr_t)source_buf;
+        VmAddr_t    dst_cursor  = (VmAddr_t)dest_buf;
 
-                    dst_access = check_access(
-                            (dst_secondlevel_pte & PT_SECONDLEVEL_AP0_MASK) >> PT_SECONDLEVEL_AP0_SHIFT
-                            );
+        /*
+        Loop once for each contiguous chunk that can be copied from a
+        source-address-space page to a destination-address-space page.
+        */
+        for (remaining = len; remaining > 0;) {
 
-                    break;
+            PhysAddr_t  src_phys;
+            PhysAddr_t  dst_phys;
+            size_t      src_valid_len;
+            size_t      dst_valid_len;
 
-                default:
-                    dst_access = false;
-                    break;
+            /*
+            Each side's translation covers a physically contiguous run.
+            Whatever's left of the longer one isn't carried over to the
+            next chunk, since nothing stops its owner unmapping it in the
+            meantime; both are looked up afresh, which the translation
+            cache keeps cheap.
+            */
+            if (!source_tt->Translate(src_cursor, src_phys, src_valid_len,
+                                      remaining, false))
+            {
+                return -ERROR_FAULT;
             }
 
-            if (!src_access || !dst_access) {
+            if (!dest_tt->Translate(dst_cursor, dst_phys, dst_valid_len,
+                                    remaining, true))
+            {
                 return -ERROR_FAULT;
             }
 
@@ -791,9 +1438,9 @@ ssize_t TranslationTable::CopyWithAddressSpaces (
             */
             memcpy((void *)P2V(dst_phys), (void *)P2V(src_phys), chunk_size);
 
-            remaining   -= chunk_size;
-            src_cursor  += chunk_size;
-            dst_cursor  += chunk_size;
+            remaining       -= chunk_size;
+            src_cursor      += chunk_size;
+            dst_cursor      += chunk_size;
         }
     }
 
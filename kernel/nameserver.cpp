@@ -52,19 +52,23 @@ NameServer::RegisterName (char const aFullPath[],
     }
 
     if (ret) {
+        bool inserted = false;
+
         SpinlockLock(&sMapLock);
 
         if (sMap->Lookup(aFullPath) == NULL) {
-
             sMap->Insert(ret->mFullPath.c_str(), ret);
-
-            if (sMap->Lookup(ret->mFullPath.c_str()) != ret) {
-                delete ret;
-                ret = NULL;
-            }
+            inserted = sMap->Lookup(ret->mFullPath.c_str()) == ret;
         }
 
         SpinlockUnlock(&sMapLock);
+
+        // Somebody else has the name, possibly having just beaten
+        // us to it from another procmgr worker
+        if (!inserted) {
+            delete ret;
+            ret = NULL;
+        }
     }
 
     return ret;
@@ -75,24 +79,33 @@ void NameServer::UnregisterName (NameRecord * aProvider)
     Once(&sOnceControl, &NameServer::OnceInit, NULL);
 
     SpinlockLock(&sMapLock);
-    sMap->Remove(aProvider->mFullPath.c_str());
+
+    // A record that lost the race for its name mustn't take the
+    // winner's entry out with it
+    if (sMap->Lookup(aProvider->mFullPath.c_str()) == aProvider) {
+        sMap->Remove(aProvider->mFullPath.c_str());
+    }
+
     SpinlockUnlock(&sMapLock);
 }
 
 RefPtr<Channel> NameServer::LookupName (char const aFullPath[])
 {
     NameRecord * record;
+    RefPtr<Channel> channel;
 
     Once(&sOnceControl, &NameServer::OnceInit, NULL);
 
+    // Take the reference before letting go of the lock, in case the
+    // record is unregistered and freed in the meantime
     SpinlockLock(&sMapLock);
     record = sMap->Lookup(aFullPath);
-    SpinlockUnlock(&sMapLock);
 
     if (record) {
-        return record->mChannel;
-    }
-    else {
-        return RefPtr<Channel>();
+        channel = record->mChannel;
     }
+
+    SpinlockUnlock(&sMapLock);
+
+    return channel;
 }
@@ -8,6 +8,7 @@
 #include <muos/procmgr.h>
 
 #include <kernel/assert.h>
+#include <kernel/exception.hpp>
 #include <kernel/math.hpp>
 #include <kernel/minmax.hpp>
 #include <kernel/process.hpp>
@@ -17,6 +18,7 @@
 #include <kernel/thread.hpp>
 #include <kernel/timer.hpp>
 #include <kernel/tree-map.hpp>
+#include <kernel/vfp.hpp>
 
 /** Handed off between spawner and spawnee threads */
 struct process_creation_context
@@ -26,6 +28,39 @@ struct process_creation_context
     Process     * created;
     const char  * executableName;
     Semaphore   * baton;
+    struct SpawnAttributes const * attributes;
+};
+
+/**
+ * Threads taking messages off the Process Manager's channel, so that
+ * one process's slow request (spawning a large image, say) doesn't hold
+ * up everyone else's
+ */
+enum
+{
+    MANAGER_WORKERS = 4,
+};
+
+/** Sizing of the stack given to each process */
+enum
+{
+    /** Populated up front */
+    USER_STACK_INITIAL_LENGTH = PAGE_SIZE * 4,
+
+    /**
+     * Grown into on demand, unless the spawner asks for a different
+     * limit; past it the process is terminated
+     */
+    USER_STACK_DEFAULT_MAX_LENGTH = 256 * 1024,
+};
+
+/**
+ * Kernel memory charged for the thread each process runs on: the page
+ * that holds both its kernel stack and its Thread descriptor
+ */
+enum
+{
+    THREAD_CHARGE = PAGE_SIZE,
 };
 
 /** Allocates monotonically increasing process identifiers */
@@ -33,18 +68,24 @@ static Pid_t get_next_pid (void);
 
 SyncSlabAllocator<Process> Process::sSlab;
 
-Process::Process (char const aComm[], Process * aParent)
-    : mAddressSpace(new AddressSpace())
+Process::Process (char const aComm[],
+                  Process * aParent,
+                  bool aWithAddressSpace)
+    : mAddressSpace(aWithAddressSpace ? new AddressSpace() : NULL)
     , thread(NULL)
     , next_chid(FIRST_CHANNEL_ID)
     , next_coid(FIRST_CONNECTION_ID)
     , next_msgid(1)
     , next_interrupt_handler_id(1)
+    , next_timer_id(1)
     , next_child_wait_handler_id(1)
     , mParent(aParent)
+    , mTerminationReason(TERMINATION_NORMAL)
 {
     this->pid = get_next_pid();
 
+    memset(&mChildTimes, 0, sizeof(mChildTimes));
+
     /* Record our name */
     strncpy(comm, aComm, sizeof(comm));
 
@@ -54,9 +95,12 @@ Process::Process (char const aComm[], Process * aParent)
     this->id_to_connection_map = new IdToConnectionMap_t(IdToConnectionMap_t::SignedIntCompareFunc);
     this->id_to_message_map    = new IdToMessageMap_t(IdToMessageMap_t::SignedIntCompareFunc);
     this->id_to_interrupt_handler_map   = new IdToInterruptHandlerMap_t(IdToInterruptHandlerMap_t::SignedIntCompareFunc);
+    this->id_to_timer_map               = new IdToTimerMap_t(IdToTimerMap_t::SignedIntCompareFunc);
 
     if (aParent) {
+        sFamilyLock.Down();
         aParent->mAliveChildren.Append(this);
+        sFamilyLock.Up();
     }
 }
 
@@ -124,12 +168,34 @@ static void DisposeInterruptHandler (
     // be the one to drop the final reference
     RefPtr<UserInterruptHandler> deleter(handler);
     handler->Unref();
-    handler->Dispose();
 
+    // Detach first, so that an interrupt worker can't be picking up
+    // the connection as it's dropped
     InterruptDetachUserHandler(deleter);
+    handler->Dispose();
     deleter.Reset();
 }
 
+static void DisposeTimer (
+        RawTreeMap::Key_t key,
+        RawTreeMap::Value_t value,
+        void * ignored
+        )
+{
+    UserTimer * timer = static_cast<UserTimer *>(value);
+
+    // Same dance as for interrupt handlers
+    RefPtr<UserTimer> deleter(timer);
+    timer->Unref();
+    timer->Dispose();
+    deleter.Reset();
+}
+
+/*
+Called with sFamilyLock held by whoever's deleting a process that may
+still have children; a process that never got to make any is safe to
+delete without it.
+*/
 Process::~Process ()
 {
     assert(GetId() != PROCMGR_PID + 1);
@@ -173,6 +239,9 @@ Process::~Process ()
     /* Free and unregister all interrupt handlers installed by the process */
     this->id_to_interrupt_handler_map->Foreach (DisposeInterruptHandler, NULL);
 
+    /* Disarm and free all timers created by the process */
+    this->id_to_timer_map->Foreach (DisposeTimer, NULL);
+
     /* Free all the child-termination handlers on this process */
     while (!this->mReapers.Empty()) {
         RefPtr<Reaper> reaper = mReapers.PopFirst();
@@ -181,9 +250,12 @@ Process::~Process ()
 }
 
 Process * Process::execIntoCurrent (const char executableName[],
-                                    Process * aParent) throw (std::bad_alloc)
+                                    Process * aParent,
+                                    struct SpawnAttributes const * aAttributes) throw (std::bad_alloc)
 {
+    Process * spawner = THREAD_CURRENT()->process;
     Process * p;
+    size_t page_limit;
     RamFsBufferPtr image;
     size_t image_len;
     const Elf32_Ehdr * hdr;
@@ -215,9 +287,30 @@ Process * Process::execIntoCurrent (const char executableName[],
         return NULL;
     }
 
+    /*
+    A process can't hand out more memory than it's allowed itself, so
+    the spawner's limit (if any) caps whatever was asked for. Applied
+    before loading anything, so that the program image counts too.
+    */
+    page_limit = aParent && aParent->mAddressSpace
+            ? aParent->mAddressSpace->GetPageLimit()
+            : 0;
+
+    if (aAttributes && aAttributes->page_limit != 0 &&
+        (page_limit == 0 || aAttributes->page_limit < page_limit))
+    {
+        page_limit = aAttributes->page_limit;
+    }
+
+    p->mAddressSpace->SetPageLimit(page_limit);
+
     /* Record Pid */
     Process::Register(p->pid, p);
 
+    if (!p->mAddressSpace->ChargeKernelObject(THREAD_CHARGE)) {
+        goto free_process;
+    }
+
     /* Okay. Save reference to this process object into the current thread */
     p->thread = THREAD_CURRENT();
     THREAD_CURRENT()->process = p;
@@ -252,9 +345,8 @@ Process * Process::execIntoCurrent (const char executableName[],
                     base,
                     Math::RoundUp(length, PAGE_SIZE)))
             {
-                // Requested address conflicted withs something already
-                // there.
-                assert(false);
+                // Requested address conflicted with something already
+                // there, or the image doesn't fit under the memory limit
                 goto free_process;
             }
 
@@ -281,8 +373,16 @@ Process * Process::execIntoCurrent (const char executableName[],
     /* Make a stack */
     VmAddr_t stack_floor;
     size_t stack_length;
+    size_t stack_max_length;
+
+    stack_max_length = aAttributes && aAttributes->stack_size != 0
+            ? aAttributes->stack_size
+            : USER_STACK_DEFAULT_MAX_LENGTH;
 
-    if (!p->mAddressSpace->CreateStack(PAGE_SIZE * 4, stack_floor, stack_length)) {
+    if (!p->mAddressSpace->CreateStack(USER_STACK_INITIAL_LENGTH,
+                                       stack_max_length,
+                                       stack_floor,
+                                       stack_length)) {
         goto free_process;
     }
 
@@ -309,12 +409,26 @@ Process * Process::execIntoCurrent (const char executableName[],
     }
 
     assert(procmgr_coid == PROCMGR_CONNECTION_ID);
+
+    if (aAttributes) {
+        THREAD_CURRENT()->SetAssignedPriority(Thread::Priority(aAttributes->priority));
+    }
     
     return p;
 
 free_process:
 
-    assert(false);
+    /* Hand this thread back to the spawner's context before it exits */
+    THREAD_CURRENT()->process = spawner;
+    AtomicCompilerMemoryBarrier();
+    TranslationTable::SetUser(spawner ? spawner->GetTranslationTable() : NULL);
+
+    Process::Remove(p->pid);
+
+    sFamilyLock.Down();
+    List<Process, &Process::mChildrenLink>::Remove(p);
+    sFamilyLock.Up();
+
     delete p;
     return NULL;
 }
@@ -325,7 +439,9 @@ void Process::UserProcessThreadBody (void * pProcessCreationContext)
     Process * p;
 
     context  = (struct process_creation_context *)pProcessCreationContext;
-    context->created = p = Process::execIntoCurrent(context->executableName, context->parent);
+    context->created = p = Process::execIntoCurrent(context->executableName,
+                                                    context->parent,
+                                                    context->attributes);
 
     /* Release the spawner now that we have the resulting Process object */
     context->baton->Up();
@@ -385,7 +501,8 @@ void Process::UserProcessThreadBody (void * pProcessCreationContext)
 }
 
 Process * Process::Create (const char aExecutableName[],
-                           Process * aParent)
+                           Process * aParent,
+                           struct SpawnAttributes const * aAttributes)
 {
     struct process_creation_context context;
     Thread * t;
@@ -402,6 +519,7 @@ Process * Process::Create (const char aExecutableName[],
     context.created = NULL;
     context.executableName = aExecutableName;
     context.baton = &baton;
+    context.attributes = aAttributes;
 
     /* Resulting process object will be stored into context->created */
     t = Thread::Create(UserProcessThreadBody, &context);
@@ -417,15 +535,144 @@ Process * Process::Create (const char aExecutableName[],
     }
 }
 
+void Process::ForkedProcessThreadBody (void * pProcessCreationContext)
+{
+    struct process_creation_context * context;
+    Process * p;
+
+    context = (struct process_creation_context *)pProcessCreationContext;
+    p = context->created;
+
+    /* Okay. Save reference to this process object into the current thread */
+    p->thread = THREAD_CURRENT();
+    THREAD_CURRENT()->process = p;
+
+    /*
+    Resume from wherever the parent made its fork request. As far as the
+    child can tell, the request completed with nothing written into its
+    reply buffer.
+    */
+    memcpy(p->thread->u_reg, context->caller->u_reg, sizeof(p->thread->u_reg));
+    p->thread->u_reg[REGISTER_INDEX_R0] = ERROR_OK;
+    Vfp::Copy(context->caller, p->thread);
+
+    /* Same priority as the forker, not whatever it's been gifted */
+    THREAD_CURRENT()->SetAssignedPriority(context->caller->assigned_priority);
+
+    /* Record Pid */
+    Process::Register(p->pid, p);
+
+    /* Same reasoning as in execIntoCurrent() */
+    AtomicCompilerMemoryBarrier();
+
+    TranslationTable::SetUser(*p->mAddressSpace->GetPageTable());
+
+    /* Release the forker; the context is gone after this */
+    context->baton->Up();
+
+    ReturnToUser();
+
+    /* Unreachable */
+    assert(false);
+}
+
+Process * Process::Fork (Thread * aCaller)
+{
+    struct process_creation_context context;
+    Process * parent = aCaller->process;
+    Process * p;
+    Thread * t;
+
+    Semaphore baton(0);
+
+    try {
+        p = new Process(parent->GetName(), parent, false);
+    } catch (std::bad_alloc) {
+        return NULL;
+    }
+
+    p->mAddressSpace.Reset(parent->mAddressSpace->Clone());
+
+    if (!p->mAddressSpace ||
+        !p->mAddressSpace->ChargeKernelObject(THREAD_CHARGE))
+    {
+        goto free_process;
+    }
+
+    /*
+    Connection identifiers are handed out in increasing order, so
+    re-registering in that same order reproduces the parent's table.
+    Identifiers of connections that are already disposed of stay
+    vacant.
+    */
+    for (Connection_t id = FIRST_CONNECTION_ID; id < parent->next_coid; id++) {
+        RefPtr<Connection> connection = parent->LookupConnection(id);
+        RefPtr<Connection> copy;
+
+        if (!connection) {
+            continue;
+        }
+
+        try {
+            copy = connection->Duplicate();
+        } catch (std::bad_alloc) {
+            goto free_process;
+        }
+
+        if (!copy) {
+            continue;
+        }
+
+        p->next_coid = id;
+
+        if (p->RegisterConnection(copy) != id) {
+            copy->Dispose();
+            goto free_process;
+        }
+    }
+
+    p->next_coid = parent->next_coid;
+
+    context.caller = aCaller;
+    context.parent = parent;
+    context.created = p;
+    context.executableName = NULL;
+    context.baton = &baton;
+    context.attributes = NULL;
+
+    t = Thread::Create(ForkedProcessThreadBody, &context);
+
+    if (!t) {
+        goto free_process;
+    }
+
+    /* Forked thread will wake us back up once it's copied what it needs */
+    baton.Down();
+
+    return p;
+
+free_process:
+
+    sFamilyLock.Down();
+    List<Process, &Process::mChildrenLink>::Remove(p);
+    sFamilyLock.Up();
+
+    delete p;
+    return NULL;
+}
+
 static Pid_t get_next_pid ()
 {
     static Pid_t counter = PROCMGR_PID;
 
-    return counter++;
+    /* Processes are made by more than one procmgr worker at once */
+    return AtomicAddAndFetch(&counter, 1) - 1;
 }
 
 Spinlock_t Process::sPidMapSpinlock = SPINLOCK_INIT;
 
+Semaphore Process::sFamilyLock(1);
+
 Process::PidMap_t Process::sPidMap(
         Process::PidMap_t::SignedIntCompareFunc
         );
@@ -503,9 +750,6 @@ void Process::ManagerThreadBody (void * pProcessCreationContext)
     Process * p;
     RefPtr<Channel> channel;
 
-    MsgType                 msg;
-    RefPtr<Message>         m;
-
     caller_context = (struct process_creation_context *)pProcessCreationContext;
 
     /* Allocate the singular channel on which the Process Manager listens for messages */
@@ -520,8 +764,7 @@ void Process::ManagerThreadBody (void * pProcessCreationContext)
     }
 
     try {
-        caller_context->created = p = new Process("procmgr", NULL);
-        p->mAddressSpace.Reset();
+        caller_context->created = p = new Process("procmgr", NULL, false);
     } catch (std::bad_alloc a) {
         assert(false);
         return;
@@ -540,12 +783,41 @@ void Process::ManagerThreadBody (void * pProcessCreationContext)
     Channel_t chid = p->RegisterChannel(channel);
     assert(chid == FIRST_CHANNEL_ID);
 
-    /* Start periodic timer to use for pre-emption */
-    Timer::StartPeriodic(5);
-  
+    /* Start the timer used for timekeeping and pre-emption */
+    Timer::Start(5);
+
+    /* The rest of the workers, all receiving on the same channel */
+    for (unsigned int i = 1; i < MANAGER_WORKERS; i++) {
+        Thread * worker = Thread::Create(ManagerWorkerBody, p);
+        assert(worker != NULL);
+    }
+
     /* Release the spawner now that we have the resulting Process object */
     caller_context->baton->Up();
 
+    /* This thread is a worker like the others from here on */
+    ManagerWorkerBody(p);
+}
+
+void Process::ManagerWorkerBody (void * pManager)
+{
+    Process * p = (Process *)pManager;
+    RefPtr<Channel> channel = p->LookupChannel(FIRST_CHANNEL_ID);
+
+    MsgType                 msg;
+    RefPtr<Message>         m;
+
+    THREAD_CURRENT()->process = p;
+
+    /*
+    Everybody waits on the Process Manager sooner or later, drivers
+    included, and it reaps finished processes too; so nothing may keep
+    it off the CPU
+    */
+    Thread::BeginTransaction();
+    THREAD_CURRENT()->SetAssignedPriority(Thread::PRIORITY_SYSTEM);
+    Thread::EndTransaction();
+
     while (true) {
         size_t hdr_len = offsetof(struct ProcMgrMessage, type) + sizeof(msg.sync.type);
         size_t len = channel->ReceiveMessage(m, &msg, MAX(hdr_len, sizeof(struct Pulse)));
@@ -562,7 +834,10 @@ void Process::ManagerThreadBody (void * pProcessCreationContext)
             // amounts to making sure that its thread is finished
             // returning from the SendMessageAsync() call that injected
             // this message into our queue here.
+            // Lend it our priority, so that yielding to it actually
+            // lets it run even if it's lower than us.
             Thread::BeginTransaction();
+            terminee->GetThread()->SetEffectivePriority(THREAD_CURRENT()->effective_priority);
             while (terminee->GetThread()->GetState() != Thread::STATE_FINISHED) {
                 Thread::MakeReady(THREAD_CURRENT());
                 Thread::RunNextThread();
@@ -570,7 +845,7 @@ void Process::ManagerThreadBody (void * pProcessCreationContext)
             Thread::EndTransaction();
 
             // Notify its parent
-            terminee->GetParent()->ReportChildFinished(terminee);
+            terminee->ReportFinished();
         }
         else if (len >= hdr_len) {
 
@@ -607,6 +882,7 @@ Process * Process::StartManager ()
     context.created = NULL;
     context.executableName = NULL;
     context.baton = &baton;
+    context.attributes = NULL;
 
     /* Resulting process object will be stored into context->created */
     Thread::Create(ManagerThreadBody, &context);
@@ -626,6 +902,18 @@ Process * Process::GetManager ()
     return managerProcess;
 }
 
+bool Process::ChargeKernelObject (size_t aBytes)
+{
+    return !this->mAddressSpace || this->mAddressSpace->ChargeKernelObject(aBytes);
+}
+
+void Process::UnchargeKernelObject (size_t aBytes)
+{
+    if (this->mAddressSpace) {
+        this->mAddressSpace->UnchargeKernelObject(aBytes);
+    }
+}
+
 Channel_t Process::RegisterChannel (RefPtr<Channel> c)
 {
     Channel_t id = this->next_chid++;
@@ -635,12 +923,17 @@ Channel_t Process::RegisterChannel (RefPtr<Channel> c)
         return -ERROR_INVALID;
     }
 
+    if (!ChargeKernelObject(sizeof(Channel))) {
+        return -ERROR_NO_MEM;
+    }
+
     this->id_to_channel_map->Insert(id, *c);
 
     if (this->id_to_channel_map->Lookup(id) == *c) {
         c->Ref();
         return id;
     } else {
+        UnchargeKernelObject(sizeof(Channel));
         return -ERROR_NO_MEM;
     }
 }
@@ -653,6 +946,8 @@ int Process::UnregisterChannel (Channel_t id)
         return -ERROR_INVALID;
     }
 
+    UnchargeKernelObject(sizeof(Channel));
+
     RefPtr<Channel> deleter(c);
     c->Unref();
     deleter.Reset();
@@ -682,12 +977,17 @@ Connection_t Process::RegisterConnection (RefPtr<Connection> c)
         return -ERROR_INVALID;
     }
 
+    if (!ChargeKernelObject(sizeof(Connection))) {
+        return -ERROR_NO_MEM;
+    }
+
     this->id_to_connection_map->Insert(id, *c);
 
     if (this->id_to_connection_map->Lookup(id) == *c) {
         c->Ref();
         return id;
     } else {
+        UnchargeKernelObject(sizeof(Connection));
         return -ERROR_NO_MEM;
     }
 }
@@ -700,6 +1000,8 @@ int Process::UnregisterConnection (Connection_t id)
         return -ERROR_INVALID;
     }
 
+    UnchargeKernelObject(sizeof(Connection));
+
     RefPtr<Connection> deleter(c);
     c->Unref();
     deleter.Reset();
@@ -778,12 +1080,17 @@ int Process::RegisterInterruptHandler (RefPtr<UserInterruptHandler> h)
         return -ERROR_INVALID;
     }
 
+    if (!ChargeKernelObject(sizeof(UserInterruptHandler))) {
+        return -ERROR_NO_MEM;
+    }
+
     this->id_to_interrupt_handler_map->Insert(handler_id, *h);
 
     if (this->id_to_interrupt_handler_map->Lookup(handler_id) == *h) {
         h->Ref();
         return handler_id;
     } else {
+        UnchargeKernelObject(sizeof(UserInterruptHandler));
         return -ERROR_NO_MEM;
     }
 }
@@ -796,6 +1103,8 @@ int Process::UnregisterInterruptHandler (int handler_id)
         return -ERROR_INVALID;
     }
 
+    UnchargeKernelObject(sizeof(UserInterruptHandler));
+
     RefPtr<UserInterruptHandler> deleter(h);
     h->Unref();
     deleter.Reset();
@@ -816,8 +1125,69 @@ RefPtr<UserInterruptHandler> Process::LookupInterruptHandler (int handler_id)
     return RefPtr<UserInterruptHandler>(ret);
 }
 
+int Process::RegisterTimer (RefPtr<UserTimer> t)
+{
+    int timer_id = this->next_timer_id++;
+
+    if (this->id_to_timer_map->Lookup(timer_id) != NULL) {
+        assert(false);
+        return -ERROR_INVALID;
+    }
+
+    if (!ChargeKernelObject(sizeof(UserTimer))) {
+        return -ERROR_NO_MEM;
+    }
+
+    this->id_to_timer_map->Insert(timer_id, *t);
+
+    if (this->id_to_timer_map->Lookup(timer_id) == *t) {
+        t->Ref();
+        return timer_id;
+    } else {
+        UnchargeKernelObject(sizeof(UserTimer));
+        return -ERROR_NO_MEM;
+    }
+}
+
+int Process::UnregisterTimer (int timer_id)
+{
+    UserTimer * t = this->id_to_timer_map->Remove(timer_id);
+
+    if (!t) {
+        return -ERROR_INVALID;
+    }
+
+    UnchargeKernelObject(sizeof(UserTimer));
+
+    RefPtr<UserTimer> deleter(t);
+    t->Unref();
+    t->Dispose();
+    deleter.Reset();
+
+    return ERROR_OK;
+}
+
+RefPtr<UserTimer> Process::LookupTimer (int timer_id)
+{
+    RefPtr<UserTimer> ret;
+
+    UserTimer * value = this->id_to_timer_map->Lookup(timer_id);
+
+    if (value) {
+        ret.Reset(value);
+    }
+
+    return ret;
+}
+
 int Process::RegisterReaper (RefPtr<Reaper> aReaper)
 {
+    if (!ChargeKernelObject(sizeof(Reaper))) {
+        return -ERROR_NO_MEM;
+    }
+
+    sFamilyLock.Down();
+
     int handler_id = this->next_child_wait_handler_id++;
 
     aReaper->mId = handler_id;
@@ -826,7 +1196,9 @@ int Process::RegisterReaper (RefPtr<Reaper> aReaper)
 
     TryReapChildren(aReaper);
 
-    return aReaper->mId;
+    sFamilyLock.Up();
+
+    return handler_id;
 }
 
 int Process::UnregisterReaper (int handler_id)
@@ -834,7 +1206,10 @@ int Process::UnregisterReaper (int handler_id)
     RefPtr<Reaper> r = LookupReaper(handler_id);
 
     if (r) {
+        sFamilyLock.Down();
         mReapers.Remove(r);
+        sFamilyLock.Up();
+        UnchargeKernelObject(sizeof(Reaper));
         return ERROR_OK;
     }
     else {
@@ -845,14 +1220,36 @@ int Process::UnregisterReaper (int handler_id)
 RefPtr<Reaper> Process::LookupReaper (int handler_id)
 {
     typedef RefList<Reaper, &Reaper::mLink> List_t;
+    RefPtr<Reaper> ret;
+
+    sFamilyLock.Down();
 
     for (List_t::Iterator i = mReapers.Begin(); i; ++i) {
         if (i->mId == handler_id) {
-            return *i;
+            ret = *i;
+            break;
         }
     }
 
-    return RefPtr<Reaper>();
+    sFamilyLock.Up();
+
+    return ret;
+}
+
+int Process::ArmReaper (int handler_id, unsigned int count)
+{
+    RefPtr<Reaper> r = LookupReaper(handler_id);
+
+    if (!r) {
+        return -ERROR_INVALID;
+    }
+
+    sFamilyLock.Down();
+    r->mCount += count;
+    TryReapChildren(r);
+    sFamilyLock.Up();
+
+    return ERROR_OK;
 }
 
 char const * Process::GetName ()
@@ -892,10 +1289,34 @@ void Process::TryReapChildren (RefPtr<Reaper> aReaper)
     }
 }
 
+static void add_times (struct ProcessTimes * aSum,
+                       struct ProcessTimes const * aTimes)
+{
+    aSum->run_ns += aTimes->run_ns;
+    aSum->voluntary_switches += aTimes->voluntary_switches;
+    aSum->involuntary_switches += aTimes->involuntary_switches;
+}
+
 void Process::ReapChild (Process * aChild, RefPtr<Connection> aConnection)
 {
     Pid_t child_pid = aChild->GetId();
     Thread * thread = aChild->GetThread();
+    int8_t pulse_type;
+
+    switch (aChild->GetTerminationReason()) {
+        case TERMINATION_STACK_OVERFLOW:
+            pulse_type = PULSE_TYPE_CHILD_STACK_OVERFLOW;
+            break;
+        default:
+            pulse_type = PULSE_TYPE_CHILD_FINISH;
+            break;
+    }
+
+    /* Last chance to see the child's usage, while its thread's still around */
+    struct ProcessTimes times;
+    aChild->GetTimes(&times);
+    add_times(&mChildTimes, &times);
+    add_times(&mChildTimes, &aChild->mChildTimes);
 
     Remove(child_pid);
     mDeadChildren.Remove(aChild);
@@ -904,23 +1325,75 @@ void Process::ReapChild (Process * aChild, RefPtr<Connection> aConnection)
     thread->process = NULL;
     thread->Join();
 
-    aConnection->SendMessageAsync(PULSE_TYPE_CHILD_FINISH, child_pid);
+    aConnection->SendMessageAsync(pulse_type, child_pid);
 }
 
-void Process::ReportChildFinished (Process * aChild)
+void Process::SetTerminationReason (TerminationReason aReason)
 {
-    Pid_t child_pid = aChild->GetId();
+    if (mTerminationReason == TERMINATION_NORMAL) {
+        mTerminationReason = aReason;
+    }
+}
+
+Process::TerminationReason Process::GetTerminationReason ()
+{
+    return mTerminationReason;
+}
+
+void Process::GetTimes (struct ProcessTimes * aTimes)
+{
+    /* Counters only change under the scheduler lock */
+    Thread::BeginTransaction();
+    aTimes->run_ns = thread->run_time * 1000;
+    aTimes->voluntary_switches = thread->voluntary_switches;
+    aTimes->involuntary_switches = thread->involuntary_switches;
+    Thread::EndTransaction();
+}
+
+bool Process::GetTimesOf (Pid_t aPid, struct ProcessTimes * aTimes)
+{
+    // Reaping, which deletes the process, happens under this lock
+    sFamilyLock.Down();
+
+    Process * p = Lookup(aPid);
+
+    if (p) {
+        p->GetTimes(aTimes);
+    }
+
+    sFamilyLock.Up();
+
+    return p != NULL;
+}
+
+void Process::GetChildTimes (struct ProcessTimes * aTimes)
+{
+    sFamilyLock.Down();
+    *aTimes = mChildTimes;
+    sFamilyLock.Up();
+}
+
+void Process::ReportFinished ()
+{
+    Pid_t pid = GetId();
+
+    sFamilyLock.Down();
+
+    // Read under the lock, since the parent may be finishing too and
+    // handing its children over to init
+    Process * parent = mParent;
 
-    mAliveChildren.Remove(aChild);
-    mDeadChildren.Append(aChild);
+    parent->mAliveChildren.Remove(this);
+    parent->mDeadChildren.Append(this);
 
-    RefPtr<Reaper> handler = GetReaperForChild(child_pid);
+    RefPtr<Reaper> handler = parent->GetReaperForChild(pid);
 
-    if (handler && handler->Handles(child_pid) && handler->mCount > 0) {
+    if (handler && handler->Handles(pid) && handler->mCount > 0) {
         handler->mCount--;
-        ReapChild(aChild, handler->mConnection);
+        parent->ReapChild(this, handler->mConnection);
     }
 
+    sFamilyLock.Up();
 }
 
 /**
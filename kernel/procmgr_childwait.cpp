@@ -44,8 +44,6 @@ void HandleInstallWait (RefPtr<Message> message)
         return;
     }
 
-    process->TryReapChildren(handler);
-
     message->Reply(ERROR_OK, &reply, sizeof(reply));
 }
 
@@ -80,16 +78,14 @@ void HandleAddWaitCount (RefPtr<Message> message)
         return;
     }
 
-    RefPtr<Reaper> handler = process->LookupReaper(msg.payload.child_wait_arm.handler_id);
+    n = process->ArmReaper(msg.payload.child_wait_arm.handler_id,
+                           msg.payload.child_wait_arm.count);
 
-    if (!handler) {
+    if (n != ERROR_OK) {
         message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
         return;
     }
 
-    handler->mCount += msg.payload.child_wait_arm.count;
-    process->TryReapChildren(handler);
-
     message->Reply(ERROR_OK, &reply, sizeof(reply));
 }
 
@@ -0,0 +1,27 @@
+#include <muos/error.h>
+#include <muos/procmgr.h>
+
+#include <kernel/message.hpp>
+#include <kernel/process.hpp>
+#include <kernel/procmgr.hpp>
+#include <kernel/thread.hpp>
+
+static void HandleFork (RefPtr<Message> message)
+{
+    struct ProcMgrReply reply;
+    Process * child;
+
+    // Sender stays reply-blocked until this returns, so its registers
+    // are safe for the child to copy
+    child = Process::Fork(message->GetSender());
+
+    if (!child) {
+        message->Reply(ERROR_NO_MEM, IoBuffer::GetEmpty());
+        return;
+    }
+
+    reply.payload.fork.pid = child->GetId();
+    message->Reply(ERROR_OK, &reply, sizeof(reply));
+}
+
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_FORK, HandleFork)
@@ -1,6 +1,7 @@
 #include <muos/procmgr.h>
 
 #include <kernel/assert.h>
+#include <kernel/cpu.hpp>
 #include <kernel/interrupt-handler.hpp>
 #include <kernel/message.hpp>
 #include <kernel/process.hpp>
@@ -59,10 +60,18 @@ static void HandleInterruptAttach (RefPtr<Message> message)
     handler->mHandlerInfo.mConnection = connection;
     handler->mHandlerInfo.mPulsePayload = (uintptr_t)msg.payload.interrupt_attach.param;
 
-    InterruptAttachUserHandler(handler);
-
     // Elevate scheduling priority to reflect interrupt handling
-    sender->assigned_priority = Thread::PRIORITY_IO;
+    if (sender->assigned_priority < Thread::PRIORITY_IO) {
+        Thread::BeginTransaction();
+        sender->SetAssignedPriority(Thread::PRIORITY_IO);
+        Thread::EndTransaction();
+    }
+
+    // Pulses are sent from the worker at the handler's own priority,
+    // so a busy lower-priority driver can't hold them up
+    handler->mHandlerInfo.mPriority = sender->assigned_priority;
+
+    InterruptAttachUserHandler(handler);
 
     message->Reply(ERROR_OK, &reply, sizeof(reply));
 }
@@ -122,3 +131,22 @@ static void HandleInterruptDetach (RefPtr<Message> message)
 }
 
 PROC_MGR_OPERATION(PROC_MGR_MESSAGE_INTERRUPT_DETACH, HandleInterruptDetach)
+
+static void HandleInterruptCount (RefPtr<Message> message)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+
+    ssize_t msg_len = PROC_MGR_MSG_LEN(interrupt_count);
+    ssize_t len = message->Read(0, &msg, msg_len);
+
+    if (msg_len != len || !Cpu::IsOnline(msg.payload.interrupt_count.cpu)) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    reply.payload.interrupt_count.count = InterruptGetCount(msg.payload.interrupt_count.cpu);
+    message->Reply(ERROR_OK, &reply, sizeof(reply));
+}
+
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_INTERRUPT_COUNT, HandleInterruptCount)
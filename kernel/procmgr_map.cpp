@@ -45,6 +45,7 @@ static void HandleMapPhys (RefPtr<Message> message)
     struct ProcMgrReply reply;
     PhysAddr_t          phys;
     size_t              len_to_map;
+    CacheAttr_t         attr;
     VmAddr_t            virt;
 
     ssize_t msg_len = PROC_MGR_MSG_LEN(map_phys);
@@ -57,15 +58,29 @@ static void HandleMapPhys (RefPtr<Message> message)
 
     phys = msg.payload.map_phys.physaddr;
     len_to_map = msg.payload.map_phys.len;
+    attr = msg.payload.map_phys.attr;
 
     if ((phys % PAGE_SIZE != 0) || (len_to_map < 0)) {
         message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
         return;
     }
 
+    switch (attr) {
+        case CACHE_ATTR_STRONGLY_ORDERED:
+        case CACHE_ATTR_DEVICE:
+        case CACHE_ATTR_WRITE_COMBINING:
+            break;
+
+        default:
+            message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+            return;
+    }
+
     AddressSpace * addressSpace = message->GetSender()->process->GetAddressSpace();
 
-    if (!addressSpace->CreatePhysicalMapping(phys, len_to_map, virt)) {
+    if (!addressSpace->CreatePhysicalMapping(phys, len_to_map, virt,
+                                             PROT_USER_READWRITE, attr))
+    {
         message->Reply(ERROR_NO_MEM, IoBuffer::GetEmpty());
     }
     else {
@@ -75,3 +90,35 @@ static void HandleMapPhys (RefPtr<Message> message)
 }
 
 PROC_MGR_OPERATION(PROC_MGR_MESSAGE_MAP_PHYS, HandleMapPhys)
+
+static void HandleUnmap (RefPtr<Message> message)
+{
+    struct ProcMgrMessage   msg;
+    struct ProcMgrReply reply;
+
+    ssize_t msg_len = PROC_MGR_MSG_LEN(unmap);
+    ssize_t actual_len = message->Read(0, &msg, msg_len);
+
+    if (actual_len != msg_len) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    if ((msg.payload.unmap.vmaddr % PAGE_SIZE != 0) ||
+        (msg.payload.unmap.len % PAGE_SIZE != 0))
+    {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    AddressSpace * addressSpace = message->GetSender()->process->GetAddressSpace();
+
+    if (!addressSpace->Unmap(msg.payload.unmap.vmaddr, msg.payload.unmap.len)) {
+        message->Reply(ERROR_NO_MEM, IoBuffer::GetEmpty());
+    }
+    else {
+        message->Reply(ERROR_OK, &reply, sizeof(reply));
+    }
+}
+
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_UNMAP, HandleUnmap)
@@ -0,0 +1,28 @@
+#include <string.h>
+
+#include <muos/error.h>
+#include <muos/procmgr.h>
+
+#include <kernel/address-space.hpp>
+#include <kernel/message.hpp>
+#include <kernel/process.hpp>
+#include <kernel/procmgr.hpp>
+#include <kernel/vm.hpp>
+
+static void HandleGetMemoryStats (RefPtr<Message> message)
+{
+    struct ProcMgrReply reply;
+    AddressSpace * addressSpace = message->GetSender()->process->GetAddressSpace();
+    struct MemoryStats & stats = reply.payload.get_memory_stats.stats;
+
+    memset(&reply, 0, sizeof(reply));
+
+    stats.free_pages = Page::GetFreeCount();
+    stats.total_pages = Page::GetTotalCount();
+    stats.committed_pages = addressSpace->GetCommittedPages();
+    stats.secondlevel_tables = addressSpace->GetPageTable()->GetSecondlevelTableCount();
+
+    message->Reply(ERROR_OK, &reply, sizeof(reply));
+}
+
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_GET_MEMORY_STATS, HandleGetMemoryStats)
@@ -116,7 +116,6 @@ static void HandleNameOpen (RefPtr<Message> message)
     }
 
     connection_id = message->GetSender()->process->RegisterConnection(connection);
-    assert(connection == message->GetSender()->process->LookupConnection(connection_id));
     reply.payload.name_open.connection_id = connection_id;
     status = ERROR_OK;
 
@@ -0,0 +1,49 @@
+#include <muos/error.h>
+#include <muos/procmgr.h>
+
+#include <kernel/message.hpp>
+#include <kernel/process.hpp>
+#include <kernel/procmgr.hpp>
+#include <kernel/thread.hpp>
+
+static void HandleSetPriority (RefPtr<Message> message)
+{
+    struct ProcMgrMessage msg;
+    Thread * sender = message->GetSender();
+
+    ssize_t msg_len = PROC_MGR_MSG_LEN(set_priority);
+    ssize_t len = message->Read(0, &msg, msg_len);
+
+    if (len != msg_len) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    if (msg.payload.set_priority.priority < Thread::PRIORITY_MIN ||
+        msg.payload.set_priority.priority > Thread::PRIORITY_USER_MAX)
+    {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    // Sender is reply-blocked, so it's not on any ready queue; the new
+    // level is used from the time the reply makes it ready again
+    Thread::BeginTransaction();
+    sender->SetAssignedPriority(Thread::Priority(msg.payload.set_priority.priority));
+    Thread::EndTransaction();
+
+    message->Reply(ERROR_OK, IoBuffer::GetEmpty());
+}
+
+static void HandleGetPriority (RefPtr<Message> message)
+{
+    struct ProcMgrReply reply;
+    Thread * sender = message->GetSender();
+
+    memset(&reply, 0, sizeof(reply));
+    reply.payload.get_priority.priority = sender->assigned_priority;
+    message->Reply(ERROR_OK, &reply, sizeof(reply));
+}
+
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_SET_PRIORITY, HandleSetPriority)
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_GET_PRIORITY, HandleGetPriority)
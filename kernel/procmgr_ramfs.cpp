@@ -0,0 +1,85 @@
+#include <muos/arch.h>
+#include <muos/error.h>
+#include <muos/procmgr.h>
+
+#include <kernel/address-space.hpp>
+#include <kernel/kmalloc.h>
+#include <kernel/math.hpp>
+#include <kernel/message.hpp>
+#include <kernel/process.hpp>
+#include <kernel/procmgr.hpp>
+#include <kernel/ramfs.h>
+#include <kernel/thread.hpp>
+#include <kernel/vm.hpp>
+
+static void HandleRamFsMap (RefPtr<Message> message)
+{
+    struct ProcMgrReply reply;
+    size_t path_len;
+    char * path;
+    RamFsBufferPtr image;
+    size_t image_len;
+    VmAddr_t virt;
+    size_t n;
+    int status;
+
+    n = message->Read(offsetof(struct ProcMgrMessage, payload.ramfs_map.path_len),
+                      &path_len,
+                      sizeof(path_len));
+
+    if (n != sizeof(path_len) || path_len == 0) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    path = (char *)kmalloc(path_len);
+
+    if (!path) {
+        message->Reply(ERROR_NO_MEM, IoBuffer::GetEmpty());
+        return;
+    }
+
+    n = message->Read(offsetof(struct ProcMgrMessage, payload.ramfs_map.path),
+                      path,
+                      path_len);
+
+    if (n != path_len) {
+        status = ERROR_INVALID;
+        goto cleanup;
+    }
+
+    path[path_len - 1] = '\0';
+
+    if (!RamFsGetImage(path, &image, &image_len) || image_len == 0) {
+        status = ERROR_INVALID;
+        goto cleanup;
+    }
+
+    // The file stays part of the kernel image, so hand out its pages
+    // directly. Read-only, so that no process can write into the
+    // copy that everybody else sees. The tail of the last page is
+    // padding or the start of the next record, since the linker script
+    // pads the image out to a page boundary; none of it is kernel data.
+    assert((VmAddr_t)image % PAGE_SIZE == 0);
+
+    if (!message->GetSender()->process->GetAddressSpace()->CreatePhysicalMapping(
+            V2P((VmAddr_t)image),
+            Math::RoundUp(image_len, PAGE_SIZE),
+            virt,
+            PROT_USER_READONLY))
+    {
+        status = ERROR_NO_MEM;
+        goto cleanup;
+    }
+
+    reply.payload.ramfs_map.vmaddr = virt;
+    reply.payload.ramfs_map.len = image_len;
+    status = ERROR_OK;
+
+cleanup:
+    kfree(path, path_len);
+
+    message->Reply(status, &reply, sizeof(reply));
+}
+
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_RAMFS_MAP, HandleRamFsMap)
@@ -28,7 +28,13 @@ void HandleSbrk (RefPtr<Message> message)
 
     AddressSpace * addressSpace = message->GetSender()->process->GetAddressSpace();
 
-    if (addressSpace->ExtendHeap(msg.payload.sbrk.increment, prev, next))
+    // Negated as unsigned, since the most negative increment has no
+    // positive counterpart. It's bigger than any heap can be anyway.
+    bool success = msg.payload.sbrk.increment < 0
+            ? addressSpace->ShrinkHeap(0 - size_t(msg.payload.sbrk.increment), prev, next)
+            : addressSpace->ExtendHeap(msg.payload.sbrk.increment, prev, next);
+
+    if (success)
     {
         reply.payload.sbrk.previous = prev;
         message->Reply(ERROR_OK, &reply, sizeof(reply));
@@ -0,0 +1,171 @@
+#include <muos/arch.h>
+#include <muos/error.h>
+#include <muos/procmgr.h>
+
+#include <kernel/address-space.hpp>
+#include <kernel/kmalloc.h>
+#include <kernel/math.hpp>
+#include <kernel/message.hpp>
+#include <kernel/process.hpp>
+#include <kernel/procmgr.hpp>
+#include <kernel/shared-memory.hpp>
+#include <kernel/thread.hpp>
+
+/**
+ * Pull a client-supplied, length-prefixed pathname out of a message.
+ *
+ * @return  a null-terminated string that must be released with
+ *          <tt>kfree(path, path_len)</tt>, or NULL on failure
+ */
+static char * ReadPath (RefPtr<Message> message,
+                        size_t len_offset,
+                        size_t path_offset,
+                        size_t & path_len)
+{
+    char * path;
+    size_t n;
+
+    n = message->Read(len_offset, &path_len, sizeof(path_len));
+
+    if (n != sizeof(path_len) || path_len == 0) {
+        return NULL;
+    }
+
+    path = (char *)kmalloc(path_len);
+
+    if (!path) {
+        return NULL;
+    }
+
+    n = message->Read(path_offset, path, path_len);
+
+    if (n != path_len) {
+        kfree(path, path_len);
+        return NULL;
+    }
+
+    path[path_len - 1] = '\0';
+    return path;
+}
+
+static void HandleShmCreate (RefPtr<Message> message)
+{
+    struct ProcMgrReply reply;
+    size_t len;
+    size_t path_len;
+    char * path;
+    size_t n;
+    RefPtr<VmArea> area;
+    VmAddr_t virt;
+    int status;
+
+    n = message->Read(offsetof(struct ProcMgrMessage,
+                               payload.shm_create.len),
+                      &len,
+                      sizeof(len));
+
+    if (n != sizeof(len) || len == 0) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    path = ReadPath(message,
+                    offsetof(struct ProcMgrMessage, payload.shm_create.path_len),
+                    offsetof(struct ProcMgrMessage, payload.shm_create.path),
+                    path_len);
+
+    if (!path) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    area = SharedMemoryRegistry::Create(path, Math::RoundUp(len, PAGE_SIZE));
+
+    if (!area) {
+        status = ERROR_NO_MEM;
+        goto cleanup;
+    }
+
+    if (!message->GetSender()->process->GetAddressSpace()->CreateSharedMapping(area, virt)) {
+        SharedMemoryRegistry::Unlink(path);
+        status = ERROR_NO_MEM;
+        goto cleanup;
+    }
+
+    reply.payload.shm_create.vmaddr = virt;
+    status = ERROR_OK;
+
+cleanup:
+    kfree(path, path_len);
+
+    message->Reply(status, &reply, sizeof(reply));
+}
+
+static void HandleShmOpen (RefPtr<Message> message)
+{
+    struct ProcMgrReply reply;
+    size_t path_len;
+    char * path;
+    RefPtr<VmArea> area;
+    VmAddr_t virt;
+    int status;
+
+    path = ReadPath(message,
+                    offsetof(struct ProcMgrMessage, payload.shm_open.path_len),
+                    offsetof(struct ProcMgrMessage, payload.shm_open.path),
+                    path_len);
+
+    if (!path) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    area = SharedMemoryRegistry::Lookup(path);
+
+    if (!area) {
+        status = ERROR_INVALID;
+        goto cleanup;
+    }
+
+    if (!message->GetSender()->process->GetAddressSpace()->CreateSharedMapping(area, virt)) {
+        status = ERROR_NO_MEM;
+        goto cleanup;
+    }
+
+    reply.payload.shm_open.vmaddr = virt;
+    reply.payload.shm_open.len = area->GetPageCount() * PAGE_SIZE;
+    status = ERROR_OK;
+
+cleanup:
+    kfree(path, path_len);
+
+    message->Reply(status, &reply, sizeof(reply));
+}
+
+static void HandleShmUnlink (RefPtr<Message> message)
+{
+    struct ProcMgrReply reply;
+    size_t path_len;
+    char * path;
+    int status;
+
+    path = ReadPath(message,
+                    offsetof(struct ProcMgrMessage, payload.shm_unlink.path_len),
+                    offsetof(struct ProcMgrMessage, payload.shm_unlink.path),
+                    path_len);
+
+    if (!path) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    status = SharedMemoryRegistry::Unlink(path) ? ERROR_OK : ERROR_INVALID;
+
+    kfree(path, path_len);
+
+    message->Reply(status, &reply, sizeof(reply));
+}
+
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_SHM_CREATE, HandleShmCreate)
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_SHM_OPEN, HandleShmOpen)
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_SHM_UNLINK, HandleShmUnlink)
@@ -1,9 +1,11 @@
 #include <kernel/kmalloc.h>
 #include <kernel/process.hpp>
 #include <kernel/procmgr.hpp>
+#include <kernel/thread.hpp>
 
 static void HandleSpawn (RefPtr<Message> message)
 {
+    struct SpawnAttributes attributes;
     size_t path_len;
     char * path;
     ProcMgrReply reply;
@@ -11,6 +13,18 @@ static void HandleSpawn (RefPtr<Message> message)
     size_t n;
     Process * p;
 
+    n = message->Read(offsetof(struct ProcMgrMessage, payload.spawn.attributes),
+                      &attributes,
+                      sizeof(attributes));
+
+    if (n != sizeof(attributes) ||
+        attributes.priority < Thread::PRIORITY_MIN ||
+        attributes.priority > Thread::PRIORITY_USER_MAX)
+    {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
     message->Read(offsetof(struct ProcMgrMessage, payload.spawn.path_len),
                   &path_len,
                   sizeof(path_len));
@@ -31,7 +45,7 @@ static void HandleSpawn (RefPtr<Message> message)
         goto cleanup;
     }
 
-    p = Process::Create(path, message->GetSender()->process);
+    p = Process::Create(path, message->GetSender()->process, &attributes);
 
     if (!p) {
         ret = ERROR_INVALID;
@@ -0,0 +1,105 @@
+#include <muos/error.h>
+#include <muos/procmgr.h>
+
+#include <kernel/message.hpp>
+#include <kernel/process.hpp>
+#include <kernel/procmgr.hpp>
+#include <kernel/timer.hpp>
+#include <kernel/user-timer.hpp>
+
+static void HandleTimerCreate (RefPtr<Message> message)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+    RefPtr<Connection> connection;
+    RefPtr<UserTimer> timer;
+    Process * process = message->GetSender()->process;
+
+    ssize_t msg_len = PROC_MGR_MSG_LEN(timer_create);
+    ssize_t len = message->Read(0, &msg, msg_len);
+
+    if (len != msg_len) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    connection = process->LookupConnection(msg.payload.timer_create.connection_id);
+
+    if (!connection) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    try {
+        timer.Reset(new UserTimer(connection, msg.payload.timer_create.value));
+    } catch (std::bad_alloc) {
+        message->Reply(ERROR_NO_MEM, IoBuffer::GetEmpty());
+        return;
+    }
+
+    reply.payload.timer_create.timer_id = process->RegisterTimer(timer);
+
+    if (reply.payload.timer_create.timer_id < 0) {
+        message->Reply(-reply.payload.timer_create.timer_id, IoBuffer::GetEmpty());
+        return;
+    }
+
+    message->Reply(ERROR_OK, &reply, sizeof(reply));
+}
+
+static void HandleTimerArm (RefPtr<Message> message)
+{
+    struct ProcMgrMessage msg;
+    RefPtr<UserTimer> timer;
+    Process * process = message->GetSender()->process;
+
+    ssize_t msg_len = PROC_MGR_MSG_LEN(timer_arm);
+    ssize_t len = message->Read(0, &msg, msg_len);
+
+    if (len != msg_len) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    timer = process->LookupTimer(msg.payload.timer_arm.timer_id);
+
+    if (!timer) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    if (msg.payload.timer_arm.delay_ns == 0) {
+        Timer::Disarm(*timer);
+    }
+    else {
+        // Rounded up, so as never to fire early
+        Timer::Arm(*timer,
+                   (msg.payload.timer_arm.delay_ns + 999) / 1000,
+                   (msg.payload.timer_arm.interval_ns + 999) / 1000);
+    }
+
+    message->Reply(ERROR_OK, IoBuffer::GetEmpty());
+}
+
+static void HandleTimerDestroy (RefPtr<Message> message)
+{
+    struct ProcMgrMessage msg;
+    Process * process = message->GetSender()->process;
+    int ret;
+
+    ssize_t msg_len = PROC_MGR_MSG_LEN(timer_destroy);
+    ssize_t len = message->Read(0, &msg, msg_len);
+
+    if (len != msg_len) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    ret = process->UnregisterTimer(msg.payload.timer_destroy.timer_id);
+
+    message->Reply(ret == ERROR_OK ? ERROR_OK : -ret, IoBuffer::GetEmpty());
+}
+
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_TIMER_CREATE, HandleTimerCreate)
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_TIMER_ARM, HandleTimerArm)
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_TIMER_DESTROY, HandleTimerDestroy)
@@ -0,0 +1,42 @@
+#include <string.h>
+
+#include <muos/error.h>
+#include <muos/procmgr.h>
+
+#include <kernel/message.hpp>
+#include <kernel/process.hpp>
+#include <kernel/procmgr.hpp>
+
+static void HandleGetTimes (RefPtr<Message> message)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+    Process * sender = message->GetSender()->process;
+
+    ssize_t msg_len = PROC_MGR_MSG_LEN(get_times);
+    ssize_t len = message->Read(0, &msg, msg_len);
+
+    if (len != msg_len) {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    memset(&reply, 0, sizeof(reply));
+
+    if (msg.payload.get_times.children) {
+        sender->GetChildTimes(&reply.payload.get_times.times);
+    }
+    else if (msg.payload.get_times.pid == SELF_PID) {
+        sender->GetTimes(&reply.payload.get_times.times);
+    }
+    else if (!Process::GetTimesOf(msg.payload.get_times.pid,
+                                  &reply.payload.get_times.times))
+    {
+        message->Reply(ERROR_INVALID, IoBuffer::GetEmpty());
+        return;
+    }
+
+    message->Reply(ERROR_OK, &reply, sizeof(reply));
+}
+
+PROC_MGR_OPERATION(PROC_MGR_MESSAGE_GET_TIMES, HandleGetTimes)
@@ -1,5 +1,6 @@
 #include <string.h>
 
+#include <kernel/math.hpp>
 #include <kernel/ramfs.h>
 
 bool RamFsGetImage (const char name[],
@@ -9,7 +10,8 @@ bool RamFsGetImage (const char name[],
     extern char __RamFsStart;
     extern char __RamFsEnd;
 
-    uint8_t const * cursor = (uint8_t const *)&__RamFsStart;
+    uint8_t const * start = (uint8_t const *)&__RamFsStart;
+    uint8_t const * cursor = start;
     uint8_t const * end = (uint8_t const *)&__RamFsEnd;
 
     while (cursor < end) {
@@ -27,7 +29,15 @@ bool RamFsGetImage (const char name[],
                                (cursor[2] << 8) + cursor[3];
         cursor += sizeof(payload_len);
 
-        if (strncmp(name, entry_name, name_len) == 0) {
+        // Skip the padding in front of the payload
+        cursor = start + Math::RoundUp(size_t(cursor - start),
+                                       RAMFS_PAYLOAD_ALIGNMENT);
+
+        // Entry names aren't terminated, so make sure that they
+        // aren't just a prefix of the name being looked for
+        if (strncmp(name, entry_name, name_len) == 0 &&
+            name[name_len] == '\0')
+        {
             *buffer = cursor;
             *len = payload_len;
             return true;
@@ -27,8 +27,7 @@ void Semaphore::Up ()
             Waiter * w = mWaitList.PopFirst();
             w->mState = Waiter::STATE_RELEASED;
             Thread::MakeReady(w->mThread);
-            Thread::MakeReady(THREAD_CURRENT());
-            Thread::RunNextThread();
+            Thread::PreemptIfOutranked(w->mThread);
         }
     }
 
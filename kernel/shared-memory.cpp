@@ -0,0 +1,112 @@
+#include <string.h>
+
+#include <kernel/memory.h>
+#include <kernel/shared-memory.hpp>
+
+SyncSlabAllocator<SharedMemoryObject> SharedMemoryObject::sSlab;
+
+SharedMemoryObject::SharedMemoryObject (char const aName[],
+                                        RefPtr<VmArea> aArea)
+    throw (std::bad_alloc)
+    : mName(aName)
+    , mArea(aArea)
+{
+}
+
+TreeMap<char const *, SharedMemoryObject *> * SharedMemoryRegistry::sMap;
+Spinlock_t SharedMemoryRegistry::sMapLock;
+
+Once_t SharedMemoryRegistry::sOnceControl = ONCE_INIT;
+
+static int CompareStrings (RawTreeMap::Key_t k1, RawTreeMap::Key_t k2)
+{
+    char const * s1 = (char const *)k1;
+    char const * s2 = (char const *)k2;
+
+    return strcmp(s1, s2);
+}
+
+void SharedMemoryRegistry::OnceInit (void * ignored)
+{
+    SpinlockInit(&sMapLock);
+    sMap = new TreeMap<char const *, SharedMemoryObject *>(&CompareStrings);
+}
+
+RefPtr<VmArea> SharedMemoryRegistry::Create (char const aName[],
+                                             size_t aLength)
+{
+    RefPtr<VmArea> area;
+    SharedMemoryObject * object;
+    bool inserted = false;
+
+    Once(&sOnceControl, &SharedMemoryRegistry::OnceInit, NULL);
+
+    // Do all the allocation before taking the lock
+    try {
+        area.Reset(new VmArea(aLength));
+        object = new SharedMemoryObject(aName, area);
+    }
+    catch (std::bad_alloc) {
+        return RefPtr<VmArea>();
+    }
+
+    area->MarkShared();
+
+    // Don't let one process see what another left in these pages
+    for (List<Page, &Page::list_link>::Iterator i = area->GetPages(); i; ++i) {
+        PageZero((void *)i->base_address);
+    }
+
+    SpinlockLock(&sMapLock);
+
+    if (sMap->Lookup(aName) == NULL) {
+        sMap->Insert(object->mName.c_str(), object);
+        inserted = sMap->Lookup(object->mName.c_str()) == object;
+    }
+
+    SpinlockUnlock(&sMapLock);
+
+    if (!inserted) {
+        delete object;
+        return RefPtr<VmArea>();
+    }
+
+    return area;
+}
+
+RefPtr<VmArea> SharedMemoryRegistry::Lookup (char const aName[])
+{
+    SharedMemoryObject * object;
+    RefPtr<VmArea> area;
+
+    Once(&sOnceControl, &SharedMemoryRegistry::OnceInit, NULL);
+
+    SpinlockLock(&sMapLock);
+    object = sMap->Lookup(aName);
+
+    if (object) {
+        area = object->mArea;
+    }
+
+    SpinlockUnlock(&sMapLock);
+
+    return area;
+}
+
+bool SharedMemoryRegistry::Unlink (char const aName[])
+{
+    SharedMemoryObject * object;
+
+    Once(&sOnceControl, &SharedMemoryRegistry::OnceInit, NULL);
+
+    SpinlockLock(&sMapLock);
+    object = sMap->Remove(aName);
+    SpinlockUnlock(&sMapLock);
+
+    if (!object) {
+        return false;
+    }
+
+    delete object;
+    return true;
+}
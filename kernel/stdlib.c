@@ -173,32 +173,6 @@ void signed_divide (
 
 #include <string.h>
 
-void * memset (void *b, int c, size_t len)
-{
-    char * ptr;
-    char * bound = ((char *)b) + len;
-
-    for (ptr = (char *)b; ptr < bound; ptr++) {
-        *ptr = (char)c;
-    }
-
-    return b;
-}
-
-void *
-memcpy (void *__restrict s1, const void *__restrict s2, size_t n)
-{
-    char * src_ptr = (char *)s2;
-    char * dst_ptr = (char *)s1;
-    char * src_bound = ((char *)s2) + n;
-
-    for (; src_ptr < src_bound; src_ptr++, dst_ptr++) {
-        *dst_ptr = *src_ptr;
-    }
-
-    return s1;
-}
-
 int strcmp (const char *s1, const char *s2)
 {
     for (;*s1 != '\0' && *s2 != '\0'; s1++, s2++) {
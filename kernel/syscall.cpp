@@ -4,11 +4,15 @@
 #include <muos/syscall.h>
 #include <muos/procmgr.h>
 
+#include <kernel/futex.hpp>
 #include <kernel/kmalloc.h>
 #include <kernel/message.hpp>
 #include <kernel/mmu.hpp>
 #include <kernel/process.hpp>
+#include <kernel/semaphore.hpp>
 #include <kernel/thread.hpp>
+#include <kernel/timer.hpp>
+#include <kernel/vmalloc.h>
 
 static bool CopyIoVecToIoBuffer (TranslationTable * user_pagetable,
                                  struct iovec const * user_iovec,
@@ -35,6 +39,46 @@ static bool CopyIoVecToIoBuffer (TranslationTable * user_pagetable,
     return true;
 }
 
+/**
+ * Long vectors are more than kmalloc() can serve, so they come from
+ * vmalloc() instead.
+ */
+static IoBuffer * AllocIoBuffers (size_t count)
+{
+    size_t size = sizeof(IoBuffer) * count;
+
+    if (count == 0) {
+        return NULL;
+    }
+
+    return (IoBuffer *)(size > KMALLOC_MAX_SIZE ? vmalloc(size) : kmalloc(size));
+}
+
+static void FreeIoBuffers (IoBuffer * buffers, size_t count)
+{
+    size_t size = sizeof(IoBuffer) * count;
+
+    if (size > KMALLOC_MAX_SIZE) {
+        vfree(buffers);
+    }
+    else {
+        kfree(buffers, size);
+    }
+}
+
+/**
+ * The receive calls store the message id straight into user memory,
+ * which neither the write-protection on copy-on-write pages nor that
+ * on read-only mappings stops.
+ */
+static int PrepareMessageIdWrite (uintptr_t * msgid)
+{
+    return THREAD_CURRENT()->process->GetAddressSpace()->PrepareWrite(
+            (VmAddr_t)msgid,
+            sizeof(*msgid)
+            );
+}
+
 static void checkExit (int messaging_result_code)
 {
     if (messaging_result_code == -ERROR_EXITING)
@@ -172,11 +216,8 @@ static ssize_t DoMessageSendV (
         return -ERROR_INVALID;
     }
 
-    size_t k_msgv_sz = sizeof(IoBuffer) * msgv_count;
-    size_t k_replyv_sz = sizeof(IoBuffer) * replyv_count;
-
-    IoBuffer * k_msgv = (IoBuffer *)kmalloc(k_msgv_sz);
-    IoBuffer * k_replyv = (IoBuffer *)kmalloc(k_replyv_sz);
+    IoBuffer * k_msgv = AllocIoBuffers(msgv_count);
+    IoBuffer * k_replyv = AllocIoBuffers(replyv_count);
 
     if ((msgv_count > 0 && !k_msgv) || (replyv_count > 0 && !k_replyv)) {
         ret = -ERROR_NO_MEM;
@@ -208,8 +249,8 @@ static ssize_t DoMessageSendV (
                          k_replyv, replyv_count);
 
 free_bufs:
-    if (k_msgv)     kfree(k_msgv, k_msgv_sz);
-    if (k_replyv)   kfree(k_replyv, k_replyv_sz);
+    if (k_msgv)     FreeIoBuffers(k_msgv, msgv_count);
+    if (k_replyv)   FreeIoBuffers(k_replyv, replyv_count);
 
 
     checkExit(ret);
@@ -232,6 +273,12 @@ static ssize_t DoMessageReceive (
         return -ERROR_INVALID;
     }
 
+    int prepared = PrepareMessageIdWrite(msgid);
+
+    if (prepared < 0) {
+        return prepared;
+    }
+
     int ret = c->ReceiveMessage(m, msgbuf, msgbuf_len);
 
     if (ret < 0) {
@@ -268,8 +315,13 @@ static ssize_t DoMessageReceiveV (
         return -ERROR_INVALID;
     }
 
-    size_t k_msgv_sz = sizeof(IoBuffer) * msgv_count;
-    IoBuffer * k_msgv = (IoBuffer *)kmalloc(k_msgv_sz);
+    int prepared = PrepareMessageIdWrite(msgid);
+
+    if (prepared < 0) {
+        return prepared;
+    }
+
+    IoBuffer * k_msgv = AllocIoBuffers(msgv_count);
 
     if (msgv_count > 0 && !k_msgv) {
         ret = -ERROR_NO_MEM;
@@ -301,7 +353,7 @@ static ssize_t DoMessageReceiveV (
 free_buffers:
 
     if (k_msgv) {
-        kfree(k_msgv, k_msgv_sz);
+        FreeIoBuffers(k_msgv, msgv_count);
     }
 
     checkExit(ret);
@@ -346,7 +398,6 @@ static ssize_t DoMessageReadV (
     int ret;
     TranslationTable * user_tt;
     TranslationTable * kernel_tt;
-    size_t k_destv_sz;
     IoBuffer * k_destv = NULL;
 
     RefPtr<Message> m = THREAD_CURRENT()->process->LookupMessage(msgid);
@@ -356,8 +407,7 @@ static ssize_t DoMessageReadV (
         goto free_buffers;
     }
 
-    k_destv_sz = sizeof(IoBuffer) * destv_count;
-    k_destv = (IoBuffer *)kmalloc(k_destv_sz);
+    k_destv = AllocIoBuffers(destv_count);
 
     if (destv_count > 0 && !k_destv) {
         ret = -ERROR_NO_MEM;
@@ -381,7 +431,7 @@ static ssize_t DoMessageReadV (
 free_buffers:
 
     if (k_destv) {
-        kfree(k_destv, k_destv_sz);
+        FreeIoBuffers(k_destv, destv_count);
     }
 
     return ret;
@@ -418,7 +468,6 @@ static ssize_t DoMessageReplyV (
     int ret;
     RefPtr<Message> m;
     IoBuffer * k_replyv = NULL;
-    size_t k_replyv_sz;
     TranslationTable * user_tt;
     TranslationTable * kernel_tt;
 
@@ -429,8 +478,7 @@ static ssize_t DoMessageReplyV (
         goto free_buffers;
     }
 
-    k_replyv_sz = sizeof(IoBuffer) * replyv_count;
-    k_replyv = (IoBuffer *)kmalloc(k_replyv_sz);
+    k_replyv = AllocIoBuffers(replyv_count);
 
     if (replyv_count > 0 && !k_replyv) {
         ret = -ERROR_NO_MEM;
@@ -455,7 +503,7 @@ static ssize_t DoMessageReplyV (
 free_buffers:
 
     if (k_replyv) {
-        kfree(k_replyv, k_replyv_sz);
+        FreeIoBuffers(k_replyv, replyv_count);
     }
 
     checkExit(ret);
@@ -463,6 +511,57 @@ free_buffers:
     return ret;
 }
 
+static int DoClockGetTime (uint64_t * nanoseconds)
+{
+    int prepared = THREAD_CURRENT()->process->GetAddressSpace()->PrepareWrite(
+            (VmAddr_t)nanoseconds,
+            sizeof(*nanoseconds)
+            );
+
+    if (prepared < 0) {
+        return prepared;
+    }
+
+    *nanoseconds = Timer::GetTime() * 1000;
+
+    return ERROR_OK;
+}
+
+/**
+ * Wakes up the thread blocked in DoNanoSleep()
+ */
+class SleepTimer : public TimerEntry
+{
+public:
+    SleepTimer ()
+        : mWakeup(0)
+    {
+    }
+
+    virtual void Expire ()
+    {
+        mWakeup.UpDuringException();
+    }
+
+    Semaphore mWakeup;
+};
+
+static int DoNanoSleep (uint32_t nanoseconds_low, uint32_t nanoseconds_high)
+{
+    uint64_t nanoseconds = ((uint64_t)nanoseconds_high << 32) | nanoseconds_low;
+    SleepTimer timer;
+
+    if (nanoseconds == 0) {
+        return ERROR_OK;
+    }
+
+    // Round up, so as never to wake early
+    Timer::Arm(&timer, (nanoseconds + 999) / 1000);
+    timer.mWakeup.Down(Thread::STATE_SLEEP);
+
+    return ERROR_OK;
+}
+
 BEGIN_DECLS
 void do_syscall (Thread * current);
 END_DECLS
@@ -526,6 +625,7 @@ void do_syscall (Thread * current)
                     (struct iovec const *)p_regs[2],
                     (size_t)p_regs[3]
                     );
+            break;
 
         case SYS_MSGGETLEN:
             p_regs[0] = DoMessageGetLength(p_regs[0]);
@@ -567,6 +667,22 @@ void do_syscall (Thread * current)
                     );
             break;
 
+        case SYS_CLOCK_GETTIME:
+            p_regs[0] = DoClockGetTime((uint64_t *)p_regs[0]);
+            break;
+
+        case SYS_NANOSLEEP:
+            p_regs[0] = DoNanoSleep(p_regs[0], p_regs[1]);
+            break;
+
+        case SYS_FUTEX_WAIT:
+            p_regs[0] = Futex::Wait((VmAddr_t)p_regs[0], p_regs[1]);
+            break;
+
+        case SYS_FUTEX_WAKE:
+            p_regs[0] = Futex::Wake((VmAddr_t)p_regs[0], p_regs[1]);
+            break;
+
         default:
             p_regs[0] = -ERROR_NO_SYS;
             break;
@@ -1,11 +1,17 @@
 #include <stdlib.h>
 
 #include <muos/arch.h>
+#include <muos/bits.h>
+#include <muos/compiler.h>
 #include <muos/spinlock.h>
 
 #include <kernel/assert.h>
+#include <kernel/cpu.hpp>
+#include <kernel/minmax.hpp>
 #include <kernel/process.hpp>
 #include <kernel/thread.hpp>
+#include <kernel/timer.hpp>
+#include <kernel/vfp.hpp>
 #include <kernel/vm.hpp>
 
 /**
@@ -20,17 +26,61 @@ END_DECLS
 
 typedef List<Thread, &Thread::queue_link> Queue_t;
 
-static Queue_t normal_ready_queue;
-static Queue_t io_ready_queue;
+/*
+Threads ready to run, queued per CPU. A thread goes back on the queue
+of the CPU it last ran on, unless that CPU is busy with something at
+least as important while another sits idle. Each CPU runs the best of
+its own queue, unless another CPU's queue holds something better, which
+it steals.
 
-static inline Queue_t * queue_for_thread (Thread * t)
+All of the queues are guarded by sched_spinlock.
+*/
+struct RunQueue
 {
-    if (t->assigned_priority == Thread::PRIORITY_IO || t->effective_priority == Thread::PRIORITY_IO) {
-        return &io_ready_queue;
-    }
-    else {
-        return &normal_ready_queue;
-    }
+    Queue_t levels[Thread::PRIORITY_COUNT];
+
+    /* Bit N is set if and only if levels[N] is nonempty */
+    uint32_t bitmap;
+
+    /* Thread last picked to run on the CPU, and the time it was picked */
+    Thread * on_cpu;
+    uint64_t on_cpu_since;
+};
+
+static RunQueue run_queues[Cpu::MAX];
+
+COMPILER_ASSERT(Thread::PRIORITY_COUNT <= BYTES_TO_BITS(sizeof(run_queues[0].bitmap)));
+
+static inline uint32_t level_bit (Thread::Priority priority)
+{
+    return (uint32_t)1 << priority;
+}
+
+/* Highest nonempty level is the highest set bit */
+static inline Thread::Priority highest_level (uint32_t bitmap)
+{
+    return Thread::Priority(31 - __builtin_clz(bitmap));
+}
+
+/* Levels of a queue that another CPU may take threads from */
+static inline uint32_t stealable (RunQueue & queue)
+{
+    return queue.bitmap & ~level_bit(Thread::PRIORITY_IDLE);
+}
+
+static inline Thread::Priority priority_for_thread (Thread * t)
+{
+    return MAX(t->assigned_priority, t->effective_priority);
+}
+
+/* Priority of what \a cpu is running; one that hasn't yet switched is idle */
+static Thread::Priority running_priority (unsigned int cpu)
+{
+    Thread * running = run_queues[cpu].on_cpu;
+
+    return running != NULL
+            ? priority_for_thread(running)
+            : Thread::PRIORITY_IDLE;
 }
 
 void Thread::BeginTransaction ()
@@ -122,6 +172,30 @@ void Thread::RunNextThread ()
     }
 }
 
+void Thread::PreemptIfOutranked (Thread * woken)
+{
+    assert(SpinlockLocked(&sched_spinlock));
+
+    Thread * curr = THREAD_CURRENT();
+    Thread::Priority woken_priority = priority_for_thread(woken);
+    Thread::Priority curr_priority = priority_for_thread(curr);
+
+    // Placed on another CPU that MakeReady() kicked to run it, it'll
+    // be taken off that CPU's list there, so there's nothing to switch
+    // to here
+    if (woken->cpu != Cpu::GetId() && running_priority(woken->cpu) < woken_priority) {
+        return;
+    }
+
+    if (woken_priority > curr_priority) {
+        MakeReady(curr);
+        RunNextThread();
+    }
+    else if (woken_priority == curr_priority) {
+        SetNeedResched();
+    }
+}
+
 void Thread::Entry (Thread::Func func, void * param)
 {
     /*
@@ -161,6 +235,15 @@ Thread::Thread (VmAddr_t stack_base, VmAddr_t stack_ceiling)
     this->kernel_stack.page     = NULL;
     this->process               = NULL;
     this->joiner                = NULL;
+    this->assigned_priority     = Thread::PRIORITY_NORMAL;
+    this->effective_priority    = Thread::PRIORITY_NORMAL;
+    this->run_time              = 0;
+    this->voluntary_switches    = 0;
+    this->involuntary_switches  = 0;
+    this->cpu                   = Cpu::GetId();
+
+    memset(&this->vfp, 0, sizeof(this->vfp));
+    this->vfp.cpu = VFP_NO_CPU;
 }
 
 Thread::Thread (Page * stack_page)
@@ -175,6 +258,12 @@ Thread::Thread (Page * stack_page)
     this->joiner = NULL;
     this->assigned_priority = Thread::PRIORITY_NORMAL;
     this->effective_priority = Thread::PRIORITY_NORMAL;
+    this->run_time = 0;
+    this->voluntary_switches = 0;
+    this->involuntary_switches = 0;
+    this->cpu = Cpu::GetId();
+    memset(&this->vfp, 0, sizeof(this->vfp));
+    this->vfp.cpu = VFP_NO_CPU;
 }
 
 Thread * Thread::Create (Thread::Func body, void * param)
@@ -232,15 +321,22 @@ void Thread::Join ()
     assert(THREAD_CURRENT() != this);
     assert(this->joiner == NULL);
 
+    /*
+    Checked under the lock, since on another CPU this thread may be
+    finishing right now. Once the lock has been had with it finished,
+    it's also switched away from for good and its stack is free.
+    */
+    BeginTransaction();
+
     this->joiner = THREAD_CURRENT();
 
     while (this->state != Thread::STATE_FINISHED) {
-        BeginTransaction();
         MakeUnready(THREAD_CURRENT(), STATE_JOINING);
         RunNextThread();
-        EndTransaction();
     }
 
+    EndTransaction();
+
     // Invoke the destructor to clean out member variables
     // that themselves have destructors
     this->~Thread();
@@ -258,41 +354,218 @@ Thread::State Thread::GetState ()
 
 Thread::~Thread ()
 {
-    // Nothing to do; the symbol just needs to exist to
-    // be invokable so that member variables can get their
-    // dtors run too.
+    // The VFP may still be holding our registers
+    Vfp::Forget(this);
+}
+
+static void enqueue (Thread * thread)
+{
+    Thread::Priority priority = priority_for_thread(thread);
+    RunQueue & queue = run_queues[thread->cpu];
+
+    queue.levels[priority].Append(thread);
+    queue.bitmap |= level_bit(priority);
+}
+
+static void dequeue (Thread * thread, Thread::Priority priority)
+{
+    RunQueue & queue = run_queues[thread->cpu];
+
+    Queue_t::Remove(thread);
+
+    if (queue.levels[priority].Empty()) {
+        queue.bitmap &= ~level_bit(priority);
+    }
+}
+
+/* CPU whose queue a thread becoming ready at \a priority goes on */
+static unsigned int place (Thread * thread, Thread::Priority priority)
+{
+    unsigned int home = thread->cpu;
+
+    // Idle threads never move, and neither does one being put back by
+    // the CPU it's running on
+    if (priority == Thread::PRIORITY_IDLE ||
+        run_queues[home].on_cpu == thread ||
+        running_priority(home) < priority)
+    {
+        return home;
+    }
+
+    for (unsigned int cpu = 0; cpu < Cpu::MAX; cpu++) {
+        if (Cpu::IsOnline(cpu) &&
+            running_priority(cpu) == Thread::PRIORITY_IDLE &&
+            stealable(run_queues[cpu]) == 0)
+        {
+            return cpu;
+        }
+    }
+
+    return home;
+}
+
+/*
+Have another CPU run its scheduler if a thread just queued for it
+ought to preempt what it's running. The caller looks after its own CPU
+the same as ever, with RunNextThread() or SetNeedResched().
+*/
+static void kick (unsigned int cpu, Thread::Priority priority)
+{
+    if (cpu != Cpu::GetId() && running_priority(cpu) < priority) {
+        Cpu::SendIpi(cpu, Cpu::IPI_RESCHEDULE);
+    }
+}
+
+/*
+A thread waiting on the ready list has to be taken off before its
+priority changes, and put back afterwards on the level for its new
+priority. It goes to the back of that level, the same as if it had
+just become ready.
+*/
+static bool pull_for_reprioritize (Thread * thread)
+{
+    if (thread->queue_link.Unlinked()) {
+        return false;
+    }
+
+    assert(SpinlockLocked(&sched_spinlock));
+    dequeue(thread, priority_for_thread(thread));
+    return true;
 }
 
 void Thread::SetEffectivePriority (Thread::Priority priority)
 {
-    this->effective_priority = priority;
+    bool queued = pull_for_reprioritize(this);
+
+    this->effective_priority = MAX(priority, this->assigned_priority);
+
+    if (queued) {
+        enqueue(this);
+    }
+}
+
+void Thread::SetAssignedPriority (Thread::Priority priority)
+{
+    bool queued = pull_for_reprioritize(this);
+
+    // A boost gifted by some other thread stays put while it's higher
+    if (this->effective_priority == this->assigned_priority) {
+        this->effective_priority = priority;
+    }
+    else {
+        this->effective_priority = MAX(this->effective_priority, priority);
+    }
+
+    this->assigned_priority = priority;
+
+    if (queued) {
+        enqueue(this);
+    }
+}
+
+/*
+Every switch, whether made by RunNextThread() or by preemption on the
+way out of an interrupt, picks its next thread through DequeueReady().
+So that's where the outgoing thread's time is charged: one counter
+read and a few additions, no matter how many threads there are.
+
+A thread that's still ready when it's switched away from was either
+preempted or chose to let others run; either way it didn't block.
+*/
+static void account_switch (RunQueue & queue, Thread * next)
+{
+    uint64_t now = Timer::GetTime();
+    Thread * prev = queue.on_cpu;
+
+    if (prev != NULL) {
+        prev->run_time += now - queue.on_cpu_since;
+
+        if (prev != next) {
+            if (prev->GetState() == Thread::STATE_READY) {
+                prev->involuntary_switches++;
+            }
+            else {
+                prev->voluntary_switches++;
+            }
+        }
+    }
+
+    queue.on_cpu = next;
+    queue.on_cpu_since = now;
 }
 
 Thread * Thread::DequeueReady ()
 {
+    unsigned int self = Cpu::GetId();
+    RunQueue & local = run_queues[self];
+    RunQueue * source = &local;
+    uint32_t bitmap = local.bitmap;
     Thread * next;
 
     assert(SpinlockLocked(&sched_spinlock));
 
-    if (!io_ready_queue.Empty()) {
-        next = io_ready_queue.PopFirst();
+    // Take from another CPU's queue if it has something better, which
+    // is never its idle thread
+    for (unsigned int cpu = 0; cpu < Cpu::MAX; cpu++) {
+        uint32_t theirs = stealable(run_queues[cpu]);
+
+        if (cpu != self && theirs != 0 &&
+            (bitmap == 0 || highest_level(theirs) > highest_level(bitmap)))
+        {
+            source = &run_queues[cpu];
+            bitmap = theirs;
+        }
     }
-    else if (!normal_ready_queue.Empty()) {
-        next = normal_ready_queue.PopFirst();
-    } else {
-        next = NULL;
+
+    if (bitmap == 0) {
+        return NULL;
+    }
+
+    Thread::Priority priority = highest_level(bitmap);
+
+    next = source->levels[priority].PopFirst();
+
+    if (source->levels[priority].Empty()) {
+        source->bitmap &= ~level_bit(priority);
     }
 
+    next->cpu = self;
+
+    account_switch(local, next);
+    Vfp::Switch(next);
+
+    // The idle thread runs until an interrupt anyway, so there's no
+    // reason to keep waking the CPU up to preempt it
+    Timer::SetTimeslicing(priority != Thread::PRIORITY_IDLE);
+
     return next;
 }
 
+bool Thread::AnyReady ()
+{
+    assert(SpinlockLocked(&sched_spinlock));
+
+    for (unsigned int cpu = 0; cpu < Cpu::MAX; cpu++) {
+        if (stealable(run_queues[cpu]) != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void Thread::MakeReady (Thread * thread)
 {
     assert(SpinlockLocked(&sched_spinlock));
     assert(thread->queue_link.Unlinked());
 
-    queue_for_thread(thread)->Append(thread);
+    Thread::Priority priority = priority_for_thread(thread);
+
+    thread->cpu = place(thread, priority);
+    enqueue(thread);
     thread->state = Thread::STATE_READY;
+
+    kick(thread->cpu, priority);
 }
 
 void Thread::MakeUnready (Thread * thread, State state)
@@ -304,15 +577,15 @@ void Thread::MakeUnready (Thread * thread, State state)
 /**
  * Set to true by interrupt handlers when something has happened
  * that makes the scheduler algorithm need to be re-run at
- * the time that a syscall is being returned from.
+ * the time that a syscall is being returned from. One per CPU.
  */
-static bool         need_resched        = false;
+static bool         need_resched[Cpu::MAX];
 static Spinlock_t   need_resched_lock   = SPINLOCK_INIT;
 
 void Thread::SetNeedResched ()
 {
     SpinlockLock(&need_resched_lock);
-    need_resched = true;
+    need_resched[Cpu::GetId()] = true;
     SpinlockUnlock(&need_resched_lock);
 }
 
@@ -321,8 +594,8 @@ bool Thread::ResetNeedResched ()
     bool ret;
 
     SpinlockLock(&need_resched_lock);
-    ret = need_resched;
-    need_resched = false;
+    ret = need_resched[Cpu::GetId()];
+    need_resched[Cpu::GetId()] = false;
     SpinlockUnlock(&need_resched_lock);
 
     return ret;
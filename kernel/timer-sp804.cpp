@@ -1,10 +1,21 @@
 #include <stdint.h>
 
+#include <kernel/assert.h>
+#include <kernel/board.h>
 #include <kernel/interrupt-handler.hpp>
+#include <kernel/minmax.hpp>
 #include <kernel/mmu.hpp>
 #include <kernel/timer.hpp>
 #include <kernel/thread.hpp>
 
+/**
+ * \brief   Driver for the first dual timer on the Versatile and
+ *          RealView boards
+ *
+ * The first timer is reprogrammed as a one-shot for each deadline.
+ * The second free-runs, for telling the time. Both count the board's
+ * 1 MHz reference clock, so one count is one microsecond.
+ */
 class Sp804 : public TimerDevice
 {
 public:
@@ -13,16 +24,37 @@ public:
 
     virtual void Init ();
     virtual void ClearInterrupt ();
-    virtual void StartPeriodic (unsigned int period_ms);
+    virtual uint32_t ReadCounter ();
+    virtual void StartOneShot (uint32_t delay_us);
 
 private:
-    volatile        uint32_t * Load;
-    volatile const  uint32_t * Value;
-    volatile        uint32_t * Control;
-    volatile        uint32_t * IntClr;
-    volatile const  uint32_t * RIS;
-    volatile const  uint32_t * MIS;
-    volatile        uint32_t * BgLoad;
+    /**
+     * \brief   Registers of one of the two timers
+     */
+    struct Registers
+    {
+        volatile        uint32_t * Load;
+        volatile const  uint32_t * Value;
+        volatile        uint32_t * Control;
+        volatile        uint32_t * IntClr;
+        volatile const  uint32_t * RIS;
+        volatile const  uint32_t * MIS;
+        volatile        uint32_t * BgLoad;
+
+        void Locate (uint8_t * base);
+    };
+
+    enum
+    {
+        CONTROL_ONESHOT     = 0b00000001,
+        CONTROL_32BIT       = 0b00000010,
+        CONTROL_INT_ENABLE  = 0b00100000,
+        CONTROL_PERIODIC    = 0b01000000,
+        CONTROL_ENABLE      = 0b10000000,
+    };
+
+    Registers mOneShot;
+    Registers mClock;
 };
 
 static void OnTimerInterrupt (void);
@@ -36,19 +68,35 @@ Sp804::~Sp804 ()
 {
 }
 
+void Sp804::Registers::Locate (uint8_t * base)
+{
+    this->Load    = (uint32_t *)  (base + 0x00);
+    this->Value   = (uint32_t *)  (base + 0x04);
+    this->Control = (uint32_t *)  (base + 0x08);
+    this->IntClr  = (uint32_t *)  (base + 0x0c);
+    this->RIS     = (uint32_t *)  (base + 0x10);
+    this->MIS     = (uint32_t *)  (base + 0x14);
+    this->BgLoad  = (uint32_t *)  (base + 0x18);
+}
+
 void Sp804::ClearInterrupt ()
 {
-    *this->IntClr = 0;
+    *mOneShot.IntClr = 0;
 }
 
 void Sp804::Init ()
 {
     enum
     {
-        SP804_BASE_PHYS = 0x101e2000,
+        SP804_BASE_PHYS = BOARD_TIMER01_PHYS,
         SP804_BASE_VIRT = 0xfff00000,
     };
 
+    enum
+    {
+        TIMER0_IRQ = BOARD_TIMER01_IRQ,
+    };
+
     bool mapped = TranslationTable::GetKernel()->MapPage(
             SP804_BASE_VIRT,
             SP804_BASE_PHYS,
@@ -58,63 +106,43 @@ void Sp804::Init ()
 
     uint8_t * base = (uint8_t *)SP804_BASE_VIRT;
 
-    this->Load    = (uint32_t *)  (base + 0x00);
-    this->Value   = (uint32_t *)  (base + 0x04);
-    this->Control = (uint32_t *)  (base + 0x08);
-    this->IntClr  = (uint32_t *)  (base + 0x0c);
-    this->RIS     = (uint32_t *)  (base + 0x10);
-    this->MIS     = (uint32_t *)  (base + 0x14);
-    this->BgLoad  = (uint32_t *)  (base + 0x18);
-}
-
-void Sp804::StartPeriodic (unsigned int period_ms)
-{
-    enum
-    {
-        TIMER0_IRQ = 4,
-    };
+    mOneShot.Locate(base + 0x00);
+    mClock.Locate(base + 0x20);
 
-    enum
-    {
-        /**
-         * Number of timer cycles requires to elapse one second
-         * on Versatile board.
-         */
-        ONE_SECOND = 1000000,
-    };
+    /*
+    Free-running mode (neither periodic nor one-shot) counts down from
+    the top of the 32-bit range and wraps, with no interrupt
+    */
+    *mClock.Control = 0;
+    *mClock.Load = 0xffffffff;
+    *mClock.Control = CONTROL_32BIT | CONTROL_ENABLE;
 
-    uint32_t period_cycles = (ONE_SECOND * period_ms) / 1000;
+    *mOneShot.Control = 0;
+    *mOneShot.IntClr = 0;
 
     /*
     Now install hooks for handling the timer interrupt
     */
     InterruptAttachKernelHandler(TIMER0_IRQ, OnTimerInterrupt);
     InterruptUnmaskIrq(TIMER0_IRQ);
+}
 
-    /*
-    Program the timer
-    */
-
-    *this->BgLoad = period_cycles;
-    *this->Load = period_cycles;
-
-    uint32_t control = *this->Control;
-    
-    /* First enable interrupts */
-    control |= 0b00100000; /* timer interrupt enabled */
-    *this->Control = control;
-
-    control |= 0b00000010; /* 32-bit expressiveness */
-    *this->Control = control;
+uint32_t Sp804::ReadCounter ()
+{
+    // Counts down, so flip it around
+    return ~*mClock.Value;
+}
 
-    //control |= 0b00000001; /* oneshot */
-    //*this->Control = control;
+void Sp804::StartOneShot (uint32_t delay_us)
+{
+    /* Stop it before reloading, so a stale expiry can't fire */
+    *mOneShot.Control = 0;
+    *mOneShot.IntClr = 0;
 
-    control |= 0b01000000; /* periodic */
-    *this->Control = control;
+    *mOneShot.Load = MAX(delay_us, (uint32_t)1);
 
-    control |= 0b10000000; /* timer enabled */
-    *this->Control = control;
+    *mOneShot.Control = CONTROL_32BIT | CONTROL_INT_ENABLE | CONTROL_ONESHOT;
+    *mOneShot.Control = CONTROL_32BIT | CONTROL_INT_ENABLE | CONTROL_ONESHOT | CONTROL_ENABLE;
 }
 
 static Sp804 instance;
@@ -124,6 +152,5 @@ static void OnTimerInterrupt ()
     /* Clear the interrupt */
     instance.ClearInterrupt();
 
-    /* Boot the current task */
-    Timer::ReportPeriodicInterrupt();
+    Timer::ReportInterrupt();
 }
@@ -1,9 +1,84 @@
+#include <muos/spinlock.h>
+
+#include <kernel/assert.h>
+#include <kernel/cpu.hpp>
+#include <kernel/minmax.hpp>
 #include <kernel/once.h>
 #include <kernel/timer.hpp>
 #include <kernel/thread.hpp>
 
 static TimerDevice * timer = 0;
 
+/*
+Longest the timer is ever programmed for. Keeps the hardware counter
+from wrapping twice between readings, which would lose time, even
+when there's nothing at all to wake up for.
+*/
+static const uint32_t MAX_ONESHOT_US = 0x80000000;
+
+/* No deadline */
+static const uint64_t NEVER = ~(uint64_t)0;
+
+/* Protects everything below */
+static Spinlock_t lock = SPINLOCK_INIT;
+
+static bool     started         = false;
+
+/* Hardware counter reading last seen, and the wraps before it */
+static uint32_t last_counter    = 0;
+static uint64_t counter_wraps   = 0;
+
+/*
+Each CPU's timeslice, all timed by the one device. Its interrupt
+only reaches CPU 0, which passes expiries on to the others by IPI.
+*/
+static uint32_t timeslice_us    = 0;
+static bool     timeslicing[Cpu::MAX];
+static uint64_t timeslice_end[Cpu::MAX];
+
+/*
+The timing wheel. Each level has 64 slots; a slot on level 0 spans one
+tick of about a millisecond, and a slot on each level above spans all
+64 of the level below. An entry goes on the lowest level whose range
+reaches its due time, and is moved down a level (cascaded) when the
+wheel turns round to its slot.
+*/
+enum
+{
+    TICK_SHIFT      = 10,
+    WHEEL_BITS      = 6,
+    WHEEL_SLOTS     = 1 << WHEEL_BITS,
+    WHEEL_MASK      = WHEEL_SLOTS - 1,
+    WHEEL_LEVELS    = 4,
+};
+
+typedef List<TimerEntry, &TimerEntry::mLink> Slot_t;
+
+static Slot_t   wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+
+/* Bit N of occupied[L] is set if and only if wheel[L][N] is nonempty */
+static uint64_t occupied[WHEEL_LEVELS];
+
+/* Next tick to be processed; everything due before it has fired */
+static uint64_t wheel_tick      = 0;
+
+/*
+Earliest tick anything on the wheel is due, for programming the
+hardware; recalculated from the wheel only when 'deadline_stale' says
+it may have changed.
+*/
+static uint64_t deadline_tick   = 0;
+static bool     deadline_stale  = true;
+
+/*
+Entries that have come due and are waiting for ReportInterrupt() to
+call Expire() on them, marked by an mLevel of EXPIRED_LEVEL; and the
+one whose Expire() is running right now, which Disarm() waits for.
+*/
+static const uint8_t EXPIRED_LEVEL = WHEEL_LEVELS;
+static Slot_t   expired;
+static TimerEntry * volatile expiring = NULL;
+
 void Timer::RegisterDevice (TimerDevice * device)
 {
     timer = device;
@@ -17,13 +92,403 @@ static void init_timer (void * ignored)
     timer->Init();
 }
 
-void Timer::StartPeriodic (unsigned int period_ms)
+static uint64_t now_locked ()
+{
+    uint32_t counter = timer->ReadCounter();
+
+    if (counter < last_counter) {
+        counter_wraps += (uint64_t)1 << 32;
+    }
+
+    last_counter = counter;
+
+    return counter_wraps + counter;
+}
+
+static inline uint64_t slot_bit (unsigned int slot)
+{
+    return (uint64_t)1 << slot;
+}
+
+/* First tick at or after 'us' */
+static inline uint64_t tick_for (uint64_t us)
+{
+    return (us + (1 << TICK_SHIFT) - 1) >> TICK_SHIFT;
+}
+
+static void insert_locked (TimerEntry * entry)
+{
+    uint64_t tick = MAX(tick_for(entry->mDue), wheel_tick);
+    uint64_t delta = tick - wheel_tick;
+    unsigned int level = 0;
+
+    while (level < WHEEL_LEVELS - 1 &&
+           delta >> (WHEEL_BITS * (level + 1)) != 0)
+    {
+        level++;
+    }
+
+    // Beyond the top level's reach, park it in the farthest slot; it's
+    // put back in when that comes round
+    if (delta >> (WHEEL_BITS * WHEEL_LEVELS) != 0) {
+        tick = wheel_tick + ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    }
+
+    entry->mLevel = level;
+    entry->mSlot = (tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+    wheel[level][entry->mSlot].Append(entry);
+    occupied[level] |= slot_bit(entry->mSlot);
+    deadline_stale = true;
+}
+
+static void remove_locked (TimerEntry * entry)
+{
+    Slot_t::Remove(entry);
+
+    if (entry->mLevel == EXPIRED_LEVEL) {
+        return;
+    }
+
+    if (wheel[entry->mLevel][entry->mSlot].Empty()) {
+        occupied[entry->mLevel] &= ~slot_bit(entry->mSlot);
+    }
+
+    deadline_stale = true;
+}
+
+static bool wheel_empty_locked ()
+{
+    for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+        if (occupied[level] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void cascade_locked (unsigned int level, unsigned int slot)
+{
+    Slot_t pending;
+
+    while (!wheel[level][slot].Empty()) {
+        pending.Append(wheel[level][slot].PopFirst());
+    }
+
+    occupied[level] &= ~slot_bit(slot);
+
+    while (!pending.Empty()) {
+        insert_locked(pending.PopFirst());
+    }
+}
+
+/*
+First occupied slot of a level that the wheel has still to reach, and
+the tick at which it's reached: when it fires, on level 0, or is
+cascaded to the level below. NEVER if the level is empty.
+
+A slot on an upper level is cascaded when the wheel reaches the start
+of its span, so once the wheel is past that, anything in the current
+slot is a whole turn of the level away.
+*/
+static uint64_t next_slot_locked (unsigned int level, unsigned int & slot)
+{
+    uint64_t slots = occupied[level];
+
+    if (slots == 0) {
+        return NEVER;
+    }
+
+    unsigned int shift = WHEEL_BITS * level;
+    uint64_t span_mask = ((uint64_t)1 << shift) - 1;
+    uint64_t first = (wheel_tick >> shift) + ((wheel_tick & span_mask) != 0);
+    unsigned int from = first & WHEEL_MASK;
+
+    // Rotate so that bit 0 is the first slot to be reached
+    if (from != 0) {
+        slots = (slots >> from) | (slots << (WHEEL_SLOTS - from));
+    }
+
+    unsigned int ahead = __builtin_ctzll(slots);
+
+    slot = (from + ahead) & WHEEL_MASK;
+
+    return (first + ahead) << shift;
+}
+
+/*
+Earliest tick that has anything to fire or cascade, or NEVER. Lets the
+wheel skip straight over stretches where nothing happens, however
+long they are.
+*/
+static uint64_t next_tick_locked ()
+{
+    uint64_t next = NEVER;
+
+    for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+        unsigned int slot;
+
+        next = MIN(next, next_slot_locked(level, slot));
+    }
+
+    return next;
+}
+
+/*
+Earliest tick anything on the wheel is actually due, or NEVER. An entry
+on an upper level is due somewhere within its slot's span, so only the
+first occupied slot of each level need be looked through, and then
+only when the wheel has changed since last time.
+*/
+static uint64_t next_deadline_locked ()
+{
+    if (!deadline_stale) {
+        return deadline_tick;
+    }
+
+    deadline_tick = NEVER;
+
+    for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+        unsigned int slot;
+        uint64_t tick = next_slot_locked(level, slot);
+
+        if (tick == NEVER || level == 0) {
+            deadline_tick = MIN(deadline_tick, tick);
+            continue;
+        }
+
+        for (Slot_t::Iterator i = wheel[level][slot].Begin(); i; i++) {
+            deadline_tick = MIN(deadline_tick, tick_for(i->mDue));
+        }
+    }
+
+    deadline_stale = false;
+
+    return deadline_tick;
+}
+
+static void process_tick_locked (uint64_t tick)
+{
+    unsigned int index = tick & WHEEL_MASK;
+
+    wheel_tick = tick;
+
+    // Each level turns over one slot when the level below wraps
+    if (index == 0) {
+        for (unsigned int level = 1; level < WHEEL_LEVELS; level++) {
+            unsigned int slot = (tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+            cascade_locked(level, slot);
+
+            if (slot != 0) {
+                break;
+            }
+        }
+    }
+
+    Slot_t & due = wheel[0][index];
+
+    occupied[0] &= ~slot_bit(index);
+    wheel_tick = tick + 1;
+    deadline_stale = true;
+
+    while (!due.Empty()) {
+        TimerEntry * entry = due.PopFirst();
+
+        if (tick_for(entry->mDue) > tick) {
+            // Parked because it was too far out
+            insert_locked(entry);
+        }
+        else {
+            entry->mLevel = EXPIRED_LEVEL;
+            expired.Append(entry);
+        }
+    }
+}
+
+static void advance_locked (uint64_t now)
+{
+    uint64_t now_tick = now >> TICK_SHIFT;
+    uint64_t tick;
+
+    while ((tick = next_tick_locked()) <= now_tick) {
+        process_tick_locked(tick);
+    }
+
+    wheel_tick = MAX(wheel_tick, now_tick + 1);
+}
+
+static void program_locked (uint64_t now)
+{
+    uint64_t deadline = NEVER;
+    uint64_t next_tick = next_deadline_locked();
+    uint64_t delay;
+
+    for (unsigned int cpu = 0; cpu < Cpu::MAX; cpu++) {
+        if (timeslicing[cpu]) {
+            deadline = MIN(deadline, timeslice_end[cpu]);
+        }
+    }
+
+    if (next_tick != NEVER) {
+        deadline = MIN(deadline, next_tick << TICK_SHIFT);
+    }
+
+    if (deadline <= now) {
+        delay = 1;
+    }
+    else {
+        delay = MIN<uint64_t>(deadline - now, MAX_ONESHOT_US);
+    }
+
+    timer->StartOneShot(delay);
+}
+
+void Timer::Start (unsigned int timeslice_ms)
 {
     Once(&timer_init_once, init_timer, NULL);
-    timer->StartPeriodic(period_ms);
+
+    SpinlockLock(&lock);
+
+    timeslice_us = timeslice_ms * 1000;
+    started = true;
+
+    uint64_t now = now_locked();
+
+    wheel_tick = tick_for(now);
+
+    // Whoever is calling this isn't the idle thread
+    timeslicing[Cpu::GetId()] = true;
+    timeslice_end[Cpu::GetId()] = now + timeslice_us;
+    program_locked(now);
+
+    SpinlockUnlock(&lock);
+}
+
+uint64_t Timer::GetTime ()
+{
+    uint64_t now;
+
+    SpinlockLock(&lock);
+    now = started ? now_locked() : 0;
+    SpinlockUnlock(&lock);
+
+    return now;
 }
 
-void Timer::ReportPeriodicInterrupt ()
+void Timer::SetTimeslicing (bool enabled)
 {
-    Thread::SetNeedResched();
+    SpinlockLock(&lock);
+
+    unsigned int cpu = Cpu::GetId();
+
+    if (started && enabled != timeslicing[cpu]) {
+        uint64_t now = now_locked();
+
+        timeslicing[cpu] = enabled;
+        timeslice_end[cpu] = enabled ? now + timeslice_us : NEVER;
+        program_locked(now);
+    }
+
+    SpinlockUnlock(&lock);
+}
+
+void Timer::Arm (TimerEntry * entry, uint64_t delay_us, uint64_t interval_us)
+{
+    SpinlockLock(&lock);
+
+    assert(started);
+
+    if (entry->IsArmed()) {
+        remove_locked(entry);
+    }
+
+    uint64_t now = now_locked();
+
+    // Nothing has advanced the wheel while there was nothing on it, and
+    // positions are reckoned from where it's got to
+    if (wheel_empty_locked()) {
+        wheel_tick = MAX(wheel_tick, now >> TICK_SHIFT);
+    }
+
+    entry->mDue = now + delay_us;
+    entry->mInterval = interval_us;
+    insert_locked(entry);
+
+    program_locked(now);
+
+    SpinlockUnlock(&lock);
+}
+
+bool Timer::Disarm (TimerEntry * entry)
+{
+    bool armed;
+
+    SpinlockLock(&lock);
+
+    armed = entry->IsArmed();
+
+    if (armed) {
+        remove_locked(entry);
+    }
+
+    SpinlockUnlock(&lock);
+
+    // Its owner may free it as soon as this returns
+    while (expiring == entry) {
+    }
+
+    return armed;
+}
+
+void Timer::ReportInterrupt ()
+{
+    SpinlockLock(&lock);
+
+    uint64_t now = now_locked();
+
+    for (unsigned int cpu = 0; cpu < Cpu::MAX; cpu++) {
+        if (timeslicing[cpu] && now >= timeslice_end[cpu]) {
+            // Boot the current task
+            if (cpu == Cpu::GetId()) {
+                Thread::SetNeedResched();
+            }
+            else {
+                Cpu::SendIpi(cpu, Cpu::IPI_RESCHEDULE);
+            }
+
+            timeslice_end[cpu] = now + timeslice_us;
+        }
+    }
+
+    advance_locked(now);
+
+    /*
+    Run the handlers without the lock, since they wake threads and
+    send pulses, and those take locks that are held while calling in
+    here. Everything about an entry is settled before its handler is
+    called, since the handler's return may be the last moment the entry
+    exists: a sleeper's entry is on its stack.
+    */
+    while (!expired.Empty()) {
+        TimerEntry * entry = expired.PopFirst();
+
+        if (entry->mInterval != 0) {
+            // Once overdue, it fires straight away, just once
+            entry->mDue = MAX(entry->mDue + entry->mInterval, now);
+            insert_locked(entry);
+        }
+
+        expiring = entry;
+        SpinlockUnlock(&lock);
+
+        entry->Expire();
+
+        SpinlockLock(&lock);
+        expiring = NULL;
+    }
+
+    program_locked(now_locked());
+    SpinlockUnlock(&lock);
 }
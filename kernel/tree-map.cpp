@@ -166,11 +166,6 @@ Value_t RawTreeMap::Insert (
 
     assert(this != NULL);
     this->root = InternalNode::Insert(this, this->root, key, value, &prev_value);
-    internal_foreach(this->root, check_subtree_balance, NULL);
-
-    if (!prev_value) {
-        this->size++;
-    }
 
     return prev_value;
 }
@@ -210,6 +205,64 @@ Value_t RawTreeMap::Lookup (
     return node ? node->value : NULL;
 }
 
+Value_t RawTreeMap::LookupFloor (
+        Key_t key
+        )
+{
+    InternalNode * node;
+    InternalNode * best = NULL;
+    int compare_val;
+
+    assert(this != NULL);
+
+    for (node = this->root; node != NULL;) {
+        compare_val = this->comparator(key, node->key);
+
+        if (compare_val == 0) {
+            return node->value;
+        }
+        else if (compare_val < 0) {
+            node = node->left;
+        }
+        else {
+            /* Candidate; but something bigger may be down to the right */
+            best = node;
+            node = node->right;
+        }
+    }
+
+    return best ? best->value : NULL;
+}
+
+Value_t RawTreeMap::LookupCeiling (
+        Key_t key
+        )
+{
+    InternalNode * node;
+    InternalNode * best = NULL;
+    int compare_val;
+
+    assert(this != NULL);
+
+    for (node = this->root; node != NULL;) {
+        compare_val = this->comparator(key, node->key);
+
+        if (compare_val == 0) {
+            return node->value;
+        }
+        else if (compare_val > 0) {
+            node = node->right;
+        }
+        else {
+            /* Candidate; but something smaller may be down to the left */
+            best = node;
+            node = node->left;
+        }
+    }
+
+    return best ? best->value : NULL;
+}
+
 unsigned int RawTreeMap::Size ()
 {
     assert(this != NULL);
@@ -262,7 +315,7 @@ InternalNode * InternalNode::Insert (
             /* New key is greater than this node. */
             node->right = InternalNode::Insert(tree, node->right, key, value, prev_value);
             node = internal_rebalance(node);
-            internal_foreach(node->right, check_subtree_balance, NULL);
+            check_subtree_balance(node, NULL);
 
             return node;
         }
@@ -270,7 +323,7 @@ InternalNode * InternalNode::Insert (
             /* New key is less than this node. */
             node->left = InternalNode::Insert(tree, node->left, key, value, prev_value);
             node = internal_rebalance(node);
-            internal_foreach(node->left, check_subtree_balance, NULL);
+            check_subtree_balance(node, NULL);
             return node;
         }
     }
@@ -279,6 +332,11 @@ InternalNode * InternalNode::Insert (
         InternalNode * new_node = (InternalNode *)ObjectCacheAlloc(&internal_node_cache);
         SpinlockUnlock(&internal_node_cache_lock);
 
+        if (!new_node) {
+            /* Out of memory; caller can tell since key is still absent */
+            return NULL;
+        }
+
         new_node->left = NULL;
         new_node->right = NULL;
         new_node->height = 0;
@@ -286,6 +344,8 @@ InternalNode * InternalNode::Insert (
         new_node->value = value;
         *prev_value = NULL;
 
+        tree->size++;
+
         return new_node;
     }
 }
@@ -0,0 +1,24 @@
+#include <muos/message.h>
+
+#include <kernel/user-timer.hpp>
+
+SyncSlabAllocator<UserTimer> UserTimer::sSlab;
+
+UserTimer::~UserTimer ()
+{
+    Dispose();
+}
+
+void UserTimer::Expire ()
+{
+    // Runs in the timer interrupt
+    if (mConnection) {
+        mConnection->SendMessageAsyncDuringException(PULSE_TYPE_TIMER, mPulseValue);
+    }
+}
+
+void UserTimer::Dispose ()
+{
+    Timer::Disarm(this);
+    mConnection.Reset();
+}
@@ -0,0 +1,195 @@
+#include <stdint.h>
+
+#include <kernel/cpu.hpp>
+#include <kernel/thread.hpp>
+#include <kernel/vfp.hpp>
+
+enum
+{
+    /* Coprocessor Access Control bits giving user and kernel cp10/cp11 */
+    CPACR_VFP_FULL  = 0xf << 20,
+
+    /* FPEXC bit that turns the VFP on */
+    FPEXC_EN        = 1 << 30,
+};
+
+/* Whether the CPUs have VFPs at all */
+static bool present = false;
+
+/*
+For each CPU, the thread whose registers were last loaded into its VFP,
+if any, and whether its VFP is turned on for the thread running there
+now. Only changed inside scheduler transactions.
+*/
+static Thread * owner[Cpu::MAX];
+static bool enabled[Cpu::MAX];
+
+/*
+With more than one CPU, a thread switched away from may next run on
+another CPU, which can't reach the registers it left behind. So any
+thread that had the VFP on saves its registers as it's switched away
+from, and a thread's saved registers are always its latest. Loading
+is still put off until the first floating-point instruction.
+*/
+static const bool save_on_switch = Cpu::MAX > 1;
+
+/* Whether the registers in \a cpu's VFP are \a thread's latest */
+static inline bool loaded (unsigned int cpu, Thread * thread)
+{
+    return owner[cpu] == thread && thread->vfp.cpu == cpu;
+}
+
+/*
+The VFP instructions are written out as the generic coprocessor ones
+they're encoded as, so that the kernel needn't be built for a VFP.
+*/
+
+static inline uint32_t read_fpexc ()
+{
+    uint32_t fpexc;
+    asm volatile("mrc p10, 7, %[fpexc], cr8, cr0, 0" : [fpexc] "=r" (fpexc));
+    return fpexc;
+}
+
+static inline void write_fpexc (uint32_t fpexc)
+{
+    asm volatile("mcr p10, 7, %[fpexc], cr8, cr0, 0" : : [fpexc] "r" (fpexc) : "memory");
+}
+
+/* Needs the VFP turned on */
+static void save (VfpContext * context)
+{
+    asm volatile(
+        "stc p11, cr0, [%[d]], {32}         \n\t"   /* fstmiad d, {d0-d15} */
+        "mrc p10, 7, %[fpscr], cr1, cr0, 0  \n\t"   /* fmrx fpscr          */
+        : [fpscr] "=r" (context->fpscr)
+        : [d] "r" (&context->d[0])
+        : "memory"
+    );
+}
+
+/* Needs the VFP turned on */
+static void load (VfpContext const * context)
+{
+    asm volatile(
+        "ldc p11, cr0, [%[d]], {32}         \n\t"   /* fldmiad d, {d0-d15} */
+        "mcr p10, 7, %[fpscr], cr1, cr0, 0  \n\t"   /* fmxr fpscr          */
+        :
+        : [d] "r" (&context->d[0]),
+          [fpscr] "r" (context->fpscr)
+        : "memory"
+    );
+}
+
+void Vfp::Init ()
+{
+    unsigned int cpu = Cpu::GetId();
+    uint32_t cpacr;
+
+    /* Access bits for a coprocessor that isn't there read back as zero */
+    asm volatile(
+        "mrc p15, 0, %[cpacr], c1, c0, 2    \n\t"
+        "orr %[cpacr], %[cpacr], %[full]    \n\t"
+        "mcr p15, 0, %[cpacr], c1, c0, 2    \n\t"
+        "mcr p15, 0, %[zero], c7, c5, 4     \n\t"   /* Flush prefetch buffer */
+        "mrc p15, 0, %[cpacr], c1, c0, 2    \n\t"
+        : [cpacr] "=&r" (cpacr)
+        : [full] "r" (CPACR_VFP_FULL),
+          [zero] "r" (0)
+        : "memory"
+    );
+
+    present = (cpacr & CPACR_VFP_FULL) == CPACR_VFP_FULL;
+
+    if (present) {
+        write_fpexc(0);
+    }
+
+    owner[cpu] = NULL;
+    enabled[cpu] = false;
+}
+
+void Vfp::Switch (Thread * incoming)
+{
+    unsigned int cpu = Cpu::GetId();
+
+    // Only the owner can have had the VFP on
+    if (save_on_switch && enabled[cpu] && incoming != owner[cpu]) {
+        save(&owner[cpu]->vfp);
+    }
+
+    bool enable = present && loaded(cpu, incoming);
+
+    if (enable != enabled[cpu]) {
+        write_fpexc(enable ? FPEXC_EN : 0);
+        enabled[cpu] = enable;
+    }
+}
+
+bool Vfp::HandleTrap (Thread * current)
+{
+    bool handled = false;
+
+    if (!present) {
+        return false;
+    }
+
+    Thread::BeginTransaction();
+
+    unsigned int cpu = Cpu::GetId();
+
+    // If the VFP was already on, something else is wrong with the
+    // instruction and trying again won't help
+    if (!loaded(cpu, current) || !enabled[cpu]) {
+        write_fpexc(FPEXC_EN);
+        enabled[cpu] = true;
+
+        if (!loaded(cpu, current)) {
+            if (!save_on_switch && owner[cpu] != NULL) {
+                save(&owner[cpu]->vfp);
+            }
+
+            load(&current->vfp);
+            owner[cpu] = current;
+            current->vfp.cpu = cpu;
+        }
+
+        handled = true;
+    }
+
+    Thread::EndTransaction();
+
+    return handled;
+}
+
+void Vfp::Copy (Thread * parent, Thread * child)
+{
+    Thread::BeginTransaction();
+
+    // The parent's latest values may only be in the registers
+    if (!save_on_switch && owner[Cpu::GetId()] == parent) {
+        uint32_t fpexc = read_fpexc();
+
+        write_fpexc(FPEXC_EN);
+        save(&parent->vfp);
+        write_fpexc(fpexc);
+    }
+
+    child->vfp = parent->vfp;
+    child->vfp.cpu = VFP_NO_CPU;
+
+    Thread::EndTransaction();
+}
+
+void Vfp::Forget (Thread * thread)
+{
+    Thread::BeginTransaction();
+
+    for (unsigned int cpu = 0; cpu < Cpu::MAX; cpu++) {
+        if (owner[cpu] == thread) {
+            owner[cpu] = NULL;
+        }
+    }
+
+    Thread::EndTransaction();
+}
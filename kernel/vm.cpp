@@ -52,6 +52,7 @@ struct BuddylistLevel
 static BuddylistLevel buddylists[NUM_BUDDYLIST_LEVELS];
 
 static unsigned int     num_pages;
+static unsigned int     num_free_pages;
 static Page *           page_structs;
 static VmAddr_t         pages_base;
 static Spinlock_t       lock = SPINLOCK_INIT;
@@ -126,6 +127,7 @@ static void vm_init (void * ignored)
     pages_base = Math::RoundUp(pages_base, PAGE_SIZE << (NUM_BUDDYLIST_LEVELS - 1));
 
     num_pages = PAGE_COUNT_FROM_SIZE(HEAP_SIZE - (pages_base - VIRTUAL_HEAP_START));
+    num_free_pages = num_pages;
     page_structs = (Page *)VIRTUAL_HEAP_START;
 
     /*
@@ -238,6 +240,9 @@ Page * Page::Alloc (unsigned int order)
 
     SpinlockLock(&lock);
     ret = AllocInternal(order, true);
+    if (ret) {
+        num_free_pages -= 1 << order;
+    }
     SpinlockUnlock(&lock);
 
     return ret;
@@ -349,6 +354,7 @@ void Page::Free (Page * page)
     new (&page->list_link) ListElement();
     buddylists[order].freelist_head->Prepend(page);
     BitmapClear(buddylists[order].bitmap.busy_elements, idx);
+    num_free_pages += 1 << order;
 
     // Try to coalesce
     try_merge_block(page, order);
@@ -356,3 +362,15 @@ void Page::Free (Page * page)
     SpinlockUnlock(&lock);
     return;
 }
+
+size_t Page::GetFreeCount ()
+{
+    Once(&init_control, vm_init, NULL);
+    return num_free_pages;
+}
+
+size_t Page::GetTotalCount ()
+{
+    Once(&init_control, vm_init, NULL);
+    return num_pages;
+}
@@ -0,0 +1,239 @@
+#include <stddef.h>
+
+#include <muos/arch.h>
+#include <muos/bits.h>
+#include <muos/spinlock.h>
+
+#include <kernel/assert.h>
+#include <kernel/list.hpp>
+#include <kernel/math.hpp>
+#include <kernel/mmu.hpp>
+#include <kernel/slaballocator.hpp>
+#include <kernel/vm.hpp>
+#include <kernel/vmalloc.h>
+
+enum
+{
+    /*
+     * Window of kernel addresses handed out by vmalloc(), between the
+     * flat map of RAM and the device mappings at the top of memory
+     */
+    VMALLOC_BASE    = 0xf0000000,
+    VMALLOC_CEILING = 0xfff00000,
+
+    VMALLOC_PAGES   = (VMALLOC_CEILING - VMALLOC_BASE) >> PAGE_SHIFT,
+
+    /* Lists the regions are spread over, by base address */
+    REGION_BUCKETS  = 64,
+};
+
+/**
+ * \brief   Bookkeeping for one range handed out by vmalloc()
+ *
+ * \class VmallocRegion vmalloc.cpp kernel/vmalloc.cpp
+ */
+class VmallocRegion
+{
+public:
+    void * operator new (size_t size) throw (std::bad_alloc)
+    {
+        assert(size == sizeof(VmallocRegion));
+        return sSlab.AllocateWithThrow();
+    }
+
+    void operator delete (void * mem) throw ()
+    {
+        sSlab.Free(mem);
+    }
+
+    VmallocRegion (size_t aPageCount)
+        : mBase(0)
+        , mPageCount(aPageCount)
+    {
+    }
+
+    ~VmallocRegion ()
+    {
+        while (!mPages.Empty()) {
+            Page::Free(mPages.PopFirst());
+        }
+    }
+
+    ListElement link;
+
+    VmAddr_t mBase;
+
+    size_t mPageCount;
+
+    List<Page, &Page::list_link> mPages;
+
+private:
+    static SyncSlabAllocator<VmallocRegion> sSlab;
+};
+
+SyncSlabAllocator<VmallocRegion> VmallocRegion::sSlab;
+
+/* One flag per page in the window, set if the page is taken */
+static uint8_t busy_pages[BITS_TO_BYTES(VMALLOC_PAGES)];
+
+static List<VmallocRegion, &VmallocRegion::link> regions[REGION_BUCKETS];
+
+/* Protects busy_pages, regions, and the window's part of the kernel table */
+static Spinlock_t lock = SPINLOCK_INIT;
+
+static List<VmallocRegion, &VmallocRegion::link> & bucket_for (VmAddr_t base)
+{
+    return regions[(base >> PAGE_SHIFT) % REGION_BUCKETS];
+}
+
+static void free_tables (List<SecondlevelTable, &SecondlevelTable::link> & tables)
+{
+    while (!tables.Empty()) {
+        delete tables.PopFirst();
+    }
+}
+
+static bool reserve_pages (size_t count, unsigned int & first)
+{
+    size_t run = 0;
+
+    for (unsigned int i = 0; i < VMALLOC_PAGES; i++) {
+        if (BitmapGet(busy_pages, i)) {
+            run = 0;
+        }
+        else if (++run == count) {
+            first = i + 1 - count;
+
+            for (unsigned int j = first; j <= i; j++) {
+                BitmapSet(busy_pages, j);
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void release_pages (unsigned int first, size_t count)
+{
+    for (unsigned int i = first; i < first + count; i++) {
+        assert(BitmapGet(busy_pages, i));
+        BitmapClear(busy_pages, i);
+    }
+}
+
+void * vmalloc (size_t size)
+{
+    TranslationTable * kernel_tt = TranslationTable::GetKernel();
+    List<SecondlevelTable, &SecondlevelTable::link> tables;
+    VmallocRegion * region;
+    unsigned int first;
+    bool mapped;
+
+    // Keep room for the guard page, and don't let the rounding overflow
+    if (size == 0 || size >= VMALLOC_CEILING - VMALLOC_BASE || !kernel_tt) {
+        return NULL;
+    }
+
+    try {
+        region = new VmallocRegion(Math::RoundUp(size, PAGE_SIZE) / PAGE_SIZE);
+    }
+    catch (std::bad_alloc) {
+        return NULL;
+    }
+
+    // Single pages can always be found if there's any memory left at all
+    for (size_t i = 0; i < region->mPageCount; i++) {
+        Page * page = Page::Alloc(0);
+
+        if (!page) {
+            delete region;
+            return NULL;
+        }
+
+        region->mPages.Append(page);
+    }
+
+    // Likewise a second-level table for every section the range could
+    // touch, so that nothing needs allocated under the lock
+    size_t sections = region->mPageCount / (SECTION_SIZE / PAGE_SIZE) + 2;
+
+    for (size_t i = 0; i < sections; i++) {
+        try {
+            tables.Append(new SecondlevelTable());
+        }
+        catch (std::bad_alloc) {
+            free_tables(tables);
+            delete region;
+            return NULL;
+        }
+    }
+
+    SpinlockLock(&lock);
+
+    if (!reserve_pages(region->mPageCount + 1, first)) {
+        SpinlockUnlock(&lock);
+        free_tables(tables);
+        delete region;
+        return NULL;
+    }
+
+    region->mBase = VMALLOC_BASE + (first << PAGE_SHIFT);
+
+    kernel_tt->AddSpareSecondlevelTables(tables);
+
+    mapped = kernel_tt->MapRange(region->mBase, region->mPages.Begin(),
+                                 region->mPageCount * PAGE_SIZE, PROT_KERNEL);
+    assert(mapped);
+
+    bucket_for(region->mBase).Append(region);
+
+    kernel_tt->TakeExcessSecondlevelTables(tables);
+
+    SpinlockUnlock(&lock);
+
+    free_tables(tables);
+
+    return (void *)region->mBase;
+}
+
+void vfree (void * ptr)
+{
+    VmallocRegion * region = NULL;
+
+    if (!ptr) {
+        return;
+    }
+
+    SpinlockLock(&lock);
+
+    List<VmallocRegion, &VmallocRegion::link> & bucket = bucket_for((VmAddr_t)ptr);
+
+    for (List<VmallocRegion, &VmallocRegion::link>::Iterator i = bucket.Begin();
+         i; i++)
+    {
+        if ((*i)->mBase == (VmAddr_t)ptr) {
+            region = *i;
+            break;
+        }
+    }
+
+    assert(region != NULL);
+
+    List<VmallocRegion, &VmallocRegion::link>::Remove(region);
+
+    bool unmapped = TranslationTable::GetKernel()->UnmapRange(
+            region->mBase,
+            region->mPageCount * PAGE_SIZE
+            );
+    assert(unmapped);
+
+    release_pages((region->mBase - VMALLOC_BASE) >> PAGE_SHIFT,
+                  region->mPageCount + 1);
+
+    SpinlockUnlock(&lock);
+
+    // Pages are only freed once nothing translates to them any more
+    delete region;
+}
@@ -0,0 +1,66 @@
+#include <muos/atomic.h>
+#include <muos/futex.h>
+#include <muos/syscall.h>
+
+int FutexWait (volatile uint32_t * word, uint32_t expected)
+{
+    return syscall2(SYS_FUTEX_WAIT, (int)word, (int)expected);
+}
+
+int FutexWake (volatile uint32_t * word, unsigned int count)
+{
+    return syscall2(SYS_FUTEX_WAKE, (int)word, (int)count);
+}
+
+enum
+{
+    MUTEX_UNLOCKED = 0,
+    MUTEX_LOCKED,
+    MUTEX_CONTENDED,
+};
+
+static uint32_t exchange (volatile uint32_t * word, uint32_t value)
+{
+    uint32_t old;
+
+    do {
+        old = *word;
+    } while (!AtomicCompareAndExchange((uint32_t *)word, old, value));
+
+    return old;
+}
+
+void MutexInit (struct Mutex * mutex)
+{
+    mutex->state = MUTEX_UNLOCKED;
+}
+
+void MutexLock (struct Mutex * mutex)
+{
+    uint32_t old;
+
+    if (AtomicCompareAndExchange((uint32_t *)&mutex->state,
+                                 MUTEX_UNLOCKED, MUTEX_LOCKED)) {
+        return;
+    }
+
+    /*
+    Whoever gets the lock from here on can't tell whether anyone else
+    is still waiting, so it always takes it as contended. At worst
+    that costs its unlock one needless wakeup.
+    */
+    old = exchange(&mutex->state, MUTEX_CONTENDED);
+
+    while (old != MUTEX_UNLOCKED) {
+        FutexWait(&mutex->state, MUTEX_CONTENDED);
+        old = exchange(&mutex->state, MUTEX_CONTENDED);
+    }
+}
+
+void MutexUnlock (struct Mutex * mutex)
+{
+    if (AtomicSubAndFetch((int *)&mutex->state, 1) != MUTEX_UNLOCKED) {
+        mutex->state = MUTEX_UNLOCKED;
+        FutexWake(&mutex->state, 1);
+    }
+}
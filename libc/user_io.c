@@ -77,7 +77,8 @@ int InterruptComplete (int handler_id)
 
 void * MapPhysical (
         uintptr_t physaddr,
-        size_t len
+        size_t len,
+        CacheAttr_t attr
         )
 {
     struct ProcMgrMessage m;
@@ -86,6 +87,7 @@ void * MapPhysical (
     m.type = PROC_MGR_MESSAGE_MAP_PHYS;
     m.payload.map_phys.physaddr = physaddr;
     m.payload.map_phys.len = len;
+    m.payload.map_phys.attr = attr;
 
     int ret = MessageSend(
             PROCMGR_CONNECTION_ID,
@@ -102,3 +104,58 @@ void * MapPhysical (
         return (void *)reply.payload.map_phys.vmaddr;
     }
 }
+
+int Unmap (
+        void * vmaddr,
+        size_t len
+        )
+{
+    struct ProcMgrMessage m;
+    struct ProcMgrReply reply;
+
+    m.type = PROC_MGR_MESSAGE_UNMAP;
+    m.payload.unmap.vmaddr = (uintptr_t)vmaddr;
+    m.payload.unmap.len = len;
+
+    int ret = MessageSend(
+            PROCMGR_CONNECTION_ID,
+            &m,
+            sizeof(m),
+            &reply,
+            sizeof(reply)
+            );
+
+    if (ret < 0) {
+        return ret;
+    }
+    else {
+        return 0;
+    }
+}
+
+int GetInterruptCount (
+        unsigned int cpu,
+        uint32_t * count
+        )
+{
+    struct ProcMgrMessage m;
+    struct ProcMgrReply reply;
+
+    m.type = PROC_MGR_MESSAGE_INTERRUPT_COUNT;
+    m.payload.interrupt_count.cpu = cpu;
+
+    int ret = MessageSend(
+            PROCMGR_CONNECTION_ID,
+            &m,
+            sizeof(m),
+            &reply,
+            sizeof(reply)
+            );
+
+    if (ret < 0) {
+        return ret;
+    }
+
+    *count = reply.payload.interrupt_count.count;
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <string.h>
 
+#include <muos/error.h>
 #include <muos/procmgr.h>
 #include <muos/process.h>
 #include <muos/uio.h>
@@ -23,6 +24,19 @@ void Exit (void)
 }
 
 int Spawn (char const path[])
+{
+    return SpawnWithAttributes(path, NULL);
+}
+
+void SpawnAttributesInit (struct SpawnAttributes * attr)
+{
+    attr->page_limit = 0;
+    attr->priority = SCHED_PRIORITY_DEFAULT;
+    attr->stack_size = 0;
+}
+
+int SpawnWithAttributes (char const path[],
+                         struct SpawnAttributes const * attr)
 {
     struct iovec msgv[3];
     struct iovec replyv[1];
@@ -33,6 +47,12 @@ int Spawn (char const path[])
     msg.type = PROC_MGR_MESSAGE_SPAWN;
     msg.payload.spawn.path_len = strlen(path) + 1;
 
+    if (attr) {
+        msg.payload.spawn.attributes = *attr;
+    } else {
+        SpawnAttributesInit(&msg.payload.spawn.attributes);
+    }
+
     msgv[0].iov_base = &msg.type;
     msgv[0].iov_len = offsetof(struct ProcMgrMessage, payload.spawn.path_len) - offsetof(struct ProcMgrMessage, type);
 
@@ -59,6 +79,116 @@ int Spawn (char const path[])
     }
 }
 
+int SetPriority (int priority)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+    int status;
+
+    msg.type = PROC_MGR_MESSAGE_SET_PRIORITY;
+    msg.payload.set_priority.priority = priority;
+
+    status = MessageSend(PROCMGR_CONNECTION_ID,
+                         &msg, sizeof(msg),
+                         &reply, sizeof(reply));
+
+    if (status >= 0) {
+        return ERROR_OK;
+    }
+    else {
+        return status;
+    }
+}
+
+int GetPriority (void)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+
+    msg.type = PROC_MGR_MESSAGE_GET_PRIORITY;
+    MessageSend(PROCMGR_CONNECTION_ID, &msg, sizeof(msg), &reply, sizeof(reply));
+
+    return reply.payload.get_priority.priority;
+}
+
+static int get_times (int pid, int children, struct ProcessTimes * times)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+    int status;
+
+    msg.type = PROC_MGR_MESSAGE_GET_TIMES;
+    msg.payload.get_times.pid = pid;
+    msg.payload.get_times.children = children;
+
+    status = MessageSend(PROCMGR_CONNECTION_ID,
+                         &msg, sizeof(msg),
+                         &reply, sizeof(reply));
+
+    if (status < 0) {
+        return status;
+    }
+
+    *times = reply.payload.get_times.times;
+    return ERROR_OK;
+}
+
+int GetProcessTimes (int pid, struct ProcessTimes * times)
+{
+    return get_times(pid, 0, times);
+}
+
+int GetChildTimes (struct ProcessTimes * times)
+{
+    return get_times(SELF_PID, 1, times);
+}
+
+int GetMemoryStats (struct MemoryStats * stats)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+    int status;
+
+    msg.type = PROC_MGR_MESSAGE_GET_MEMORY_STATS;
+
+    status = MessageSend(PROCMGR_CONNECTION_ID,
+                         &msg, sizeof(msg),
+                         &reply, sizeof(reply));
+
+    if (status < 0) {
+        return status;
+    }
+
+    *stats = reply.payload.get_memory_stats.stats;
+    return ERROR_OK;
+}
+
+int Fork (void)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+    int status;
+
+    msg.type = PROC_MGR_MESSAGE_FORK;
+
+    /*
+    The child resumes from a copy of this stack frame without ever
+    receiving the reply, so this is the value it sees.
+    */
+    reply.payload.fork.pid = 0;
+
+    status = MessageSend(PROCMGR_CONNECTION_ID,
+                         &msg, sizeof(msg),
+                         &reply, sizeof(reply));
+
+    if (status >= 0) {
+        return reply.payload.fork.pid;
+    }
+    else {
+        return status;
+    }
+}
+
 int ChildWaitAttach (int connection_id, int pid)
 {
     struct ProcMgrMessage msg;
@@ -0,0 +1,46 @@
+#include <string.h>
+
+#include <muos/message.h>
+#include <muos/procmgr.h>
+#include <muos/ramfs.h>
+
+void const * RamFsMap (char const name[], size_t * len)
+{
+    struct iovec msgv[3];
+    struct iovec replyv[1];
+
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+
+    int msg_result;
+
+    msg.type = PROC_MGR_MESSAGE_RAMFS_MAP;
+    msg.payload.ramfs_map.path_len = strlen(name) + 1;
+
+    msgv[0].iov_base = &msg.type;
+    msgv[0].iov_len = offsetof(struct ProcMgrMessage, payload.ramfs_map.path_len) - offsetof(struct ProcMgrMessage, type);
+
+    msgv[1].iov_base = &msg.payload.ramfs_map.path_len;
+    msgv[1].iov_len = offsetof(struct ProcMgrMessage, payload.ramfs_map.path) - offsetof(struct ProcMgrMessage, payload.ramfs_map.path_len);
+
+    msgv[2].iov_base = (void *)&name[0];
+    msgv[2].iov_len = msg.payload.ramfs_map.path_len * sizeof(char);
+
+    replyv[0].iov_base = &reply;
+    replyv[0].iov_len = sizeof(reply);
+
+    msg_result = MessageSendV(PROCMGR_CONNECTION_ID,
+                              msgv,
+                              sizeof(msgv) / sizeof(msgv[0]),
+                              replyv,
+                              sizeof(replyv) / sizeof(replyv[0]));
+
+    if (msg_result >= 0) {
+        if (len) {
+            *len = reply.payload.ramfs_map.len;
+        }
+        return (void const *)reply.payload.ramfs_map.vmaddr;
+    } else {
+        return NULL;
+    }
+}
@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include <muos/message.h>
+#include <muos/procmgr.h>
+#include <muos/shm.h>
+
+void * SharedMemoryCreate (char const name[], size_t len)
+{
+    struct iovec msgv[3];
+    struct iovec replyv[1];
+
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+
+    int msg_result;
+
+    msg.type = PROC_MGR_MESSAGE_SHM_CREATE;
+    msg.payload.shm_create.len = len;
+    msg.payload.shm_create.path_len = strlen(name) + 1;
+
+    msgv[0].iov_base = &msg.type;
+    msgv[0].iov_len = offsetof(struct ProcMgrMessage, payload.shm_create.len) - offsetof(struct ProcMgrMessage, type);
+
+    msgv[1].iov_base = &msg.payload.shm_create.len;
+    msgv[1].iov_len = offsetof(struct ProcMgrMessage, payload.shm_create.path) - offsetof(struct ProcMgrMessage, payload.shm_create.len);
+
+    msgv[2].iov_base = (void *)&name[0];
+    msgv[2].iov_len = msg.payload.shm_create.path_len * sizeof(char);
+
+    replyv[0].iov_base = &reply;
+    replyv[0].iov_len = sizeof(reply);
+
+    msg_result = MessageSendV(PROCMGR_CONNECTION_ID,
+                              msgv,
+                              sizeof(msgv) / sizeof(msgv[0]),
+                              replyv,
+                              sizeof(replyv) / sizeof(replyv[0]));
+
+    if (msg_result >= 0) {
+        return (void *)reply.payload.shm_create.vmaddr;
+    } else {
+        return NULL;
+    }
+}
+
+void * SharedMemoryOpen (char const name[], size_t * len)
+{
+    struct iovec msgv[3];
+    struct iovec replyv[1];
+
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+
+    int msg_result;
+
+    msg.type = PROC_MGR_MESSAGE_SHM_OPEN;
+    msg.payload.shm_open.path_len = strlen(name) + 1;
+
+    msgv[0].iov_base = &msg.type;
+    msgv[0].iov_len = offsetof(struct ProcMgrMessage, payload.shm_open.path_len) - offsetof(struct ProcMgrMessage, type);
+
+    msgv[1].iov_base = &msg.payload.shm_open.path_len;
+    msgv[1].iov_len = offsetof(struct ProcMgrMessage, payload.shm_open.path) - offsetof(struct ProcMgrMessage, payload.shm_open.path_len);
+
+    msgv[2].iov_base = (void *)&name[0];
+    msgv[2].iov_len = msg.payload.shm_open.path_len * sizeof(char);
+
+    replyv[0].iov_base = &reply;
+    replyv[0].iov_len = sizeof(reply);
+
+    msg_result = MessageSendV(PROCMGR_CONNECTION_ID,
+                              msgv,
+                              sizeof(msgv) / sizeof(msgv[0]),
+                              replyv,
+                              sizeof(replyv) / sizeof(replyv[0]));
+
+    if (msg_result >= 0) {
+        if (len) {
+            *len = reply.payload.shm_open.len;
+        }
+        return (void *)reply.payload.shm_open.vmaddr;
+    } else {
+        return NULL;
+    }
+}
+
+int SharedMemoryUnlink (char const name[])
+{
+    struct iovec msgv[3];
+    struct iovec replyv[1];
+
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+
+    int msg_result;
+
+    msg.type = PROC_MGR_MESSAGE_SHM_UNLINK;
+    msg.payload.shm_unlink.path_len = strlen(name) + 1;
+
+    msgv[0].iov_base = &msg.type;
+    msgv[0].iov_len = offsetof(struct ProcMgrMessage, payload.shm_unlink.path_len) - offsetof(struct ProcMgrMessage, type);
+
+    msgv[1].iov_base = &msg.payload.shm_unlink.path_len;
+    msgv[1].iov_len = offsetof(struct ProcMgrMessage, payload.shm_unlink.path) - offsetof(struct ProcMgrMessage, payload.shm_unlink.path_len);
+
+    msgv[2].iov_base = (void *)&name[0];
+    msgv[2].iov_len = msg.payload.shm_unlink.path_len * sizeof(char);
+
+    replyv[0].iov_base = &reply;
+    replyv[0].iov_len = sizeof(reply);
+
+    msg_result = MessageSendV(PROCMGR_CONNECTION_ID,
+                              msgv,
+                              sizeof(msgv) / sizeof(msgv[0]),
+                              replyv,
+                              sizeof(replyv) / sizeof(replyv[0]));
+
+    return msg_result >= 0 ? 0 : msg_result;
+}
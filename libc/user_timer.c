@@ -0,0 +1,69 @@
+#include <muos/procmgr.h>
+#include <muos/syscall.h>
+#include <muos/timer.h>
+
+int ClockGetTime (uint64_t * nanoseconds)
+{
+    return syscall1(SYS_CLOCK_GETTIME, (int)nanoseconds);
+}
+
+int NanoSleep (uint64_t nanoseconds)
+{
+    return syscall2(SYS_NANOSLEEP,
+                    (int)(uint32_t)nanoseconds,
+                    (int)(uint32_t)(nanoseconds >> 32));
+}
+
+int TimerCreate (int connection_id, uintptr_t value)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+    int status;
+
+    msg.type = PROC_MGR_MESSAGE_TIMER_CREATE;
+    msg.payload.timer_create.connection_id = connection_id;
+    msg.payload.timer_create.value = value;
+
+    status = MessageSend(PROCMGR_CONNECTION_ID,
+                         &msg, sizeof(msg),
+                         &reply, sizeof(reply));
+
+    if (status >= 0) {
+        return reply.payload.timer_create.timer_id;
+    }
+    else {
+        return status;
+    }
+}
+
+int TimerArm (int timer_id, uint64_t delay_ns, uint64_t interval_ns)
+{
+    struct ProcMgrMessage msg;
+    int status;
+
+    msg.type = PROC_MGR_MESSAGE_TIMER_ARM;
+    msg.payload.timer_arm.timer_id = timer_id;
+    msg.payload.timer_arm.delay_ns = delay_ns;
+    msg.payload.timer_arm.interval_ns = interval_ns;
+
+    status = MessageSend(PROCMGR_CONNECTION_ID,
+                         &msg, sizeof(msg),
+                         NULL, 0);
+
+    return status < 0 ? status : 0;
+}
+
+int TimerDestroy (int timer_id)
+{
+    struct ProcMgrMessage msg;
+    int status;
+
+    msg.type = PROC_MGR_MESSAGE_TIMER_DESTROY;
+    msg.payload.timer_destroy.timer_id = timer_id;
+
+    status = MessageSend(PROCMGR_CONNECTION_ID,
+                         &msg, sizeof(msg),
+                         NULL, 0);
+
+    return status < 0 ? status : 0;
+}
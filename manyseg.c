@@ -0,0 +1,39 @@
+#include <stdint.h>
+
+#include <muos/arch.h>
+
+/*
+ * One page of initialized data in each of sixteen sections, which
+ * manyseg.ldscript links into a loadable segment apiece. Spawning this
+ * is timed by 'mapindex'.
+ */
+#define PIECE(n)                                                    \
+    static volatile uint32_t piece##n[PAGE_SIZE / sizeof(uint32_t)] \
+        __attribute__((section(".seg" #n))) = { n + 1 }
+
+PIECE(0);   PIECE(1);   PIECE(2);   PIECE(3);
+PIECE(4);   PIECE(5);   PIECE(6);   PIECE(7);
+PIECE(8);   PIECE(9);   PIECE(10);  PIECE(11);
+PIECE(12);  PIECE(13);  PIECE(14);  PIECE(15);
+
+static volatile uint32_t * const pieces[] = {
+    piece0,     piece1,     piece2,     piece3,
+    piece4,     piece5,     piece6,     piece7,
+    piece8,     piece9,     piece10,    piece11,
+    piece12,    piece13,    piece14,    piece15,
+};
+
+#define NUM_PIECES  (sizeof(pieces) / sizeof(pieces[0]))
+
+int main () {
+    unsigned int i;
+
+    /* Every segment was loaded, at the right place */
+    for (i = 0; i < NUM_PIECES; i++) {
+        if (pieces[i][0] != i + 1) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
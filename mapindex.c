@@ -0,0 +1,100 @@
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <muos/arch.h>
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+/* Program with a loadable segment for each of many sections */
+#define MANY_SEGMENTS   "manyseg"
+
+#define SPAWNS          20
+
+/*
+ * Small heap extensions, a quarter of a page at a time. Every fourth
+ * one reaches the kernel for another page, each lying right against
+ * the last.
+ */
+#define SBRKS           10000
+#define SBRK_BYTES      (PAGE_SIZE / 4)
+#define BATCH           1000
+
+/*
+ * Nanoseconds to spawn MANY_SEGMENTS, counted until it has exited;
+ * and per sbrk() call in each successive BATCH of them. With one
+ * mapping added for each extension, later batches would slow as the
+ * mappings pile up. Left here to be read from the debugger.
+ */
+static volatile uint64_t spawn_ns;
+static volatile uint32_t sbrk_ns[SBRKS / BATCH];
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static void spawn_many_segments (int chid, int coid)
+{
+    struct Pulse pulse;
+    int wait_id;
+    int msgid;
+    int pid;
+
+    pid = Spawn(MANY_SEGMENTS);
+    assert(pid >= 0);
+
+    wait_id = ChildWaitAttach(coid, pid);
+    ChildWaitArm(wait_id, 1);
+
+    assert(MessageReceive(chid, &msgid, &pulse, sizeof(pulse)) == sizeof(pulse));
+    assert(msgid == 0);
+    assert(pulse.type == PULSE_TYPE_CHILD_FINISH);
+
+    ChildWaitDetach(wait_id);
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    char * first = NULL;
+    char * last = NULL;
+    uint64_t start;
+    unsigned int i;
+
+    start = now();
+    for (i = 0; i < SPAWNS; i++) {
+        spawn_many_segments(chid, coid);
+    }
+    spawn_ns = (now() - start) / SPAWNS;
+
+    for (i = 0; i < SBRKS; i++) {
+        if (i % BATCH == 0) {
+            start = now();
+        }
+
+        last = sbrk(SBRK_BYTES);
+        assert(last != (char *)-1);
+
+        if (i == 0) {
+            first = last;
+        }
+
+        if (i % BATCH == BATCH - 1) {
+            sbrk_ns[i / BATCH] = (now() - start) / BATCH;
+        }
+    }
+
+    /* One unbroken heap, written from end to end */
+    assert(last == first + (SBRKS - 1) * SBRK_BYTES);
+    last[SBRK_BYTES - 1] = 1;
+    first[0] = 1;
+
+    assert(sbrk(-(SBRKS * SBRK_BYTES)) != (void *)-1);
+
+    return 0;
+}
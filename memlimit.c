@@ -0,0 +1,89 @@
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <muos/arch.h>
+#include <muos/error.h>
+#include <muos/message.h>
+#include <muos/process.h>
+
+/* Must match the limit init.c spawns this program with */
+#define PAGE_LIMIT 128
+
+#define CHUNK_PAGES 4
+
+/*
+ * More channels than could fit in the page or so of slack left once
+ * the heap is full, however small the kernel's channels are
+ */
+#define MAX_CHANNELS 1024
+
+static int chids[MAX_CHANNELS];
+
+static uint32_t committed (void)
+{
+    struct MemoryStats stats;
+
+    assert(GetMemoryStats(&stats) == 0);
+
+    /* Nothing, the pagetable included, takes a process past its limit */
+    assert(stats.committed_pages <= PAGE_LIMIT);
+
+    return stats.committed_pages;
+}
+
+int main () {
+    unsigned int grown = 0;
+    unsigned int channels;
+    uint32_t full;
+
+    /* Keep taking heap until the kernel says no */
+    while (sbrk(CHUNK_PAGES * PAGE_SIZE) != (void *)-1) {
+        grown += CHUNK_PAGES;
+        assert(grown < PAGE_LIMIT);
+        committed();
+    }
+
+    assert(errno == ENOMEM);
+
+    /* Program image, stack and pagetable take some; the heap gets the rest */
+    assert(grown > PAGE_LIMIT / 2);
+
+    /* Then a page at a time, right up to the limit */
+    while (sbrk(PAGE_SIZE) != (void *)-1) {
+        grown++;
+        committed();
+    }
+
+    assert(errno == ENOMEM);
+
+    /* Kernel objects count too, so they soon run out as well */
+    full = committed();
+
+    for (channels = 0; channels < MAX_CHANNELS; channels++) {
+        int chid = ChannelCreate();
+
+        if (chid < 0) {
+            assert(chid == -ERROR_NO_MEM);
+            break;
+        }
+
+        chids[channels] = chid;
+        committed();
+    }
+
+    assert(channels < MAX_CHANNELS);
+
+    while (channels > 0) {
+        assert(ChannelDestroy(chids[--channels]) == 0);
+    }
+
+    assert(committed() == full);
+
+    /* Giving memory back makes room again */
+    assert(sbrk(-(int)(grown * PAGE_SIZE)) != (void *)-1);
+    assert(sbrk(CHUNK_PAGES * PAGE_SIZE) != (void *)-1);
+    assert(ChannelCreate() >= 0);
+
+    return 0;
+}
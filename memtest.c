@@ -0,0 +1,214 @@
+/*
+ * Host-side check of the kernel's memcpy(), memset(), PageZero() and PageCopy()
+ * against every combination of source alignment, destination alignment
+ * and short length. Build and run with:
+ *
+ *   cc -Iinclude -fno-strict-aliasing -o memtest memtest.c && ./memtest
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* <muos/arch.h> only knows about ARM, so stand in for it */
+#define __MUOS_ARCH_H__
+#define PAGE_SIZE 4096
+
+/* Build the kernel's versions under names that don't clash with libc */
+#define memcpy  kernel_memcpy
+#define memset  kernel_memset
+#include "kernel/memory.c"
+#undef memcpy
+#undef memset
+
+enum
+{
+    /* Long enough to take the block loops a few times over */
+    MAX_LEN     = 3 * BLOCK_SIZE + 2 * WORD_SIZE + 3,
+
+    /* Untouched bytes kept on either side of the target range */
+    GUARD       = 16,
+
+    BUF_SIZE    = GUARD + WORD_SIZE + MAX_LEN + GUARD,
+};
+
+static unsigned int failures;
+
+static void fill_pattern (uint8_t * buf, size_t len, uint8_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed + i * 7);
+    }
+}
+
+static void check (int ok, char const * what, size_t src_align,
+                   size_t dst_align, size_t len)
+{
+    if (!ok) {
+        failures++;
+        printf("FAIL: %s (src +%u, dst +%u, len %u)\n", what,
+               (unsigned)src_align, (unsigned)dst_align, (unsigned)len);
+    }
+}
+
+static void test_memcpy (void)
+{
+    /* word_t-typed storage so that offset 0 is word-aligned */
+    word_t src_words[BUF_SIZE / WORD_SIZE + 1];
+    word_t dst_words[BUF_SIZE / WORD_SIZE + 1];
+    uint8_t * src = (uint8_t *)src_words;
+    uint8_t * dst = (uint8_t *)dst_words;
+    uint8_t expect[BUF_SIZE];
+    size_t src_align;
+    size_t dst_align;
+    size_t len;
+    size_t i;
+
+    for (src_align = 0; src_align < WORD_SIZE; src_align++) {
+        for (dst_align = 0; dst_align < WORD_SIZE; dst_align++) {
+            for (len = 0; len <= MAX_LEN; len++) {
+                uint8_t * s = src + GUARD + src_align;
+                uint8_t * d = dst + GUARD + dst_align;
+                void * ret;
+
+                fill_pattern(src, BUF_SIZE, 1);
+                fill_pattern(dst, BUF_SIZE, 101);
+                fill_pattern(expect, BUF_SIZE, 101);
+
+                for (i = 0; i < len; i++) {
+                    expect[GUARD + dst_align + i] = s[i];
+                }
+
+                ret = kernel_memcpy(d, s, len);
+
+                check(ret == d, "memcpy return value",
+                      src_align, dst_align, len);
+
+                for (i = 0; i < BUF_SIZE && dst[i] == expect[i]; i++) {
+                }
+
+                check(i == BUF_SIZE, "memcpy contents",
+                      src_align, dst_align, len);
+            }
+        }
+    }
+}
+
+static void test_memset (void)
+{
+    word_t buf_words[BUF_SIZE / WORD_SIZE + 1];
+    uint8_t * buf = (uint8_t *)buf_words;
+    uint8_t expect[BUF_SIZE];
+    size_t align;
+    size_t len;
+    size_t i;
+
+    for (align = 0; align < WORD_SIZE; align++) {
+        for (len = 0; len <= MAX_LEN; len++) {
+            uint8_t * d = buf + GUARD + align;
+            void * ret;
+
+            fill_pattern(buf, BUF_SIZE, 3);
+            fill_pattern(expect, BUF_SIZE, 3);
+
+            for (i = 0; i < len; i++) {
+                expect[GUARD + align + i] = 0xa5;
+            }
+
+            /* Only the low byte of the fill value counts */
+            ret = kernel_memset(d, 0x7a5, len);
+
+            check(ret == d, "memset return value", 0, align, len);
+
+            for (i = 0; i < BUF_SIZE && buf[i] == expect[i]; i++) {
+            }
+
+            check(i == BUF_SIZE, "memset contents", 0, align, len);
+        }
+    }
+}
+
+static void test_page_zero (void)
+{
+    uint8_t * pages;
+    uint8_t * page;
+    size_t i;
+
+    /* Page plus a guard page on either side */
+    pages = (uint8_t *)malloc(4 * PAGE_SIZE);
+
+    if (!pages) {
+        failures++;
+        printf("FAIL: out of memory\n");
+        return;
+    }
+
+    page = (uint8_t *)(((uintptr_t)pages + 2 * PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1));
+
+    for (i = 0; i < 4 * PAGE_SIZE; i++) {
+        pages[i] = 0xff;
+    }
+
+    PageZero(page);
+
+    for (i = 0; i < PAGE_SIZE && page[i] == 0; i++) {
+    }
+
+    check(i == PAGE_SIZE, "PageZero contents", 0, 0, PAGE_SIZE);
+    check(page[-1] == 0xff && page[PAGE_SIZE] == 0xff,
+          "PageZero bounds", 0, 0, PAGE_SIZE);
+
+    free(pages);
+}
+
+static void test_page_copy (void)
+{
+    uint8_t * pages;
+    uint8_t * src;
+    uint8_t * dst;
+    size_t i;
+
+    /* Two pages plus a guard page on either side of the destination */
+    pages = (uint8_t *)malloc(5 * PAGE_SIZE);
+
+    if (!pages) {
+        failures++;
+        printf("FAIL: out of memory\n");
+        return;
+    }
+
+    src = (uint8_t *)(((uintptr_t)pages + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1));
+    dst = src + 2 * PAGE_SIZE;
+
+    fill_pattern(src, PAGE_SIZE, 5);
+    dst[-1] = 0xff;
+    dst[PAGE_SIZE] = 0xff;
+
+    PageCopy(dst, src);
+
+    for (i = 0; i < PAGE_SIZE && dst[i] == src[i]; i++) {
+    }
+
+    check(i == PAGE_SIZE, "PageCopy contents", 0, 0, PAGE_SIZE);
+    check(dst[-1] == 0xff && dst[PAGE_SIZE] == 0xff,
+          "PageCopy bounds", 0, 0, PAGE_SIZE);
+
+    free(pages);
+}
+
+int main ()
+{
+    test_memcpy();
+    test_memset();
+    test_page_zero();
+    test_page_copy();
+
+    if (failures > 0) {
+        printf("%u failures\n", failures);
+        return 1;
+    }
+
+    printf("All passed\n");
+    return 0;
+}
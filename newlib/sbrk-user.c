@@ -11,6 +11,41 @@ static uintptr_t user_heap_size = 0;
 static uintptr_t kernel_heap_size = 0;
 static uint8_t * base;
 
+static void * SbrkUserShrink (uintptr_t decrement)
+{
+    struct ProcMgrMessage msg;
+    struct ProcMgrReply reply;
+    int ret;
+
+    uintptr_t kernel_decrement;
+
+    if (decrement > user_heap_size) {
+        errno = EINVAL;
+        return (void *)-1;
+    }
+
+    user_heap_size -= decrement;
+
+    /* Give back however many whole pages are no longer in use */
+    kernel_decrement = kernel_heap_size - user_heap_size;
+    kernel_decrement /= PAGE_SIZE;
+    kernel_decrement *= PAGE_SIZE;
+
+    if (kernel_decrement > 0) {
+        msg.type = PROC_MGR_MESSAGE_SBRK;
+        msg.payload.sbrk.increment = -(intptr_t)kernel_decrement;
+
+        ret = MessageSend(PROCMGR_CONNECTION_ID, &msg, sizeof(msg), &reply, sizeof(reply));
+
+        /* Not fatal; the pages just stay reserved for later growth */
+        if (ret == sizeof(reply)) {
+            kernel_heap_size -= kernel_decrement;
+        }
+    }
+
+    return base + user_heap_size + decrement;
+}
+
 static void * SbrkUser (int increment)
 {
     struct ProcMgrMessage msg;
@@ -19,6 +54,10 @@ static void * SbrkUser (int increment)
 
     intptr_t kernel_increment;
 
+    if (increment < 0) {
+        return SbrkUserShrink(-increment);
+    }
+
     if (increment <= kernel_heap_size - user_heap_size) {
         user_heap_size += increment;
         return &base[user_heap_size - increment];
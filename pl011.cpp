@@ -18,8 +18,19 @@
 
 #include "uart.h"
 
-#define VERSATILE_UART0_BASE    0x101F1000
-#define VERSATILE_UART0_IRQ     12
+/*
+ * On the RealView EB's MPCore test chip, board interrupt lines reach
+ * the GIC remapped, as shared interrupts numbered from 32. UART0's line
+ * 12 becomes shared interrupt 4.
+ */
+#if defined(BOARD_REALVIEW_EB_MPCORE)
+    #define UART0_BASE          0x10009000
+    #define UART0_IRQ           36
+#else
+    #define UART0_BASE          0x101F1000
+    #define UART0_IRQ           12
+#endif
+
 #define PL011_MMAP_SIZE         4096
 
 typedef struct
@@ -302,7 +313,8 @@ int main (int argc, char *argv[]) {
     Spawn("uio");
     Spawn("terminal");
 
-    uart0 = (volatile pl011_t *)MapPhysical(VERSATILE_UART0_BASE, PL011_MMAP_SIZE);
+    uart0 = (volatile pl011_t *)MapPhysical(UART0_BASE, PL011_MMAP_SIZE,
+                                           CACHE_ATTR_STRONGLY_ORDERED);
 
     pl011_printf(uart0, "PL011 UART driver started up in echo mode...\n");
 
@@ -312,7 +324,7 @@ int main (int argc, char *argv[]) {
     // Enable interrupts
     uart0->IMSC = (IMSC_RX | IMSC_TX);
 
-    irq_handler_id = InterruptAttach(coid, VERSATILE_UART0_IRQ, NULL);
+    irq_handler_id = InterruptAttach(coid, UART0_IRQ, NULL);
 
     // Main interrupt-handling loop
     for (;;) {
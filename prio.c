@@ -0,0 +1,254 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/error.h>
+#include <muos/io.h>
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+#define MSEC            ((uint64_t)1000 * 1000)
+
+/* Must match the priority init.c spawns this program with */
+#define SPAWN_PRIORITY  (SCHED_PRIORITY_DEFAULT + 4)
+
+/* More than any board this runs on */
+#define MAX_CPUS        16
+
+/* Busy-work done between reports; long enough to span timer ticks */
+#define SPIN            200000
+
+/* Reports taken from each low spinner before starting the high thread */
+#define LOW_WARMUP      3
+
+/* Times the high-priority thread sleeps and is woken */
+#define HIGH_ROUNDS     20
+
+/* How long it sleeps each time */
+#define HIGH_SLEEP      (2 * MSEC)
+
+/*
+ * Most a wakeup may be late by: the timer's resolution of about a
+ * millisecond, with some to spare. A thread made ready while one of
+ * lower priority has the CPU should take it over right away. Left to
+ * wait for the next 5ms timeslice tick instead, it would often be
+ * later than this.
+ */
+#define MAX_WAKE_LATE   (2 * MSEC)
+
+enum
+{
+    REPORT_LOW = 1,
+};
+
+/* What the high-priority thread sends once it's done */
+struct Report
+{
+    uint32_t late_ns[HIGH_ROUNDS];
+};
+
+/*
+ * Nanoseconds from each of the high-priority thread's timers expiring
+ * to its running, while every CPU was kept busy by a low-priority
+ * spinner. Left here to be read from the debugger.
+ */
+static volatile uint32_t late_ns[HIGH_ROUNDS];
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static unsigned int count_cpus (void)
+{
+    unsigned int cpus;
+    uint32_t count;
+
+    for (cpus = 0; cpus < MAX_CPUS; cpus++) {
+        if (GetInterruptCount(cpus, &count) != 0) {
+            break;
+        }
+    }
+
+    return cpus;
+}
+
+static void spin (void)
+{
+    volatile unsigned int i;
+
+    for (i = 0; i < SPIN; i++) {
+    }
+}
+
+static void run_low (int coid)
+{
+    int who = REPORT_LOW;
+    int stop;
+
+    assert(SetPriority(SCHED_PRIORITY_MIN) == ERROR_OK);
+    assert(GetPriority() == SCHED_PRIORITY_MIN);
+
+    do {
+        int n;
+
+        spin();
+
+        /* The parent replies nonzero once it wants this to stop */
+        n = MessageSend(coid, &who, sizeof(who), &stop, sizeof(stop));
+        assert(n == sizeof(stop));
+    } while (!stop);
+}
+
+static void run_high (int coid)
+{
+    int chid = ChannelCreate();
+    int timer = TimerCreate(Connect(SELF_PID, chid), 0);
+    struct Report report;
+    unsigned int i;
+
+    assert(timer > 0);
+
+    /* Forked children start out with the forker's priority */
+    assert(GetPriority() == SPAWN_PRIORITY);
+
+    assert(SetPriority(SCHED_PRIORITY_MAX) == ERROR_OK);
+
+    for (i = 0; i < HIGH_ROUNDS; i++) {
+        struct Pulse pulse;
+        uint64_t due = now() + HIGH_SLEEP;
+        int msgid;
+
+        assert(TimerArm(timer, HIGH_SLEEP, 0) == 0);
+
+        assert(MessageReceive(chid, &msgid, &pulse, sizeof(pulse)) == sizeof(pulse));
+        assert(msgid == 0 && pulse.type == PULSE_TYPE_TIMER);
+
+        report.late_ns[i] = now() - due;
+    }
+
+    assert(TimerDestroy(timer) == 0);
+
+    assert(MessageSend(coid, &report, sizeof(report), NULL, 0) == 0);
+}
+
+static int start (int coid, void (*body)(int coid))
+{
+    int pid = Fork();
+
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        body(coid);
+        Exit();
+    }
+
+    return pid;
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    int wait_id;
+    unsigned int cpus;
+    unsigned int i;
+    unsigned int warmup;
+    unsigned int finished = 0;
+    int high_done = 0;
+
+    assert(GetPriority() == SPAWN_PRIORITY);
+
+    /* Outside the range open to user threads */
+    assert(SetPriority(SCHED_PRIORITY_MIN - 1) == -ERROR_INVALID);
+    assert(SetPriority(SCHED_PRIORITY_MAX + 1) == -ERROR_INVALID);
+    assert(GetPriority() == SPAWN_PRIORITY);
+
+    {
+        struct SpawnAttributes attr;
+
+        SpawnAttributesInit(&attr);
+        attr.priority = SCHED_PRIORITY_MAX + 1;
+        assert(SpawnWithAttributes("prio", &attr) < 0);
+    }
+
+    cpus = count_cpus();
+    assert(cpus > 0);
+
+    wait_id = ChildWaitAttach(coid, ANY_PID);
+    ChildWaitArm(wait_id, cpus + 1);
+
+    /*
+    A low spinner for every CPU, so that wherever the high-priority
+    thread wakes up, it has to take the CPU from one of them
+    */
+    for (i = 0; i < cpus; i++) {
+        start(coid, run_low);
+    }
+
+    /*
+    We outrank the low spinners, so they only get the CPUs while we're
+    waiting here.
+    */
+    for (warmup = 0; warmup < cpus * LOW_WARMUP; warmup++) {
+        int msgid;
+        int who;
+        int stop = 0;
+
+        assert(MessageReceive(chid, &msgid, &who, sizeof(who)) == sizeof(who));
+        assert(msgid != 0 && who == REPORT_LOW);
+        MessageReply(msgid, 0, &stop, sizeof(stop));
+    }
+
+    start(coid, run_high);
+
+    while (finished < cpus + 1) {
+        union {
+            int who;
+            struct Pulse pulse;
+            struct Report report;
+        } msg;
+        int msgid;
+        int n = MessageReceive(chid, &msgid, &msg, sizeof(msg));
+
+        if (msgid == 0) {
+            assert(n == sizeof(struct Pulse));
+            assert(msg.pulse.type == PULSE_TYPE_CHILD_FINISH);
+            finished++;
+            continue;
+        }
+
+        if (n == sizeof(struct Report)) {
+            for (i = 0; i < HIGH_ROUNDS; i++) {
+                late_ns[i] = msg.report.late_ns[i];
+            }
+
+            high_done = 1;
+            MessageReply(msgid, 0, NULL, 0);
+        }
+        else {
+            /* Once the high-priority thread is done, let the low ones finish */
+            int stop = high_done;
+
+            assert(n == sizeof(msg.who) && msg.who == REPORT_LOW);
+            MessageReply(msgid, 0, &stop, sizeof(stop));
+        }
+    }
+
+    assert(high_done);
+
+    /*
+    Woken from behind a low spinner, the high-priority thread must have
+    been given the CPU as soon as its timer fired, and not at the end
+    of the spinner's timeslice
+    */
+    for (i = 0; i < HIGH_ROUNDS; i++) {
+        assert(late_ns[i] < MAX_WAKE_LATE);
+    }
+
+    ChildWaitDetach(wait_id);
+
+    return 0;
+}
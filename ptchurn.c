@@ -0,0 +1,65 @@
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <muos/arch.h>
+#include <muos/process.h>
+
+#define SECTION_BYTES (1024 * 1024)
+
+/*
+ * Each trip maps and unmaps the one page on the far side of a 1MB
+ * boundary, which installs and then empties a second-level table.
+ * Unmapping a lone page goes through UnmapPage(), which is where
+ * emptied tables used to leak.
+ */
+#define TRIPS 100000
+
+static void trip (unsigned int i)
+{
+    char * p = sbrk(PAGE_SIZE);
+
+    assert(p != (char *)-1);
+
+    /* Touch the page past the boundary */
+    p[0] = (char)i;
+
+    assert(sbrk(-PAGE_SIZE) != (void *)-1);
+}
+
+int main () {
+    struct MemoryStats before;
+    struct MemoryStats after;
+    uintptr_t brk;
+    uintptr_t boundary;
+    unsigned int i;
+
+    /* sbrk(0) is meaningless until the heap has first grown */
+    brk = (uintptr_t)sbrk(PAGE_SIZE);
+    assert(brk != (uintptr_t)-1);
+    brk += PAGE_SIZE;
+
+    /* Fill the heap right up to the next boundary */
+    boundary = (brk + SECTION_BYTES - 1) & ~(uintptr_t)(SECTION_BYTES - 1);
+    assert(sbrk((int)(boundary - brk)) != (void *)-1);
+
+    /* Once round first, so that the spare table kept for reuse exists */
+    trip(0);
+    assert(GetMemoryStats(&before) == 0);
+
+    for (i = 1; i < TRIPS; i++) {
+        trip(i);
+    }
+
+    assert(GetMemoryStats(&after) == 0);
+
+    /*
+    Not a single table or page more than before. (The free count is
+    for the whole system, and others are running too, so it can only
+    be looked at, not compared.)
+    */
+    assert(after.secondlevel_tables == before.secondlevel_tables);
+    assert(after.committed_pages == before.committed_pages);
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <muos/arch.h>
+#include <muos/io.h>
+#include <muos/message.h>
+#include <muos/ramfs.h>
+
+/* Generated at build time; see the 'ramfs-map.dat' rule in wscript */
+#define DATA_FILE   "ramfs-map.dat"
+#define DATA_BYTES  (1024 * 1024)
+
+/* Must match the generator in wscript */
+static unsigned char expected (size_t i)
+{
+    return (unsigned char)(i * 7 + (i >> 12));
+}
+
+int main () {
+    unsigned char const * data;
+    size_t len;
+    size_t i;
+
+    data = RamFsMap(DATA_FILE, &len);
+    assert(data != NULL);
+    assert(len == DATA_BYTES);
+    assert((uintptr_t)data % PAGE_SIZE == 0);
+
+    for (i = 0; i < len; i++) {
+        assert(data[i] == expected(i));
+    }
+
+    /*
+    The mapping is read-only, and that has to hold even for the
+    kernel writing on our behalf: a receive that would store its
+    message id into the file must be refused.
+    */
+    {
+        int chid = ChannelCreate();
+        char buf[4];
+
+        assert(MessageReceive(chid, (int *)data, buf, sizeof(buf)) < 0);
+        assert(data[0] == expected(0));
+
+        ChannelDestroy(chid);
+    }
+
+    assert(Unmap((void *)data, (len + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)) == 0);
+
+    /* Mapping the same file again gives the same contents */
+    data = RamFsMap(DATA_FILE, NULL);
+    assert(data != NULL);
+    assert(data[DATA_BYTES - 1] == expected(DATA_BYTES - 1));
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <muos/message.h>
+#include <muos/timer.h>
+
+/*
+ * Each frame holds onto this much stack, so that the recursion
+ * quickly runs past what the kernel maps up front
+ */
+#define FRAME_BYTES 1024
+
+/*
+ * init spawns this with a stack limit of STACK_BYTES, twice the
+ * default, so that the recursion can go further than the default
+ * would let it
+ */
+#define STACK_BYTES (512 * 1024)
+
+/*
+ * Padding that puts what the kernel is asked to write well below
+ * anything the program has touched so far
+ */
+#define UNTOUCHED_BYTES (64 * 1024)
+
+static int recurse (int depth)
+{
+    volatile char frame[FRAME_BYTES];
+
+    frame[0] = (char)depth;
+    frame[FRAME_BYTES - 1] = (char)depth;
+
+    if (depth == 0) {
+        return frame[0];
+    }
+
+    /* Use the result so that this can't become a tail call */
+    return recurse(depth - 1) + frame[FRAME_BYTES - 1];
+}
+
+/* The kernel's write lands in stack the program has never used */
+static void clock_into_untouched (void)
+{
+    uint64_t deep[UNTOUCHED_BYTES / sizeof(uint64_t)];
+
+    assert(ClockGetTime(&deep[0]) == 0);
+    assert(deep[0] != 0);
+}
+
+/* Likewise a timer's pulse copied in, from further down still */
+static void receive_into_untouched (int chid, int coid)
+{
+    struct Pulse deep[2 * UNTOUCHED_BYTES / sizeof(struct Pulse)];
+    int timer = TimerCreate(coid, 42);
+    int msgid;
+
+    assert(timer > 0);
+    assert(TimerArm(timer, 1000 * 1000, 0) == 0);
+
+    assert(MessageReceive(chid, &msgid, &deep[0], sizeof(deep[0])) == sizeof(deep[0]));
+    assert(msgid == 0);
+    assert(deep[0].type == PULSE_TYPE_TIMER && deep[0].value == 42);
+
+    assert(TimerDestroy(timer) == 0);
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+
+    clock_into_untouched();
+    receive_into_untouched(chid, coid);
+
+    /*
+    About 384KB deep: well past the initial stack, and past the default
+    limit too, but under the one this was spawned with
+    */
+    recurse(STACK_BYTES / FRAME_BYTES * 3 / 4);
+
+    /*
+    Now run off the end of the stack altogether. The kernel should
+    report this to our parent as a stack overflow.
+    */
+    recurse(-1);
+
+    return 0;
+}
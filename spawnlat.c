@@ -0,0 +1,128 @@
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <muos/arch.h>
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+/* Large program spawned over and over to keep procmgr busy */
+#define BIG_IMAGE   "bigimage"
+
+/* Spawns the background process makes */
+#define SPAWNS      20
+
+/*
+ * Worst sbrk() round trip (grow by a page, then shrink back) seen with
+ * procmgr otherwise idle, and while another process spawns BIG_IMAGE
+ * in a loop; and how long one spawn of BIG_IMAGE takes. Left here to
+ * be read from the debugger.
+ */
+static volatile uint64_t idle_max_ns;
+static volatile uint64_t busy_max_ns;
+static volatile uint64_t spawn_ns;
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static uint64_t worst_sbrk_trip (uint64_t duration)
+{
+    uint64_t start = now();
+    uint64_t worst = 0;
+    uint64_t t = start;
+
+    while (t - start < duration) {
+        uint64_t trip_start = t;
+
+        assert(sbrk(PAGE_SIZE) != (void *)-1);
+        assert(sbrk(-PAGE_SIZE) != (void *)-1);
+
+        t = now();
+
+        if (t - trip_start > worst) {
+            worst = t - trip_start;
+        }
+    }
+
+    return worst;
+}
+
+static void await_child (int chid, int coid, int pid)
+{
+    struct Pulse pulse;
+    int wait_id;
+    int msgid;
+
+    wait_id = ChildWaitAttach(coid, pid);
+    assert(wait_id >= 0);
+    ChildWaitArm(wait_id, 1);
+
+    assert(MessageReceive(chid, &msgid, &pulse, sizeof(pulse)) == sizeof(pulse));
+    assert(msgid == 0);
+    assert(pulse.type == PULSE_TYPE_CHILD_FINISH);
+
+    ChildWaitDetach(wait_id);
+}
+
+static void spawn_big_image (int chid, int coid)
+{
+    int pid = Spawn(BIG_IMAGE);
+
+    assert(pid >= 0);
+    await_child(chid, coid, pid);
+}
+
+static void run_spawner (void)
+{
+    /* Channels aren't inherited */
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    unsigned int i;
+
+    for (i = 0; i < SPAWNS; i++) {
+        spawn_big_image(chid, coid);
+    }
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    uint64_t start;
+    int pid;
+
+    start = now();
+    spawn_big_image(chid, coid);
+    spawn_ns = now() - start;
+
+    idle_max_ns = worst_sbrk_trip(spawn_ns * SPAWNS / 4);
+
+    pid = Fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        run_spawner();
+        return 0;
+    }
+
+    /* Well inside the time the spawner keeps going for */
+    busy_max_ns = worst_sbrk_trip(spawn_ns * SPAWNS / 4);
+
+    await_child(chid, coid, pid);
+
+    /*
+    Only recorded, not compared. With one procmgr thread, a request
+    that came in during a spawn waited for the rest of it, so the worst
+    trip was about as long as a whole spawn; it should now be nearer
+    idle_max_ns. But everything else running at the same time shares
+    the CPUs and procmgr too, and can stretch any one trip past a spawn
+    on its own.
+    */
+
+    return 0;
+}
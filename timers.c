@@ -0,0 +1,182 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+#define MSEC    ((uint64_t)1000 * 1000)
+
+/*
+Most a wakeup may be late by: the timer's own resolution, plus two
+timeslices for sharing the CPU with another thread at the top priority
+*/
+#define SLACK   (12 * MSEC)
+
+/* Timers armed at once in the cost test */
+#define MANY    5000
+
+/* Due times in the cost test are spread over this long */
+#define SPREAD  (500 * MSEC)
+
+/* Expiries of the repeating timer to wait for */
+#define REPEATS 10
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static uint64_t const sleeps[] = {
+    1 * MSEC,
+    5 * MSEC,
+    20 * MSEC,
+    100 * MSEC,
+};
+
+static void test_sleep (void)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(sleeps) / sizeof(sleeps[0]); i++) {
+        uint64_t start = now();
+        uint64_t slept;
+
+        assert(NanoSleep(sleeps[i]) == 0);
+        slept = now() - start;
+
+        assert(slept >= sleeps[i]);
+        assert(slept < sleeps[i] + SLACK);
+    }
+}
+
+static struct Pulse receive_timer_pulse (int chid)
+{
+    struct Pulse pulse;
+    int msgid;
+    int n = MessageReceive(chid, &msgid, &pulse, sizeof(pulse));
+
+    assert(n == sizeof(pulse));
+    assert(msgid == 0);
+    assert(pulse.type == PULSE_TYPE_TIMER);
+
+    return pulse;
+}
+
+static void test_repeat (int chid, int coid)
+{
+    int timer = TimerCreate(coid, 42);
+    uint64_t start;
+    uint64_t elapsed;
+    unsigned int i;
+
+    assert(timer > 0);
+
+    start = now();
+    assert(TimerArm(timer, 10 * MSEC, 10 * MSEC) == 0);
+
+    for (i = 0; i < REPEATS; i++) {
+        assert(receive_timer_pulse(chid).value == 42);
+    }
+
+    elapsed = now() - start;
+    assert(elapsed >= REPEATS * 10 * MSEC);
+    assert(elapsed < REPEATS * 10 * MSEC + SLACK);
+
+    /* Disarming stops it; destroying it frees it */
+    assert(TimerArm(timer, 0, 0) == 0);
+    assert(TimerDestroy(timer) == 0);
+    assert(TimerDestroy(timer) < 0);
+    assert(TimerArm(timer, MSEC, 0) < 0);
+}
+
+static void test_many (int chid, int coid)
+{
+    static int timers[MANY];
+    static uint64_t due[MANY];
+    static unsigned char fired[MANY];
+    uint64_t start;
+    uint64_t armed;
+    uint64_t worst = 0;
+    unsigned int i;
+
+    for (i = 0; i < MANY; i++) {
+        timers[i] = TimerCreate(coid, i);
+        assert(timers[i] > 0);
+    }
+
+    /*
+    Arm in a scrambled order, so the wheel doesn't just get appended
+    to in due-time order
+    */
+    start = now();
+
+    for (i = 0; i < MANY; i++) {
+        unsigned int which = (i * 2999) % MANY;
+        uint64_t delay = 50 * MSEC + (SPREAD / MANY) * which;
+
+        due[which] = now() + delay;
+        assert(TimerArm(timers[which], delay, 0) == 0);
+    }
+
+    armed = now() - start;
+
+    /* Arming is constant-time, however many are armed already */
+    assert(armed / MANY < MSEC);
+
+    memset(fired, 0, sizeof(fired));
+
+    for (i = 0; i < MANY; i++) {
+        uintptr_t which = receive_timer_pulse(chid).value;
+        uint64_t late;
+
+        assert(which < MANY);
+        assert(!fired[which]);
+        fired[which] = 1;
+
+        /* Never early */
+        late = now() - due[which];
+        assert((int64_t)late >= 0);
+
+        if (late > worst) {
+            worst = late;
+        }
+    }
+
+    /*
+    Pulses are read one at a time behind the timers, so allow for the
+    backlog as well as the usual slack
+    */
+    assert(worst < SLACK + 50 * MSEC);
+
+    for (i = 0; i < MANY; i++) {
+        assert(TimerDestroy(timers[i]) == 0);
+    }
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    uint64_t before;
+    uint64_t after;
+
+    /* Stay ahead of the other test programs */
+    assert(SetPriority(SCHED_PRIORITY_MAX) == 0);
+
+    before = now();
+    after = now();
+    assert(after >= before);
+
+    assert(TimerCreate(-1, 0) < 0);
+
+    test_sleep();
+    test_repeat(chid, coid);
+    test_many(chid, coid);
+
+    return 0;
+}
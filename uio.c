@@ -17,7 +17,7 @@ int main (int argc, char *argv[])
     chid = ChannelCreate();
     coid = Connect(SELF_PID, chid);
 
-    void * zeroPtr = MapPhysical(0, 4096 * 4);
+    void * zeroPtr = MapPhysical(0, 4096 * 4, CACHE_ATTR_STRONGLY_ORDERED);
     zeroPtr = zeroPtr;
 
     int handler_id = InterruptAttach(coid, 4, NULL);
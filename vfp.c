@@ -0,0 +1,179 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+/*
+ * Steps of double-precision work each process does in the interleaved
+ * test. Enough to take many timeslices, so that each process gets
+ * preempted with its registers live over and over again.
+ */
+#define STEPS           2000000
+
+/* Message round trips timed for each kind of switch */
+#define ROUNDS          2000
+
+enum
+{
+    /* Neither side touches the VFP between switches */
+    TRIP_PLAIN,
+
+    /* Only the client does, so it keeps the VFP the whole time */
+    TRIP_ONE_USER,
+
+    /* Both do, so the registers change hands at every switch */
+    TRIP_BOTH_USERS,
+
+    TRIP_COUNT,
+};
+
+/*
+ * Nanoseconds per round trip of each kind. Two switches happen in
+ * each. Left here to be read from the debugger.
+ */
+static volatile uint64_t trip_ns[TRIP_COUNT];
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static double crunch (double x, double k, unsigned int steps)
+{
+    unsigned int i;
+
+    for (i = 0; i < steps; i++) {
+        x = x * k + 1.0 / (x + k);
+    }
+
+    return x;
+}
+
+static void client (int coid)
+{
+    double x;
+    double y = 1.0;
+    unsigned int kind;
+    unsigned int i;
+
+    x = crunch(0.5, 0.75, STEPS);
+
+    /* Report in, so that the parent can check it */
+    assert(MessageSend(coid, &x, sizeof(x), NULL, 0) == 0);
+
+    for (kind = 0; kind < TRIP_COUNT; kind++) {
+        for (i = 0; i < ROUNDS; i++) {
+            if (kind != TRIP_PLAIN) {
+                y = crunch(y, 0.5, 1);
+            }
+
+            assert(MessageSend(coid, &kind, sizeof(kind), NULL, 0) == 0);
+        }
+    }
+
+    /* Carried in a register across every switch above */
+    assert(MessageSend(coid, &y, sizeof(y), NULL, 0) == 0);
+}
+
+static uint64_t serve (int chid, unsigned int kind, double * z)
+{
+    uint64_t start = now();
+    unsigned int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        unsigned int sent;
+        int msgid;
+
+        assert(MessageReceive(chid, &msgid, &sent, sizeof(sent)) == sizeof(sent));
+        assert(msgid != 0 && sent == kind);
+
+        if (kind == TRIP_BOTH_USERS) {
+            *z = crunch(*z, 0.25, 1);
+        }
+
+        MessageReply(msgid, 0, NULL, 0);
+    }
+
+    return (now() - start) / ROUNDS;
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    double mine_expected;
+    double theirs_expected;
+    double mine;
+    double theirs;
+    double z = 2.0;
+    unsigned int kind;
+    int wait_id;
+    int pid;
+
+    /* Worked out before there's anyone to share the VFP with */
+    mine_expected = crunch(0.25, 1.25, STEPS);
+    theirs_expected = crunch(0.5, 0.75, STEPS);
+
+    pid = Fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        client(coid);
+        return 0;
+    }
+
+    wait_id = ChildWaitAttach(coid, pid);
+    ChildWaitArm(wait_id, 1);
+
+    /* Same priority as the child, so the two take turns */
+    mine = crunch(0.25, 1.25, STEPS);
+    assert(mine == mine_expected);
+
+    {
+        int msgid;
+
+        assert(MessageReceive(chid, &msgid, &theirs, sizeof(theirs)) == sizeof(theirs));
+        assert(msgid != 0);
+        assert(theirs == theirs_expected);
+        MessageReply(msgid, 0, NULL, 0);
+    }
+
+    for (kind = 0; kind < TRIP_COUNT; kind++) {
+        trip_ns[kind] = serve(chid, kind, &z);
+    }
+
+    assert(z == crunch(2.0, 0.25, ROUNDS));
+
+    {
+        int msgid;
+
+        assert(MessageReceive(chid, &msgid, &theirs, sizeof(theirs)) == sizeof(theirs));
+        assert(msgid != 0);
+        assert(theirs == crunch(1.0, 0.5, 2 * ROUNDS));
+        MessageReply(msgid, 0, NULL, 0);
+    }
+
+    /*
+    Switching between a thread that uses the VFP and one that doesn't
+    costs next to nothing more than switching between two that don't.
+    */
+    assert(trip_ns[TRIP_ONE_USER] < trip_ns[TRIP_PLAIN] + trip_ns[TRIP_PLAIN] / 4);
+
+    {
+        struct Pulse pulse;
+        int msgid;
+        size_t n = MessageReceive(chid, &msgid, &pulse, sizeof(pulse));
+
+        assert(n == sizeof(struct Pulse));
+        assert(msgid == 0);
+        assert(pulse.type == PULSE_TYPE_CHILD_FINISH);
+    }
+
+    ChildWaitDetach(wait_id);
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <muos/arch.h>
+#include <muos/io.h>
+#include <muos/message.h>
+#include <muos/process.h>
+
+/*
+ * Enough one-byte pieces that the kernel's copy of the vector is
+ * several pages long, and so has to come from vmalloc()
+ */
+#define PIECES 2048
+
+/* Heap the child takes to punch holes in; plenty, but far from all of RAM */
+#define BUDGET_PAGES 1024
+
+static char send_bytes[PIECES];
+static char recv_bytes[PIECES];
+static struct iovec send_vec[PIECES];
+static struct iovec recv_vec[PIECES];
+
+/*
+ * Take a few megabytes of pages, write to every one so that each is
+ * sure to be backed by RAM, then give back every other one. None of
+ * the freed pages has its neighbor free, so the buddy allocator keeps
+ * them as single pages and hands them out before splitting any bigger
+ * block: the vector's pages then come back scattered, and have to be
+ * stitched together.
+ */
+static void fragment (void)
+{
+    struct MemoryStats before;
+    struct MemoryStats after;
+    unsigned int holes = 0;
+    uintptr_t start;
+    uintptr_t end;
+    uintptr_t page;
+
+    /* sbrk(0) is meaningless until the heap has first grown */
+    start = (uintptr_t)sbrk(BUDGET_PAGES * PAGE_SIZE);
+    assert(start != (uintptr_t)-1);
+    end = start + BUDGET_PAGES * PAGE_SIZE;
+
+    page = (start + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+
+    for (; page + PAGE_SIZE <= end; page += PAGE_SIZE) {
+        *(volatile char *)page = 1;
+    }
+
+    assert(GetMemoryStats(&before) == 0);
+
+    page = (start + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+
+    for (page += PAGE_SIZE;
+         page + PAGE_SIZE <= end;
+         page += 2 * PAGE_SIZE)
+    {
+        assert(Unmap((void *)page, PAGE_SIZE) == 0);
+        holes++;
+    }
+
+    assert(GetMemoryStats(&after) == 0);
+
+    /* Every hole really went back to the kernel */
+    assert(after.committed_pages + holes <= before.committed_pages);
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    int wait_id;
+    int pid;
+    int msgid;
+    int status;
+    size_t i;
+
+    for (i = 0; i < PIECES; i++) {
+        send_bytes[i] = (char)(i * 7);
+        send_vec[i].iov_base = &send_bytes[i];
+        send_vec[i].iov_len = 1;
+
+        recv_vec[i].iov_base = &recv_bytes[PIECES - 1 - i];
+        recv_vec[i].iov_len = 1;
+    }
+
+    pid = Fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        fragment();
+
+        /* The reply comes back through the same long vector */
+        status = MessageSendV(coid, send_vec, PIECES, send_vec, PIECES);
+        assert(status == PIECES);
+
+        for (i = 0; i < PIECES; i++) {
+            assert(send_bytes[i] == (char)(i * 3));
+        }
+
+        return 0;
+    }
+
+    wait_id = ChildWaitAttach(coid, pid);
+    ChildWaitArm(wait_id, 1);
+
+    /* Stored back to front, a piece at a time */
+    assert(MessageReceiveV(chid, &msgid, recv_vec, PIECES) == PIECES);
+    assert(msgid != 0);
+
+    for (i = 0; i < PIECES; i++) {
+        assert(recv_bytes[PIECES - 1 - i] == (char)(i * 7));
+        recv_bytes[PIECES - 1 - i] = (char)(i * 3);
+    }
+
+    assert(MessageReplyV(msgid, 0, recv_vec, PIECES) == 0);
+
+    {
+        struct Pulse pulse;
+        size_t n = MessageReceive(chid, &msgid, &pulse, sizeof(pulse));
+
+        assert(n == sizeof(struct Pulse));
+        assert(msgid == 0);
+        assert(pulse.type == PULSE_TYPE_CHILD_FINISH);
+    }
+
+    ChildWaitDetach(wait_id);
+
+    return 0;
+}
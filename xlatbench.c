@@ -0,0 +1,170 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <muos/arch.h>
+#include <muos/message.h>
+#include <muos/process.h>
+#include <muos/timer.h>
+
+/*
+ * Every message copy translates each page of the sender's and the
+ * receiver's buffers, so ROUNDS trips of a BUFFER_PAGES-page message
+ * do ROUNDS * BUFFER_PAGES * 2 page translations in the kernel.
+ */
+#define BUFFER_PAGES    64
+#define BUFFER_BYTES    (BUFFER_PAGES * PAGE_SIZE)
+#define ROUNDS          1000
+
+/*
+ * The same amount of data again, but sent as one byte from every other
+ * page. Nothing is contiguous, so each byte costs a full lookup.
+ */
+#define SCATTERED       (BUFFER_PAGES / 2)
+
+static struct iovec scattered[SCATTERED];
+
+/* What the child sends once it's done, after all the round trips */
+struct Report
+{
+    uint32_t contiguous_ns;
+    uint32_t scattered_ns;
+};
+
+/*
+ * Nanoseconds per round trip of the contiguous message, and of the
+ * scattered one, as timed by the child that sends them. Left here to be
+ * read from the debugger.
+ */
+static volatile uint32_t contiguous_ns;
+static volatile uint32_t scattered_ns;
+
+static uint64_t now (void)
+{
+    uint64_t t;
+
+    assert(ClockGetTime(&t) == 0);
+    return t;
+}
+
+static uint32_t checksum (unsigned char const * buf, size_t len)
+{
+    uint32_t sum = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        sum = sum * 31 + buf[i];
+    }
+
+    return sum;
+}
+
+static void serve (int chid, unsigned char * buf)
+{
+    unsigned int i;
+
+    for (i = 0; i < 2 * ROUNDS; i++) {
+        int msgid;
+        int n = MessageReceive(chid, &msgid, buf, BUFFER_BYTES);
+
+        assert(n == BUFFER_BYTES || n == SCATTERED);
+        assert(msgid != 0);
+
+        /* Echo back whatever arrived */
+        MessageReply(msgid, 0, buf, n);
+    }
+}
+
+int main () {
+    int chid = ChannelCreate();
+    int coid = Connect(SELF_PID, chid);
+    unsigned char * buf = malloc(BUFFER_BYTES);
+    unsigned char * reply = malloc(BUFFER_BYTES);
+    unsigned int i;
+    int wait_id;
+    int pid;
+
+    assert(buf != NULL && reply != NULL);
+
+    for (i = 0; i < BUFFER_BYTES; i++) {
+        buf[i] = (unsigned char)(i * 13);
+    }
+
+    for (i = 0; i < SCATTERED; i++) {
+        scattered[i].iov_base = &buf[2 * i * PAGE_SIZE + i];
+        scattered[i].iov_len = 1;
+    }
+
+    pid = Fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        uint64_t start;
+
+        /* Child sends, over the connection it inherited */
+        start = now();
+        for (i = 0; i < ROUNDS; i++) {
+            int n = MessageSend(coid, buf, BUFFER_BYTES, reply, BUFFER_BYTES);
+            assert(n == BUFFER_BYTES);
+        }
+        contiguous_ns = (now() - start) / ROUNDS;
+
+        assert(checksum(reply, BUFFER_BYTES) == checksum(buf, BUFFER_BYTES));
+
+        start = now();
+        for (i = 0; i < ROUNDS; i++) {
+            struct iovec replyv = { reply, SCATTERED };
+            int n = MessageSendV(coid, scattered, SCATTERED, &replyv, 1);
+            assert(n == SCATTERED);
+        }
+        scattered_ns = (now() - start) / ROUNDS;
+
+        for (i = 0; i < SCATTERED; i++) {
+            assert(reply[i] == buf[2 * i * PAGE_SIZE + i]);
+        }
+
+        {
+            struct Report report = { contiguous_ns, scattered_ns };
+
+            assert(MessageSend(coid, &report, sizeof(report), NULL, 0) == 0);
+        }
+
+        return 0;
+    }
+
+    wait_id = ChildWaitAttach(coid, pid);
+    ChildWaitArm(wait_id, 1);
+
+    /* Parent owns the channel, so it serves */
+    serve(chid, reply);
+
+    /* Then collects the child's timings, and waits for it to be gone */
+    {
+        struct Report report;
+        struct Pulse pulse;
+        int msgid;
+        size_t n;
+
+        n = MessageReceive(chid, &msgid, &report, sizeof(report));
+        assert(n == sizeof(report));
+        assert(msgid != 0);
+        MessageReply(msgid, 0, NULL, 0);
+
+        contiguous_ns = report.contiguous_ns;
+        scattered_ns = report.scattered_ns;
+
+        n = MessageReceive(chid, &msgid, &pulse, sizeof(pulse));
+        assert(n == sizeof(struct Pulse));
+        assert(msgid == 0);
+        assert(pulse.type == PULSE_TYPE_CHILD_FINISH);
+    }
+
+    assert(contiguous_ns != 0 && scattered_ns != 0);
+
+    ChildWaitDetach(wait_id);
+
+    free(reply);
+    free(buf);
+    return 0;
+}